@@ -25,8 +25,10 @@
 #include <avogadro/core/version.h>
 
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 using Avogadro::Io::FileFormatManager;
 using Avogadro::Core::Cube;
@@ -37,6 +39,7 @@ using std::cout;
 using std::endl;
 using std::string;
 using std::ostringstream;
+using std::vector;
 
 using Eigen::Vector3d;
 using Eigen::Vector3i;
@@ -56,7 +59,7 @@ int main(int argc, char* argv[])
 
   // Process the command line arguments, see what has been requested.
   string inFormat;
-  int orbitalNumber = 0;
+  vector<int> orbitalNumbers;
   string inFile;
   bool density = false;
   for (int i = 1; i < argc; ++i) {
@@ -71,8 +74,13 @@ int main(int argc, char* argv[])
       inFormat = argv[++i];
       cout << "input format " << inFormat << endl;
     } else if (current == "-orb" && i + 1 < argc) {
-      orbitalNumber = atoi(argv[++i]);
-      // cout << "plot orbital " << orbitalNumber << endl;
+      // A comma separated list of orbitals, all calculated in one pass.
+      std::istringstream list(argv[++i]);
+      string number;
+      while (getline(list, number, ',')) {
+        if (atoi(number.c_str()) > 0)
+          orbitalNumbers.push_back(atoi(number.c_str()));
+      }
     } else if (current == "-dens" && i < argc) {
       density = true;
     } else if (inFile.empty()) {
@@ -101,31 +109,38 @@ int main(int argc, char* argv[])
   } else {
     cout << "Error, no input file or stream supplied with format." << endl;
   }
-  if ((orbitalNumber > 0) && density) {
-    cout << "Error, choose either density or a single orbital, not both."
-         << endl;
+  if (!orbitalNumbers.empty() && density) {
+    cout << "Error, choose either density or orbitals, not both." << endl;
     return 1;
   }
 
   // cube header
   cout << "Avogadro generated cube" << endl;
-  if (orbitalNumber > 0)
-    cout << "Orbital " << orbitalNumber << endl;
-  else
+  if (orbitalNumbers.size() == 1) {
+    cout << "Orbital " << orbitalNumbers[0] << endl;
+  } else if (!orbitalNumbers.empty()) {
+    cout << "Orbitals";
+    for (size_t i = 0; i < orbitalNumbers.size(); ++i)
+      cout << " " << orbitalNumbers[i];
+    cout << endl;
+  } else {
     cout << "Electron Density" << endl;
+  }
 
   // set box dimensions in Bohr
   Vector3d min = Vector3d(-10.0, -10.0, -10.0);
   Vector3d max = Vector3d(10.0, 10.0, 10.0);
   Vector3i points = Vector3i(61, 61, 61);
 
-  Cube* m_qube = new Cube;
+  std::unique_ptr<Cube> m_qube(new Cube);
   m_qube->setLimits(min * BOHR_TO_ANGSTROM, max * BOHR_TO_ANGSTROM, points);
 
   min = m_qube->position(0) * ANGSTROM_TO_BOHR;
   Vector3d spacing = m_qube->spacing() * ANGSTROM_TO_BOHR;
   int nat = mol.atomCount();
-  printf("%4d %11.6f %11.6f %11.6f\n", nat, min.x(), min.y(), min.z());
+  // A negative atom count flags the orbital list following the atoms.
+  printf("%4d %11.6f %11.6f %11.6f\n", orbitalNumbers.empty() ? nat : -nat,
+         min.x(), min.y(), min.z());
   printf("%4d %11.6f %11.6f %11.6f\n", points.x(), spacing.x(), 0.0, 0.0);
   printf("%4d %11.6f %11.6f %11.6f\n", points.y(), 0.0, spacing.y(), .0);
   printf("%4d %11.6f %11.6f %11.6f\n", points.z(), 0.0, 0.0, spacing.z());
@@ -137,27 +152,53 @@ int main(int argc, char* argv[])
            mol.atomPosition3d(iatom).y() * ANGSTROM_TO_BOHR,
            mol.atomPosition3d(iatom).z() * ANGSTROM_TO_BOHR);
   }
-  if (orbitalNumber > 0)
-    cout << "1  " << orbitalNumber << endl;
+  if (!orbitalNumbers.empty()) {
+    cout << orbitalNumbers.size();
+    for (size_t i = 0; i < orbitalNumbers.size(); ++i)
+      cout << "  " << orbitalNumbers[i];
+    cout << endl;
+  }
 
-  GaussianSetTools* m_tools = new GaussianSetTools(&mol);
+  std::unique_ptr<GaussianSetTools> m_tools(new GaussianSetTools(&mol));
 
-  // print the qube values
+  // Calculate all of the cubes up front, the orbitals in a single pass. The
+  // cubes after the first are owned by extraCubes.
+  vector<std::unique_ptr<Cube>> extraCubes;
+  vector<Cube*> cubes(1, m_qube.get());
+  if (density || orbitalNumbers.empty()) {
+    m_tools->calculateElectronDensity(*m_qube);
+  } else {
+    vector<int> orbitals;
+    for (size_t i = 0; i < orbitalNumbers.size(); ++i) {
+      if (i > 0) {
+        extraCubes.push_back(std::unique_ptr<Cube>(new Cube));
+        extraCubes.back()->setLimits(*m_qube);
+        cubes.push_back(extraCubes.back().get());
+      }
+      orbitals.push_back(orbitalNumbers[i] - 1);
+    }
+    if (!m_tools->calculateMolecularOrbitals(cubes, orbitals)) {
+      cout << "Error, invalid orbital number." << endl;
+      return 1;
+    }
+  }
+
+  // print the qube values, with the orbitals interleaved for each point
   int linecount = 0;
   for (unsigned int i = 0; i < m_qube->data()->size(); i++) {
     if (i % points.z() == 0 && i > 0) {
       linecount = 0;
       printf("\n");
     }
-    double value =
-      m_tools->calculateMolecularOrbital(m_qube->position(i), orbitalNumber);
-    printf("%13.5E", value);
-    // line wrapping
-    linecount++;
-    if (linecount % 6 == 0 && i > 0)
-      printf("\n");
-    else
-      printf(" ");
+    for (size_t j = 0; j < cubes.size(); ++j) {
+      printf("%13.5E", (*cubes[j]->data())[i]);
+      // line wrapping
+      linecount++;
+      if (linecount % 6 == 0)
+        printf("\n");
+      else
+        printf(" ");
+    }
   }
   printf("\n");
 
@@ -167,6 +208,6 @@ int main(int argc, char* argv[])
 void printHelp()
 {
   cout << "Usage: qube [-i <input-type>] <infilename> [-dens] [-orb <orbital "
-          "number>] [-v / --version] \n"
+          "number>[,<orbital number>...]] [-v / --version] \n"
        << endl;
 }
@@ -194,14 +194,14 @@ template <class Molecule_T>
 typename BondTemplate<Molecule_T>::AtomType BondTemplate<Molecule_T>::atom1()
   const
 {
-  return AtomType(m_molecule, m_molecule->bondPairs()[m_index].first);
+  return AtomType(m_molecule, m_molecule->bondPair(m_index).first);
 }
 
 template <class Molecule_T>
 typename BondTemplate<Molecule_T>::AtomType BondTemplate<Molecule_T>::atom2()
   const
 {
-  return AtomType(m_molecule, m_molecule->bondPairs()[m_index].second);
+  return AtomType(m_molecule, m_molecule->bondPair(m_index).second);
 }
 
 template <class Molecule_T>
@@ -213,7 +213,7 @@ void BondTemplate<Molecule_T>::setOrder(unsigned char o)
 template <class Molecule_T>
 unsigned char BondTemplate<Molecule_T>::order() const
 {
-  return m_molecule->bondOrders()[m_index];
+  return m_molecule->bondOrder(m_index);
 }
 
 } // end Core namespace
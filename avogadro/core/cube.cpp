@@ -20,11 +20,13 @@
 #include "molecule.h"
 #include "mutex.h"
 
+#include <algorithm>
+
 namespace Avogadro {
 namespace Core {
 
 Cube::Cube()
-  : m_data(0), m_min(0.0, 0.0, 0.0), m_max(0.0, 0.0, 0.0),
+  : m_data(0), m_precision(Double), m_min(0.0, 0.0, 0.0), m_max(0.0, 0.0, 0.0),
     m_spacing(0.0, 0.0, 0.0), m_points(0, 0, 0), m_minValue(0.0),
     m_maxValue(0.0), m_lock(new Mutex)
 {
@@ -47,7 +49,7 @@ bool Cube::setLimits(const Vector3& min_, const Vector3& max_,
   m_min = min_;
   m_max = max_;
   m_points = points;
-  m_data.resize(m_points.x() * m_points.y() * m_points.z());
+  resizeData();
   return true;
 }
 
@@ -73,7 +75,7 @@ bool Cube::setLimits(const Vector3& min_, const Vector3i& dim,
   m_max = max_;
   m_points = dim;
   m_spacing = spacing_;
-  m_data.resize(m_points.x() * m_points.y() * m_points.z());
+  resizeData();
   return true;
 }
 
@@ -83,7 +85,7 @@ bool Cube::setLimits(const Cube& cube)
   m_max = cube.m_max;
   m_points = cube.m_points;
   m_spacing = cube.m_spacing;
-  m_data.resize(m_points.x() * m_points.y() * m_points.z());
+  resizeData();
   return true;
 }
 
@@ -119,6 +121,28 @@ bool Cube::setLimits(const Molecule& mol, double spacing_, double padding)
   return setLimits(min_, max_, spacing_);
 }
 
+void Cube::setPrecision(Precision precision_)
+{
+  if (precision_ == m_precision)
+    return;
+  if (precision_ == Float) {
+    m_floatData.assign(m_data.begin(), m_data.end());
+    std::vector<double>().swap(m_data);
+  } else {
+    m_data.assign(m_floatData.begin(), m_floatData.end());
+    std::vector<float>().swap(m_floatData);
+  }
+  m_precision = precision_;
+}
+
+void Cube::resizeData()
+{
+  if (m_precision == Float)
+    m_floatData.resize(pointCount());
+  else
+    m_data.resize(pointCount());
+}
+
 std::vector<double>* Cube::data()
 {
   return &m_data;
@@ -129,54 +153,92 @@ const std::vector<double>* Cube::data() const
   return &m_data;
 }
 
-bool Cube::setData(const std::vector<double>& values)
+std::vector<float>* Cube::floatData()
+{
+  return &m_floatData;
+}
+
+const std::vector<float>* Cube::floatData() const
+{
+  return &m_floatData;
+}
+
+namespace {
+
+template <typename T>
+void findRange(const T* values, size_t count, double& minValue,
+               double& maxValue)
+{
+  T lo = values[0];
+  T hi = values[0];
+  for (size_t i = 1; i < count; ++i) {
+    lo = std::min(lo, values[i]);
+    hi = std::max(hi, values[i]);
+  }
+  minValue = lo;
+  maxValue = hi;
+}
+
+} // namespace
+
+template <typename T>
+bool Cube::assignData(const std::vector<T>& values)
 {
   if (!values.size())
     return false;
 
-  if (static_cast<int>(values.size()) ==
-      m_points.x() * m_points.y() * m_points.z()) {
-    m_data = values;
+  if (values.size() == pointCount()) {
+    if (m_precision == Float)
+      m_floatData.assign(values.begin(), values.end());
+    else
+      m_data.assign(values.begin(), values.end());
     // Now to update the minimum and maximum values
-    m_minValue = m_maxValue = m_data[0];
-    for (std::vector<double>::const_iterator it = values.begin();
-         it != values.end(); ++it) {
-      if (*it < m_minValue)
-        m_minValue = *it;
-      else if (*it > m_maxValue)
-        m_maxValue = *it;
-    }
+    findRange(values.data(), values.size(), m_minValue, m_maxValue);
     return true;
   } else {
     return false;
   }
 }
 
+bool Cube::setData(const std::vector<double>& values)
+{
+  return assignData(values);
+}
+
+bool Cube::setData(const std::vector<float>& values)
+{
+  return assignData(values);
+}
+
 bool Cube::addData(const std::vector<double>& values)
 {
   // Initialise the cube to zero if necessary
-  if (!m_data.size())
-    m_data.resize(m_points.x() * m_points.y() * m_points.z());
-  if (values.size() != m_data.size() || !values.size())
+  if (m_precision == Float ? m_floatData.empty() : m_data.empty())
+    resizeData();
+  if (values.size() != pointCount() || !values.size())
     return false;
-  for (unsigned int i = 0; i < m_data.size(); i++) {
-    m_data[i] += values[i];
-    if (m_data[i] < m_minValue)
-      m_minValue = m_data[i];
-    else if (m_data[i] > m_maxValue)
-      m_maxValue = m_data[i];
+  for (size_t i = 0; i < values.size(); i++) {
+    double sum;
+    if (m_precision == Float)
+      sum = m_floatData[i] += static_cast<float>(values[i]);
+    else
+      sum = m_data[i] += values[i];
+    if (sum < m_minValue)
+      m_minValue = sum;
+    if (sum > m_maxValue)
+      m_maxValue = sum;
   }
   return true;
 }
 
-unsigned int Cube::closestIndex(const Vector3& pos) const
+size_t Cube::closestIndex(const Vector3& pos) const
 {
   int i, j, k;
   // Calculate how many steps each coordinate is along its axis
   i = int((pos.x() - m_min.x()) / m_spacing.x());
   j = int((pos.y() - m_min.y()) / m_spacing.y());
   k = int((pos.z() - m_min.z()) / m_spacing.z());
-  return i * m_points.y() * m_points.z() + j * m_points.z() + k;
+  return pointIndex(i, j, k);
 }
 
 Vector3i Cube::indexVector(const Vector3& pos) const
@@ -189,19 +251,22 @@ Vector3i Cube::indexVector(const Vector3& pos) const
   return Vector3i(i, j, k);
 }
 
-Vector3 Cube::position(unsigned int index) const
+Vector3 Cube::position(size_t index) const
 {
+  const size_t planeSize = static_cast<size_t>(m_points.y()) * m_points.z();
   int x, y, z;
-  x = int(index / (m_points.y() * m_points.z()));
-  y = int((index - (x * m_points.y() * m_points.z())) / m_points.z());
-  z = index % m_points.z();
+  x = int(index / planeSize);
+  y = int((index - x * planeSize) / m_points.z());
+  z = int(index % m_points.z());
   return Vector3(x * m_spacing.x() + m_min.x(), y * m_spacing.y() + m_min.y(),
                  z * m_spacing.z() + m_min.z());
 }
 
 double Cube::value(int i, int j, int k) const
 {
-  unsigned int index = i * m_points.y() * m_points.z() + j * m_points.z() + k;
+  size_t index = pointIndex(i, j, k);
+  if (m_precision == Float)
+    return index < m_floatData.size() ? m_floatData[index] : 0.0;
   if (index < m_data.size())
     return m_data[index];
   else
@@ -210,8 +275,9 @@ double Cube::value(int i, int j, int k) const
 
 double Cube::value(const Vector3i& pos) const
 {
-  unsigned int index =
-    pos.x() * m_points.y() * m_points.z() + pos.y() * m_points.z() + pos.z();
+  size_t index = pointIndex(pos.x(), pos.y(), pos.z());
+  if (m_precision == Float)
+    return index < m_floatData.size() ? m_floatData[index] : 6969.0;
   if (index < m_data.size())
     return m_data[index];
   else
@@ -277,12 +343,15 @@ double Cube::value(const Vector3& pos) const
 
 bool Cube::setValue(int i, int j, int k, double value_)
 {
-  unsigned int index = i * m_points.y() * m_points.z() + j * m_points.z() + k;
-  if (index < m_data.size()) {
-    m_data[index] = value_;
+  size_t index = pointIndex(i, j, k);
+  if (index < (m_precision == Float ? m_floatData.size() : m_data.size())) {
+    if (m_precision == Float)
+      m_floatData[index] = static_cast<float>(value_);
+    else
+      m_data[index] = value_;
     if (value_ < m_minValue)
       m_minValue = value_;
-    else if (value_ > m_maxValue)
+    if (value_ > m_maxValue)
       m_maxValue = value_;
     return true;
   } else {
@@ -290,5 +359,57 @@ bool Cube::setValue(int i, int j, int k, double value_)
   }
 }
 
+bool Cube::fillValues(size_t first, size_t count, const double* values)
+{
+  const size_t size = m_precision == Float ? m_floatData.size() : m_data.size();
+  if (first > size || count > size - first)
+    return false;
+  if (m_precision == Float) {
+    float* data = m_floatData.data() + first;
+    for (size_t i = 0; i < count; ++i)
+      data[i] = static_cast<float>(values[i]);
+  } else {
+    std::copy(values, values + count, m_data.begin() + first);
+  }
+  return true;
+}
+
+bool Cube::fillValues(size_t first, size_t count, const double* values,
+                      double& minValue, double& maxValue)
+{
+  const size_t size = m_precision == Float ? m_floatData.size() : m_data.size();
+  if (first > size || count > size - first)
+    return false;
+  if (m_precision == Float) {
+    float* data = m_floatData.data() + first;
+    for (size_t i = 0; i < count; ++i) {
+      data[i] = static_cast<float>(values[i]);
+      minValue = std::min(minValue, static_cast<double>(data[i]));
+      maxValue = std::max(maxValue, static_cast<double>(data[i]));
+    }
+  } else {
+    double* data = m_data.data() + first;
+    for (size_t i = 0; i < count; ++i) {
+      data[i] = values[i];
+      minValue = std::min(minValue, values[i]);
+      maxValue = std::max(maxValue, values[i]);
+    }
+  }
+  return true;
+}
+
+bool Cube::valueRange(size_t first, size_t count, double& minValue,
+                      double& maxValue) const
+{
+  const size_t size = m_precision == Float ? m_floatData.size() : m_data.size();
+  if (count == 0 || first > size || count > size - first)
+    return false;
+  if (m_precision == Float)
+    findRange(m_floatData.data() + first, count, minValue, maxValue);
+  else
+    findRange(m_data.data() + first, count, minValue, maxValue);
+  return true;
+}
+
 } // End Core namespace
 } // End Avogadro namespace
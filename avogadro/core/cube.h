@@ -55,6 +55,27 @@ public:
     None
   };
 
+  /**
+   * \enum Precision The type the values of the cube are stored as.
+   */
+  enum Precision
+  {
+    Double,
+    Float
+  };
+
+  /**
+   * Set the type the values are stored as, converting any values already in
+   * the cube. Single precision halves the memory needed, and is plenty for
+   * the data in most volumetric files. The default is Double.
+   */
+  void setPrecision(Precision precision);
+
+  /**
+   * @return The type the values are stored as.
+   */
+  Precision precision() const { return m_precision; }
+
   /**
    * @return The minimum point in the cube.
    */
@@ -124,15 +145,33 @@ public:
   bool setLimits(const Molecule& mol, double spacing, double padding);
 
   /**
-   * @return Vector containing all the data in a one-dimensional array.
+   * @return The number of points in the cube.
+   */
+  size_t pointCount() const
+  {
+    return static_cast<size_t>(m_points.x()) * m_points.y() * m_points.z();
+  }
+
+  /**
+   * @return Vector containing all the data in a one-dimensional array. It is
+   * empty unless the precision() is Double.
    */
   std::vector<double>* data();
   const std::vector<double>* data() const;
 
   /**
-   * Set the values in the cube to those passed in the vector.
+   * @return Vector containing all the data in a one-dimensional array. It is
+   * empty unless the precision() is Float.
+   */
+  std::vector<float>* floatData();
+  const std::vector<float>* floatData() const;
+
+  /**
+   * Set the values in the cube to those passed in the vector, converting them
+   * to the precision() of the cube.
    */
   bool setData(const std::vector<double>& values);
+  bool setData(const std::vector<float>& values);
 
   /**
    * Adds the values in the cube to those passed in the vector.
@@ -143,7 +182,7 @@ public:
    * @return Index of the point closest to the position supplied.
    * @param pos Position to get closest index for.
    */
-  unsigned int closestIndex(const Vector3& pos) const;
+  size_t closestIndex(const Vector3& pos) const;
 
   /**
    * @param pos Position to get closest index for.
@@ -155,7 +194,7 @@ public:
    * @param index Index to be translated to a position.
    * @return Position of the given index.
    */
-  Vector3 position(unsigned int index) const;
+  Vector3 position(size_t index) const;
 
   /**
    * This function is very quick as it just returns the value at the point.
@@ -200,7 +239,42 @@ public:
    * Sets the value at the specified index in the cube.
    * @param i 1-dimenional index of the point to set in the cube.
    */
-  bool setValue(unsigned int i, double value);
+  bool setValue(size_t i, double value);
+
+  /**
+   * Write @a count values to the points from @a first on. Unlike setValue()
+   * this leaves the range of the cube alone, so several threads may fill
+   * disjoint ranges of points at once. Once they are done, set the range with
+   * setValueRange(), e.g. from the ranges of their points found as they are
+   * filled.
+   * @return False if the points are not all in the cube.
+   */
+  bool fillValues(size_t first, size_t count, const double* values);
+
+  /**
+   * As fillValues(size_t, size_t, const double*), and widen @a minValue and
+   * @a maxValue to take in the values as they are stored, so the range of a
+   * set of points can be found while filling them.
+   */
+  bool fillValues(size_t first, size_t count, const double* values,
+                  double& minValue, double& maxValue);
+
+  /**
+   * Get the smallest and largest of the @a count values from point @a first.
+   * @return False if there are no such points.
+   */
+  bool valueRange(size_t first, size_t count, double& minValue,
+                  double& maxValue) const;
+
+  /**
+   * Set the range of the values, e.g. after filling the cube with
+   * fillValues().
+   */
+  void setValueRange(double minValue, double maxValue)
+  {
+    m_minValue = minValue;
+    m_maxValue = maxValue;
+  }
 
   /**
    * @return The minimum  value at any point in the Cube.
@@ -224,7 +298,25 @@ public:
   Mutex* lock() const { return m_lock; }
 
 protected:
+  /**
+   * @return The index of the point i, j, k in the data.
+   */
+  size_t pointIndex(int i, int j, int k) const
+  {
+    return (static_cast<size_t>(i) * m_points.y() + j) * m_points.z() + k;
+  }
+
+  /**
+   * Size the data of the current precision to hold all of the points.
+   */
+  void resizeData();
+
+  template <typename T>
+  bool assignData(const std::vector<T>& values);
+
   std::vector<double> m_data;
+  std::vector<float> m_floatData;
+  Precision m_precision;
   Vector3 m_min, m_max, m_spacing;
   Vector3i m_points;
   double m_minValue, m_maxValue;
@@ -233,17 +325,22 @@ protected:
   Mutex* m_lock;
 };
 
-inline bool Cube::setValue(unsigned int i, double value_)
+inline bool Cube::setValue(size_t i, double value_)
 {
-  if (i < m_data.size()) {
+  if (m_precision == Float) {
+    if (i >= m_floatData.size())
+      return false;
+    m_floatData[i] = static_cast<float>(value_);
+  } else {
+    if (i >= m_data.size())
+      return false;
     m_data[i] = value_;
-    if (value_ > m_maxValue)
-      m_maxValue = value_;
-    if (value_ < m_minValue)
-      m_minValue = value_;
-    return true;
-  } else
-    return false;
+  }
+  if (value_ > m_maxValue)
+    m_maxValue = value_;
+  if (value_ < m_minValue)
+    m_minValue = value_;
+  return true;
 }
 
 } // End Core namespace
@@ -0,0 +1,72 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include "framesource.h"
+
+namespace Avogadro {
+namespace Core {
+
+FrameSource::FrameSource() : m_cacheSize(8)
+{
+}
+
+FrameSource::FrameSource(const FrameSource& other)
+  : m_cacheSize(other.m_cacheSize)
+{
+}
+
+FrameSource::~FrameSource()
+{
+}
+
+bool FrameSource::frame(Index index, Array<Vector3>& coordinates)
+{
+  if (index >= frameCount())
+    return false;
+
+  // The lock is held while reading too, as most sources share one stream.
+  m_mutex.lock();
+  for (auto it = m_cache.begin(); it != m_cache.end(); ++it) {
+    if (it->first == index) {
+      m_cache.splice(m_cache.begin(), m_cache, it);
+      coordinates = it->second;
+      m_mutex.unlock();
+      return true;
+    }
+  }
+
+  Array<Vector3> read;
+  if (!readFrame(index, read)) {
+    m_mutex.unlock();
+    return false;
+  }
+  coordinates = read;
+  if (m_cacheSize > 0) {
+    m_cache.push_front(std::make_pair(index, read));
+    if (m_cache.size() > m_cacheSize)
+      m_cache.pop_back();
+  }
+  m_mutex.unlock();
+  return true;
+}
+
+void FrameSource::setCacheSize(Index size)
+{
+  m_mutex.lock();
+  m_cacheSize = size;
+  while (m_cache.size() > m_cacheSize)
+    m_cache.pop_back();
+  m_mutex.unlock();
+}
+
+void FrameSource::clearCache()
+{
+  m_mutex.lock();
+  m_cache.clear();
+  m_mutex.unlock();
+}
+
+} // namespace Core
+} // namespace Avogadro
@@ -0,0 +1,83 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#ifndef AVOGADRO_CORE_FRAMESOURCE_H
+#define AVOGADRO_CORE_FRAMESOURCE_H
+
+#include "avogadrocore.h"
+
+#include "array.h"
+#include "mutex.h"
+#include "vector.h"
+
+#include <list>
+#include <utility>
+
+namespace Avogadro {
+namespace Core {
+
+/**
+ * @class FrameSource framesource.h <avogadro/core/framesource.h>
+ * @brief The FrameSource class provides the coordinate sets of a trajectory
+ * on demand.
+ *
+ * Large trajectories do not fit in memory as one coordinate set per frame.
+ * A FrameSource instead reads each frame when it is asked for, typically from
+ * the file it was loaded from, and keeps only the most recently used frames
+ * around. Subclasses implement frameCount(), readFrame() and clone().
+ */
+class AVOGADROCORE_EXPORT FrameSource
+{
+public:
+  FrameSource();
+  FrameSource(const FrameSource& other);
+  virtual ~FrameSource();
+
+  /**
+   * @return A new copy of this source, which the caller owns.
+   */
+  virtual FrameSource* clone() const = 0;
+
+  /**
+   * @return The number of frames available.
+   */
+  virtual Index frameCount() const = 0;
+
+  /**
+   * Get the coordinates of frame @a index, reading it if it is not cached.
+   * @return False if the index is out of range or the frame cannot be read.
+   */
+  bool frame(Index index, Array<Vector3>& coordinates);
+
+  /**
+   * The number of frames kept in memory, 8 by default.
+   */
+  void setCacheSize(Index size);
+  Index cacheSize() const { return m_cacheSize; }
+
+  /**
+   * Drop all of the cached frames.
+   */
+  void clearCache();
+
+protected:
+  /**
+   * Read the coordinates of frame @a index, which is less than frameCount().
+   */
+  virtual bool readFrame(Index index, Array<Vector3>& coordinates) = 0;
+
+private:
+  FrameSource& operator=(const FrameSource&); // Not implemented.
+
+  // Most recently used first.
+  std::list<std::pair<Index, Array<Vector3>>> m_cache;
+  Index m_cacheSize;
+  Mutex m_mutex;
+};
+
+} // namespace Core
+} // namespace Avogadro
+
+#endif // AVOGADRO_CORE_FRAMESOURCE_H
@@ -22,7 +22,10 @@
 #include "gaussianset.h"
 #include "molecule.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 using std::cout;
 using std::endl;
@@ -32,7 +35,287 @@ using std::vector;
 namespace Avogadro {
 namespace Core {
 
-GaussianSetTools::GaussianSetTools(Molecule* mol) : m_molecule(mol)
+namespace {
+
+// Grid points are evaluated in blocks of this many points, which keeps the
+// basis function values of a block in cache.
+const size_t blockSize = 128;
+
+// Shells are skipped at points where each primitive is below this value.
+const double cutoffThreshold = 1e-10;
+
+typedef Eigen::Array<double, Eigen::Dynamic, 1> ArrayX;
+typedef Eigen::Array<double, Eigen::Dynamic, Eigen::Dynamic> ArrayXX;
+typedef Eigen::Matrix<double, 3, Eigen::Dynamic> Matrix3X;
+
+struct ShellData
+{
+  int type;
+  unsigned int components;
+  unsigned int moIndex;
+  unsigned int gtoBegin;
+  unsigned int gtoEnd;
+  unsigned int cIndex;
+  // Squared distance (Bohr) beyond which the shell is negligible.
+  double cutoff2;
+};
+
+struct AtomShells
+{
+  Vector3 center;
+  double cutoff2;
+  std::vector<ShellData> shells;
+};
+
+// Evaluates all basis functions for blocks of points. The shells are sorted
+// by atom, and whole atoms or shells are skipped when the block lies outside
+// of their cutoff radius. Each primitive is evaluated for the whole block at
+// once, which lets Eigen vectorize the exponentials.
+class BlockEvaluator
+{
+public:
+  BlockEvaluator(GaussianSet& basis, const Molecule& molecule);
+
+  Index basisCount() const { return m_basisCount; }
+
+  // Fill values (points x basis functions) for points given in Bohr. Only
+  // the columns of the shells listed in active() are set, all other basis
+  // functions are negligible for the block.
+  void evaluate(const Matrix3X& points, MatrixX& values);
+
+  const std::vector<const ShellData*>& active() const { return m_active; }
+
+private:
+  void evaluateShell(const ShellData& shell, MatrixX& values);
+
+  const std::vector<double>& m_gtoA;
+  const std::vector<double>& m_gtoCN;
+  std::vector<AtomShells> m_atoms;
+  std::vector<const ShellData*> m_active;
+  Index m_basisCount;
+
+  // Workspace for the current block and atom.
+  ArrayX m_x, m_y, m_z, m_r2, m_exp;
+  ArrayXX m_radial;
+};
+
+int angularMomentum(int type)
+{
+  switch (type) {
+    case GaussianSet::S:
+      return 0;
+    case GaussianSet::P:
+      return 1;
+    case GaussianSet::D:
+    case GaussianSet::D5:
+      return 2;
+    default:
+      return 3;
+  }
+}
+
+unsigned int componentCount(int type)
+{
+  switch (type) {
+    case GaussianSet::S:
+      return 1;
+    case GaussianSet::P:
+      return 3;
+    case GaussianSet::D:
+      return 6;
+    case GaussianSet::D5:
+      return 5;
+    case GaussianSet::F:
+      return 10;
+    case GaussianSet::F7:
+      return 7;
+    default:
+      // Not handled - no contribution
+      return 0;
+  }
+}
+
+// Squared radius beyond which c * r^l * exp(-a * r^2) < cutoffThreshold,
+// found by fixed point iteration on r^2 = (ln(c / threshold) + l ln(r)) / a.
+double primitiveCutoff2(double c, double a, int l)
+{
+  double logC = std::log(std::abs(c) / cutoffThreshold);
+  if (logC <= 0.0 || a <= 0.0)
+    return 0.0;
+  double r2 = logC / a;
+  for (int i = 0; i < 5; ++i)
+    r2 = (logC + 0.5 * l * std::log(std::max(r2, 1.0))) / a;
+  return r2;
+}
+
+BlockEvaluator::BlockEvaluator(GaussianSet& basis, const Molecule& molecule)
+  : m_gtoA(basis.gtoA()), m_gtoCN(basis.gtoCN()), m_basisCount(0)
+{
+  const std::vector<int>& symmetry = basis.symmetry();
+  const std::vector<unsigned int>& atomIndices = basis.atomIndices();
+  const std::vector<unsigned int>& moIndices = basis.moIndices();
+  const std::vector<unsigned int>& gtoIndices = basis.gtoIndices();
+  const std::vector<unsigned int>& cIndices = basis.cIndices();
+  const Array<Vector3>& positions = molecule.atomPositions3d();
+
+  m_basisCount = static_cast<Index>(basis.moMatrix().rows());
+  m_atoms.resize(positions.size());
+  for (size_t i = 0; i < m_atoms.size(); ++i) {
+    m_atoms[i].center = positions[i] * ANGSTROM_TO_BOHR;
+    m_atoms[i].cutoff2 = 0.0;
+  }
+
+  for (size_t i = 0; i < symmetry.size(); ++i) {
+    ShellData shell;
+    shell.type = symmetry[i];
+    shell.components = componentCount(shell.type);
+    if (shell.components == 0 || atomIndices[i] >= m_atoms.size() ||
+        i >= cIndices.size() || moIndices[i] + shell.components > m_basisCount)
+      continue;
+    shell.moIndex = moIndices[i];
+    shell.gtoBegin = gtoIndices[i];
+    shell.gtoEnd = gtoIndices[i + 1];
+    shell.cIndex = cIndices[i];
+
+    int l = angularMomentum(shell.type);
+    shell.cutoff2 = 0.0;
+    unsigned int cIndex = shell.cIndex;
+    for (unsigned int j = shell.gtoBegin; j < shell.gtoEnd; ++j) {
+      double c = 0.0;
+      for (unsigned int k = 0; k < shell.components; ++k)
+        c = std::max(c, std::abs(m_gtoCN[cIndex++]));
+      shell.cutoff2 =
+        std::max(shell.cutoff2, primitiveCutoff2(c, m_gtoA[j], l));
+    }
+
+    AtomShells& atom = m_atoms[atomIndices[i]];
+    atom.cutoff2 = std::max(atom.cutoff2, shell.cutoff2);
+    atom.shells.push_back(shell);
+  }
+}
+
+void BlockEvaluator::evaluate(const Matrix3X& points, MatrixX& values)
+{
+  Index count = points.cols();
+  values.resize(count, m_basisCount);
+  m_active.clear();
+  if (count == 0)
+    return;
+
+  Vector3 boxMin = points.rowwise().minCoeff();
+  Vector3 boxMax = points.rowwise().maxCoeff();
+
+  for (size_t i = 0; i < m_atoms.size(); ++i) {
+    const AtomShells& atom = m_atoms[i];
+    if (atom.shells.empty())
+      continue;
+
+    // Closest distance between the atom and the bounding box of the block.
+    Vector3 outside = (boxMin - atom.center)
+                        .cwiseMax(atom.center - boxMax)
+                        .cwiseMax(Vector3::Zero());
+    double boxDistance2 = outside.squaredNorm();
+    if (boxDistance2 > atom.cutoff2)
+      continue;
+
+    m_x = points.row(0).transpose().array() - atom.center.x();
+    m_y = points.row(1).transpose().array() - atom.center.y();
+    m_z = points.row(2).transpose().array() - atom.center.z();
+    m_r2 = m_x.square() + m_y.square() + m_z.square();
+
+    for (size_t j = 0; j < atom.shells.size(); ++j) {
+      if (boxDistance2 <= atom.shells[j].cutoff2) {
+        evaluateShell(atom.shells[j], values);
+        m_active.push_back(&atom.shells[j]);
+      }
+    }
+  }
+}
+
+void BlockEvaluator::evaluateShell(const ShellData& shell, MatrixX& values)
+{
+  // Sum the contracted radial part of each component over the primitives.
+  m_radial.setZero(m_r2.size(), shell.components);
+  unsigned int cIndex = shell.cIndex;
+  for (unsigned int i = shell.gtoBegin; i < shell.gtoEnd; ++i) {
+    m_exp = (-m_gtoA[i] * m_r2).exp();
+    for (unsigned int j = 0; j < shell.components; ++j)
+      m_radial.col(j) += m_gtoCN[cIndex++] * m_exp;
+  }
+
+  // Then multiply by the angular part, in the order used by pointS etc.
+  const ArrayX& x = m_x;
+  const ArrayX& y = m_y;
+  const ArrayX& z = m_z;
+  Index b = shell.moIndex;
+  switch (shell.type) {
+    case GaussianSet::S:
+      values.col(b) = m_radial.col(0).matrix();
+      break;
+    case GaussianSet::P:
+      values.col(b) = (m_radial.col(0) * x).matrix();
+      values.col(b + 1) = (m_radial.col(1) * y).matrix();
+      values.col(b + 2) = (m_radial.col(2) * z).matrix();
+      break;
+    case GaussianSet::D:
+      values.col(b) = (m_radial.col(0) * x * x).matrix();
+      values.col(b + 1) = (m_radial.col(1) * y * y).matrix();
+      values.col(b + 2) = (m_radial.col(2) * z * z).matrix();
+      values.col(b + 3) = (m_radial.col(3) * x * y).matrix();
+      values.col(b + 4) = (m_radial.col(4) * x * z).matrix();
+      values.col(b + 5) = (m_radial.col(5) * y * z).matrix();
+      break;
+    case GaussianSet::D5:
+      values.col(b) = (m_radial.col(0) * (z * z - m_r2)).matrix();
+      values.col(b + 1) = (m_radial.col(1) * x * z).matrix();
+      values.col(b + 2) = (m_radial.col(2) * y * z).matrix();
+      values.col(b + 3) = (m_radial.col(3) * (x * x - y * y)).matrix();
+      values.col(b + 4) = (m_radial.col(4) * x * y).matrix();
+      break;
+    case GaussianSet::F:
+      values.col(b) = (m_radial.col(0) * x * x * x).matrix();
+      values.col(b + 1) = (m_radial.col(1) * x * x * y).matrix();
+      values.col(b + 2) = (m_radial.col(2) * x * x * z).matrix();
+      values.col(b + 3) = (m_radial.col(3) * x * y * y).matrix();
+      values.col(b + 4) = (m_radial.col(4) * x * y * z).matrix();
+      values.col(b + 5) = (m_radial.col(5) * x * z * z).matrix();
+      values.col(b + 6) = (m_radial.col(6) * y * y * y).matrix();
+      values.col(b + 7) = (m_radial.col(7) * y * y * z).matrix();
+      values.col(b + 8) = (m_radial.col(8) * y * z * z).matrix();
+      values.col(b + 9) = (m_radial.col(9) * z * z * z).matrix();
+      break;
+    case GaussianSet::F7: {
+      // See pointF7 for the spherical combinations.
+      const double root6 = 2.449489742783178;
+      const double root60 = 7.745966692414834;
+      const double root360 = 18.973665961010276;
+      ArrayX xx = x * x;
+      ArrayX yy = y * y;
+      ArrayX zz = z * z;
+      values.col(b) =
+        (m_radial.col(0) * z * (zz - 1.5 * (xx + yy))).matrix();
+      values.col(b + 1) =
+        (m_radial.col(1) * x * (6.0 * zz - 1.5 * (xx + yy)) / root6).matrix();
+      values.col(b + 2) =
+        (m_radial.col(2) * y * (6.0 * zz - 1.5 * (xx + yy)) / root6).matrix();
+      values.col(b + 3) =
+        (m_radial.col(3) * z * 15.0 * (xx - yy) / root60).matrix();
+      values.col(b + 4) =
+        (m_radial.col(4) * x * y * z * 30.0 / root60).matrix();
+      values.col(b + 5) =
+        (m_radial.col(5) * x * (15.0 * xx - 45.0 * yy) / root360).matrix();
+      values.col(b + 6) =
+        (m_radial.col(6) * y * (45.0 * xx - 15.0 * yy) / root360).matrix();
+      break;
+    }
+    default:;
+  }
+}
+
+} // End anonymous namespace
+
+GaussianSetTools::GaussianSetTools(Molecule* mol)
+  : m_molecule(mol), m_basis(nullptr)
 {
   if (m_molecule)
     m_basis = dynamic_cast<GaussianSet*>(m_molecule->basisSet());
@@ -44,9 +327,87 @@ GaussianSetTools::~GaussianSetTools()
 
 bool GaussianSetTools::calculateMolecularOrbital(Cube& cube, int moNumber) const
 {
-  for (size_t i = 0; i < cube.data()->size(); ++i) {
-    Vector3 pos = cube.position(i);
-    cube.setValue(i, calculateMolecularOrbital(pos, moNumber));
+  return calculateMolecularOrbitals(std::vector<Cube*>(1, &cube),
+                                    std::vector<int>(1, moNumber));
+}
+
+bool GaussianSetTools::calculateMolecularOrbitals(
+  const std::vector<Cube*>& cubes, const std::vector<int>& moNumbers,
+  Index first, Index count, double* minValues, double* maxValues) const
+{
+  if (!m_basis || !m_molecule || cubes.empty() ||
+      cubes.size() != moNumbers.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < cubes.size(); ++i) {
+    if (!cubes[i])
+      return false;
+  }
+
+  m_basis->initCalculation();
+  const MatrixX& matrix = m_basis->moMatrix(m_type);
+
+  // All of the cubes must share the grid of the first one.
+  const Cube& grid = *cubes[0];
+  for (size_t i = 0; i < cubes.size(); ++i) {
+    if (cubes[i]->dimensions() != grid.dimensions() ||
+        cubes[i]->min() != grid.min() ||
+        cubes[i]->spacing() != grid.spacing() ||
+        cubes[i]->pointCount() != grid.pointCount()) {
+      return false;
+    }
+    if (moNumbers[i] < 0 || moNumbers[i] >= static_cast<int>(matrix.cols()))
+      return false;
+  }
+
+  BlockEvaluator evaluator(*m_basis, *m_molecule);
+  if (evaluator.basisCount() != static_cast<Index>(matrix.rows()))
+    return false;
+
+  // The coefficients of the requested orbitals, one column per cube.
+  MatrixX coefficients(matrix.rows(), static_cast<Index>(cubes.size()));
+  for (size_t i = 0; i < cubes.size(); ++i)
+    coefficients.col(i) = matrix.col(moNumbers[i]);
+
+  size_t size = grid.pointCount();
+  if (first > size)
+    return false;
+  size_t end = first + std::min(count, size - first);
+
+  // The range of each cube is found as its values are written.
+  std::vector<double> lo(cubes.size(), std::numeric_limits<double>::max());
+  std::vector<double> hi(cubes.size(), std::numeric_limits<double>::lowest());
+  Matrix3X points;
+  MatrixX values;
+  MatrixX block;
+  for (size_t start = first; start < end; start += blockSize) {
+    size_t n = std::min(blockSize, end - start);
+    points.resize(3, n);
+    for (size_t i = 0; i < n; ++i) {
+      points.col(i) = grid.position(start + i) * ANGSTROM_TO_BOHR;
+    }
+    evaluator.evaluate(points, values);
+
+    // The basis values are shared by all of the orbitals in the block.
+    block.setZero(n, coefficients.cols());
+    const std::vector<const ShellData*>& active = evaluator.active();
+    for (size_t i = 0; i < active.size(); ++i) {
+      Index b = active[i]->moIndex;
+      Index c = active[i]->components;
+      block.noalias() +=
+        values.middleCols(b, c) * coefficients.middleRows(b, c);
+    }
+    for (size_t k = 0; k < cubes.size(); ++k)
+      cubes[k]->fillValues(start, n, block.col(k).data(), lo[k], hi[k]);
+  }
+  for (size_t k = 0; k < cubes.size(); ++k) {
+    if (minValues)
+      minValues[k] = lo[k];
+    if (maxValues)
+      maxValues[k] = hi[k];
+    if (first == 0 && end == size && size > 0)
+      cubes[k]->setValueRange(lo[k], hi[k]);
   }
   return true;
 }
@@ -93,6 +454,16 @@ double GaussianSetTools::calculateElectronDensity(const Vector3& position) const
   return rho;
 }
 
+bool GaussianSetTools::calculateElectronDensity(Cube& cube, Index first,
+                                                Index count, double* minValue,
+                                                double* maxValue) const
+{
+  if (!m_basis)
+    return false;
+  return calculateDensity(cube, m_basis->densityMatrix(), first, count,
+                          minValue, maxValue);
+}
+
 double GaussianSetTools::calculateSpinDensity(const Vector3& position) const
 {
   const MatrixX& matrix = m_basis->spinDensityMatrix();
@@ -116,6 +487,91 @@ double GaussianSetTools::calculateSpinDensity(const Vector3& position) const
   return rho;
 }
 
+bool GaussianSetTools::calculateSpinDensity(Cube& cube, Index first,
+                                            Index count, double* minValue,
+                                            double* maxValue) const
+{
+  if (!m_basis)
+    return false;
+  return calculateDensity(cube, m_basis->spinDensityMatrix(), first, count,
+                          minValue, maxValue);
+}
+
+bool GaussianSetTools::calculateDensity(Cube& cube, const MatrixX& matrix,
+                                        Index first, Index count,
+                                        double* minValue,
+                                        double* maxValue) const
+{
+  if (!m_basis || !m_molecule)
+    return false;
+
+  m_basis->initCalculation();
+  BlockEvaluator evaluator(*m_basis, *m_molecule);
+  Index matrixSize = evaluator.basisCount();
+  if (static_cast<Index>(matrix.rows()) != matrixSize ||
+      static_cast<Index>(matrix.cols()) != matrixSize) {
+    return false;
+  }
+
+  size_t size = cube.pointCount();
+  if (first > size)
+    return false;
+  size_t end = first + std::min(count, size - first);
+
+  Matrix3X points;
+  MatrixX values;
+  MatrixX activeValues;
+  MatrixX activeMatrix;
+  MatrixX product;
+  Eigen::VectorXd rho;
+  std::vector<Index> columns;
+  double lo = std::numeric_limits<double>::max();
+  double hi = std::numeric_limits<double>::lowest();
+  for (size_t start = first; start < end; start += blockSize) {
+    size_t n = std::min(blockSize, end - start);
+    points.resize(3, n);
+    for (size_t i = 0; i < n; ++i) {
+      points.col(i) = cube.position(start + i) * ANGSTROM_TO_BOHR;
+    }
+    evaluator.evaluate(points, values);
+
+    // Gather the basis functions that contribute to this block, and the
+    // matching rows and columns of the density matrix.
+    columns.clear();
+    const std::vector<const ShellData*>& active = evaluator.active();
+    for (size_t i = 0; i < active.size(); ++i) {
+      for (unsigned int j = 0; j < active[i]->components; ++j)
+        columns.push_back(active[i]->moIndex + j);
+    }
+    Index activeCount = static_cast<Index>(columns.size());
+    activeValues.resize(n, activeCount);
+    activeMatrix.resize(activeCount, activeCount);
+    for (Index j = 0; j < activeCount; ++j) {
+      activeValues.col(j) = values.col(columns[j]);
+      for (Index i = j; i < activeCount; ++i)
+        activeMatrix(i, j) = matrix(columns[i], columns[j]);
+    }
+
+    // rho = sum_ij D_ij phi_i phi_j for each point, the density matrix is
+    // symmetric and only its lower triangle is read, as for a single point.
+    if (activeCount > 0) {
+      product.noalias() =
+        activeValues * activeMatrix.selfadjointView<Eigen::Lower>();
+      rho.noalias() = product.cwiseProduct(activeValues).rowwise().sum();
+    } else {
+      rho.setZero(n);
+    }
+    cube.fillValues(start, n, rho.data(), lo, hi);
+  }
+  if (minValue)
+    *minValue = lo;
+  if (maxValue)
+    *maxValue = hi;
+  if (first == 0 && end == size && size > 0)
+    cube.setValueRange(lo, hi);
+  return true;
+}
+
 bool GaussianSetTools::isValid() const
 {
   if (m_molecule && dynamic_cast<GaussianSet*>(m_molecule->basisSet()))
@@ -22,6 +22,7 @@
 #include "avogadrocore.h"
 
 #include "basisset.h"
+#include "matrix.h"
 #include "vector.h"
 
 #include <vector>
@@ -54,12 +55,45 @@ public:
 
   /**
    * @brief Populate the cube with values for the molecular orbital.
+   *
+   * The grid is evaluated in blocks of points, skipping the shells that are
+   * negligible everywhere in a block, which is much faster than calling
+   * calculateMolecularOrbital() for each position.
    * @param cube The cube to be populated with values.
    * @param molecularOrbitalNumber The molecular orbital number.
    * @return True on success, false on failure.
    */
   bool calculateMolecularOrbital(Cube& cube, int molecularOrbitalNumber) const;
 
+  /**
+   * @brief Populate several cubes with values for molecular orbitals in a
+   * single pass over the grid.
+   *
+   * The basis functions are evaluated once for each block of points and
+   * combined with the coefficients of all of the requested orbitals, so this
+   * costs little more than a single orbital.
+   * @param cubes The cubes to be populated, they must all share the limits
+   * of the first cube.
+   * @param molecularOrbitalNumbers The molecular orbital number for each cube.
+   * @param first The index of the first point to calculate.
+   * @param count The number of points to calculate, by default all points from
+   * @a first to the end of the cubes.
+   * @param minValues If not null, set to the smallest value calculated for
+   * each of the cubes.
+   * @param maxValues If not null, set to the largest value calculated for
+   * each of the cubes.
+   * @return True on success, false on failure.
+   * @note The range of the cubes is only set when all of their points are
+   * calculated. Several threads may calculate disjoint parts of the cubes at
+   * once, and then set it with Cube::setValueRange() from the ranges of
+   * their parts.
+   */
+  bool calculateMolecularOrbitals(
+    const std::vector<Cube*>& cubes,
+    const std::vector<int>& molecularOrbitalNumbers, Index first = 0,
+    Index count = MaxIndex, double* minValues = nullptr,
+    double* maxValues = nullptr) const;
+
   /**
    * @brief Calculate the value of the specified molecular orbital at the
    * position specified.
@@ -79,6 +113,27 @@ public:
    */
   double calculateElectronDensity(const Vector3& position) const;
 
+  /**
+   * @brief Populate the cube with values for the electron density.
+   *
+   * The basis functions are evaluated for blocks of points at once, and the
+   * density of a block is obtained from matrix products with the part of the
+   * density matrix belonging to the shells that are not negligible there.
+   * @param cube The cube to be populated with values.
+   * @param first The index of the first point to calculate.
+   * @param count The number of points to calculate, by default all points from
+   * @a first to the end of the cube.
+   * @param minValue If not null, set to the smallest value calculated.
+   * @param maxValue If not null, set to the largest value calculated.
+   * @return True on success, false on failure.
+   * @note As for calculateMolecularOrbitals(), the range of the cube is only
+   * set when all of its points are calculated.
+   */
+  bool calculateElectronDensity(Cube& cube, Index first = 0,
+                                Index count = MaxIndex,
+                                double* minValue = nullptr,
+                                double* maxValue = nullptr) const;
+
   /**
    * @brief Calculate the value of the electron spin density at the position
    * specified.
@@ -87,6 +142,20 @@ public:
    */
   double calculateSpinDensity(const Vector3& position) const;
 
+  /**
+   * @brief Populate the cube with values for the electron spin density, see
+   * calculateElectronDensity(Cube&, Index, Index) for details.
+   * @param cube The cube to be populated with values.
+   * @param first The index of the first point to calculate.
+   * @param count The number of points to calculate.
+   * @param minValue If not null, set to the smallest value calculated.
+   * @param maxValue If not null, set to the largest value calculated.
+   * @return True on success, false on failure.
+   */
+  bool calculateSpinDensity(Cube& cube, Index first = 0,
+                            Index count = MaxIndex, double* minValue = nullptr,
+                            double* maxValue = nullptr) const;
+
   /**
    * @brief Check that the basis set is valid and can be used.
    * @return True if valid, false otherwise.
@@ -100,6 +169,13 @@ private:
 
   bool isSmall(double value) const;
 
+  /**
+   * @brief Populate the cube with the density described by @a matrix.
+   */
+  bool calculateDensity(Cube& cube, const MatrixX& matrix, Index first,
+                        Index count, double* minValue,
+                        double* maxValue) const;
+
   /**
    * @brief Calculate the values at this position in space. The public calculate
    * functions call this function to prepare values before multiplying by the
@@ -33,8 +33,9 @@ Mesh::Mesh() : m_stable(true), m_other(0), m_cube(0), m_lock(new Mutex)
 
 Mesh::Mesh(const Mesh& other)
   : m_vertices(other.m_vertices), m_normals(other.m_normals),
-    m_colors(other.m_colors), m_name(other.m_name), m_stable(true),
-    m_isoValue(other.m_isoValue), m_other(other.m_other), m_cube(other.m_cube),
+    m_colors(other.m_colors), m_triangles(other.m_triangles),
+    m_name(other.m_name), m_stable(true), m_isoValue(other.m_isoValue),
+    m_other(other.m_other), m_cube(other.m_cube),
     m_lock(new Mutex)
 {
 }
@@ -124,6 +125,27 @@ bool Mesh::addNormals(const Core::Array<Vector3f>& values)
   }
 }
 
+const Core::Array<unsigned int>& Mesh::triangles() const
+{
+  return m_triangles;
+}
+
+unsigned int Mesh::numTriangles() const
+{
+  if (m_triangles.empty())
+    return static_cast<unsigned int>(m_vertices.size() / 3);
+  return static_cast<unsigned int>(m_triangles.size() / 3);
+}
+
+bool Mesh::setTriangles(const Core::Array<unsigned int>& values)
+{
+  if (values.size() % 3 != 0)
+    return false;
+  m_triangles.clear();
+  m_triangles = values;
+  return true;
+}
+
 const Core::Array<Color3f>& Mesh::colors() const
 {
   return m_colors;
@@ -175,14 +197,16 @@ bool Mesh::clear()
   m_vertices.clear();
   m_normals.clear();
   m_colors.clear();
+  m_triangles.clear();
   return true;
 }
 
 Mesh& Mesh::operator=(const Mesh& other)
 {
   m_vertices = other.m_vertices;
-  m_normals = other.m_vertices;
+  m_normals = other.m_normals;
   m_colors = other.m_colors;
+  m_triangles = other.m_triangles;
   m_name = other.m_name;
   m_isoValue = other.m_isoValue;
 
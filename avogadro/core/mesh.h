@@ -172,6 +172,23 @@ public:
    */
   bool addNormals(const Core::Array<Vector3f>& values);
 
+  /**
+   * @return Array of vertex indices, three per triangle. This is empty for
+   * meshes where every three consecutive vertices form a triangle.
+   */
+  const Core::Array<unsigned int>& triangles() const;
+
+  /**
+   * @return The number of triangles in the mesh.
+   */
+  unsigned int numTriangles() const;
+
+  /**
+   * Clear the triangles array and assign new values, the array is expected to
+   * be of length 3 x n where n is the number of triangles.
+   */
+  bool setTriangles(const Core::Array<unsigned int>& values);
+
   /**
    * @return Array containing all of the colors in a one-dimensional array.
    */
@@ -232,6 +249,7 @@ private:
   Core::Array<Vector3f> m_vertices;
   Core::Array<Vector3f> m_normals;
   Core::Array<Color3f> m_colors;
+  Core::Array<unsigned int> m_triangles;
   std::string m_name;
   bool m_stable;
   float m_isoValue;
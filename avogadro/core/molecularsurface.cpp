@@ -0,0 +1,271 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include "molecularsurface.h"
+
+#include "cube.h"
+#include "elements.h"
+#include "molecule.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace Avogadro {
+namespace Core {
+
+namespace {
+
+struct Sphere
+{
+  Vector3 center;
+  double radius;
+};
+
+// Stands in for infinity in the distance transform, where the arithmetic
+// must stay finite.
+const float farAway = 1.0e30f;
+
+// Split [0, count) into contiguous ranges and call func(begin, end) for each
+// of them on its own thread.
+template <typename Func>
+void parallelFor(Index count, int threadCount, const Func& func)
+{
+  Index threads = std::min(static_cast<Index>(std::max(threadCount, 1)), count);
+  if (threads <= 1) {
+    if (count > 0)
+      func(0, count);
+    return;
+  }
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (Index t = 1; t < threads; ++t)
+    pool.push_back(
+      std::thread(func, count * t / threads, count * (t + 1) / threads));
+  func(0, count / threads);
+  for (size_t t = 0; t < pool.size(); ++t)
+    pool[t].join();
+}
+
+// Set each grid point to its largest depth inside of any of the spheres, or
+// to -margin when it is further than that outside of all of them. Each thread
+// fills a slab of x planes, visiting only the points near each sphere.
+template <typename T>
+void rasterize(const std::vector<Sphere>& spheres, double margin,
+               const Cube& cube, T* data, int threads)
+{
+  const Vector3i dim = cube.dimensions();
+  const Vector3 min = cube.min();
+  const Vector3 spacing = cube.spacing();
+  const size_t planeSize = static_cast<size_t>(dim.y()) * dim.z();
+
+  parallelFor(dim.x(), threads, [&](Index begin, Index end) {
+    std::fill(data + begin * planeSize, data + end * planeSize,
+              static_cast<T>(-margin));
+    for (size_t s = 0; s < spheres.size(); ++s) {
+      const Vector3& c = spheres[s].center;
+      const double reach = spheres[s].radius + margin;
+      const double reach2 = reach * reach;
+      int lo[3], hi[3];
+      for (int a = 0; a < 3; ++a) {
+        lo[a] = std::max(
+          0, static_cast<int>(std::ceil((c[a] - reach - min[a]) / spacing[a])));
+        hi[a] = std::min(
+          dim[a] - 1,
+          static_cast<int>(std::floor((c[a] + reach - min[a]) / spacing[a])));
+      }
+      lo[0] = std::max(lo[0], static_cast<int>(begin));
+      hi[0] = std::min(hi[0], static_cast<int>(end) - 1);
+
+      for (int i = lo[0]; i <= hi[0]; ++i) {
+        double dx = min.x() + i * spacing.x() - c.x();
+        double dx2 = dx * dx;
+        for (int j = lo[1]; j <= hi[1]; ++j) {
+          double dy = min.y() + j * spacing.y() - c.y();
+          double dxy2 = dx2 + dy * dy;
+          if (dxy2 > reach2)
+            continue;
+          // The run of points along z within reach of the center.
+          double half = std::sqrt(reach2 - dxy2);
+          int kBegin = std::max(
+            lo[2], static_cast<int>(std::ceil((c.z() - half - min.z()) /
+                                              spacing.z())));
+          int kEnd = std::min(
+            hi[2], static_cast<int>(std::floor((c.z() + half - min.z()) /
+                                               spacing.z())));
+          T* row = data + i * planeSize + static_cast<size_t>(j) * dim.z();
+          for (int k = kBegin; k <= kEnd; ++k) {
+            double dz = min.z() + k * spacing.z() - c.z();
+            T depth =
+              static_cast<T>(spheres[s].radius - std::sqrt(dxy2 + dz * dz));
+            if (depth > row[k])
+              row[k] = depth;
+          }
+        }
+      }
+    }
+  });
+}
+
+// One pass of the squared Euclidean distance transform of Felzenszwalb and
+// Huttenlocher, along each of the lines of n points a stride apart. Line l
+// starts at (l / inner) * outer + l % inner.
+void distancePass(float* data, Index lines, Index inner, Index outer, Index n,
+                  Index stride, double spacing, int threads)
+{
+  parallelFor(lines, threads, [&](Index begin, Index end) {
+    std::vector<double> f(n);
+    std::vector<double> z(n + 1);
+    std::vector<Index> v(n);
+    for (Index l = begin; l < end; ++l) {
+      float* line = data + (l / inner) * outer + l % inner;
+      for (Index q = 0; q < n; ++q)
+        f[q] = line[q * stride];
+
+      // Find the lower envelope of the parabolas rooted at each point...
+      Index k = 0;
+      v[0] = 0;
+      z[0] = -std::numeric_limits<double>::infinity();
+      z[1] = std::numeric_limits<double>::infinity();
+      for (Index q = 1; q < n; ++q) {
+        double s;
+        for (;;) {
+          double p = static_cast<double>(v[k]);
+          s = ((f[q] + q * q * spacing * spacing) -
+               (f[v[k]] + p * p * spacing * spacing)) /
+              (2.0 * spacing * (q - p));
+          if (s > z[k])
+            break;
+          --k;
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = std::numeric_limits<double>::infinity();
+      }
+
+      // ...and sample it at each point.
+      k = 0;
+      for (Index q = 0; q < n; ++q) {
+        while (z[k + 1] < q * spacing)
+          ++k;
+        double d = (static_cast<double>(q) - static_cast<double>(v[k])) *
+                   spacing;
+        line[q * stride] = static_cast<float>(d * d + f[v[k]]);
+      }
+    }
+  });
+}
+
+// Fill the data with the surface of the spheres, which are grown by the probe
+// radius for all but the van der Waals surface.
+template <typename T>
+void surface(std::vector<Sphere>& spheres, MolecularSurface::Type type,
+             double probe, double margin, const Cube& cube, T* data,
+             int threads)
+{
+  if (type != MolecularSurface::SolventExcluded) {
+    for (size_t i = 0; i < spheres.size(); ++i)
+      spheres[i].radius += probe;
+    rasterize(spheres, margin, cube, data, threads);
+    return;
+  }
+
+  // The solvent excluded surface is the part of space a probe sphere cannot
+  // reach, i.e. the points further than the probe radius from any point
+  // outside of the solvent accessible surface. The van der Waals spheres are
+  // always inside, and give the exact surface where the probe touches them.
+  rasterize(spheres, margin, cube, data, threads);
+
+  std::vector<float> distance(cube.pointCount());
+  for (size_t i = 0; i < spheres.size(); ++i)
+    spheres[i].radius += probe;
+  rasterize(spheres, cube.spacing().minCoeff(), cube, distance.data(),
+            threads);
+  parallelFor(distance.size(), threads, [&](Index begin, Index end) {
+    for (Index i = begin; i < end; ++i)
+      distance[i] = distance[i] <= 0.0f ? 0.0f : farAway;
+  });
+
+  const Vector3i dim = cube.dimensions();
+  const Index nx = dim.x();
+  const Index ny = dim.y();
+  const Index nz = dim.z();
+  const Vector3 spacing = cube.spacing();
+  distancePass(distance.data(), nx * ny, 1, nz, nz, 1, spacing.z(), threads);
+  distancePass(distance.data(), nx * nz, nz, ny * nz, ny, nz, spacing.y(),
+               threads);
+  distancePass(distance.data(), ny * nz, ny * nz, 0, nx, ny * nz, spacing.x(),
+               threads);
+
+  parallelFor(distance.size(), threads, [&](Index begin, Index end) {
+    for (Index i = begin; i < end; ++i) {
+      double depth = std::sqrt(static_cast<double>(distance[i])) - probe;
+      data[i] = std::max(data[i], static_cast<T>(depth));
+    }
+  });
+}
+
+} // namespace
+
+MolecularSurface::MolecularSurface() : m_probeRadius(1.4), m_threadCount(0)
+{
+}
+
+bool MolecularSurface::calculate(const Molecule& molecule, Cube& cube,
+                                 Type type) const
+{
+  const Array<Vector3>& positions = molecule.atomPositions3d();
+  std::vector<double> radii(molecule.atomCount());
+  for (Index i = 0; i < radii.size(); ++i)
+    radii[i] = Elements::radiusVDW(molecule.atomicNumber(i));
+  return calculate(std::vector<Vector3>(positions.begin(), positions.end()),
+                   radii, cube, type);
+}
+
+bool MolecularSurface::calculate(const std::vector<Vector3>& positions,
+                                 const std::vector<double>& radii, Cube& cube,
+                                 Type type) const
+{
+  const Vector3i dim = cube.dimensions();
+  const size_t size = cube.precision() == Cube::Float
+                        ? cube.floatData()->size()
+                        : cube.data()->size();
+  if (dim.minCoeff() < 1 || size == 0 || size != cube.pointCount() ||
+      positions.size() != radii.size()) {
+    return false;
+  }
+
+  int threads = m_threadCount;
+  if (threads < 1) {
+    threads =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+
+  // Values are exact to at least a couple of grid points from the surface,
+  // which covers every edge the isosurface crosses.
+  const double margin = 2.0 * cube.spacing().maxCoeff();
+  const double probe = type == VanDerWaals ? 0.0 : m_probeRadius;
+
+  std::vector<Sphere> spheres(positions.size());
+  for (Index i = 0; i < spheres.size(); ++i) {
+    spheres[i].center = positions[i];
+    spheres[i].radius = radii[i];
+  }
+
+  // The values are written in the precision of the cube.
+  if (cube.precision() == Cube::Float) {
+    surface(spheres, type, probe, margin, cube, cube.floatData()->data(),
+            threads);
+  } else {
+    surface(spheres, type, probe, margin, cube, cube.data()->data(), threads);
+  }
+  return true;
+}
+
+} // namespace Core
+} // namespace Avogadro
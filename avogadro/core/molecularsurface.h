@@ -0,0 +1,85 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#ifndef AVOGADRO_CORE_MOLECULARSURFACE_H
+#define AVOGADRO_CORE_MOLECULARSURFACE_H
+
+#include "avogadrocore.h"
+
+#include "vector.h"
+
+#include <vector>
+
+namespace Avogadro {
+namespace Core {
+
+class Cube;
+class Molecule;
+
+/**
+ * @class MolecularSurface molecularsurface.h
+ * <avogadro/core/molecularsurface.h>
+ * @brief The MolecularSurface class calculates van der Waals, solvent
+ * accessible and solvent excluded surfaces of a molecule on a grid.
+ *
+ * The surface is written into a Cube as the distance inside of the surface,
+ * positive inside and negative outside, so the surface itself is the
+ * isosurface at zero. The atomic spheres are rasterized into the grid slab by
+ * slab in parallel, only visiting the grid points near each atom. The solvent
+ * excluded surface is then found with a Euclidean distance transform of the
+ * grid points that a probe sphere can reach.
+ */
+class AVOGADROCORE_EXPORT MolecularSurface
+{
+public:
+  enum Type
+  {
+    VanDerWaals,
+    SolventAccessible,
+    SolventExcluded
+  };
+
+  MolecularSurface();
+
+  /**
+   * The radius of the solvent probe in Angstrom, 1.4 (water) by default.
+   */
+  void setProbeRadius(double radius) { m_probeRadius = radius; }
+  double probeRadius() const { return m_probeRadius; }
+
+  /**
+   * The number of threads to use, 0 (the default) uses one per core.
+   */
+  void setThreadCount(int count) { m_threadCount = count; }
+  int threadCount() const { return m_threadCount; }
+
+  /**
+   * Calculate the surface of @a molecule into @a cube, which must already
+   * have its limits set. The cube should extend at least the largest atomic
+   * radius plus the probe radius past the atoms.
+   * @return True on success, false if the cube has no points.
+   */
+  bool calculate(const Molecule& molecule, Cube& cube, Type type) const;
+
+  /**
+   * Calculate the surface of the atoms at @a positions, with the van der Waals
+   * @a radii, into @a cube. This needs none of the rest of the molecule, so
+   * the atoms can be copied cheaply to calculate the surface on a thread.
+   * @return True on success, false if the cube has no points or the arrays
+   * differ in size.
+   */
+  bool calculate(const std::vector<Vector3>& positions,
+                 const std::vector<double>& radii, Cube& cube,
+                 Type type) const;
+
+private:
+  double m_probeRadius;
+  int m_threadCount;
+};
+
+} // namespace Core
+} // namespace Avogadro
+
+#endif // AVOGADRO_CORE_MOLECULARSURFACE_H
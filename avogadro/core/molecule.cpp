@@ -20,7 +20,9 @@
 #include "color3f.h"
 #include "cube.h"
 #include "elements.h"
+#include "framesource.h"
 #include "mesh.h"
+#include "neighborperceiver.h"
 #include "residue.h"
 #include "unitcell.h"
 
@@ -30,8 +32,57 @@
 namespace Avogadro {
 namespace Core {
 
+namespace {
+// Make an std::pair where the lower index is always first in the pair. This
+// offers us the guarantee that any given pair of atoms will always result in
+// a pair that is the same no matter what the order of the atoms given.
+std::pair<Index, Index> makeBondPair(const Index& a, const Index& b)
+{
+  return a < b ? std::make_pair(a, b) : std::make_pair(b, a);
+}
+
+// Pack an atom pair into the key used by the bond lookup index, independent of
+// the order of the atoms.
+uint64_t bondKey(Index a, Index b)
+{
+  if (a > b)
+    std::swap(a, b);
+  return (static_cast<uint64_t>(a) << 32) | static_cast<uint64_t>(b);
+}
+
+// Drop the entries flagged in removed, keeping the rest in order. Arrays that
+// are not in use (i.e. not the same length as the flags) are left alone.
+template <typename ArrayType>
+void compactArray(ArrayType& values, const std::vector<bool>& removed)
+{
+  if (values.size() != removed.size())
+    return;
+  typename ArrayType::iterator out = values.begin();
+  typename ArrayType::iterator in = values.begin();
+  for (size_t i = 0; i < removed.size(); ++i, ++in) {
+    if (!removed[i]) {
+      if (out != in)
+        *out = *in;
+      ++out;
+    }
+  }
+  values.erase(out, values.end());
+}
+
+// Remove a single bond id from an atom's bond list.
+void eraseBondId(std::vector<Index>& ids, Index bondId)
+{
+  std::vector<Index>::iterator it = std::find(ids.begin(), ids.end(), bondId);
+  if (it != ids.end()) {
+    *it = ids.back();
+    ids.pop_back();
+  }
+}
+} // namespace
+
 Molecule::Molecule()
-  : m_graphDirty(false), m_basisSet(nullptr), m_unitCell(nullptr)
+  : m_graphDirty(false), m_basisSet(nullptr), m_unitCell(nullptr),
+    m_frameSource(nullptr), m_bondIndexDirty(false)
 {}
 
 Molecule::Molecule(const Molecule& other)
@@ -48,7 +99,10 @@ Molecule::Molecule(const Molecule& other)
     m_meshes(std::vector<Mesh*>()), m_cubes(std::vector<Cube*>()),
     m_basisSet(other.m_basisSet ? other.m_basisSet->clone() : nullptr),
     m_unitCell(other.m_unitCell ? new UnitCell(*other.m_unitCell) : nullptr),
-    m_residues(other.m_residues)
+    m_frameSource(other.m_frameSource ? other.m_frameSource->clone()
+                                      : nullptr),
+    m_residues(other.m_residues), m_bondMap(other.m_bondMap),
+    m_bondLookup(other.m_bondLookup), m_bondIndexDirty(other.m_bondIndexDirty)
 {
   // Copy over any meshes
   for (Index i = 0; i < other.meshCount(); ++i) {
@@ -82,13 +136,19 @@ Molecule::Molecule(Molecule&& other) noexcept
     m_bondOrders(std::move(other.m_bondOrders)),
     m_selectedAtoms(std::move(other.m_selectedAtoms)),
     m_meshes(std::move(other.m_meshes)), m_cubes(std::move(other.m_cubes)),
-    m_residues(std::move(other.m_residues))
+    m_residues(std::move(other.m_residues)),
+    m_bondMap(std::move(other.m_bondMap)),
+    m_bondLookup(std::move(other.m_bondLookup)),
+    m_bondIndexDirty(other.m_bondIndexDirty)
 {
   m_basisSet = other.m_basisSet;
   other.m_basisSet = nullptr;
 
   m_unitCell = other.m_unitCell;
   other.m_unitCell = nullptr;
+
+  m_frameSource = other.m_frameSource;
+  other.m_frameSource = nullptr;
 }
 
 Molecule& Molecule::operator=(const Molecule& other)
@@ -112,6 +172,9 @@ Molecule& Molecule::operator=(const Molecule& other)
     m_bondOrders = other.m_bondOrders;
     m_selectedAtoms = other.m_selectedAtoms;
     m_residues = other.m_residues;
+    m_bondMap = other.m_bondMap;
+    m_bondLookup = other.m_bondLookup;
+    m_bondIndexDirty = other.m_bondIndexDirty;
 
     clearMeshes();
 
@@ -133,6 +196,9 @@ Molecule& Molecule::operator=(const Molecule& other)
     m_basisSet = other.m_basisSet ? other.m_basisSet->clone() : nullptr;
     delete m_unitCell;
     m_unitCell = other.m_unitCell ? new UnitCell(*other.m_unitCell) : nullptr;
+    delete m_frameSource;
+    m_frameSource =
+      other.m_frameSource ? other.m_frameSource->clone() : nullptr;
   }
 
   return *this;
@@ -159,6 +225,9 @@ Molecule& Molecule::operator=(Molecule&& other) noexcept
     m_bondOrders = std::move(other.m_bondOrders);
     m_selectedAtoms = std::move(other.m_selectedAtoms);
     m_residues = std::move(other.m_residues);
+    m_bondMap = std::move(other.m_bondMap);
+    m_bondLookup = std::move(other.m_bondLookup);
+    m_bondIndexDirty = other.m_bondIndexDirty;
 
     clearMeshes();
     m_meshes = std::move(other.m_meshes);
@@ -173,6 +242,10 @@ Molecule& Molecule::operator=(Molecule&& other) noexcept
     delete m_unitCell;
     m_unitCell = other.m_unitCell;
     other.m_unitCell = nullptr;
+
+    delete m_frameSource;
+    m_frameSource = other.m_frameSource;
+    other.m_frameSource = nullptr;
   }
 
   return *this;
@@ -182,6 +255,7 @@ Molecule::~Molecule()
 {
   delete m_basisSet;
   delete m_unitCell;
+  delete m_frameSource;
   clearMeshes();
   clearCubes();
 }
@@ -268,6 +342,8 @@ const Array<Vector3>& Molecule::atomPositions3d() const
 
 Array<std::pair<Index, Index>>& Molecule::bondPairs()
 {
+  // The caller may modify the pairs, so the lookup index can't be trusted.
+  m_bondIndexDirty = true;
   return m_bondPairs;
 }
 
@@ -326,6 +402,8 @@ Molecule::AtomType Molecule::addAtom(unsigned char number)
 
   // Add the atomic number.
   m_atomicNumbers.push_back(number);
+  if (!m_bondIndexDirty)
+    m_bondMap.resize(m_atomicNumbers.size());
 
   return AtomType(this, static_cast<Index>(m_atomicNumbers.size() - 1));
 }
@@ -342,6 +420,8 @@ bool Molecule::removeAtom(Index index)
     atomBonds = bonds(atom(index));
   }
 
+  m_graphDirty = true;
+  updateBondIndex();
   Index newSize = static_cast<Index>(m_atomicNumbers.size() - 1);
   if (index != newSize) {
     // We need to move the last atom to this position, and update its unique ID.
@@ -356,18 +436,22 @@ bool Molecule::removeAtom(Index index)
       m_formalCharges[index] = m_formalCharges.back();
 
     // Find any bonds to the moved atom and update their index.
-    atomBonds = bonds(atom(newSize));
-    for (Array<BondType>::const_iterator it = atomBonds.begin(),
-                                         itEnd = atomBonds.end();
+    const std::vector<Index>& movedBonds = m_bondMap[newSize];
+    for (std::vector<Index>::const_iterator it = movedBonds.begin(),
+                                            itEnd = movedBonds.end();
          it != itEnd; ++it) {
-      std::pair<Index, Index> pair = m_bondPairs[it->index()];
+      std::pair<Index, Index> pair = m_bondPairs[*it];
+      m_bondLookup.erase(bondKey(pair.first, pair.second));
       if (pair.first == newSize)
         pair.first = index;
       else if (pair.second == newSize)
         pair.second = index;
-      m_bondPairs[it->index()] = pair;
+      m_bondPairs[*it] = makeBondPair(pair.first, pair.second);
+      m_bondLookup[bondKey(pair.first, pair.second)] = *it;
     }
+    m_bondMap[index].swap(m_bondMap[newSize]);
   }
+  m_bondMap.pop_back();
   // Resize the arrays for the smaller molecule.
   if (m_positions2d.size() == m_atomicNumbers.size())
     m_positions2d.pop_back();
@@ -387,10 +471,60 @@ bool Molecule::removeAtom(const AtomType& atom_)
   return removeAtom(atom_.index());
 }
 
+bool Molecule::removeAtoms(const std::vector<Index>& indices)
+{
+  std::vector<bool> removed(atomCount(), false);
+  for (std::vector<Index>::const_iterator it = indices.begin(),
+                                          itEnd = indices.end();
+       it != itEnd; ++it) {
+    if (*it >= atomCount())
+      return false;
+    removed[*it] = true;
+  }
+  if (indices.empty())
+    return true;
+
+  // New index of each remaining atom.
+  std::vector<Index> newIndex(atomCount(), MaxIndex);
+  Index next = 0;
+  for (Index i = 0; i < atomCount(); ++i) {
+    if (!removed[i])
+      newIndex[i] = next++;
+  }
+
+  // Drop the bonds to removed atoms and renumber the others.
+  std::vector<bool> removedBonds(m_bondPairs.size(), false);
+  for (Index i = 0; i < m_bondPairs.size(); ++i) {
+    std::pair<Index, Index>& pair = m_bondPairs[i];
+    if (removed[pair.first] || removed[pair.second])
+      removedBonds[i] = true;
+    else
+      pair = makeBondPair(newIndex[pair.first], newIndex[pair.second]);
+  }
+  compactArray(m_bondPairs, removedBonds);
+  compactArray(m_bondOrders, removedBonds);
+
+  if (!m_selectedAtoms.empty())
+    m_selectedAtoms.resize(atomCount(), false);
+  compactArray(m_positions2d, removed);
+  compactArray(m_positions3d, removed);
+  compactArray(m_hybridizations, removed);
+  compactArray(m_formalCharges, removed);
+  compactArray(m_forceVectors, removed);
+  compactArray(m_selectedAtoms, removed);
+  compactArray(m_atomicNumbers, removed);
+
+  m_bondIndexDirty = true;
+  m_graphDirty = true;
+  return true;
+}
+
 void Molecule::clearAtoms()
 {
-  while (atomCount() != 0)
-    removeAtom(0);
+  std::vector<Index> indices(atomCount());
+  for (Index i = 0; i < indices.size(); ++i)
+    indices[i] = i;
+  removeAtoms(indices);
 }
 
 Molecule::AtomType Molecule::atom(Index index) const
@@ -415,16 +549,6 @@ Index Molecule::atomCount(unsigned char number) const
   return count;
 }
 
-namespace {
-// Make an std::pair where the lower index is always first in the pair. This
-// offers us the guarantee that any given pair of atoms will always result in
-// a pair that is the same no matter what the order of the atoms given.
-std::pair<Index, Index> makeBondPair(const Index& a, const Index& b)
-{
-  return a < b ? std::make_pair(a, b) : std::make_pair(b, a);
-}
-} // namespace
-
 Molecule::BondType Molecule::addBond(Index atom1, Index atom2,
                                      unsigned char order)
 {
@@ -432,14 +556,14 @@ Molecule::BondType Molecule::addBond(Index atom1, Index atom2,
   assert(atom2 < atomCount());
 
   // check if the bond exists - if not, create it
-  std::pair<Index, Index> pair = makeBondPair(atom1, atom2);
-
-  Array<std::pair<Index, Index>>::iterator iter =
-    std::find(m_bondPairs.begin(), m_bondPairs.end(), pair);
+  updateBondIndex();
+  uint64_t key = bondKey(atom1, atom2);
+  std::unordered_map<uint64_t, Index>::const_iterator iter =
+    m_bondLookup.find(key);
 
-  if (iter != m_bondPairs.end()) {
+  if (iter != m_bondLookup.end()) {
     // found an existing bond between these atoms
-    Index index = static_cast<Index>(std::distance(m_bondPairs.begin(), iter));
+    Index index = iter->second;
     if (m_bondOrders[index] != order) {
       // change the order
       m_bondOrders[index] = order;
@@ -449,10 +573,14 @@ Molecule::BondType Molecule::addBond(Index atom1, Index atom2,
   }
 
   m_graphDirty = true;
+  Index index = bondCount();
   m_bondPairs.push_back(makeBondPair(atom1, atom2));
   m_bondOrders.push_back(order);
+  m_bondLookup[key] = index;
+  m_bondMap[atom1].push_back(index);
+  m_bondMap[atom2].push_back(index);
 
-  return BondType(this, bondCount() - 1);
+  return BondType(this, index);
 }
 
 Molecule::BondType Molecule::addBond(const AtomType& a, const AtomType& b,
@@ -469,13 +597,28 @@ bool Molecule::removeBond(Index index)
   if (index >= bondCount())
     return false;
 
+  updateBondIndex();
+  std::pair<Index, Index> pair = m_bondPairs[index];
+  m_bondLookup.erase(bondKey(pair.first, pair.second));
+  eraseBondId(m_bondMap[pair.first], index);
+  eraseBondId(m_bondMap[pair.second], index);
+
   Index newSize = static_cast<Index>(m_bondOrders.size() - 1);
   if (index != newSize) {
     m_bondOrders[index] = m_bondOrders.back();
     m_bondPairs[index] = m_bondPairs.back();
+
+    // The last bond moved, point the index at its new position.
+    const std::pair<Index, Index>& moved = m_bondPairs[index];
+    m_bondLookup[bondKey(moved.first, moved.second)] = index;
+    std::replace(m_bondMap[moved.first].begin(), m_bondMap[moved.first].end(),
+                 newSize, index);
+    std::replace(m_bondMap[moved.second].begin(),
+                 m_bondMap[moved.second].end(), newSize, index);
   }
   m_bondOrders.pop_back();
   m_bondPairs.pop_back();
+  m_graphDirty = true;
   return true;
 }
 
@@ -494,10 +637,33 @@ bool Molecule::removeBond(const AtomType& a, const AtomType& b)
   return removeBond(bond(a, b).index());
 }
 
+bool Molecule::removeBonds(const std::vector<Index>& indices)
+{
+  std::vector<bool> removed(bondCount(), false);
+  for (std::vector<Index>::const_iterator it = indices.begin(),
+                                          itEnd = indices.end();
+       it != itEnd; ++it) {
+    if (*it >= bondCount())
+      return false;
+    removed[*it] = true;
+  }
+  if (indices.empty())
+    return true;
+
+  compactArray(m_bondPairs, removed);
+  compactArray(m_bondOrders, removed);
+
+  m_bondIndexDirty = true;
+  m_graphDirty = true;
+  return true;
+}
+
 void Molecule::clearBonds()
 {
-  while (bondCount())
-    removeBond(0);
+  std::vector<Index> indices(bondCount());
+  for (Index i = 0; i < indices.size(); ++i)
+    indices[i] = i;
+  removeBonds(indices);
 }
 
 Molecule::BondType Molecule::bond(Index index) const
@@ -520,17 +686,14 @@ Molecule::BondType Molecule::bond(Index atomId1, Index atomId2) const
   assert(atomId1 < atomCount());
   assert(atomId2 < atomCount());
 
-  std::pair<Index, Index> pair = makeBondPair(atomId1, atomId2);
+  updateBondIndex();
+  std::unordered_map<uint64_t, Index>::const_iterator iter =
+    m_bondLookup.find(bondKey(atomId1, atomId2));
 
-  Array<std::pair<Index, Index>>::const_iterator iter =
-    std::find(m_bondPairs.begin(), m_bondPairs.end(), pair);
-
-  if (iter == m_bondPairs.end())
+  if (iter == m_bondLookup.end())
     return BondType();
 
-  Index index = static_cast<Index>(std::distance(m_bondPairs.begin(), iter));
-
-  return BondType(const_cast<Molecule*>(this), index);
+  return BondType(const_cast<Molecule*>(this), iter->second);
 }
 
 Array<Molecule::BondType> Molecule::bonds(const AtomType& a)
@@ -545,9 +708,14 @@ Array<Molecule::BondType> Molecule::bonds(Index a)
 {
   Array<BondType> atomBonds;
   if (a < atomCount()) {
-    for (Index i = 0; i < m_bondPairs.size(); ++i)
-      if (m_bondPairs[i].first == a || m_bondPairs[i].second == a)
-        atomBonds.push_back(BondType(this, i));
+    updateBondIndex();
+    // Return the bonds in index order, as callers have always received them.
+    std::vector<Index> ids(m_bondMap[a]);
+    std::sort(ids.begin(), ids.end());
+    atomBonds.reserve(ids.size());
+    for (std::vector<Index>::const_iterator it = ids.begin(), itEnd = ids.end();
+         it != itEnd; ++it)
+      atomBonds.push_back(BondType(this, *it));
   }
   return atomBonds;
 }
@@ -713,37 +881,53 @@ void Molecule::setVibrationLx(const Array<Array<Vector3>>& lx)
 void Molecule::perceiveBondsSimple(const double tolerance, const double min)
 {
   // check for coordinates
-  if (m_positions3d.size() != atomCount())
+  if (m_positions3d.size() != atomCount() || atomCount() < 2)
     return;
 
   // cache atomic radii
   std::vector<double> radii(atomCount());
+  double maxRadius = 0.0;
   for (size_t i = 0; i < radii.size(); i++) {
     radii[i] = Elements::radiusCovalent(m_atomicNumbers[i]);
     if (radii[i] <= 0.0)
       radii[i] = 2.0;
+    maxRadius = std::max(maxRadius, radii[i]);
   }
 
-  // check for bonds
-  for (Index i = 0; i < atomCount(); i++) {
-    Vector3 ipos = m_positions3d[i];
-    for (Index j = i + 1; j < atomCount(); j++) {
-      double cutoff = radii[i] + radii[j] + tolerance;
-      Vector3 jpos = m_positions3d[j];
-      Vector3 diff = jpos - ipos;
+  // Bin the atoms into cells at least as large as the longest possible bond,
+  // so only atoms in neighboring cells need to be compared.
+  const Array<Vector3>& positions = m_positions3d;
+  NeighborPerceiver perceiver(positions, 2.0 * maxRadius + tolerance);
 
-      if (std::fabs(diff[0]) > cutoff || std::fabs(diff[1]) > cutoff ||
-          std::fabs(diff[2]) > cutoff ||
-          (m_atomicNumbers[i] == 1 && m_atomicNumbers[j] == 1))
+  // Collect the accepted pairs first, then add them in one go.
+  std::vector<std::pair<Index, Index>> pairs;
+  Array<Index> neighbors;
+  double minSq = min * min;
+  for (Index i = 0; i < atomCount(); i++) {
+    const Vector3& ipos = positions[i];
+    perceiver.getNeighborsInclusive(neighbors, ipos);
+    for (Index n = 0; n < neighbors.size(); n++) {
+      Index j = neighbors[n];
+      // Each pair is seen from both sides, only keep it once.
+      if (j <= i)
+        continue;
+      if (m_atomicNumbers[i] == 1 && m_atomicNumbers[j] == 1)
         continue;
 
       // check radius and add bond if needed
-      double cutoffSq = cutoff * cutoff;
-      double diffsq = diff.squaredNorm();
-      if (diffsq < cutoffSq && diffsq > min * min)
-        addBond(atom(i), atom(j), 1);
+      double cutoff = radii[i] + radii[j] + tolerance;
+      double diffsq = (positions[j] - ipos).squaredNorm();
+      if (diffsq < cutoff * cutoff && diffsq > minSq)
+        pairs.push_back(std::make_pair(i, j));
     }
   }
+
+  // Keep the order of the old pairwise loop so bond indices are stable.
+  std::sort(pairs.begin(), pairs.end());
+  m_bondPairs.reserve(m_bondPairs.size() + pairs.size());
+  m_bondOrders.reserve(m_bondOrders.size() + pairs.size());
+  for (size_t k = 0; k < pairs.size(); ++k)
+    addBond(pairs[k].first, pairs[k].second, 1);
 }
 
 void Molecule::perceiveBondsFromResidueData()
@@ -753,23 +937,45 @@ void Molecule::perceiveBondsFromResidueData()
   }
 }
 
-int Molecule::coordinate3dCount()
+int Molecule::coordinate3dCount() const
 {
-  return static_cast<int>(m_coordinates3d.size());
+  Index count = m_coordinates3d.size();
+  if (m_frameSource)
+    count = std::max(count, m_frameSource->frameCount());
+  return static_cast<int>(count);
 }
 
 bool Molecule::setCoordinate3d(int coord)
 {
-  if (coord >= 0 && coord < static_cast<int>(m_coordinates3d.size())) {
-    m_positions3d = m_coordinates3d[coord];
-    return true;
-  }
-  return false;
+  if (coord < 0 || coord >= coordinate3dCount())
+    return false;
+  Array<Vector3> coords = coordinate3d(coord);
+  if (coords.empty())
+    return false;
+  m_positions3d = coords;
+  return true;
 }
 
 Array<Vector3> Molecule::coordinate3d(int index) const
 {
-  return m_coordinates3d[index];
+  Index i = static_cast<Index>(index);
+  if (index < 0)
+    return Array<Vector3>();
+  // Sets given explicitly take precedence over the frame source.
+  if (i < m_coordinates3d.size() && !m_coordinates3d[i].empty())
+    return m_coordinates3d[i];
+  Array<Vector3> coords;
+  if (m_frameSource && !m_frameSource->frame(i, coords))
+    coords.clear();
+  return coords;
+}
+
+void Molecule::setFrameSource(FrameSource* source)
+{
+  if (source == m_frameSource)
+    return;
+  delete m_frameSource;
+  m_frameSource = source;
 }
 
 bool Molecule::setCoordinate3d(const Array<Vector3>& coords, int index)
@@ -780,7 +986,7 @@ bool Molecule::setCoordinate3d(const Array<Vector3>& coords, int index)
   return true;
 }
 
-double Molecule::timeStep(int index, bool& status)
+double Molecule::timeStep(int index, bool& status) const
 {
   if (static_cast<int>(m_timesteps.size()) <= index) {
     status = false;
@@ -811,6 +1017,28 @@ void Molecule::updateGraph() const
   }
 }
 
+void Molecule::updateBondIndex() const
+{
+  // Atoms appended directly to the atomic numbers have no bonds yet.
+  if (!m_bondIndexDirty && m_bondMap.size() <= atomCount()) {
+    m_bondMap.resize(atomCount());
+    return;
+  }
+  m_bondIndexDirty = false;
+  m_bondMap.clear();
+  m_bondMap.resize(atomCount());
+  m_bondLookup.clear();
+  m_bondLookup.reserve(m_bondPairs.size());
+  for (Index i = 0; i < m_bondPairs.size(); ++i) {
+    const std::pair<Index, Index>& pair = m_bondPairs[i];
+    m_bondLookup[bondKey(pair.first, pair.second)] = i;
+    if (pair.first < m_bondMap.size())
+      m_bondMap[pair.first].push_back(i);
+    if (pair.second < m_bondMap.size())
+      m_bondMap[pair.second].push_back(i);
+  }
+}
+
 Array<Vector3>& Molecule::forceVectors()
 {
   return m_forceVectors;
@@ -838,5 +1066,15 @@ Residue& Molecule::residue(int index)
   return m_residues[index];
 }
 
+const Residue& Molecule::residue(int index) const
+{
+  return m_residues[index];
+}
+
+Index Molecule::residueCount() const
+{
+  return m_residues.size();
+}
+
 } // namespace Core
 } // namespace Avogadro
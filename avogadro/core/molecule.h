@@ -19,8 +19,11 @@
 
 #include "avogadrocore.h"
 
+#include <cstdint>
 #include <map>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "array.h"
 #include "bond.h"
@@ -32,6 +35,7 @@ namespace Avogadro {
 namespace Core {
 class BasisSet;
 class Cube;
+class FrameSource;
 class Mesh;
 class Residue;
 class UnitCell;
@@ -253,7 +257,12 @@ public:
   /** Returns whether the selection is empty or not */
   bool isSelectionEmpty() const;
 
-  /** Returns a vector of pairs of atom indices of the bonds in the molecule. */
+  /**
+   * Returns a vector of pairs of atom indices of the bonds in the molecule.
+   * @note Modifying the bonds through this reference invalidates the bond
+   * lookup index, which is rebuilt on the next bond query. Prefer the const
+   * overload when only reading.
+   */
   Array<std::pair<Index, Index>>& bondPairs();
 
   /** \overload */
@@ -358,6 +367,17 @@ public:
    */
   virtual bool removeAtom(const AtomType& atom);
 
+  /**
+   * @brief Remove several atoms from the molecule in a single pass.
+   * @param indices The indices of the atoms to be removed, in any order.
+   * Repeated indices are ignored.
+   * @return True on success, false if any index is out of range, in which case
+   * the molecule is left unchanged.
+   * @note Unlike removeAtom(), the remaining atoms keep their relative order.
+   * Any bonds to the removed atoms are removed as well.
+   */
+  virtual bool removeAtoms(const std::vector<Index>& indices);
+
   /**
    * Remove all atoms from the molecule.
    */
@@ -421,6 +441,16 @@ public:
   virtual bool removeBond(const AtomType& atom1, const AtomType& atom2);
   /** @} */
 
+  /**
+   * @brief Remove several bonds from the molecule in a single pass.
+   * @param indices The indices of the bonds to be removed, in any order.
+   * Repeated indices are ignored.
+   * @return True on success, false if any index is out of range, in which case
+   * the molecule is left unchanged.
+   * @note Unlike removeBond(), the remaining bonds keep their relative order.
+   */
+  virtual bool removeBonds(const std::vector<Index>& indices);
+
   /**
    * Remove all bonds from the molecule.
    */
@@ -537,16 +567,35 @@ public:
    */
   void perceiveBondsFromResidueData();
 
-  int coordinate3dCount();
+  /**
+   * The coordinate sets (conformers or trajectory frames) of the molecule.
+   * Sets that were not given with setCoordinate3d(coords, index) are read from
+   * the frameSource(), if there is one. setCoordinate3d(coord) makes set
+   * @a coord the current atom positions.
+   * @{
+   */
+  int coordinate3dCount() const;
   bool setCoordinate3d(int coord);
   Array<Vector3> coordinate3d(int index) const;
   bool setCoordinate3d(const Array<Vector3>& coords, int index);
+  /** @} */
+
+  /**
+   * Provide coordinate sets on demand, e.g. from a trajectory that is too large
+   * to read in at once. The molecule takes ownership of @a source, and any
+   * previous source is deleted.
+   * @{
+   */
+  void setFrameSource(FrameSource* source);
+  FrameSource* frameSource() { return m_frameSource; }
+  const FrameSource* frameSource() const { return m_frameSource; }
+  /** @} */
 
   /**
    * Timestep property is used when molecular dynamics trajectories are read
    */
   bool setTimeStep(double timestep, int index);
-  double timeStep(int index, bool& status);
+  double timeStep(int index, bool& status) const;
 
   /** Returns a vector of forces for the atoms in the molecule. */
   const Array<Vector3>& forceVectors() const;
@@ -580,6 +629,8 @@ public:
   Residue& addResidue(std::string& name, Index& number, char& id);
   void addResidue(Residue& residue);
   Residue& residue(int index);
+  const Residue& residue(int index) const;
+  Index residueCount() const;
 
 protected:
   mutable Graph m_graph;     // A transformation of the molecule to a graph.
@@ -611,10 +662,21 @@ protected:
 
   BasisSet* m_basisSet;
   UnitCell* m_unitCell;
+  FrameSource* m_frameSource;
   Array<Residue> m_residues;
 
+  // Bond lookup index: the bonds touching each atom, and the bond id keyed on
+  // the packed (lower, higher) atom pair. Kept up to date by addBond and the
+  // remove methods, rebuilt lazily when the bond pairs are modified directly.
+  mutable std::vector<std::vector<Index>> m_bondMap;
+  mutable std::unordered_map<uint64_t, Index> m_bondLookup;
+  mutable bool m_bondIndexDirty;
+
   /** Update the graph to correspond to the current molecule. */
   void updateGraph() const;
+
+  /** Rebuild the bond lookup index if it no longer matches the bonds. */
+  void updateBondIndex() const;
 };
 
 class AVOGADROCORE_EXPORT Atom : public AtomTemplate<Molecule>
@@ -793,6 +855,7 @@ inline bool Molecule::setBondPairs(const Array<std::pair<Index, Index>>& pairs)
 {
   if (pairs.size() == bondCount()) {
     m_bondPairs = pairs;
+    m_bondIndexDirty = true;
     return true;
   }
   return false;
@@ -803,6 +866,7 @@ inline bool Molecule::setBondPair(Index bondId,
 {
   if (bondId < bondCount()) {
     m_bondPairs[bondId] = pair;
+    m_bondIndexDirty = true;
     return true;
   }
   return false;
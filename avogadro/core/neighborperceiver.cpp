@@ -0,0 +1,115 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include "neighborperceiver.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Avogadro {
+namespace Core {
+
+NeighborPerceiver::NeighborPerceiver(const Array<Vector3>& points,
+                                     Real maxDistance)
+  : m_min(Vector3::Zero()), m_cellSize(maxDistance), m_dims(1, 1, 1)
+{
+  if (m_cellSize <= 0.0)
+    m_cellSize = 1.0;
+
+  if (points.empty()) {
+    m_cellStart.assign(2, 0);
+    return;
+  }
+
+  Vector3 max = points[0];
+  m_min = points[0];
+  for (Index i = 1; i < points.size(); ++i) {
+    m_min = m_min.cwiseMin(points[i]);
+    max = max.cwiseMax(points[i]);
+  }
+  Vector3 extent = max - m_min;
+
+  // Sparse inputs spread over a large volume (e.g. a few atoms far apart)
+  // would otherwise allocate a huge, mostly empty grid. Grow the cells until
+  // there are at most a few per point.
+  const double maxCells = 8.0 * static_cast<double>(points.size()) + 64.0;
+  for (;;) {
+    double cells = 1.0;
+    for (int i = 0; i < 3; ++i)
+      cells *= std::floor(extent[i] / m_cellSize) + 1.0;
+    if (cells <= maxCells)
+      break;
+    m_cellSize *= 2.0;
+  }
+  for (int i = 0; i < 3; ++i)
+    m_dims[i] = static_cast<int>(std::floor(extent[i] / m_cellSize)) + 1;
+
+  size_t cellCount = static_cast<size_t>(m_dims[0]) * m_dims[1] * m_dims[2];
+
+  // Counting sort of the point indices by cell.
+  std::vector<Index> pointCell(points.size());
+  m_cellStart.assign(cellCount + 1, 0);
+  for (Index i = 0; i < points.size(); ++i) {
+    Vector3i c = cellCoordinates(points[i]);
+    pointCell[i] = (static_cast<Index>(c[2]) * m_dims[1] + c[1]) * m_dims[0] +
+                   c[0];
+    ++m_cellStart[pointCell[i] + 1];
+  }
+  for (size_t c = 0; c < cellCount; ++c)
+    m_cellStart[c + 1] += m_cellStart[c];
+
+  std::vector<Index> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+  m_cellPoints.resize(points.size());
+  for (Index i = 0; i < points.size(); ++i)
+    m_cellPoints[fill[pointCell[i]]++] = i;
+}
+
+void NeighborPerceiver::getNeighborsInclusive(Array<Index>& out,
+                                              const Vector3& point) const
+{
+  out.clear();
+  if (m_cellPoints.empty())
+    return;
+
+  Vector3 rel = (point - m_min) / m_cellSize;
+  int center[3];
+  for (int i = 0; i < 3; ++i) {
+    // Points well outside the grid cannot have any neighbors.
+    if (rel[i] < -1.0 || rel[i] >= m_dims[i] + 1.0)
+      return;
+    center[i] = static_cast<int>(std::floor(rel[i]));
+  }
+
+  int lo[3], hi[3];
+  for (int i = 0; i < 3; ++i) {
+    lo[i] = std::max(center[i] - 1, 0);
+    hi[i] = std::min(center[i] + 1, m_dims[i] - 1);
+  }
+
+  for (int z = lo[2]; z <= hi[2]; ++z) {
+    for (int y = lo[1]; y <= hi[1]; ++y) {
+      size_t row = (static_cast<size_t>(z) * m_dims[1] + y) * m_dims[0];
+      // The cells along x are contiguous, so take them as one range.
+      Index begin = m_cellStart[row + lo[0]];
+      Index end = m_cellStart[row + hi[0] + 1];
+      for (Index p = begin; p < end; ++p)
+        out.push_back(m_cellPoints[p]);
+    }
+  }
+}
+
+Vector3i NeighborPerceiver::cellCoordinates(const Vector3& point) const
+{
+  Vector3 rel = (point - m_min) / m_cellSize;
+  Vector3i c;
+  for (int i = 0; i < 3; ++i) {
+    c[i] = static_cast<int>(std::floor(rel[i]));
+    c[i] = std::max(0, std::min(c[i], m_dims[i] - 1));
+  }
+  return c;
+}
+
+} // namespace Core
+} // namespace Avogadro
@@ -0,0 +1,64 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#ifndef AVOGADRO_CORE_NEIGHBORPERCEIVER_H
+#define AVOGADRO_CORE_NEIGHBORPERCEIVER_H
+
+#include "avogadrocore.h"
+
+#include "array.h"
+#include "vector.h"
+
+#include <vector>
+
+namespace Avogadro {
+namespace Core {
+
+/**
+ * @class NeighborPerceiver neighborperceiver.h
+ * <avogadro/core/neighborperceiver.h>
+ * @brief The NeighborPerceiver class sorts a set of points into a uniform
+ * grid of cells so that all points within a fixed distance of a query point
+ * can be found in constant time.
+ *
+ * The cell edge is at least @a maxDistance, so any point closer than that to
+ * the query lies in the query's cell or one of its 26 neighbors. Building the
+ * grid is linear in the number of points, which makes pairwise searches such
+ * as bond perception linear rather than quadratic.
+ */
+class AVOGADROCORE_EXPORT NeighborPerceiver
+{
+public:
+  /**
+   * Bin @a points into cells sized for neighbor searches up to
+   * @a maxDistance.
+   */
+  NeighborPerceiver(const Array<Vector3>& points, Real maxDistance);
+
+  /**
+   * Fill @a out with the indices of all points in the cells surrounding
+   * @a point. The result is a superset of the points within maxDistance of
+   * @a point (and includes @a point itself if it was in the input), so callers
+   * must still check the actual distances.
+   */
+  void getNeighborsInclusive(Array<Index>& out, const Vector3& point) const;
+
+private:
+  Vector3i cellCoordinates(const Vector3& point) const;
+
+  Vector3 m_min;
+  Real m_cellSize;
+  Vector3i m_dims;
+
+  // Compressed cell storage: the points in cell c are
+  // m_cellPoints[m_cellStart[c]] .. m_cellPoints[m_cellStart[c + 1] - 1].
+  std::vector<Index> m_cellStart;
+  std::vector<Index> m_cellPoints;
+};
+
+} // namespace Core
+} // namespace Avogadro
+
+#endif // AVOGADRO_CORE_NEIGHBORPERCEIVER_H
@@ -35,13 +35,14 @@ Residue::Residue(std::string& name, Index& number, char& id)
 
 Residue::Residue(const Residue& other)
   : m_residueName(other.m_residueName), m_residueId(other.m_residueId),
-    m_atomNameMap(other.m_atomNameMap)
+    m_chainId(other.m_chainId), m_atomNameMap(other.m_atomNameMap)
 {}
 
 Residue& Residue::operator=(Residue other)
 {
   m_residueName = other.m_residueName;
   m_residueId = other.m_residueId;
+  m_chainId = other.m_chainId;
   m_atomNameMap = other.m_atomNameMap;
   return *this;
 }
@@ -17,8 +17,14 @@
 #ifndef AVOGADRO_CORE_UTILITIES_H
 #define AVOGADRO_CORE_UTILITIES_H
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <locale>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace Avogadro {
@@ -109,6 +115,308 @@ T lexicalCast(const std::string& inputString, bool& ok)
   return value;
 }
 
+/**
+ * @brief A non-owning view of a range of characters.
+ *
+ * File readers use this to take lines apart into fields and tokens without
+ * copying them into strings of their own. It provides the parts of C++17's
+ * std::string_view that they need. The characters must outlive the view.
+ */
+class StringView
+{
+public:
+  static const size_t npos = static_cast<size_t>(-1);
+
+  StringView() : m_data(nullptr), m_size(0) {}
+  StringView(const char* data, size_t size) : m_data(data), m_size(size) {}
+  StringView(const char* string) : m_data(string), m_size(std::strlen(string))
+  {
+  }
+  StringView(const std::string& string)
+    : m_data(string.data()), m_size(string.size())
+  {
+  }
+
+  const char* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  const char* begin() const { return m_data; }
+  const char* end() const { return m_data + m_size; }
+  char operator[](size_t i) const { return m_data[i]; }
+
+  /**
+   * @return The view of up to @p count characters starting at @p pos. Unlike
+   * std::string::substr this is empty rather than an error when @p pos is
+   * past the end, which suits fixed column formats with short lines.
+   */
+  StringView substr(size_t pos, size_t count = npos) const
+  {
+    pos = std::min(pos, m_size);
+    return StringView(m_data + pos, std::min(count, m_size - pos));
+  }
+
+  /**
+   * @return The position of the first @p c at or after @p pos, or npos.
+   */
+  size_t find(char c, size_t pos = 0) const
+  {
+    if (pos >= m_size)
+      return npos;
+    const void* found = std::memchr(m_data + pos, c, m_size - pos);
+    return found ? static_cast<const char*>(found) - m_data : npos;
+  }
+
+  bool startsWith(StringView prefix) const
+  {
+    return m_size >= prefix.m_size &&
+           std::memcmp(m_data, prefix.m_data, prefix.m_size) == 0;
+  }
+
+  /**
+   * @return The view without whitespace at either end.
+   */
+  StringView trimmed() const
+  {
+    const char* first = m_data;
+    const char* last = m_data + m_size;
+    while (first != last && isSpace(*first))
+      ++first;
+    while (last != first && isSpace(*(last - 1)))
+      --last;
+    return StringView(first, last - first);
+  }
+
+  std::string toString() const { return std::string(m_data, m_size); }
+
+  /**
+   * @return True if @p c is a space, tab, carriage return or other character
+   * that separates tokens.
+   */
+  static bool isSpace(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' ||
+           c == '\f';
+  }
+
+private:
+  const char* m_data;
+  size_t m_size;
+};
+
+inline bool operator==(StringView a, StringView b)
+{
+  return a.size() == b.size() &&
+         (a.empty() || std::memcmp(a.data(), b.data(), a.size()) == 0);
+}
+
+inline bool operator!=(StringView a, StringView b)
+{
+  return !(a == b);
+}
+
+/**
+ * @brief Split the first whitespace delimited token off of @p input.
+ * @param input The text to take the token from, which is advanced past it.
+ * @param token Set to the token.
+ * @return False if only whitespace was left in @p input.
+ */
+inline bool nextToken(StringView& input, StringView& token)
+{
+  const char* first = input.begin();
+  const char* last = input.end();
+  while (first != last && StringView::isSpace(*first))
+    ++first;
+  const char* tokenEnd = first;
+  while (tokenEnd != last && !StringView::isSpace(*tokenEnd))
+    ++tokenEnd;
+  token = StringView(first, tokenEnd - first);
+  input = StringView(tokenEnd, last - tokenEnd);
+  return !token.empty();
+}
+
+/**
+ * @brief Split the first line off of @p input.
+ * @param input The text to take the line from, which is advanced past it.
+ * @param line Set to the line, without its line ending.
+ * @return False if @p input was empty.
+ */
+inline bool nextLine(StringView& input, StringView& line)
+{
+  if (input.empty()) {
+    line = StringView();
+    return false;
+  }
+  size_t end = input.find('\n');
+  if (end == StringView::npos) {
+    line = input;
+    input = StringView();
+  } else {
+    line = input.substr(0, end);
+    input = input.substr(end + 1);
+  }
+  if (!line.empty() && line[line.size() - 1] == '\r')
+    line = line.substr(0, line.size() - 1);
+  return true;
+}
+
+/**
+ * @brief Split @p input into its whitespace delimited tokens. Unlike split()
+ * the tokens are views of @p input, and any run of spaces, tabs or carriage
+ * returns separates them.
+ * @param input The text to be split up.
+ * @param tokens Replaced with the tokens, reusing its storage.
+ * @return The number of tokens.
+ */
+inline size_t tokenize(StringView input, std::vector<StringView>& tokens)
+{
+  tokens.clear();
+  StringView token;
+  while (nextToken(input, token))
+    tokens.push_back(token);
+  return tokens.size();
+}
+
+/**
+ * @brief Parse an integer from the characters in [first, last), in the manner
+ * of C++17's std::from_chars: no whitespace is skipped, and parsing stops at
+ * the first character that is not part of the number. A leading '+' is
+ * accepted as it is by streams.
+ * @return A pointer past the number, or @p first with @p value untouched if
+ * there is no number or it does not fit in @p value.
+ */
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value, const char*>::type
+fromChars(const char* first, const char* last, T& value)
+{
+  typedef typename std::make_unsigned<T>::type Unsigned;
+  const char* p = first;
+  bool negative = false;
+  if (p != last && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+  if (negative && !std::is_signed<T>::value)
+    return first;
+
+  const Unsigned limit =
+    static_cast<Unsigned>(std::numeric_limits<T>::max()) + (negative ? 1 : 0);
+  const char* digits = p;
+  Unsigned result = 0;
+  for (; p != last && *p >= '0' && *p <= '9'; ++p) {
+    Unsigned digit = static_cast<Unsigned>(*p - '0');
+    if (result > (limit - digit) / 10)
+      return first;
+    result = result * 10 + digit;
+  }
+  if (p == digits)
+    return first;
+  value = static_cast<T>(negative ? Unsigned(0) - result : result);
+  return p;
+}
+
+/**
+ * @brief Parse a floating point number from the characters in [first, last),
+ * in the manner of C++17's std::from_chars. Numbers with up to 15 significant
+ * digits and small exponents, which covers the fixed point columns of every
+ * chemical format, are converted exactly with a single multiplication or
+ * division. Anything else goes through a stream in the classic locale.
+ * @return A pointer past the number, or @p first with @p value untouched if
+ * there is no number.
+ */
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value, const char*>::type
+fromChars(const char* first, const char* last, T& value)
+{
+  static const double powers[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                    1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                    1e18, 1e19, 1e20, 1e21, 1e22 };
+  const char* p = first;
+  bool negative = false;
+  if (p != last && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+
+  // Gather up the significant digits, and the power of ten they are scaled by.
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool exact = true;
+  bool any = false;
+  for (; p != last && *p >= '0' && *p <= '9'; ++p, any = true) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+      digits += mantissa != 0;
+    } else {
+      exact = false;
+    }
+  }
+  if (p != last && *p == '.') {
+    for (++p; p != last && *p >= '0' && *p <= '9'; ++p, any = true) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+        digits += mantissa != 0;
+        --exponent;
+      } else {
+        exact = false;
+      }
+    }
+  }
+  if (!any)
+    return first;
+
+  // The exponent only counts if it has digits.
+  if (p != last && (*p == 'e' || *p == 'E')) {
+    const char* e = p + 1;
+    bool negativeExponent = false;
+    if (e != last && (*e == '-' || *e == '+')) {
+      negativeExponent = *e == '-';
+      ++e;
+    }
+    if (e != last && *e >= '0' && *e <= '9') {
+      int power = 0;
+      for (; e != last && *e >= '0' && *e <= '9'; ++e)
+        power = std::min(power * 10 + (*e - '0'), 100000);
+      exponent += negativeExponent ? -power : power;
+      p = e;
+    }
+  }
+
+  if (exact && mantissa < (uint64_t(1) << 53) && exponent >= -22 &&
+      exponent <= 22) {
+    double result = static_cast<double>(mantissa);
+    result = exponent < 0 ? result / powers[-exponent]
+                          : result * powers[exponent];
+    value = static_cast<T>(negative ? -result : result);
+    return p;
+  }
+
+  std::istringstream stream(std::string(first, p));
+  stream.imbue(std::locale::classic());
+  T result;
+  stream >> result;
+  if (stream.fail())
+    return first;
+  value = result;
+  return p;
+}
+
+/**
+ * @brief Parse the number at the start of @p text into @p value. Like
+ * lexicalCast() leading whitespace is skipped and anything after the number
+ * is ignored, but nothing is allocated.
+ * @return True if a number was found.
+ */
+template <typename T>
+bool parseNumber(StringView text, T& value)
+{
+  const char* first = text.begin();
+  while (first != text.end() && StringView::isSpace(*first))
+    ++first;
+  return fromChars(first, text.end(), value) != first;
+}
+
 } // end Core namespace
 } // end Avogadro namespace
 
@@ -0,0 +1,144 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#ifndef AVOGADRO_IO_BINARYBLOCK_P_H
+#define AVOGADRO_IO_BINARYBLOCK_P_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Avogadro {
+namespace Io {
+
+/**
+ * @return True if this machine stores numbers big endian first.
+ */
+inline bool hostIsBigEndian()
+{
+  const uint32_t one = 1;
+  unsigned char first;
+  std::memcpy(&first, &one, 1);
+  return first == 0;
+}
+
+#ifdef __SSE2__
+// Swap the bytes of each 16 bit word of a vector.
+inline __m128i swapBytes16(__m128i v)
+{
+  return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+#endif
+
+/**
+ * Reverse the byte order of @a count 32 bit words in place, four at a time
+ * where SSE2 is available.
+ */
+inline void swapBytes32(void* data, size_t count)
+{
+  unsigned char* bytes = static_cast<unsigned char*>(data);
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 4 <= count; i += 4, bytes += 16) {
+    __m128i v = swapBytes16(_mm_loadu_si128(reinterpret_cast<__m128i*>(bytes)));
+    // Then swap the 16 bit halves of each word.
+    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xb1), 0xb1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), v);
+  }
+#endif
+  for (; i < count; ++i, bytes += 4) {
+    uint32_t w;
+    std::memcpy(&w, bytes, 4);
+    w = (w << 24) | ((w << 8) & 0x00ff0000u) | ((w >> 8) & 0x0000ff00u) |
+        (w >> 24);
+    std::memcpy(bytes, &w, 4);
+  }
+}
+
+/**
+ * Reverse the byte order of @a count 64 bit words in place, two at a time
+ * where SSE2 is available.
+ */
+inline void swapBytes64(void* data, size_t count)
+{
+  unsigned char* bytes = static_cast<unsigned char*>(data);
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 2 <= count; i += 2, bytes += 16) {
+    __m128i v = swapBytes16(_mm_loadu_si128(reinterpret_cast<__m128i*>(bytes)));
+    // Then reverse the order of the 16 bit quarters of each word.
+    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0x1b), 0x1b);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), v);
+  }
+#endif
+  for (; i < count; ++i, bytes += 8) {
+    uint64_t w;
+    std::memcpy(&w, bytes, 8);
+    w = ((w << 8) & 0xff00ff00ff00ff00ull) | ((w >> 8) & 0x00ff00ff00ff00ffull);
+    w = ((w << 16) & 0xffff0000ffff0000ull) |
+        ((w >> 16) & 0x0000ffff0000ffffull);
+    w = (w << 32) | (w >> 32);
+    std::memcpy(bytes, &w, 8);
+  }
+}
+
+/**
+ * Read @a count 4 or 8 byte values (ints, floats or doubles) with a single
+ * read, reversing their byte order if @a swap is true.
+ * @return False if the stream ended before all of the values were read.
+ */
+template <typename T>
+bool readBlock(std::istream& in, T* values, size_t count, bool swap)
+{
+  static_assert(sizeof(T) == 4 || sizeof(T) == 8,
+                "Only 4 and 8 byte values are supported.");
+  if (count == 0)
+    return static_cast<bool>(in);
+  in.read(reinterpret_cast<char*>(values),
+          static_cast<std::streamsize>(count * sizeof(T)));
+  if (!in)
+    return false;
+  if (swap) {
+    if (sizeof(T) == 4)
+      swapBytes32(values, count);
+    else
+      swapBytes64(values, count);
+  }
+  return true;
+}
+
+/**
+ * Append @a count 4 or 8 byte values to @a buffer, reversing their byte order
+ * if @a swap is true.
+ */
+template <typename T>
+void appendBlock(std::vector<char>& buffer, const T* values, size_t count,
+                 bool swap)
+{
+  static_assert(sizeof(T) == 4 || sizeof(T) == 8,
+                "Only 4 and 8 byte values are supported.");
+  size_t offset = buffer.size();
+  buffer.resize(offset + count * sizeof(T));
+  if (count == 0)
+    return;
+  std::memcpy(buffer.data() + offset, values, count * sizeof(T));
+  if (swap) {
+    if (sizeof(T) == 4)
+      swapBytes32(buffer.data() + offset, count);
+    else
+      swapBytes64(buffer.data() + offset, count);
+  }
+}
+
+} // namespace Io
+} // namespace Avogadro
+
+#endif // AVOGADRO_IO_BINARYBLOCK_P_H
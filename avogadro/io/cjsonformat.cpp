@@ -15,6 +15,9 @@
 ******************************************************************************/
 
 #include "cjsonformat.h"
+
+#include "binaryblock_p.h"
+
 #include <avogadro/core/crystaltools.h>
 #include <avogadro/core/cube.h>
 #include <avogadro/core/elements.h>
@@ -25,8 +28,12 @@
 
 #include <nlohmann/json.hpp>
 
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 
 using json = nlohmann::json;
 
@@ -49,39 +56,415 @@ using Core::Molecule;
 using Core::split;
 using Core::Variant;
 
-CjsonFormat::CjsonFormat() = default;
+CjsonFormat::CjsonFormat() : m_encoding(Text) {}
+
+CjsonFormat::CjsonFormat(Encoding encoding) : m_encoding(encoding) {}
 
 CjsonFormat::~CjsonFormat() = default;
 
-bool setJsonKey(json& j, Molecule& m, const std::string& key)
+CjsonBinaryFormat::CjsonBinaryFormat() : CjsonFormat(Binary) {}
+
+CjsonBinaryFormat::~CjsonBinaryFormat() = default;
+
+namespace {
+
+// Binary CJSON starts with six magic bytes, a byte for the encoding of the
+// document, the version, and the size of the document as a little endian 64
+// bit integer. The blobs follow the document, each aligned to 8 bytes.
+const char binaryMagic[] = "CJSONB";
+const size_t binaryHeaderSize = 16;
+const char cborEncoding = 'C';
+const char messagePackEncoding = 'M';
+const char binaryVersion = 1;
+
+// Numeric arrays shorter than this are left in the document.
+const size_t minBlobCount = 16;
+
+// The key of the objects that stand in for the arrays stored as blobs.
+const char blobKey[] = "$blob";
+
+size_t alignBlob(size_t offset)
 {
-  if (j.count(key) && j.find(key)->is_string()) {
-    m.setData(key, j.value(key, "undefined"));
+  return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+template <typename T>
+void appendBlob(const json& array, vector<char>& blobs)
+{
+  vector<T> values(array.size());
+  for (size_t i = 0; i < values.size(); ++i)
+    values[i] = array[i].get<T>();
+  appendBlock(blobs, values.data(), values.size(), hostIsBigEndian());
+}
+
+// Move the numeric arrays in node with at least minBlobCount entries to
+// blobs, replacing each with an object giving its type, offset and count.
+void extractBlobs(json& node, vector<char>& blobs)
+{
+  if (node.is_object()) {
+    for (auto it = node.begin(); it != node.end(); ++it)
+      extractBlobs(*it, blobs);
+    return;
+  }
+  if (!node.is_array())
+    return;
+
+  bool numeric = node.size() >= minBlobCount;
+  bool integers = true;
+  bool small = true;
+  // Floating point values that survive a round trip through single precision,
+  // e.g. those of single precision cubes, are stored as such.
+  bool singles = true;
+  for (size_t i = 0; numeric && i < node.size(); ++i) {
+    const json& value = node[i];
+    if (value.is_number_unsigned()) {
+      uint64_t u = value.get<uint64_t>();
+      small = small && u <= std::numeric_limits<int32_t>::max();
+      integers = integers && u <= std::numeric_limits<int64_t>::max();
+    } else if (value.is_number_integer()) {
+      int64_t n = value.get<int64_t>();
+      small = small && n >= std::numeric_limits<int32_t>::min() &&
+              n <= std::numeric_limits<int32_t>::max();
+    } else if (value.is_number_float()) {
+      integers = false;
+      double d = value.get<double>();
+      singles = singles && static_cast<double>(static_cast<float>(d)) == d;
+    } else {
+      numeric = false;
+    }
+  }
+  if (!numeric) {
+    for (auto it = node.begin(); it != node.end(); ++it)
+      extractBlobs(*it, blobs);
+    return;
+  }
+
+  json blob;
+  blobs.resize(alignBlob(blobs.size()), 0);
+  blob["offset"] = blobs.size();
+  blob["count"] = node.size();
+  if (!integers && singles) {
+    blob["type"] = "float32";
+    appendBlob<float>(node, blobs);
+  } else if (!integers) {
+    blob["type"] = "float64";
+    appendBlob<double>(node, blobs);
+  } else if (small) {
+    blob["type"] = "int32";
+    appendBlob<int32_t>(node, blobs);
+  } else {
+    blob["type"] = "int64";
+    appendBlob<int64_t>(node, blobs);
+  }
+  node = json::object();
+  node[blobKey] = blob;
+}
+
+// Numeric arrays can be kept out of the document, each replaced there by an
+// {"$array": index} object giving its index in an ArrayStore.
+typedef vector<vector<double>> ArrayStore;
+const char arrayKey[] = "$array";
+
+// Replace node with a reference to values, which are moved to arrays.
+void storeArray(json& node, vector<double>& values, ArrayStore& arrays)
+{
+  node = json::object();
+  node[arrayKey] = arrays.size();
+  arrays.push_back(vector<double>());
+  arrays.back().swap(values);
+}
+
+template <typename T>
+void readBlob(const char* data, size_t count, vector<double>& values)
+{
+  values.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    T value;
+    std::memcpy(&value, data + i * sizeof(T), sizeof(T));
+    if (hostIsBigEndian()) {
+      if (sizeof(T) == 4)
+        swapBytes32(&value, 1);
+      else
+        swapBytes64(&value, 1);
+    }
+    values[i] = static_cast<double>(value);
+  }
+}
+
+// Move the arrays stored in blobs to arrays, in place of the objects standing
+// in for them. Returns false if any of them is out of bounds.
+bool restoreBlobs(json& node, const char* blobs, size_t size,
+                  ArrayStore& arrays)
+{
+  if (node.is_array()) {
+    for (auto it = node.begin(); it != node.end(); ++it) {
+      if (!restoreBlobs(*it, blobs, size, arrays))
+        return false;
+    }
     return true;
   }
-  return false;
+  if (!node.is_object())
+    return true;
+
+  auto blob = node.find(blobKey);
+  if (blob == node.end()) {
+    for (auto it = node.begin(); it != node.end(); ++it) {
+      if (!restoreBlobs(*it, blobs, size, arrays))
+        return false;
+    }
+    return true;
+  }
+
+  if (!blob->is_object())
+    return false;
+  auto type = blob->find("type");
+  auto offset = blob->find("offset");
+  auto count = blob->find("count");
+  if (type == blob->end() || !type->is_string() || offset == blob->end() ||
+      !offset->is_number_unsigned() || count == blob->end() ||
+      !count->is_number_unsigned()) {
+    return false;
+  }
+  size_t begin = offset->get<size_t>();
+  size_t n = count->get<size_t>();
+  size_t width = *type == "int32" || *type == "float32" ? 4 : 8;
+  if (begin > size || n > (size - begin) / width)
+    return false;
+
+  vector<double> values;
+  if (*type == "float64")
+    readBlob<double>(blobs + begin, n, values);
+  else if (*type == "float32")
+    readBlob<float>(blobs + begin, n, values);
+  else if (*type == "int32")
+    readBlob<int32_t>(blobs + begin, n, values);
+  else if (*type == "int64")
+    readBlob<int64_t>(blobs + begin, n, values);
+  else
+    return false;
+  storeArray(node, values, arrays);
+  return true;
 }
 
-bool isNumericArray(json& j)
+// Builds the document from the events of the SAX parser, moving each numeric
+// array to an ArrayStore as its numbers arrive. As json values the numbers
+// would take several times the memory.
+class StreamingReader : public nlohmann::json_sax<json>
 {
-  if (j.is_array() && j.size() > 0) {
-    for (unsigned int i = 0; i < j.size(); ++i) {
-      json v = j[i];
-      if (!v.is_number()) {
+public:
+  StreamingReader(json& root, ArrayStore& arrays)
+    : m_root(root), m_arrays(arrays)
+  {
+  }
+
+  bool null() override { return add(json()) != nullptr; }
+  bool boolean(bool value) override { return add(json(value)) != nullptr; }
+  bool number_integer(number_integer_t value) override
+  {
+    return addNumber(value);
+  }
+  bool number_unsigned(number_unsigned_t value) override
+  {
+    return addNumber(value);
+  }
+  bool number_float(number_float_t value, const string_t&) override
+  {
+    return addNumber(value);
+  }
+  bool string(string_t& value) override
+  {
+    return add(json(std::move(value))) != nullptr;
+  }
+
+  bool start_object(std::size_t) override
+  {
+    m_stack.push_back(Frame(add(json::object())));
+    return true;
+  }
+
+  bool key(string_t& value) override
+  {
+    m_key = std::move(value);
+    return true;
+  }
+
+  bool end_object() override
+  {
+    m_stack.pop_back();
+    return true;
+  }
+
+  bool start_array(std::size_t) override
+  {
+    m_stack.push_back(Frame(add(json::array())));
+    m_stack.back().numeric = true;
+    return true;
+  }
+
+  bool end_array() override
+  {
+    Frame& frame = m_stack.back();
+    if (frame.numeric && !frame.numbers.empty())
+      storeArray(*frame.node, frame.numbers, m_arrays);
+    m_stack.pop_back();
+    return true;
+  }
+
+  bool parse_error(std::size_t, const std::string&,
+                   const nlohmann::detail::exception&) override
+  {
+    return false;
+  }
+
+private:
+  // An object or array that is being read.
+  struct Frame
+  {
+    explicit Frame(json* node_) : node(node_), numeric(false) {}
+    json* node;
+    // True while an array holds nothing but the numbers.
+    bool numeric;
+    vector<double> numbers;
+  };
+
+  template <typename T>
+  bool addNumber(T value)
+  {
+    if (!m_stack.empty() && m_stack.back().numeric) {
+      m_stack.back().numbers.push_back(static_cast<double>(value));
+      return true;
+    }
+    return add(json(value)) != nullptr;
+  }
+
+  // Add value to the innermost object or array, returning where it went.
+  json* add(json&& value)
+  {
+    if (m_stack.empty()) {
+      m_root = std::move(value);
+      return &m_root;
+    }
+    Frame& frame = m_stack.back();
+    if (frame.node->is_object()) {
+      json& member = (*frame.node)[m_key];
+      member = std::move(value);
+      return &member;
+    }
+    if (frame.numeric) {
+      // Not a numeric array after all.
+      for (size_t i = 0; i < frame.numbers.size(); ++i)
+        frame.node->push_back(frame.numbers[i]);
+      frame.numbers.clear();
+      frame.numeric = false;
+    }
+    frame.node->push_back(std::move(value));
+    return &frame.node->back();
+  }
+
+  json& m_root;
+  ArrayStore& m_arrays;
+  vector<Frame> m_stack;
+  std::string m_key;
+};
+
+bool readBinary(const char* data, size_t size, bool streaming, json& root,
+                ArrayStore& arrays)
+{
+  if (size < binaryHeaderSize || std::memcmp(data, binaryMagic, 6) != 0 ||
+      data[7] != binaryVersion) {
+    return false;
+  }
+  uint64_t documentSize;
+  std::memcpy(&documentSize, data + 8, 8);
+  if (hostIsBigEndian())
+    swapBytes64(&documentSize, 1);
+  if (documentSize > size - binaryHeaderSize)
+    return false;
+
+  const char* document = data + binaryHeaderSize;
+  nlohmann::detail::input_format_t format;
+  if (data[6] == cborEncoding)
+    format = nlohmann::detail::input_format_t::cbor;
+  else if (data[6] == messagePackEncoding)
+    format = nlohmann::detail::input_format_t::msgpack;
+  else
+    return false;
+  if (streaming) {
+    StreamingReader reader(root, arrays);
+    if (!json::sax_parse(nlohmann::detail::input_adapter(
+                           document, static_cast<size_t>(documentSize)),
+                         &reader, format)) {
+      return false;
+    }
+  } else {
+    if (format == nlohmann::detail::input_format_t::cbor)
+      root = json::from_cbor(document, document + documentSize, true, false);
+    else
+      root = json::from_msgpack(document, document + documentSize, true, false);
+    if (root.is_discarded())
+      return false;
+  }
+
+  size_t blobs = std::min(alignBlob(binaryHeaderSize + documentSize), size);
+  return restoreBlobs(root, data + blobs, size - blobs, arrays);
+}
+
+json parseOptions(const string& options)
+{
+  if (options.empty())
+    return json::object();
+  json opts = json::parse(options, nullptr, false);
+  return opts.is_object() ? opts : json::object();
+}
+
+// The value of key in node, or null if there is none.
+const json& member(const json& node, const string& key)
+{
+  static const json null;
+  if (!node.is_object())
+    return null;
+  auto it = node.find(key);
+  return it == node.end() ? null : *it;
+}
+
+// Take the numbers of a non-empty numeric array in the document, which may
+// have been moved to arrays.
+bool takeNumbers(const json& node, ArrayStore& arrays, vector<double>& values)
+{
+  values.clear();
+  if (node.is_array()) {
+    values.reserve(node.size());
+    for (auto it = node.begin(); it != node.end(); ++it) {
+      if (!it->is_number()) {
+        values.clear();
         return false;
       }
+      values.push_back(it->get<double>());
+    }
+  } else if (node.is_object()) {
+    auto index = node.find(arrayKey);
+    if (index != node.end() && index->is_number_unsigned() &&
+        index->get<size_t>() < arrays.size()) {
+      values.swap(arrays[index->get<size_t>()]);
     }
+  }
+  return !values.empty();
+}
+
+bool setJsonKey(const json& j, Molecule& m, const std::string& key)
+{
+  if (j.count(key) && j.find(key)->is_string()) {
+    m.setData(key, j.value(key, "undefined"));
     return true;
   }
   return false;
 }
 
-bool isBooleanArray(json& j)
+bool isBooleanArray(const json& j)
 {
   if (j.is_array() && j.size() > 0) {
     for (unsigned int i = 0; i < j.size(); ++i) {
-      json v = j[i];
-      if (!v.is_boolean()) {
+      if (!j[i].is_boolean()) {
         return false;
       }
     }
@@ -90,14 +473,20 @@ bool isBooleanArray(json& j)
   return false;
 }
 
-bool CjsonFormat::read(std::istream& file, Molecule& molecule)
+Array<Vector3> toVectors(const vector<double>& values)
 {
-  json jsonRoot = json::parse(file, nullptr, false);
-  if (jsonRoot.is_discarded()) {
-    appendError("Error parsing JSON.");
-    return false;
+  Array<Vector3> vectors(values.size() / 3);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    vectors[i] =
+      Vector3(values[3 * i], values[3 * i + 1], values[3 * i + 2]);
   }
+  return vectors;
+}
 
+// Read the molecule from the document, whichever way it was parsed.
+bool readDocument(const json& jsonRoot, ArrayStore& arrays, Molecule& molecule,
+                  const std::function<void(const string&)>& appendError)
+{
   if (!jsonRoot.is_object()) {
     appendError("Error: Input is not a JSON object.");
     return false;
@@ -118,18 +507,19 @@ bool CjsonFormat::read(std::istream& file, Molecule& molecule)
   setJsonKey(jsonRoot, molecule, "formula");
 
   // Read in the atoms.
-  json atoms = jsonRoot["atoms"];
+  const json& atoms = member(jsonRoot, "atoms");
   if (!atoms.is_object()) {
     appendError("The 'atoms' key does not contain an object.");
     return false;
   }
 
-  json atomicNumbers = atoms["elements"]["number"];
+  vector<double> values;
   // This represents our minimal spec for a molecule - atoms that have an
   // atomic number.
-  if (isNumericArray(atomicNumbers) && atomicNumbers.size() > 0) {
-    for (unsigned int i = 0; i < atomicNumbers.size(); ++i)
-      molecule.addAtom(atomicNumbers[i]);
+  if (takeNumbers(member(member(atoms, "elements"), "number"), arrays,
+                  values)) {
+    for (size_t i = 0; i < values.size(); ++i)
+      molecule.addAtom(static_cast<unsigned char>(values[i]));
   } else {
     appendError("Malformed array for in atoms.elements.number");
     return false;
@@ -137,118 +527,108 @@ bool CjsonFormat::read(std::istream& file, Molecule& molecule)
   Index atomCount = molecule.atomCount();
 
   // 3d coordinates if available for our atoms
-  json atomicCoords = atoms["coords"]["3d"];
-  if (isNumericArray(atomicCoords) && atomicCoords.size() == 3 * atomCount) {
-    for (Index i = 0; i < atomCount; ++i) {
-      auto a = molecule.atom(i);
-      a.setPosition3d(Vector3(atomicCoords[3 * i], atomicCoords[3 * i + 1],
-                              atomicCoords[3 * i + 2]));
-    }
+  const json& coords = member(atoms, "coords");
+  if (takeNumbers(member(coords, "3d"), arrays, values) &&
+      values.size() == 3 * atomCount) {
+    molecule.setAtomPositions3d(toVectors(values));
   }
 
   // Check for coordinate sets, and read them in if found, e.g. trajectories.
-  json coordSets = atoms["coords"]["3dSets"];
+  const json& coordSets = member(coords, "3dSets");
   if (coordSets.is_array() && coordSets.size()) {
     for (unsigned int i = 0; i < coordSets.size(); ++i) {
-      Array<Vector3> setArray;
-      json set = coordSets[i];
-      if (isNumericArray(set)) {
-        for (unsigned int j = 0; j < set.size() / 3; ++j) {
-          setArray.push_back(
-            Vector3(set[3 * j], set[3 * j + 1], set[3 * j + 2]));
-        }
-        molecule.setCoordinate3d(setArray, i);
-      }
+      if (takeNumbers(coordSets[i], arrays, values))
+        molecule.setCoordinate3d(toVectors(values), i);
     }
     // Make sure the first step is active once we are done loading the sets.
     molecule.setCoordinate3d(0);
   }
 
   // Selection is optional, but if present should be loaded.
-  json selection = atoms["selected"];
-  if (isBooleanArray(selection) && selection.size() == atomCount)
+  const json& selection = member(atoms, "selected");
+  if (isBooleanArray(selection) && selection.size() == atomCount) {
     for (Index i = 0; i < atomCount; ++i)
       molecule.setAtomSelected(i, selection[i]);
-  else if (isNumericArray(selection) && selection.size() == atomCount)
+  } else if (takeNumbers(selection, arrays, values) &&
+             values.size() == atomCount) {
     for (Index i = 0; i < atomCount; ++i)
-      molecule.setAtomSelected(i, selection[i] != 0);
+      molecule.setAtomSelected(i, values[i] != 0);
+  }
 
   // Bonds are optional, but if present should be loaded.
-  json bonds = jsonRoot["bonds"];
-  if (bonds.is_object() && isNumericArray(bonds["connections"]["index"])) {
-    json connections = bonds["connections"]["index"];
-    for (unsigned int i = 0; i < connections.size() / 2; ++i) {
-      molecule.addBond(static_cast<Index>(connections[2 * i]),
-                       static_cast<Index>(connections[2 * i + 1]), 1);
-    }
-    json order = bonds["order"];
-    if (isNumericArray(order)) {
-      for (unsigned int i = 0; i < molecule.bondCount() && i < order.size();
-           ++i) {
-        molecule.bond(i).setOrder(static_cast<int>(order[i]));
-      }
+  const json& bonds = member(jsonRoot, "bonds");
+  if (takeNumbers(member(member(bonds, "connections"), "index"), arrays,
+                  values)) {
+    for (size_t i = 0; i < values.size() / 2; ++i) {
+      molecule.addBond(static_cast<Index>(values[2 * i]),
+                       static_cast<Index>(values[2 * i + 1]), 1);
+    }
+    if (takeNumbers(member(bonds, "order"), arrays, values)) {
+      for (size_t i = 0; i < molecule.bondCount() && i < values.size(); ++i)
+        molecule.bond(i).setOrder(static_cast<int>(values[i]));
     }
   }
 
-  json unitCell = jsonRoot["unit cell"];
-  if (!unitCell.is_object())
-    unitCell = jsonRoot["unitCell"];
+  const json* unitCell = &member(jsonRoot, "unit cell");
+  if (!unitCell->is_object())
+    unitCell = &member(jsonRoot, "unitCell");
 
-  if (unitCell.is_object()) {
+  if (unitCell->is_object()) {
     Core::UnitCell* unitCellObject = nullptr;
 
     // read in cell vectors in preference to a, b, c parameters
-    json cellVectors = unitCell["cellVectors"];
-    if (cellVectors.is_array() && cellVectors.size() == 9 &&
-        isNumericArray(cellVectors)) {
-      Vector3 aVector(cellVectors[0], cellVectors[1], cellVectors[2]);
-      Vector3 bVector(cellVectors[3], cellVectors[4], cellVectors[5]);
-      Vector3 cVector(cellVectors[6], cellVectors[7], cellVectors[8]);
+    if (takeNumbers(member(*unitCell, "cellVectors"), arrays, values) &&
+        values.size() == 9) {
+      Vector3 aVector(values[0], values[1], values[2]);
+      Vector3 bVector(values[3], values[4], values[5]);
+      Vector3 cVector(values[6], values[7], values[8]);
       unitCellObject = new Core::UnitCell(aVector, bVector, cVector);
-    } else if (unitCell["a"].is_number() && unitCell["b"].is_number() &&
-               unitCell["c"].is_number() && unitCell["alpha"].is_number() &&
-               unitCell["beta"].is_number() && unitCell["gamma"].is_number()) {
-      Real a = static_cast<Real>(unitCell["a"]);
-      Real b = static_cast<Real>(unitCell["b"]);
-      Real c = static_cast<Real>(unitCell["c"]);
-      Real alpha = static_cast<Real>(unitCell["alpha"]) * DEG_TO_RAD;
-      Real beta = static_cast<Real>(unitCell["beta"]) * DEG_TO_RAD;
-      Real gamma = static_cast<Real>(unitCell["gamma"]) * DEG_TO_RAD;
+    } else if (member(*unitCell, "a").is_number() &&
+               member(*unitCell, "b").is_number() &&
+               member(*unitCell, "c").is_number() &&
+               member(*unitCell, "alpha").is_number() &&
+               member(*unitCell, "beta").is_number() &&
+               member(*unitCell, "gamma").is_number()) {
+      Real a = static_cast<Real>(member(*unitCell, "a"));
+      Real b = static_cast<Real>(member(*unitCell, "b"));
+      Real c = static_cast<Real>(member(*unitCell, "c"));
+      Real alpha = static_cast<Real>(member(*unitCell, "alpha")) * DEG_TO_RAD;
+      Real beta = static_cast<Real>(member(*unitCell, "beta")) * DEG_TO_RAD;
+      Real gamma = static_cast<Real>(member(*unitCell, "gamma")) * DEG_TO_RAD;
       unitCellObject = new Core::UnitCell(a, b, c, alpha, beta, gamma);
     }
     if (unitCellObject != nullptr)
       molecule.setUnitCell(unitCellObject);
   }
 
-  json fractional = atoms["coords"]["3d fractional"];
-  if (!fractional.is_array())
-    fractional = atoms["coords"]["3dFractional"];
-  if (fractional.is_array() && fractional.size() == 3 * atomCount &&
-      isNumericArray(fractional) && molecule.unitCell()) {
-    Array<Vector3> fcoords;
-    fcoords.reserve(atomCount);
-    for (Index i = 0; i < atomCount; ++i) {
-      fcoords.push_back(Vector3(static_cast<Real>(fractional[i * 3 + 0]),
-                                static_cast<Real>(fractional[i * 3 + 1]),
-                                static_cast<Real>(fractional[i * 3 + 2])));
-    }
-    CrystalTools::setFractionalCoordinates(molecule, fcoords);
+  const json* fractional = &member(coords, "3d fractional");
+  if (fractional->is_null())
+    fractional = &member(coords, "3dFractional");
+  if (molecule.unitCell() && takeNumbers(*fractional, arrays, values) &&
+      values.size() == 3 * atomCount) {
+    CrystalTools::setFractionalCoordinates(molecule, toVectors(values));
   }
 
   // Basis set is optional, if present read it in.
-  json basisSet = jsonRoot["basisSet"];
+  const json& basisSet = member(jsonRoot, "basisSet");
   if (basisSet.is_object()) {
     GaussianSet* basis = new GaussianSet;
     basis->setMolecule(&molecule);
     // Gather the relevant pieces together so that they can be read in.
-    json shellTypes = basisSet["shellTypes"];
-    json primitivesPerShell = basisSet["primitivesPerShell"];
-    json shellToAtomMap = basisSet["shellToAtomMap"];
-    json exponents = basisSet["exponents"];
-    json coefficients = basisSet["coefficients"];
-
-    int nGTO = 0;
-    for (unsigned int i = 0; i < shellTypes.size(); ++i) {
+    vector<double> shellTypes, primitivesPerShell, shellToAtomMap, exponents,
+      coefficients;
+    takeNumbers(member(basisSet, "shellTypes"), arrays, shellTypes);
+    takeNumbers(member(basisSet, "primitivesPerShell"), arrays,
+                primitivesPerShell);
+    takeNumbers(member(basisSet, "shellToAtomMap"), arrays, shellToAtomMap);
+    takeNumbers(member(basisSet, "exponents"), arrays, exponents);
+    takeNumbers(member(basisSet, "coefficients"), arrays, coefficients);
+
+    size_t nGTO = 0;
+    for (size_t i = 0; i < shellTypes.size() &&
+                       i < primitivesPerShell.size() &&
+                       i < shellToAtomMap.size();
+         ++i) {
       GaussianSet::orbital type;
       switch (static_cast<int>(shellTypes[i])) {
         case 0:
@@ -270,59 +650,45 @@ bool CjsonFormat::read(std::istream& file, Molecule& molecule)
       }
       if (type != GaussianSet::UU) {
         int b = basis->addBasis(static_cast<int>(shellToAtomMap[i]), type);
-        for (int j = 0; j < static_cast<int>(primitivesPerShell[i]); ++j) {
+        for (int j = 0; j < static_cast<int>(primitivesPerShell[i]) &&
+                        nGTO < coefficients.size() && nGTO < exponents.size();
+             ++j) {
           basis->addGto(b, coefficients[nGTO], exponents[nGTO]);
           ++nGTO;
         }
       }
     }
 
-    json orbitals = jsonRoot["orbitals"];
+    const json& orbitals = member(jsonRoot, "orbitals");
     if (orbitals.is_object() && basis->isValid()) {
-      basis->setElectronCount(orbitals["electronCount"]);
-      json moCoefficients = orbitals["moCoefficients"];
-      json moCoefficientsA = orbitals["alphaCoefficients"];
-      json moCoefficientsB = orbitals["betaCoefficients"];
-      if (isNumericArray(moCoefficients)) {
-        std::vector<double> coeffs;
-        for (unsigned int i = 0; i < moCoefficients.size(); ++i)
-          coeffs.push_back(static_cast<double>(moCoefficients[i]));
-        basis->setMolecularOrbitals(coeffs);
-      } else if (isNumericArray(moCoefficientsA) &&
-                 isNumericArray(moCoefficientsB)) {
-        std::vector<double> coeffsA;
-        for (unsigned int i = 0; i < moCoefficientsA.size(); ++i)
-          coeffsA.push_back(static_cast<double>(moCoefficientsA[i]));
-        std::vector<double> coeffsB;
-        for (unsigned int i = 0; i < moCoefficientsB.size(); ++i)
-          coeffsB.push_back(static_cast<double>(moCoefficientsB[i]));
-        basis->setMolecularOrbitals(coeffsA, BasisSet::Alpha);
+      const json& electronCount = member(orbitals, "electronCount");
+      if (electronCount.is_number())
+        basis->setElectronCount(electronCount);
+      vector<double> coeffsB;
+      if (takeNumbers(member(orbitals, "moCoefficients"), arrays, values)) {
+        basis->setMolecularOrbitals(values);
+      } else if (takeNumbers(member(orbitals, "alphaCoefficients"), arrays,
+                             values) &&
+                 takeNumbers(member(orbitals, "betaCoefficients"), arrays,
+                             coeffsB)) {
+        basis->setMolecularOrbitals(values, BasisSet::Alpha);
         basis->setMolecularOrbitals(coeffsB, BasisSet::Beta);
       } else {
         std::cout << "No orbital cofficients found!" << std::endl;
       }
       // Check for orbital coefficient sets, these are paired with coordinates
       // when they exist, but have constant basis set, atom types, etc.
-      if (orbitals["sets"].is_array() && orbitals["sets"].size()) {
-        json orbSets = orbitals["sets"];
+      const json& orbSets = member(orbitals, "sets");
+      if (orbSets.is_array() && orbSets.size()) {
         for (unsigned int idx = 0; idx < orbSets.size(); ++idx) {
-          moCoefficients = orbSets[idx]["moCoefficients"];
-          moCoefficientsA = orbSets[idx]["alphaCoefficients"];
-          moCoefficientsB = orbSets[idx]["betaCoefficients"];
-          if (isNumericArray(moCoefficients)) {
-            std::vector<double> coeffs;
-            for (unsigned int i = 0; i < moCoefficients.size(); ++i)
-              coeffs.push_back(static_cast<double>(moCoefficients[i]));
-            basis->setMolecularOrbitals(coeffs, BasisSet::Paired, idx);
-          } else if (isNumericArray(moCoefficientsA) &&
-                     isNumericArray(moCoefficientsB)) {
-            std::vector<double> coeffsA;
-            for (unsigned int i = 0; i < moCoefficientsA.size(); ++i)
-              coeffsA.push_back(static_cast<double>(moCoefficientsA[i]));
-            std::vector<double> coeffsB;
-            for (unsigned int i = 0; i < moCoefficientsB.size(); ++i)
-              coeffsB.push_back(static_cast<double>(moCoefficientsB[i]));
-            basis->setMolecularOrbitals(coeffsA, BasisSet::Alpha, idx);
+          const json& orbSet = orbSets[idx];
+          if (takeNumbers(member(orbSet, "moCoefficients"), arrays, values)) {
+            basis->setMolecularOrbitals(values, BasisSet::Paired, idx);
+          } else if (takeNumbers(member(orbSet, "alphaCoefficients"), arrays,
+                                 values) &&
+                     takeNumbers(member(orbSet, "betaCoefficients"), arrays,
+                                 coeffsB)) {
+            basis->setMolecularOrbitals(values, BasisSet::Alpha, idx);
             basis->setMolecularOrbitals(coeffsB, BasisSet::Beta, idx);
           }
         }
@@ -334,53 +700,125 @@ bool CjsonFormat::read(std::istream& file, Molecule& molecule)
   }
 
   // See if there is any vibration data, load it if so.
-  json vibrations = jsonRoot["vibrations"];
+  const json& vibrations = member(jsonRoot, "vibrations");
   if (vibrations.is_object()) {
-    json frequencies = vibrations["frequencies"];
-    if (isNumericArray(frequencies)) {
+    if (takeNumbers(member(vibrations, "frequencies"), arrays, values)) {
       Array<double> freqs;
-      for (unsigned int i = 0; i < frequencies.size(); ++i) {
-        freqs.push_back(static_cast<double>(frequencies[i]));
-      }
+      for (size_t i = 0; i < values.size(); ++i)
+        freqs.push_back(values[i]);
       molecule.setVibrationFrequencies(freqs);
     }
-    json intensities = vibrations["intensities"];
-    if (isNumericArray(intensities)) {
+    if (takeNumbers(member(vibrations, "intensities"), arrays, values)) {
       Array<double> intens;
-      for (unsigned int i = 0; i < intensities.size(); ++i) {
-        intens.push_back(static_cast<double>(intensities[i]));
-      }
+      for (size_t i = 0; i < values.size(); ++i)
+        intens.push_back(values[i]);
       molecule.setVibrationIntensities(intens);
     }
-    json displacements = vibrations["eigenVectors"];
+    const json& displacements = member(vibrations, "eigenVectors");
     if (displacements.is_array()) {
       Array<Array<Vector3>> disps;
       for (unsigned int i = 0; i < displacements.size(); ++i) {
-        json arr = displacements[i];
-        if (isNumericArray(arr)) {
-          Array<Vector3> mode;
-          mode.resize(arr.size() / 3);
-          double* ptr = &mode[0][0];
-          for (unsigned int j = 0; j < arr.size(); ++j) {
-            *(ptr++) = static_cast<double>(arr[j]);
-          }
-          disps.push_back(mode);
-        }
+        if (takeNumbers(displacements[i], arrays, values))
+          disps.push_back(toVectors(values));
       }
       molecule.setVibrationLx(disps);
     }
   }
 
+  // A cube is written with its grid and values, read it back in if present.
+  const json& cube = member(jsonRoot, "cube");
+  vector<double> origin, spacing, dimensions;
+  if (takeNumbers(member(cube, "origin"), arrays, origin) &&
+      origin.size() == 3 &&
+      takeNumbers(member(cube, "spacing"), arrays, spacing) &&
+      spacing.size() == 3 &&
+      takeNumbers(member(cube, "dimensions"), arrays, dimensions) &&
+      dimensions.size() == 3 &&
+      takeNumbers(member(cube, "scalars"), arrays, values)) {
+    Vector3i dim(static_cast<int>(dimensions[0]),
+                 static_cast<int>(dimensions[1]),
+                 static_cast<int>(dimensions[2]));
+    if (dim.minCoeff() > 0 &&
+        values.size() == static_cast<size_t>(dim.x()) * dim.y() * dim.z()) {
+      Cube* newCube = molecule.addCube();
+      newCube->setLimits(Vector3(origin[0], origin[1], origin[2]), dim,
+                         Vector3(spacing[0], spacing[1], spacing[2]));
+      newCube->data()->swap(values);
+    }
+  }
+
   return true;
 }
 
+} // namespace
+
+bool CjsonFormat::read(std::istream& file, Molecule& molecule)
+{
+  json jsonRoot;
+  ArrayStore arrays;
+  if (m_encoding == Text && parseOptions(options()).value("streaming", false)) {
+    // Parse straight from the stream, never holding all of it in memory.
+    StreamingReader reader(jsonRoot, arrays);
+    if (!json::sax_parse(file, &reader)) {
+      appendError("Error parsing JSON.");
+      return false;
+    }
+    return readDocument(jsonRoot, arrays, molecule,
+                        [this](const string& error) { appendError(error); });
+  }
+
+  // Parsing from memory is much faster than a character at a time from the
+  // stream. It is read into a single string, sized up front when the stream
+  // can tell how much of it is left.
+  string buffer;
+  const std::streamoff start = file.tellg();
+  if (start >= 0) {
+    file.seekg(0, std::ios_base::end);
+    const std::streamoff end = file.tellg();
+    file.clear();
+    file.seekg(start);
+    if (end > start)
+      buffer.reserve(static_cast<size_t>(end - start));
+  }
+  char chunk[65536];
+  while (file.read(chunk, sizeof(chunk)) || file.gcount() > 0)
+    buffer.append(chunk, static_cast<size_t>(file.gcount()));
+  return readMapped(buffer.data(), buffer.size(), molecule);
+}
+
+bool CjsonFormat::readMapped(const char* data, size_t size, Molecule& molecule)
+{
+  // The streaming reader keeps the numeric arrays out of the json document.
+  bool streaming = parseOptions(options()).value("streaming", false);
+  json jsonRoot;
+  ArrayStore arrays;
+  if (m_encoding == Binary) {
+    if (!readBinary(data, size, streaming, jsonRoot, arrays)) {
+      appendError("Error parsing binary CJSON.");
+      return false;
+    }
+  } else if (streaming) {
+    StreamingReader reader(jsonRoot, arrays);
+    if (!json::sax_parse(nlohmann::detail::input_adapter(data, size),
+                         &reader)) {
+      appendError("Error parsing JSON.");
+      return false;
+    }
+  } else {
+    jsonRoot = json::parse(data, data + size, nullptr, false);
+    if (jsonRoot.is_discarded()) {
+      appendError("Error parsing JSON.");
+      return false;
+    }
+  }
+
+  return readDocument(jsonRoot, arrays, molecule,
+                      [this](const string& error) { appendError(error); });
+}
+
 bool CjsonFormat::write(std::ostream& file, const Molecule& molecule)
 {
-  json opts;
-  if (!options().empty())
-    opts = json::parse(options(), nullptr, false);
-  else
-    opts = json::object();
+  json opts = parseOptions(options());
 
   json root;
 
@@ -502,12 +940,8 @@ bool CjsonFormat::write(std::ostream& file, const Molecule& molecule)
   // Write out any cubes that are present in the molecule.
   if (molecule.cubeCount() > 0) {
     const Cube* cube = molecule.cube(0);
-    json cubeData;
-    for (vector<double>::const_iterator it = cube->data()->begin(),
-                                        itEnd = cube->data()->end();
-         it != itEnd; ++it) {
-      cubeData.push_back(*it);
-    }
+    json cubeData = cube->precision() == Cube::Float ? json(*cube->floatData())
+                                                     : json(*cube->data());
     // Get the origin, max, spacing, and dimensions to place in the object.
     json cubeObj;
     json cubeMin;
@@ -628,6 +1062,34 @@ bool CjsonFormat::write(std::ostream& file, const Molecule& molecule)
     root["vibrations"]["eigenVectors"] = eigenVectors;
   }
 
+  if (m_encoding == Binary) {
+    string encoding = opts.value("encoding", "cbor");
+    if (encoding != "cbor" && encoding != "messagepack") {
+      appendError("Unknown binary CJSON encoding: " + encoding);
+      return false;
+    }
+    vector<char> blobs;
+    extractBlobs(root, blobs);
+    vector<uint8_t> document;
+    if (encoding == "cbor")
+      json::to_cbor(root, document);
+    else
+      json::to_msgpack(root, document);
+
+    vector<char> header(binaryMagic, binaryMagic + 6);
+    header.push_back(encoding == "cbor" ? cborEncoding : messagePackEncoding);
+    header.push_back(binaryVersion);
+    uint64_t documentSize = document.size();
+    appendBlock(header, &documentSize, 1, hostIsBigEndian());
+    file.write(header.data(), header.size());
+    file.write(reinterpret_cast<const char*>(document.data()),
+               document.size());
+    const char padding[8] = {};
+    file.write(padding, alignBlob(document.size()) - document.size());
+    file.write(blobs.data(), blobs.size());
+    return static_cast<bool>(file);
+  }
+
   // Write out the file, use a two space indent to "pretty print".
   file << std::setw(2) << root;
 
@@ -648,5 +1110,19 @@ vector<std::string> CjsonFormat::mimeTypes() const
   return mime;
 }
 
+vector<std::string> CjsonBinaryFormat::fileExtensions() const
+{
+  vector<std::string> ext;
+  ext.push_back("cjsonb");
+  return ext;
+}
+
+vector<std::string> CjsonBinaryFormat::mimeTypes() const
+{
+  vector<std::string> mime;
+  mime.push_back("chemical/x-cjson-binary");
+  return mime;
+}
+
 } // namespace Io
 } // namespace Avogadro
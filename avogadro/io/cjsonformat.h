@@ -28,6 +28,10 @@ namespace Io {
 /**
  * @class CjsonFormat cjsonformat.h <avogadro/io/cjsonformat.h>
  * @brief Implementation of the Chemical JSON format.
+ *
+ * With the "streaming" option set to true, files are read without building
+ * the whole json document, moving numeric arrays straight to flat storage
+ * as they are parsed, which needs much less memory for large files.
  */
 
 class AVOGADROIO_EXPORT CjsonFormat : public FileFormat
@@ -38,7 +42,7 @@ public:
 
   Operations supportedOperations() const override
   {
-    return ReadWrite | File | Stream | String;
+    return ReadWrite | File | Stream | String | Mapped;
   }
 
   FileFormat* newInstance() const override { return new CjsonFormat; }
@@ -59,7 +63,50 @@ public:
   std::vector<std::string> mimeTypes() const override;
 
   bool read(std::istream& in, Core::Molecule& molecule) override;
+  bool readMapped(const char* data, size_t size,
+                  Core::Molecule& molecule) override;
   bool write(std::ostream& out, const Core::Molecule& molecule) override;
+
+protected:
+  /** The ways the document can be stored. */
+  enum Encoding
+  {
+    Text,
+    Binary
+  };
+
+  explicit CjsonFormat(Encoding encoding);
+
+private:
+  Encoding m_encoding;
+};
+
+/**
+ * @class CjsonBinaryFormat cjsonformat.h <avogadro/io/cjsonformat.h>
+ * @brief Chemical JSON in a binary encoding.
+ *
+ * The document is stored as CBOR, or as MessagePack when the "encoding"
+ * option is "messagepack", and its larger numeric arrays as little endian
+ * blobs after it. Everything that is read and written by CjsonFormat is
+ * read and written by this format too.
+ */
+class AVOGADROIO_EXPORT CjsonBinaryFormat : public CjsonFormat
+{
+public:
+  CjsonBinaryFormat();
+  ~CjsonBinaryFormat() override;
+
+  FileFormat* newInstance() const override { return new CjsonBinaryFormat; }
+  std::string identifier() const override { return "Avogadro: CJSON binary"; }
+  std::string name() const override { return "Chemical JSON (binary)"; }
+  std::string description() const override
+  {
+    return "Binary CJSON stores the Chemical JSON document as CBOR or "
+           "MessagePack, with numeric arrays stored as binary blobs";
+  }
+
+  std::vector<std::string> fileExtensions() const override;
+  std::vector<std::string> mimeTypes() const override;
 };
 
 } // end Io namespace
@@ -15,6 +15,10 @@
 ******************************************************************************/
 
 #include "dcdformat.h"
+
+#include "binaryblock_p.h"
+#include "fileframesource.h"
+#include "frameselection_p.h"
 #include "struct.h"
 
 #include <avogadro/core/elements.h>
@@ -24,8 +28,10 @@
 #include <avogadro/core/vector.h>
 
 #include <cmath>
+#include <cstring>
 #include <iomanip>
 #include <istream>
+#include <memory>
 #include <ostream>
 #include <sstream>
 #include <string>
@@ -74,6 +80,124 @@ char swap_endian(char endian)
     return '>';
 }
 
+namespace {
+
+// Get a value from the raw header block, in the byte order of the file.
+template <typename T>
+T headerValue(const char* raw, int offset, bool swap)
+{
+  T value;
+  std::memcpy(&value, raw + offset, sizeof(T));
+  if (swap && sizeof(T) == 4)
+    swapBytes32(&value, 1);
+  else if (swap)
+    swapBytes64(&value, 1);
+  return value;
+}
+
+// Append a record, framed by its length before and after.
+void appendRecord(vector<char>& buffer, const void* data, int32_t size)
+{
+  const char* bytes = static_cast<const char*>(data);
+  const char* length = reinterpret_cast<const char*>(&size);
+  buffer.insert(buffer.end(), length, length + sizeof(int32_t));
+  buffer.insert(buffer.end(), bytes, bytes + size);
+  buffer.insert(buffer.end(), length, length + sizeof(int32_t));
+}
+
+// Read a record of count floats, framed by its length before and after.
+bool readFloatRecord(std::istream& in, bool swap, int count, float* values)
+{
+  int32_t length;
+  if (!readBlock(in, &length, 1, swap) || length != count * 4 ||
+      !readBlock(in, values, count, swap)) {
+    return false;
+  }
+  in.seekg(sizeof(int32_t), std::ios_base::cur);
+  return static_cast<bool>(in);
+}
+
+// Read a frame: the unit cell block CHARMM trajectories may have, the x, y
+// and z coordinates, and the fourth dimension block, which is skipped. Sets
+// hasCell if the unit cell was read into cell. The coordinates are read into
+// buffer first, a whole record at a time.
+bool readDcdFrame(std::istream& in, bool swap, int charmm, int natoms,
+                  vector<float>& buffer, Array<Vector3>& positions,
+                  double* cell, bool& hasCell)
+{
+  hasCell = false;
+  int32_t length;
+
+  if ((charmm & DCD_IS_CHARMM) && (charmm & DCD_HAS_EXTRA_BLOCK)) {
+    if (!readBlock(in, &length, 1, swap))
+      return false;
+    if (length == 48) {
+      if (!readBlock(in, cell, 6, swap))
+        return false;
+      hasCell = true;
+    } else {
+      in.seekg(length, std::ios_base::cur);
+    }
+    in.seekg(sizeof(int32_t), std::ios_base::cur);
+  }
+
+  // Reading the atom coordinates
+  buffer.resize(3 * static_cast<size_t>(natoms));
+  for (int c = 0; c < 3; ++c) {
+    if (!readFloatRecord(in, swap, natoms, buffer.data() + c * natoms))
+      return false;
+  }
+  const float* x = buffer.data();
+  const float* y = x + natoms;
+  const float* z = y + natoms;
+  positions.resize(natoms);
+  Vector3* out = positions.data();
+  for (int i = 0; i < natoms; ++i)
+    out[i] = Vector3(x[i], y[i], z[i]);
+
+  // Skipping fourth dimension block
+  if ((charmm & DCD_IS_CHARMM) && (charmm & DCD_HAS_4DIMS)) {
+    if (!readBlock(in, &length, 1, swap))
+      return false;
+    in.seekg(static_cast<std::streamoff>(length) + sizeof(int32_t),
+             std::ios_base::cur);
+  }
+
+  return static_cast<bool>(in);
+}
+
+class DcdFrameSource : public FileFrameSource
+{
+public:
+  DcdFrameSource(const string& fileName, bool swap, int charmm, int natoms)
+    : FileFrameSource(fileName), m_swap(swap), m_charmm(charmm),
+      m_natoms(natoms)
+  {
+  }
+
+  Core::FrameSource* clone() const override
+  {
+    return new DcdFrameSource(*this);
+  }
+
+protected:
+  bool parseFrame(std::istream& in, Array<Vector3>& coordinates) override
+  {
+    double cell[6];
+    bool hasCell;
+    return readDcdFrame(in, m_swap, m_charmm, m_natoms, m_buffer, coordinates,
+                        cell, hasCell);
+  }
+
+private:
+  bool m_swap;
+  int m_charmm;
+  int m_natoms;
+  vector<float> m_buffer;
+};
+
+} // namespace
+
 DcdFormat::DcdFormat() {}
 
 DcdFormat::~DcdFormat() {}
@@ -101,12 +225,15 @@ bool DcdFormat::read(std::istream& inStream, Core::Molecule& mol)
 
   // Determining size of file
   inStream.seekg(0, inStream.end);
-  int fileLen = inStream.tellg();
+  std::streamoff fileLen = inStream.tellg();
   inStream.seekg(0, inStream.beg);
 
   // Reading magic number
   snprintf(fmt, sizeof(fmt), "%c1i", endian);
-  inStream.read(buff, struct_calcsize(fmt));
+  if (!inStream.read(buff, struct_calcsize(fmt))) {
+    appendError("Unexpected end of file in the header.");
+    return false;
+  }
   struct_unpack(buff, fmt, &magic);
   if (magic != DCD_MAGIC) {
     magic = swap_integer(magic);
@@ -119,38 +246,40 @@ bool DcdFormat::read(std::istream& inStream, Core::Molecule& mol)
 
   // CORD
   snprintf(fmt, sizeof(fmt), "%c%ds", endian, magic);
-  inStream.read(buff, struct_calcsize(fmt));
+  if (!inStream.read(buff, struct_calcsize(fmt))) {
+    appendError("Unexpected end of file in the header.");
+    return false;
+  }
   struct_unpack(buff, fmt, raw);
   if (raw[0] != 'C' || raw[1] != 'O' || raw[2] != 'R' || raw[3] != 'D') {
     appendError("Keyword CORD not found.");
     return false;
   }
 
+  // The struct library's '>' is big endian.
+  const bool swap = (endian == '>') != hostIsBigEndian();
+
   // Determining whether the trajectory file is from CHARMM or not
-  if (*(reinterpret_cast<int*>(raw + 80)) != 0) {
+  if (headerValue<int32_t>(raw, 80, swap) != 0) {
     charmm = DCD_IS_CHARMM;
-    if (*(reinterpret_cast<int*>(raw + 44)) != 0)
+    if (headerValue<int32_t>(raw, 44, swap) != 0)
       charmm |= DCD_HAS_EXTRA_BLOCK;
 
-    if (*(reinterpret_cast<int*>(raw + 48)) == 1)
+    if (headerValue<int32_t>(raw, 48, swap) == 1)
       charmm |= DCD_HAS_4DIMS;
   } else {
     charmm = 0;
   }
 
   // number of fixed atoms
-  NAMNF = *(reinterpret_cast<int*>(raw + 36));
+  NAMNF = headerValue<int32_t>(raw, 36, swap);
 
   // DELTA (timestep) is stored as a double with X-PLOR but as a float with
   // CHARMM
-  if (charmm & DCD_IS_CHARMM) {
-    float ftmp;
-    ftmp = *(reinterpret_cast<float*>(raw + 40));
-
-    DELTA = static_cast<double>(ftmp);
-  } else {
-    (DELTA) = *(reinterpret_cast<double*>(raw + 40));
-  }
+  if (charmm & DCD_IS_CHARMM)
+    DELTA = static_cast<double>(headerValue<float>(raw, 40, swap));
+  else
+    DELTA = headerValue<double>(raw, 40, swap);
 
   snprintf(fmt, sizeof(fmt), "%c1i", endian);
   inStream.read(buff, struct_calcsize(fmt));
@@ -160,16 +289,23 @@ bool DcdFormat::read(std::istream& inStream, Core::Molecule& mol)
   inStream.read(buff, struct_calcsize(fmt));
   struct_unpack(buff, fmt, &blockSize);
 
-  if (((blockSize - 4) % 80) == 0) {
+  if (inStream && blockSize >= 4 && ((blockSize - 4) % 80) == 0) {
     // Read NTITLE, the number of 80 character title strings
     snprintf(fmt, sizeof(fmt), "%c1i", endian);
     inStream.read(buff, struct_calcsize(fmt));
     struct_unpack(buff, fmt, &NTITLE);
+    // The titles are read in one go, and must fill the block.
+    if (!inStream || NTITLE < 0 || NTITLE * 80 != blockSize - 4 ||
+        NTITLE * 80 > static_cast<int>(sizeof(buff))) {
+      appendError("Title block does not match its size.");
+      return false;
+    }
     lenRemarks = NTITLE * 80;
     remarks = reinterpret_cast<char*>(malloc(lenRemarks));
     snprintf(fmt, sizeof(fmt), "%c%ds", endian, lenRemarks);
     inStream.read(buff, struct_calcsize(fmt));
     struct_unpack(buff, fmt, remarks);
+    free(remarks);
 
     snprintf(fmt, sizeof(fmt), "%c1i", endian);
     inStream.read(buff, struct_calcsize(fmt));
@@ -195,10 +331,18 @@ bool DcdFormat::read(std::istream& inStream, Core::Molecule& mol)
   snprintf(fmt, sizeof(fmt), "%c1i", endian);
   inStream.read(buff, struct_calcsize(fmt));
   struct_unpack(buff, fmt, &fourInput);
+  if (!inStream) {
+    appendError("Unexpected end of file in the header.");
+    return false;
+  }
   if (fourInput != 4) {
     appendError("Expected token 4. Read token " + to_string(fourInput));
     return false;
   }
+  if (NATOMS < 1) {
+    appendError("Invalid number of atoms " + to_string(NATOMS) + ".");
+    return false;
+  }
 
   if (NAMNF != 0) {
     int** FREEINDEXES =
@@ -233,91 +377,43 @@ bool DcdFormat::read(std::istream& inStream, Core::Molecule& mol)
     }
   }
 
+  // The frames follow the header, each with the same size as long as there
+  // are no fixed atoms.
+  std::streamoff firstFrame = inStream.tellg();
+  vector<float> buffer;
+  Array<Vector3> positions;
+  double unitcell[6];
+  bool hasCell;
+  if (!readDcdFrame(inStream, swap, charmm, NATOMS, buffer, positions,
+                    unitcell, hasCell)) {
+    appendError("Unable to read the first frame.");
+    return false;
+  }
+  std::streamoff frameSize = static_cast<std::streamoff>(inStream.tellg()) -
+                             firstFrame;
+
   // CHARMM trajectories have an extra block to be read, that contains
   // information about the unit cell
-  if ((charmm & DCD_IS_CHARMM) && (charmm & DCD_HAS_EXTRA_BLOCK)) {
-    snprintf(fmt, sizeof(fmt), "%c1i", endian);
-    inStream.read(buff, struct_calcsize(fmt));
-    int leadingNum;
-    struct_unpack(buff, fmt, &leadingNum);
-
-    if (leadingNum == 48) {
-      double unitcell[6];
-      for (int aa = 0; aa < 6; ++aa) {
-        snprintf(fmt, sizeof(fmt), "%c%dd", endian, 1);
-        inStream.read(buff, struct_calcsize(fmt));
-        struct_unpack(buff, fmt, &unitcell[aa]);
-      }
-      if (unitcell[1] >= -1.0 && unitcell[1] <= 1.0 && unitcell[3] >= -1.0 &&
-          unitcell[3] <= 1.0 && unitcell[4] >= -1.0 && unitcell[4] <= 1.0) {
-        // CHARMM and certain NAMD files have the cosines instead of angles
-        // This formulation improves rounding behavior for orthogonal cells
-        // so that the angles end up at precisely 90 degrees, unlike acos()
-        unitcell[4] = M_PI_2 - asin(unitcell[4]); /* cosBC */
-        unitcell[3] = M_PI_2 - asin(unitcell[3]); /* cosAC */
-        unitcell[1] = M_PI_2 - asin(unitcell[1]); /* cosAB */
-      }
-
-      mol.setUnitCell(new UnitCell(unitcell[0], unitcell[2], unitcell[5],
-                                   unitcell[4], unitcell[3], unitcell[1]));
-    } else {
-      inStream.read(buff, leadingNum);
+  if (hasCell) {
+    if (unitcell[1] >= -1.0 && unitcell[1] <= 1.0 && unitcell[3] >= -1.0 &&
+        unitcell[3] <= 1.0 && unitcell[4] >= -1.0 && unitcell[4] <= 1.0) {
+      // CHARMM and certain NAMD files have the cosines instead of angles
+      // This formulation improves rounding behavior for orthogonal cells
+      // so that the angles end up at precisely 90 degrees, unlike acos()
+      unitcell[4] = M_PI_2 - asin(unitcell[4]); /* cosBC */
+      unitcell[3] = M_PI_2 - asin(unitcell[3]); /* cosAC */
+      unitcell[1] = M_PI_2 - asin(unitcell[1]); /* cosAB */
     }
-    inStream.read(buff, sizeof(int));
-  }
-
-  // Reading the atom coordinates
-  int formatint[6];
-  Array<float> cx, cy, cz;
-  cx.reserve(NATOMS);
-  cy.reserve(NATOMS);
-  cz.reserve(NATOMS);
 
-  snprintf(fmt, sizeof(fmt), "%c1i", endian);
-  inStream.read(buff, struct_calcsize(fmt));
-  struct_unpack(buff, fmt, &formatint[0]);
-
-  for (int i = 0; i < NATOMS; ++i) {
-    // X coordinates
-    snprintf(fmt, sizeof(fmt), "%c%df", endian, 1);
-    inStream.read(buff, struct_calcsize(fmt));
-    struct_unpack(buff, fmt, &cx[i]);
-    /* code */
-  }
-
-  snprintf(fmt, sizeof(fmt), "%c2i", endian);
-  inStream.read(buff, struct_calcsize(fmt));
-  struct_unpack(buff, fmt, &formatint[1], &formatint[2]);
-
-  for (int i = 0; i < NATOMS; ++i) {
-    // Y coordinates
-    snprintf(fmt, sizeof(fmt), "%c%df", endian, 1);
-    inStream.read(buff, struct_calcsize(fmt));
-    struct_unpack(buff, fmt, &cy[i]);
-  }
-
-  snprintf(fmt, sizeof(fmt), "%c2i", endian);
-  inStream.read(buff, struct_calcsize(fmt));
-  struct_unpack(buff, fmt, &formatint[3], &formatint[4]);
-
-  for (int i = 0; i < NATOMS; ++i) {
-    // Z coordinates
-    snprintf(fmt, sizeof(fmt), "%c%df", endian, 1);
-    inStream.read(buff, struct_calcsize(fmt));
-    struct_unpack(buff, fmt, &cz[i]);
+    mol.setUnitCell(new UnitCell(unitcell[0], unitcell[2], unitcell[5],
+                                 unitcell[4], unitcell[3], unitcell[1]));
   }
 
-  snprintf(fmt, sizeof(fmt), "%c1i", endian);
-  inStream.read(buff, struct_calcsize(fmt));
-  struct_unpack(buff, fmt, &formatint[5]);
-
   typedef map<string, unsigned char> AtomTypeMap;
   AtomTypeMap atomTypes;
   unsigned char customElementCounter = CustomElementMin;
 
   for (int i = 0; i < NATOMS; ++i) {
-    Vector3 pos(cx[i], cy[i], cz[i]);
-
     AtomTypeMap::const_iterator it;
     atomTypes.insert(std::make_pair(to_string(i), customElementCounter++));
     it = atomTypes.find(to_string(i));
@@ -326,23 +422,11 @@ bool DcdFormat::read(std::istream& inStream, Core::Molecule& mol)
     //   return false;
     // }
     Atom newAtom = mol.addAtom(it->second);
-    newAtom.setPosition3d(pos);
+    newAtom.setPosition3d(positions[i]);
   }
 
   mol.setTimeStep(0, 0);
 
-  // Skipping fourth dimension block
-  if ((charmm & DCD_IS_CHARMM) && (charmm & DCD_HAS_EXTRA_BLOCK)) {
-    snprintf(fmt, sizeof(fmt), "%c1i", endian);
-    inStream.read(buff, struct_calcsize(fmt));
-    int sizeToRead;
-    struct_unpack(buff, fmt, &sizeToRead);
-
-    inStream.read(buff, sizeToRead);
-
-    inStream.read(buff, sizeof(int));
-  }
-
   // Set the custom element map if needed
   if (!atomTypes.empty()) {
     Molecule::CustomElementMap elementMap;
@@ -354,83 +438,130 @@ bool DcdFormat::read(std::istream& inStream, Core::Molecule& mol)
     mol.setCustomElementMap(elementMap);
   }
 
+  // Frames of trajectories read from a file are located from their fixed size,
+  // and only read when they are needed.
+  if (isMode(Read) && !fileName().empty() && NAMNF == 0) {
+    Index frameCount = static_cast<Index>((fileLen - firstFrame) / frameSize);
+    std::unique_ptr<DcdFrameSource> frames(
+      new DcdFrameSource(fileName(), swap, charmm, NATOMS));
+    frames->setFixedFrames(firstFrame, frameSize, frameCount);
+    for (Index i = 0; i < frameCount; ++i)
+      mol.setTimeStep(DELTA * i, i);
+    if (frameCount > 1)
+      mol.setFrameSource(frames.release());
+    else
+      mol.setCoordinate3d(mol.atomPositions3d(), 0);
+    return true;
+  }
+
   mol.setCoordinate3d(mol.atomPositions3d(), 0);
 
   // Do we have an animation?
   int coordSet = 1;
-  while ((static_cast<int>(inStream.tellg()) != fileLen) &&
-         (static_cast<int>(inStream.tellg()) != DCD_EOF)) {
-    // Reading the atom coordinates
-    Array<Vector3> positions;
-    positions.reserve(NATOMS);
-
-    snprintf(fmt, sizeof(fmt), "%c1i", endian);
-    inStream.read(buff, struct_calcsize(fmt));
-    struct_unpack(buff, fmt, &formatint[0]);
-
-    for (int i = 0; i < NATOMS; ++i) {
-      // X coordinates
-      snprintf(fmt, sizeof(fmt), "%c%df", endian, 1);
-      inStream.read(buff, struct_calcsize(fmt));
-      struct_unpack(buff, fmt, &cx[i]);
+  while ((static_cast<std::streamoff>(inStream.tellg()) != fileLen) &&
+         (static_cast<std::streamoff>(inStream.tellg()) != DCD_EOF)) {
+    if (!readDcdFrame(inStream, swap, charmm, NATOMS, buffer, positions,
+                      unitcell, hasCell)) {
+      break;
     }
+    mol.setTimeStep(DELTA * coordSet, coordSet);
+    mol.setCoordinate3d(positions, coordSet++);
+  }
 
-    snprintf(fmt, sizeof(fmt), "%c2i", endian);
-    inStream.read(buff, struct_calcsize(fmt));
-    struct_unpack(buff, fmt, &formatint[1], &formatint[2]);
-
-    for (int i = 0; i < NATOMS; ++i) {
-      // Y coordinates
-      snprintf(fmt, sizeof(fmt), "%c%df", endian, 1);
-      inStream.read(buff, struct_calcsize(fmt));
-      struct_unpack(buff, fmt, &cy[i]);
-    }
+  return true;
+}
 
-    snprintf(fmt, sizeof(fmt), "%c2i", endian);
-    inStream.read(buff, struct_calcsize(fmt));
-    struct_unpack(buff, fmt, &formatint[3], &formatint[4]);
+bool DcdFormat::write(std::ostream& outStream, const Core::Molecule& mol)
+{
+  vector<int> frames;
+  string error;
+  if (!selectedFrames(mol, options(), frames, error)) {
+    appendError(error);
+    return false;
+  }
+  const int natoms = static_cast<int>(mol.atomCount());
+  const UnitCell* cell = mol.unitCell();
+
+  // The time between frames, if there is more than one.
+  double delta = 0.0;
+  if (frames.size() > 1 && frames[0] >= 0) {
+    bool status0, status1;
+    double t0 = mol.timeStep(frames[0], status0);
+    double t1 = mol.timeStep(frames[1], status1);
+    if (status0 && status1)
+      delta = t1 - t0;
+  }
 
-    for (int i = 0; i < NATOMS; ++i) {
-      // Z coordinates
-      snprintf(fmt, sizeof(fmt), "%c%df", endian, 1);
-      inStream.read(buff, struct_calcsize(fmt));
-      struct_unpack(buff, fmt, &cz[i]);
+  // The records are written in the byte order of this machine, which readers
+  // detect from the length of the first one.
+  vector<char> buffer;
+
+  // The CHARMM flavor of the header, which has room for a unit cell in each
+  // frame.
+  int32_t control[20] = { 0 };
+  control[0] = static_cast<int32_t>(frames.size()); // Number of frames
+  control[2] = 1;                                   // Steps between frames
+  control[3] = static_cast<int32_t>(frames.size()); // Number of steps
+  float floatDelta = static_cast<float>(delta);
+  std::memcpy(&control[9], &floatDelta, sizeof(float));
+  control[10] = cell ? 1 : 0; // Unit cell block in each frame
+  control[19] = 24;           // CHARMM version
+  char header[84];
+  std::memcpy(header, "CORD", 4);
+  std::memcpy(header + 4, control, sizeof(control));
+  appendRecord(buffer, header, sizeof(header));
+
+  char title[84];
+  int32_t titleCount = 1;
+  std::memcpy(title, &titleCount, sizeof(int32_t));
+  std::memset(title + 4, ' ', 80);
+  const char remarks[] = "REMARKS Created by Avogadro";
+  std::memcpy(title + 4, remarks, sizeof(remarks) - 1);
+  appendRecord(buffer, title, sizeof(title));
+
+  int32_t atomCount = natoms;
+  appendRecord(buffer, &atomCount, sizeof(int32_t));
+  outStream.write(buffer.data(), buffer.size());
+
+  // Each frame is fetched, written and released in turn, so trajectories that
+  // are read on demand are never all in memory.
+  vector<float> coords(natoms);
+  for (size_t f = 0; f < frames.size(); ++f) {
+    const Array<Vector3> positions = frames[f] < 0
+                                       ? mol.atomPositions3d()
+                                       : mol.coordinate3d(frames[f]);
+    if (static_cast<int>(positions.size()) != natoms) {
+      appendError("Frame " + to_string(frames[f]) +
+                  " does not have a position for each atom.");
+      return false;
     }
 
-    snprintf(fmt, sizeof(fmt), "%c1i", endian);
-    inStream.read(buff, struct_calcsize(fmt));
-    struct_unpack(buff, fmt, &formatint[5]);
-
-    for (int i = 0; i < NATOMS; ++i) {
-      Vector3 pos(cx[i], cy[i], cz[i]);
-      positions.push_back(pos);
+    buffer.clear();
+    if (cell) {
+      // The CHARMM convention, with the cosines of the angles.
+      double values[6] = { cell->a(),
+                           std::cos(cell->gamma()),
+                           cell->b(),
+                           std::cos(cell->beta()),
+                           std::cos(cell->alpha()),
+                           cell->c() };
+      appendRecord(buffer, values, sizeof(values));
     }
-
-    mol.setTimeStep(DELTA * coordSet, coordSet);
-
-    // Skipping fourth dimension block
-    if ((charmm & DCD_IS_CHARMM) && (charmm & DCD_HAS_EXTRA_BLOCK)) {
-      snprintf(fmt, sizeof(fmt), "%c1i", endian);
-      inStream.read(buff, struct_calcsize(fmt));
-      int sizeToRead;
-      struct_unpack(buff, fmt, &sizeToRead);
-
-      inStream.read(buff, sizeToRead);
-
-      inStream.read(buff, sizeof(int));
+    for (int c = 0; c < 3; ++c) {
+      for (int i = 0; i < natoms; ++i)
+        coords[i] = static_cast<float>(positions[i][c]);
+      appendRecord(buffer, coords.data(), natoms * sizeof(float));
+    }
+    outStream.write(buffer.data(), buffer.size());
+    if (!outStream) {
+      appendError("Unable to write the trajectory.");
+      return false;
     }
-
-    mol.setCoordinate3d(positions, coordSet++);
   }
 
   return true;
 }
 
-bool DcdFormat::write(std::ostream& outStream, const Core::Molecule& mol)
-{
-  return false;
-}
-
 std::vector<std::string> DcdFormat::fileExtensions() const
 {
   std::vector<std::string> ext;
@@ -36,7 +36,7 @@ public:
 
   Operations supportedOperations() const override
   {
-    return ReadWrite | MultiMolecule | File | Stream | String;
+    return ReadWrite | MultiMolecule | File | Stream | String | Mapped;
   }
 
   FileFormat* newInstance() const override { return new DcdFormat; }
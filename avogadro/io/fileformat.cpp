@@ -16,6 +16,12 @@
 
 #include "fileformat.h"
 
+#include "fileframesource.h"
+#include "mappedfile.h"
+#include "memorystream_p.h"
+
+#include <avogadro/core/molecule.h>
+
 #include <fstream>
 #include <locale>
 #include <sstream>
@@ -97,9 +103,33 @@ bool FileFormat::writeMolecule(const Core::Molecule& molecule)
   return write(*m_out, molecule);
 }
 
+bool FileFormat::readMapped(const char* data, size_t size,
+                            Core::Molecule& molecule)
+{
+  MemoryInputStream stream(data, size);
+  // Imbue the standard C locale.
+  locale cLocale("C");
+  stream.imbue(cLocale);
+  return read(stream, molecule);
+}
+
 bool FileFormat::readFile(const std::string& fileName_,
                           Core::Molecule& molecule)
 {
+  // The mapping is only used while reading, nothing read on demand later may
+  // keep it, as the file could shrink under it.
+  if (supportedOperations() & Mapped) {
+    MappedFile mapped;
+    if (mapped.open(fileName_)) {
+      close();
+      m_fileName = fileName_;
+      m_mode = Read;
+      bool result = readMapped(mapped.data(), mapped.size(), molecule);
+      close();
+      return result;
+    }
+  }
+
   bool result = open(fileName_, Read);
   if (!result)
     return false;
@@ -112,6 +142,25 @@ bool FileFormat::readFile(const std::string& fileName_,
 bool FileFormat::writeFile(const std::string& fileName_,
                            const Core::Molecule& molecule)
 {
+  // Opening the file truncates it, so frames still to be read from it are
+  // copied into memory first.
+  const FileFrameSource* frames =
+    dynamic_cast<const FileFrameSource*>(molecule.frameSource());
+  if (frames && frames->readsFrom(fileName_)) {
+    Core::Molecule copy(molecule);
+    for (int i = 0; i < molecule.coordinate3dCount(); ++i) {
+      Core::Array<Vector3> coordinates = molecule.coordinate3d(i);
+      if (coordinates.empty()) {
+        appendError("Unable to read frame " + std::to_string(i) + " of " +
+                    fileName_ + " before writing over it.");
+        return false;
+      }
+      copy.setCoordinate3d(coordinates, i);
+    }
+    copy.setFrameSource(nullptr);
+    return writeFile(fileName_, copy);
+  }
+
   bool result = open(fileName_, Write);
   if (!result)
     return false;
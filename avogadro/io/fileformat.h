@@ -66,6 +66,7 @@ public:
     Stream = 0x10,
     String = 0x20,
     File = 0x40,
+    Mapped = 0x80,
 
     All = ReadWrite | MultiMolecule | Stream | String | File
   };
@@ -125,6 +126,17 @@ public:
    */
   virtual bool read(std::istream& in, Core::Molecule& molecule) = 0;
 
+  /**
+   * @brief Read a molecule from the @p size bytes at @p data, which hold the
+   * whole of the file being read. readFile() calls this in place of read()
+   * for formats that support the Mapped operation, with the file mapped into
+   * memory where the system allows it, so that they can parse it in place.
+   * The default implementation reads the bytes through read().
+   * @return True on success, false on failure.
+   */
+  virtual bool readMapped(const char* data, size_t size,
+                          Core::Molecule& molecule);
+
   /**
    * @brief Write to the given @p out stream the contents of @p molecule.
    * @param fileName The output stream to write the data to.
@@ -142,7 +154,9 @@ public:
   bool readFile(const std::string& fileName, Core::Molecule& molecule);
 
   /**
-   * @brief Write to the given @p fileName the contents of @p molecule.
+   * @brief Write to the given @p fileName the contents of @p molecule. If
+   * the trajectory frames of @p molecule are read on demand from the same
+   * file, they are all read in first, as writing truncates the file.
    * @param fileName The full path to the file to be written.
    * @param molecule The contents of this molecule will be written to the file.
    * @return True on success, false on failure.
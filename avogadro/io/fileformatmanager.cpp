@@ -302,6 +302,7 @@ FileFormatManager::FileFormatManager()
 {
   addFormat(new CmlFormat);
   addFormat(new CjsonFormat);
+  addFormat(new CjsonBinaryFormat);
   addFormat(new GromacsFormat);
   addFormat(new MdlFormat);
   addFormat(new OutcarFormat);
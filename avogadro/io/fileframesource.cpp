@@ -0,0 +1,87 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include "fileframesource.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define AVO_HAVE_STAT
+#include <sys/stat.h>
+#endif
+
+namespace Avogadro {
+namespace Io {
+
+FileFrameSource::FileFrameSource(const std::string& fileName)
+  : m_fileName(fileName), m_firstOffset(0), m_frameSize(0), m_fixedCount(0)
+{
+}
+
+FileFrameSource::FileFrameSource(const FileFrameSource& other)
+  : Core::FrameSource(other), m_fileName(other.m_fileName),
+    m_offsets(other.m_offsets), m_firstOffset(other.m_firstOffset),
+    m_frameSize(other.m_frameSize), m_fixedCount(other.m_fixedCount)
+{
+}
+
+FileFrameSource::~FileFrameSource()
+{
+}
+
+Index FileFrameSource::frameCount() const
+{
+  return m_frameSize != 0 ? m_fixedCount : m_offsets.size();
+}
+
+void FileFrameSource::setFixedFrames(std::streamoff offset,
+                                     std::streamoff frameSize, Index count)
+{
+  m_offsets.clear();
+  m_firstOffset = offset;
+  m_frameSize = frameSize;
+  m_fixedCount = count;
+}
+
+std::streamoff FileFrameSource::frameOffset(Index index) const
+{
+  if (m_frameSize != 0)
+    return m_firstOffset + static_cast<std::streamoff>(index) * m_frameSize;
+  return m_offsets[index];
+}
+
+bool FileFrameSource::readsFrom(const std::string& fileName) const
+{
+  if (fileName == m_fileName)
+    return true;
+#ifdef AVO_HAVE_STAT
+  // The same file may be reached through another path.
+  struct stat info;
+  struct stat ownInfo;
+  return ::stat(fileName.c_str(), &info) == 0 &&
+         ::stat(m_fileName.c_str(), &ownInfo) == 0 &&
+         info.st_dev == ownInfo.st_dev && info.st_ino == ownInfo.st_ino;
+#else
+  return false;
+#endif
+}
+
+bool FileFrameSource::readFrame(Index index, Core::Array<Vector3>& coordinates)
+{
+  if (!m_file) {
+    m_file.reset(new std::ifstream(m_fileName.c_str(), std::ifstream::binary));
+    if (!m_file->is_open()) {
+      m_file.reset();
+      return false;
+    }
+  }
+
+  m_file->clear();
+  m_file->seekg(frameOffset(index));
+  if (!*m_file)
+    return false;
+  return parseFrame(*m_file, coordinates);
+}
+
+} // namespace Io
+} // namespace Avogadro
@@ -0,0 +1,87 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#ifndef AVOGADRO_IO_FILEFRAMESOURCE_H
+#define AVOGADRO_IO_FILEFRAMESOURCE_H
+
+#include "avogadroioexport.h"
+
+#include <avogadro/core/framesource.h>
+
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Avogadro {
+namespace Io {
+
+/**
+ * @class FileFrameSource fileframesource.h <avogadro/io/fileframesource.h>
+ * @brief The FileFrameSource class reads trajectory frames from a file on
+ * demand.
+ *
+ * File formats index the offset of each frame in the file when it is opened,
+ * or for binary formats with frames of a fixed size just the first of them,
+ * and subclass this to parse a single frame starting at its offset. The file
+ * is only opened once a frame is first needed, and is read as a stream rather
+ * than through a mapping, so that a file truncated in the meantime fails the
+ * read instead of faulting.
+ */
+class AVOGADROIO_EXPORT FileFrameSource : public Core::FrameSource
+{
+public:
+  explicit FileFrameSource(const std::string& fileName);
+  FileFrameSource(const FileFrameSource& other);
+  ~FileFrameSource() override;
+
+  Index frameCount() const override;
+
+  const std::string& fileName() const { return m_fileName; }
+
+  /**
+   * Append a frame starting at @a offset bytes into the file.
+   */
+  void addFrame(std::streamoff offset) { m_offsets.push_back(offset); }
+
+  /**
+   * Use @a count frames of @a frameSize bytes each, the first starting at
+   * @a offset, in place of the frames added.
+   */
+  void setFixedFrames(std::streamoff offset, std::streamoff frameSize,
+                      Index count);
+
+  std::streamoff frameOffset(Index index) const;
+
+  /**
+   * @return True if the frames are read from the file @a fileName, which
+   * would lose them if it were written over.
+   */
+  bool readsFrom(const std::string& fileName) const;
+
+protected:
+  bool readFrame(Index index, Core::Array<Vector3>& coordinates) override;
+
+  /**
+   * Parse the coordinates of a frame, with @a in at the start of the frame.
+   */
+  virtual bool parseFrame(std::istream& in,
+                          Core::Array<Vector3>& coordinates) = 0;
+
+private:
+  std::string m_fileName;
+  std::vector<std::streamoff> m_offsets;
+  // The layout of fixed size frames, used when m_frameSize is not zero.
+  std::streamoff m_firstOffset;
+  std::streamoff m_frameSize;
+  Index m_fixedCount;
+  std::unique_ptr<std::ifstream> m_file;
+};
+
+} // namespace Io
+} // namespace Avogadro
+
+#endif // AVOGADRO_IO_FILEFRAMESOURCE_H
@@ -0,0 +1,120 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#ifndef AVOGADRO_IO_FRAMEBATCH_P_H
+#define AVOGADRO_IO_FRAMEBATCH_P_H
+
+#include <avogadro/core/array.h>
+#include <avogadro/core/utilities.h>
+#include <avogadro/core/vector.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Avogadro {
+namespace Io {
+
+/**
+ * Collects the text of the frames of a text trajectory, and parses them on
+ * several threads once there are enough of them. The readers scan the file
+ * for the frames serially, which only needs to find the ends of lines, and
+ * leave the number parsing to the batch.
+ */
+class FrameBatch
+{
+public:
+  FrameBatch()
+    : m_size(0), m_bytes(0),
+      m_threads(std::max(1u, std::thread::hardware_concurrency()))
+  {
+  }
+
+  /**
+   * Append a copy of the text of a frame.
+   */
+  void add(Core::StringView text)
+  {
+    if (m_size == m_texts.size()) {
+      m_texts.resize(m_size + 1);
+      m_frames.resize(m_size + 1);
+      m_failed.resize(m_size + 1);
+    }
+    m_texts[m_size].assign(text.data(), text.size());
+    m_bytes += text.size();
+    ++m_size;
+  }
+
+  size_t size() const { return m_size; }
+
+  /**
+   * @return True once the batch holds enough text to be parsed.
+   */
+  bool isFull() const
+  {
+    return m_size >= 64 * m_threads || m_bytes >= (size_t(64) << 20);
+  }
+
+  /**
+   * Call parse(index, text, coordinates) for each frame on several threads,
+   * each frame on one of them.
+   * @return The index of the first frame that failed to parse, or size().
+   */
+  template <typename Parse>
+  size_t parse(const Parse& parse)
+  {
+    size_t threads = std::min(m_threads, m_size);
+    auto work = [&](size_t thread) {
+      for (size_t i = thread; i < m_size; i += threads)
+        m_failed[i] = !parse(i, Core::StringView(m_texts[i]), m_frames[i]);
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; ++t)
+      pool.push_back(std::thread(work, t));
+    if (threads > 0)
+      work(0);
+    for (size_t t = 0; t < pool.size(); ++t)
+      pool[t].join();
+
+    for (size_t i = 0; i < m_size; ++i) {
+      if (m_failed[i])
+        return i;
+    }
+    return m_size;
+  }
+
+  Core::StringView text(size_t index) const
+  {
+    return Core::StringView(m_texts[index]);
+  }
+
+  /**
+   * The coordinates parsed for frame @a index.
+   */
+  Core::Array<Vector3>& frame(size_t index) { return m_frames[index]; }
+
+  /**
+   * Empty the batch, keeping its storage for the next one.
+   */
+  void clear()
+  {
+    m_size = 0;
+    m_bytes = 0;
+  }
+
+private:
+  std::vector<std::string> m_texts;
+  std::vector<Core::Array<Vector3>> m_frames;
+  std::vector<char> m_failed;
+  size_t m_size;
+  size_t m_bytes;
+  size_t m_threads;
+};
+
+} // namespace Io
+} // namespace Avogadro
+
+#endif // AVOGADRO_IO_FRAMEBATCH_P_H
@@ -0,0 +1,70 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#ifndef AVOGADRO_IO_FRAMESELECTION_P_H
+#define AVOGADRO_IO_FRAMESELECTION_P_H
+
+#include <avogadro/core/molecule.h>
+
+#include <nlohmann/json.hpp>
+
+#include <string>
+#include <vector>
+
+namespace Avogadro {
+namespace Io {
+
+/**
+ * Get the coordinate sets of @a molecule that trajectory writers should
+ * write, as selected by the "firstFrame", "lastFrame" (inclusive, -1 for the
+ * last frame) and "frameStride" entries of the JSON @a options. A molecule
+ * without coordinate sets has its current positions written as its only
+ * frame, which is given as index -1.
+ * @return False if one of the entries is not an integer, with @a error
+ * saying which.
+ */
+inline bool selectedFrames(const Core::Molecule& molecule,
+                           const std::string& options, std::vector<int>& frames,
+                           std::string& error)
+{
+  nlohmann::json opts;
+  if (!options.empty())
+    opts = nlohmann::json::parse(options, nullptr, false);
+  if (!opts.is_object())
+    opts = nlohmann::json::object();
+
+  const char* names[3] = { "firstFrame", "lastFrame", "frameStride" };
+  for (int i = 0; i < 3; ++i) {
+    if (opts.count(names[i]) && !opts[names[i]].is_number_integer()) {
+      error = std::string("The ") + names[i] + " option must be an integer.";
+      return false;
+    }
+  }
+
+  frames.clear();
+  int count = molecule.coordinate3dCount();
+  if (count == 0) {
+    frames.push_back(-1);
+    return true;
+  }
+
+  int first = opts.value("firstFrame", 0);
+  int last = opts.value("lastFrame", -1);
+  int stride = opts.value("frameStride", 1);
+  if (last < 0 || last >= count)
+    last = count - 1;
+  if (first < 0)
+    first = 0;
+  if (stride < 1)
+    stride = 1;
+  for (int i = first; i <= last; i += stride)
+    frames.push_back(i);
+  return true;
+}
+
+} // namespace Io
+} // namespace Avogadro
+
+#endif // AVOGADRO_IO_FRAMESELECTION_P_H
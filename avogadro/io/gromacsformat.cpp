@@ -16,6 +16,8 @@
 
 #include "gromacsformat.h"
 
+#include "linereader.h"
+
 #include <avogadro/core/avogadrocore.h>
 
 #include <avogadro/core/atom.h>
@@ -35,12 +37,11 @@ namespace Io {
 using Core::Atom;
 using Core::Molecule;
 using Core::UnitCell;
-using Core::lexicalCast;
-using Core::trimmed;
-using Core::split;
+using Core::parseNumber;
+using Core::StringView;
+using Core::tokenize;
 
 using std::string;
-using std::getline;
 using std::map;
 using std::vector;
 
@@ -64,20 +65,19 @@ std::vector<std::string> GromacsFormat::mimeTypes() const
 
 bool GromacsFormat::read(std::istream& in, Molecule& molecule)
 {
-  string buffer;
-  string value;
+  LineReader reader(in);
+  StringView buffer;
+  StringView value;
 
   // Title
-  getline(in, buffer);
+  reader.getLine(buffer);
   if (!buffer.empty())
-    molecule.setData("name", trimmed(buffer));
+    molecule.setData("name", buffer.trimmed().toString());
 
   // Atom count
-  getline(in, buffer);
-  buffer = trimmed(buffer);
-  bool ok;
-  size_t numAtoms = lexicalCast<size_t>(buffer, ok);
-  if (buffer.empty() || !ok) {
+  reader.getLine(buffer);
+  size_t numAtoms = 0;
+  if (!parseNumber(buffer, numAtoms)) {
     appendError("Number of atoms (line 2) invalid.");
     return false;
   }
@@ -87,28 +87,31 @@ bool GromacsFormat::read(std::istream& in, Molecule& molecule)
   AtomTypeMap atomTypes;
   unsigned char customElementCounter = CustomElementMin;
   Vector3 pos;
+  string atomName;
   while (numAtoms-- > 0) {
-    getline(in, buffer);
+    if (!reader.getLine(buffer))
+      buffer = StringView();
     // Figure out the distance between decimal points, implement support for
     // variable precision as specified:
     // "any number of decimal places, the format will then be n+5 positions with
     // n decimal places (n+1 for velocities) in stead of 8 with 3 (with 4 for
     // velocities)".
-    size_t decimal1 = buffer.find(".", 20);
-    size_t decimal2 = string::npos;
+    size_t decimal1 = buffer.find('.', 20);
+    size_t decimal2 = StringView::npos;
     int decimalSep = 0;
-    if (decimal1 != string::npos)
-      decimal2 = buffer.find(".", decimal1 + 1);
-    if (decimal2 != string::npos)
+    if (decimal1 != StringView::npos)
+      decimal2 = buffer.find('.', decimal1 + 1);
+    if (decimal2 != StringView::npos)
       decimalSep = decimal2 - decimal1;
     if (decimalSep == 0) {
-      appendError("Decimal separation of 0 found in atom positions: " + buffer);
+      appendError("Decimal separation of 0 found in atom positions: " +
+                  buffer.toString());
       return false;
     }
 
     if (buffer.size() < static_cast<size_t>(20 + 3 * decimalSep)) {
       appendError("Error reading atom specification -- line too short: " +
-                  buffer);
+                  buffer.toString());
       return false;
     }
 
@@ -125,11 +128,12 @@ bool GromacsFormat::read(std::istream& in, Molecule& molecule)
     // Offset: 60 format: %8.4f value: z velocity (nm/ps, a.k.a. km/s)
 
     // Atom name:
-    value = trimmed(buffer.substr(10, 5));
-    AtomTypeMap::const_iterator it = atomTypes.find(value);
+    value = buffer.substr(10, 5).trimmed();
+    atomName.assign(value.data(), value.size());
+    AtomTypeMap::const_iterator it = atomTypes.find(atomName);
     if (it == atomTypes.end()) {
-      atomTypes.insert(std::make_pair(value, customElementCounter++));
-      it = atomTypes.find(value);
+      atomTypes.insert(std::make_pair(atomName, customElementCounter++));
+      it = atomTypes.find(atomName);
       if (customElementCounter > CustomElementMax) {
         appendError("Custom element type limit exceeded.");
         return false;
@@ -139,12 +143,11 @@ bool GromacsFormat::read(std::istream& in, Molecule& molecule)
 
     // Coords
     for (int i = 0; i < 3; ++i) {
-      value = trimmed(buffer.substr(20 + i * decimalSep, decimalSep));
-      pos[i] = lexicalCast<Real>(value, ok);
-      if (!ok || value.empty()) {
+      value = buffer.substr(20 + i * decimalSep, decimalSep).trimmed();
+      if (!parseNumber(value, pos[i])) {
         appendError(
-          "Error reading atom specification -- invalid coordinate: '" + buffer +
-          "' (bad coord: '" + value + "')");
+          "Error reading atom specification -- invalid coordinate: '" +
+          buffer.toString() + "' (bad coord: '" + value.toString() + "')");
         return false;
       }
     }
@@ -166,12 +169,13 @@ bool GromacsFormat::read(std::istream& in, Molecule& molecule)
   // v1(x) v2(y) v3(z) [v1(y) v1(z) v2(x) v2(z) v3(x) v3(y)]
   // The last six values may be omitted, set all non-specified values to 0.
   // v1(y) == v1(z) == v2(z) == 0 always.
-  getline(in, buffer);
-  vector<string> tokens(split(buffer, ' ', true));
-  if (tokens.size() > 0) {
+  if (!reader.getLine(buffer))
+    buffer = StringView();
+  vector<StringView> tokens;
+  if (tokenize(buffer, tokens) > 0) {
     if (tokens.size() != 3 && tokens.size() != 9) {
       appendError("Invalid box specification -- need either 3 or 9 values: '" +
-                  buffer + "'");
+                  buffer.toString() + "'");
       return false;
     }
 
@@ -181,10 +185,9 @@ bool GromacsFormat::read(std::istream& in, Molecule& molecule)
 
     Matrix3 cellMatrix = Matrix3::Zero();
     for (size_t i = 0; i < tokens.size(); ++i) {
-      cellMatrix(rows[i], cols[i]) = lexicalCast<Real>(tokens[i], ok);
-      if (!ok || tokens[i].empty()) {
-        appendError("Invalid box specification -- bad value: '" + tokens[i] +
-                    "'");
+      if (!parseNumber(tokens[i], cellMatrix(rows[i], cols[i]))) {
+        appendError("Invalid box specification -- bad value: '" +
+                    tokens[i].toString() + "'");
         return false;
       }
     }
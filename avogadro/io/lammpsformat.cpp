@@ -16,6 +16,10 @@
 
 #include "lammpsformat.h"
 
+#include "fileframesource.h"
+#include "framebatch_p.h"
+#include "linereader.h"
+
 #include <avogadro/core/crystaltools.h>
 #include <avogadro/core/elements.h>
 #include <avogadro/core/molecule.h>
@@ -25,12 +29,12 @@
 
 #include <iomanip>
 #include <istream>
+#include <memory>
 #include <ostream>
 #include <sstream>
 #include <string>
 
 using std::endl;
-using std::getline;
 using std::map;
 using std::string;
 using std::to_string;
@@ -44,159 +48,243 @@ using Core::Atom;
 using Core::Bond;
 using Core::CrystalTools;
 using Core::Elements;
-using Core::lexicalCast;
 using Core::Molecule;
-using Core::split;
-using Core::trimmed;
+using Core::nextLine;
+using Core::parseNumber;
+using Core::StringView;
+using Core::tokenize;
 using Core::UnitCell;
 
 #ifndef _WIN32
 using std::isalpha;
 #endif
 
-LammpsTrajectoryFormat::LammpsTrajectoryFormat() {}
+namespace {
 
-LammpsTrajectoryFormat::~LammpsTrajectoryFormat() {}
+// The contents of the header of a frame in a dump file, which describes how to
+// read the atom lines that follow it.
+struct DumpHeader
+{
+  DumpHeader()
+    : timestep(0), numAtoms(0), columns(0), typeIndex(0), min(Vector3::Zero()),
+      max(Vector3::Zero()), tilt(Vector3::Zero())
+  {
+    for (int i = 0; i < 3; ++i) {
+      index[i] = 0;
+      scaled[i] = false;
+    }
+  }
 
-bool LammpsTrajectoryFormat::read(std::istream& inStream, Core::Molecule& mol)
+  // If parsed coordinates are fractional, the corresponding unscaling is done.
+  // Else the positions are assigned as parsed.
+  Vector3 position(const vector<StringView>& tokens) const
+  {
+    Vector3 pos;
+    for (int i = 0; i < 3; ++i) {
+      double value = 0.0;
+      parseNumber(tokens[index[i]], value);
+      pos[i] = scaled[i] ? min[i] + (max[i] - min[i]) * value : value;
+    }
+    return pos;
+  }
+
+  UnitCell* unitCell() const
+  {
+    return new UnitCell(Vector3(max.x() - min.x(), 0, 0),
+                        Vector3(tilt.x(), max.y() - min.y(), 0),
+                        Vector3(tilt.y(), tilt.z(), max.z() - min.z()));
+  }
+
+  size_t timestep;
+  size_t numAtoms;
+  // The number of columns of each atom line, and which of them hold the type
+  // and the coordinates.
+  size_t columns;
+  size_t typeIndex;
+  size_t index[3];
+  bool scaled[3];
+  // The bounds of the box, and the xy, xz and yz tilt factors.
+  Vector3 min;
+  Vector3 max;
+  Vector3 tilt;
+};
+
+// Read the header of a frame, following its "ITEM: TIMESTEP" line.
+bool readDumpHeader(LineReader& reader, DumpHeader& header, string& error)
 {
-  size_t numAtoms = 0, timestep = 0, x_idx = -1, y_idx = -1, z_idx = -1,
-         type_idx = -1, id_idx = -1;
-  double x_min = 0, x_max = 0, y_min = 0, y_max = 0, z_min = 0, z_max = 0,
-         tilt_xy = 0, tilt_xz = 0, tilt_yz = 0, scale_x = 0., scale_y = 0.,
-         scale_z = 0.;
-
-  string buffer;
-  getline(inStream, buffer); // Finish the first line
-  buffer = trimmed(buffer);
-  if (buffer != "ITEM: TIMESTEP") {
-    appendError("No timestep item found.");
+  header = DumpHeader();
+  StringView line;
+  reader.getLine(line);
+  parseNumber(line, header.timestep);
+
+  reader.getLine(line);
+  if (line.trimmed() != "ITEM: NUMBER OF ATOMS") {
+    error = "No number of atoms item found.";
     return false;
   }
-  getline(inStream, buffer);
-  if (!buffer.empty()) {
-    timestep = lexicalCast<size_t>(buffer);
-    mol.setTimeStep(timestep, 0);
+  reader.getLine(line);
+  parseNumber(line, header.numAtoms);
+
+  // If unit cell is triclinic, tilt factors are needed to define the supercell
+  // Else if unit cell is orthogonal, tilt factors are zero
+  reader.getLine(line);
+  if (line.startsWith("ITEM: BOX BOUNDS")) {
+    bool triclinic = line.startsWith("ITEM: BOX BOUNDS xy xz yz");
+    vector<StringView> bounds;
+    for (int i = 0; i < 3; ++i) {
+      reader.getLine(line);
+      if (tokenize(line, bounds) < (triclinic ? 3u : 2u)) {
+        error = "Not enough box bounds in this line: " + line.toString();
+        return false;
+      }
+      parseNumber(bounds[0], header.min[i]);
+      parseNumber(bounds[1], header.max[i]);
+      if (triclinic)
+        parseNumber(bounds[2], header.tilt[i]);
+    }
+
+    if (triclinic) {
+      const Vector3& tilt = header.tilt;
+      header.min.x() -= std::min(
+        std::min(std::min(tilt.x(), tilt.y()), tilt.x() + tilt.y()), 0.0);
+      header.max.x() -= std::max(
+        std::max(std::max(tilt.x(), tilt.y()), tilt.x() + tilt.y()), 0.0);
+      header.min.y() -= std::min(tilt.z(), 0.0);
+      header.max.y() -= std::max(tilt.z(), 0.0);
+    }
+    reader.getLine(line);
   }
 
-  getline(inStream, buffer);
-  buffer = trimmed(buffer);
-  if (buffer != "ITEM: NUMBER OF ATOMS") {
-    appendError("No number of atoms item found.");
+  // x,y,z stand for the coordinate axes
+  // s stands for scaled coordinates
+  // u stands for unwrapped coordinates
+  // The labels start with "ITEM: ATOMS", which are not columns.
+  vector<StringView> labels;
+  if (tokenize(line, labels) < 2) {
+    error = "No atoms item found.";
     return false;
   }
-  getline(inStream, buffer);
-  if (!buffer.empty())
-    numAtoms = lexicalCast<size_t>(buffer);
+  header.columns = labels.size() - 2;
+  const char axes[3] = { 'x', 'y', 'z' };
+  for (size_t i = 2; i < labels.size(); ++i) {
+    const StringView& label = labels[i];
+    for (int a = 0; a < 3; ++a) {
+      if (label[0] != axes[a])
+        continue;
+      StringView suffix = label.substr(1);
+      if (suffix.empty() || suffix == "u") {
+        header.index[a] = i - 2;
+        header.scaled[a] = false;
+      } else if (suffix == "s" || suffix == "su") {
+        header.index[a] = i - 2;
+        header.scaled[a] = true;
+      }
+    }
+    if (label == "type")
+      header.typeIndex = i - 2;
+  }
+  return true;
+}
 
-  // If unit cell is triclinic, tilt factors are needed to define the supercell
-  getline(inStream, buffer);
-  if (buffer.find("ITEM: BOX BOUNDS xy xz yz") == 0) {
-    // Read x_min, x_max, tiltfactor_xy
-    getline(inStream, buffer);
-    vector<string> box_bounds_x(split(buffer, ' '));
-    x_min = lexicalCast<double>(box_bounds_x.at(0));
-    x_max = lexicalCast<double>(box_bounds_x.at(1));
-    tilt_xy = lexicalCast<double>(box_bounds_x.at(2));
-    // Read y_min, y_max, tiltfactor_xz
-    getline(inStream, buffer);
-    vector<string> box_bounds_y(split(buffer, ' '));
-    y_min = lexicalCast<double>(box_bounds_y.at(0));
-    y_max = lexicalCast<double>(box_bounds_y.at(1));
-    tilt_xz = lexicalCast<double>(box_bounds_y.at(2));
-    getline(inStream, buffer);
-    // Read z_min, z_max, tiltfactor_yz
-    vector<string> box_bounds_z(split(buffer, ' '));
-    z_min = lexicalCast<double>(box_bounds_z.at(0));
-    z_max = lexicalCast<double>(box_bounds_z.at(1));
-    tilt_yz = lexicalCast<double>(box_bounds_z.at(2));
-
-    x_min -= std::min(std::min(std::min(tilt_xy, tilt_xz), tilt_xy + tilt_xz),
-                      (double)0);
-    x_max -= std::max(std::max(std::max(tilt_xy, tilt_xz), tilt_xy + tilt_xz),
-                      (double)0);
-    y_min -= std::min(tilt_yz, (double)0);
-    y_max -= std::max(tilt_yz, (double)0);
+// Parse the positions from the block of atom lines of a frame, leaving the
+// offending line in line on failure.
+bool parseDumpPositions(StringView block, const DumpHeader& header,
+                        Array<Vector3>& positions, StringView& line)
+{
+  positions.resize(header.numAtoms);
+  vector<StringView> tokens;
+  for (size_t i = 0; i < header.numAtoms; ++i) {
+    nextLine(block, line);
+    if (tokenize(line, tokens) < header.columns)
+      return false;
+    positions[i] = header.position(tokens);
   }
+  return true;
+}
 
-  // Else if unit cell is orthogonal, tilt factors are zero
-  else if (buffer.find("ITEM: BOX BOUNDS") == 0) {
-    // Read x_min, x_max
-    getline(inStream, buffer);
-    vector<string> box_bounds_x(split(buffer, ' '));
-    x_min = lexicalCast<double>(box_bounds_x.at(0));
-    x_max = lexicalCast<double>(box_bounds_x.at(1));
-    // Read y_min, y_max
-    getline(inStream, buffer);
-    vector<string> box_bounds_y(split(buffer, ' '));
-    y_min = lexicalCast<double>(box_bounds_y.at(0));
-    y_max = lexicalCast<double>(box_bounds_y.at(1));
-    // Read z_min, z_max
-    getline(inStream, buffer);
-    vector<string> box_bounds_z(split(buffer, ' '));
-    z_min = lexicalCast<double>(box_bounds_z.at(0));
-    z_max = lexicalCast<double>(box_bounds_z.at(1));
+class DumpFrameSource : public FileFrameSource
+{
+public:
+  DumpFrameSource(const string& fileName, size_t numAtoms)
+    : FileFrameSource(fileName), m_numAtoms(numAtoms)
+  {
+  }
+
+  Core::FrameSource* clone() const override
+  {
+    return new DumpFrameSource(*this);
+  }
+
+protected:
+  bool parseFrame(std::istream& in, Array<Vector3>& coordinates) override
+  {
+    // The frame starts at its "ITEM: TIMESTEP" line.
+    LineReader reader(in);
+    StringView line;
+    reader.getLine(line);
+    DumpHeader header;
+    string error;
+    if (!readDumpHeader(reader, header, error))
+      return false;
+    header.numAtoms = m_numAtoms;
+    StringView block;
+    return reader.getLines(m_numAtoms, block) &&
+           parseDumpPositions(block, header, coordinates, line);
   }
 
+private:
+  size_t m_numAtoms;
+};
+
+} // namespace
+
+LammpsTrajectoryFormat::LammpsTrajectoryFormat() {}
+
+LammpsTrajectoryFormat::~LammpsTrajectoryFormat() {}
+
+bool LammpsTrajectoryFormat::read(std::istream& inStream, Core::Molecule& mol)
+{
+  LineReader reader(inStream);
+  std::streamoff start = reader.tell();
+  StringView line;
+  reader.getLine(line);
+  if (line.trimmed() != "ITEM: TIMESTEP") {
+    appendError("No timestep item found.");
+    return false;
+  }
+
+  DumpHeader header;
+  string error;
+  if (!readDumpHeader(reader, header, error)) {
+    appendError(error);
+    return false;
+  }
+  const size_t numAtoms = header.numAtoms;
+
+  // Frames of trajectories read from a file are indexed, and only read when
+  // they are needed.
+  std::unique_ptr<DumpFrameSource> frames;
+  if (isMode(Read) && !fileName().empty())
+    frames.reset(new DumpFrameSource(fileName(), numAtoms));
+  mol.setTimeStep(header.timestep, 0);
+
   typedef map<string, unsigned char> AtomTypeMap;
   AtomTypeMap atomTypes;
   unsigned char customElementCounter = CustomElementMin;
 
-  // x,y,z stand for the coordinate axes
-  // s stands for scaled coordinates
-  // u stands for unwrapped coordinates
-  // scale_x = 0. if coordinates are cartesian and 1 if fractional (scaled)
-  getline(inStream, buffer);
-  vector<string> labels(split(buffer, ' '));
-  for (size_t i = 0; i < labels.size(); i++) {
-    if (labels[i] == "x" || labels[i] == "xu") {
-      x_idx = i;
-      scale_x = 0.;
-    } else if (labels[i] == "xs" || labels[i] == "xsu") {
-      x_idx = i;
-      scale_x = 1.;
-    } else if (labels[i] == "y" || labels[i] == "yu") {
-      y_idx = i;
-      scale_y = 0.;
-    } else if (labels[i] == "ys" || labels[i] == "ysu") {
-      y_idx = i;
-      scale_y = 1.;
-    } else if (labels[i] == "z" || labels[i] == "zu") {
-      z_idx = i;
-      scale_z = 0.;
-    } else if (labels[i] == "zs" || labels[i] == "zsu") {
-      z_idx = i;
-      scale_z = 1.;
-    } else if (labels[i] == "type")
-      type_idx = i;
-    else if (labels[i] == "id")
-      id_idx = i;
-  }
-
   // Parse atoms
+  vector<StringView> tokens;
   for (size_t i = 0; i < numAtoms; ++i) {
-    getline(inStream, buffer);
-    vector<string> tokens(split(buffer, ' '));
-
-    if (tokens.size() < labels.size() - 2) {
-      appendError("Not enough tokens in this line: " + buffer);
+    if (!reader.getLine(line))
+      line = StringView();
+    if (tokenize(line, tokens) < header.columns) {
+      appendError("Not enough tokens in this line: " + line.toString());
       return false;
     }
 
-    unsigned char atomicNum(0);
-    atomicNum = lexicalCast<short int>(tokens[type_idx - 2]);
-
-    // If parsed coordinates are fractional, the corresponding unscaling is
-    // done. Else the positions are assigned as parsed.
-    Vector3 pos((1 - scale_x) * lexicalCast<double>(tokens[x_idx - 2]) +
-                  scale_x * (x_min + (x_max - x_min) *
-                                       lexicalCast<double>(tokens[x_idx - 2])),
-                (1 - scale_y) * lexicalCast<double>(tokens[y_idx - 2]) +
-                  scale_y * (y_min + (y_max - y_min) *
-                                       lexicalCast<double>(tokens[y_idx - 2])),
-                (1 - scale_z) * lexicalCast<double>(tokens[z_idx - 2]) +
-                  scale_z * (z_min + (z_max - z_min) *
-                                       lexicalCast<double>(tokens[z_idx - 2])));
+    short int type = 0;
+    parseNumber(tokens[header.typeIndex], type);
+    unsigned char atomicNum = static_cast<unsigned char>(type);
 
     AtomTypeMap::const_iterator it = atomTypes.find(to_string(atomicNum));
     if (it == atomTypes.end()) {
@@ -209,7 +297,7 @@ bool LammpsTrajectoryFormat::read(std::istream& inStream, Core::Molecule& mol)
       }
     }
     Atom newAtom = mol.addAtom(it->second);
-    newAtom.setPosition3d(pos);
+    newAtom.setPosition3d(header.position(tokens));
   }
 
   // Set the custom element map if needed:
@@ -228,168 +316,84 @@ bool LammpsTrajectoryFormat::read(std::istream& inStream, Core::Molecule& mol)
     std::ostringstream errorStream;
     errorStream << "Error parsing atom at index " << mol.atomCount()
                 << " (line " << 10 + mol.atomCount() << ").\n"
-                << buffer;
+                << line.toString();
     appendError(errorStream.str());
     return false;
   }
-  mol.setCoordinate3d(mol.atomPositions3d(), 0);
-  mol.setUnitCell(new UnitCell(Vector3(x_max - x_min, 0, 0),
-                               Vector3(tilt_xy, y_max - y_min, 0),
-                               Vector3(tilt_xz, tilt_yz, z_max - z_min)));
+  mol.setUnitCell(header.unitCell());
+  if (frames)
+    frames->addFrame(start);
+  else
+    mol.setCoordinate3d(mol.atomPositions3d(), 0);
 
-  // Do we have an animation?
-  size_t numAtoms2;
+  // Frames that are not read lazily are collected into batches, along with
+  // their headers, and each batch is parsed on several threads. The frames
+  // are then added in order, as far as the first one that failed.
   int coordSet = 1;
-  while (getline(inStream, buffer) && trimmed(buffer) == "ITEM: TIMESTEP") {
-    x_idx = -1;
-    y_idx = -1;
-    z_idx = -1;
-    type_idx = -1;
-    id_idx = -1;
-    x_min = 0;
-    x_max = 0;
-    y_min = 0;
-    y_max = 0;
-    z_min = 0;
-    z_max = 0;
-    tilt_xy = 0;
-    tilt_xz = 0;
-    tilt_yz = 0;
-    scale_x = 0.;
-    scale_y = 0.;
-    scale_z = 0.;
-
-    getline(inStream, buffer);
-    if (!buffer.empty()) {
-      timestep = lexicalCast<size_t>(buffer);
-      mol.setTimeStep(timestep, coordSet);
+  FrameBatch batch;
+  vector<DumpHeader> headers;
+  auto parseBatch = [&]() -> bool {
+    size_t failed = batch.parse(
+      [&headers](size_t i, StringView text, Array<Vector3>& coords) {
+        StringView badLine;
+        return parseDumpPositions(text, headers[i], coords, badLine);
+      });
+    for (size_t i = 0; i < failed; ++i) {
+      mol.setCoordinate3d(batch.frame(i), coordSet);
+      mol.setTimeStep(headers[i].timestep, coordSet++);
+      mol.setUnitCell(headers[i].unitCell());
     }
-
-    getline(inStream, buffer);
-    buffer = trimmed(buffer);
-    if (buffer != "ITEM: NUMBER OF ATOMS") {
-      appendError("No number of atoms item found.");
+    if (failed < batch.size()) {
+      Array<Vector3> positions;
+      parseDumpPositions(batch.text(failed), headers[failed], positions, line);
+      appendError("Not enough tokens in this line: " + line.toString());
       return false;
     }
-    getline(inStream, buffer);
-    if (!buffer.empty())
-      numAtoms2 = lexicalCast<size_t>(buffer);
-
-    if (numAtoms2 != numAtoms) {
-      appendError("Number of atoms isn't constant in the trajectory.");
-    }
+    batch.clear();
+    headers.clear();
+    return true;
+  };
 
-    // If unit cell is triclinic, tilt factors are needed to define the
-    // supercell
-    getline(inStream, buffer);
-    if (buffer.find("ITEM: BOX BOUNDS xy xz yz") == 0) {
-      // Read x_min, x_max, tiltfactor_xy
-      getline(inStream, buffer);
-      vector<string> box_bounds_x(split(buffer, ' '));
-      x_min = lexicalCast<double>(box_bounds_x.at(0));
-      x_max = lexicalCast<double>(box_bounds_x.at(1));
-      tilt_xy = lexicalCast<double>(box_bounds_x.at(2));
-      // Read y_min, y_max, tiltfactor_xz
-      getline(inStream, buffer);
-      vector<string> box_bounds_y(split(buffer, ' '));
-      y_min = lexicalCast<double>(box_bounds_y.at(0));
-      y_max = lexicalCast<double>(box_bounds_y.at(1));
-      tilt_xz = lexicalCast<double>(box_bounds_y.at(2));
-      getline(inStream, buffer);
-      // Read z_min, z_max, tiltfactor_yz
-      vector<string> box_bounds_z(split(buffer, ' '));
-      z_min = lexicalCast<double>(box_bounds_z.at(0));
-      z_max = lexicalCast<double>(box_bounds_z.at(1));
-      tilt_yz = lexicalCast<double>(box_bounds_z.at(2));
-
-      x_min -= std::min(std::min(std::min(tilt_xy, tilt_xz), tilt_xy + tilt_xz),
-                        (double)0);
-      x_max -= std::max(std::max(std::max(tilt_xy, tilt_xz), tilt_xy + tilt_xz),
-                        (double)0);
-      y_min -= std::min(tilt_yz, (double)0);
-      y_max -= std::max(tilt_yz, (double)0);
-    }
-
-    // Else if unit cell is orthogonal, tilt factors are zero
-    else if (buffer.find("ITEM: BOX BOUNDS") == 0) {
-      // Read x_min, x_max
-      getline(inStream, buffer);
-      vector<string> box_bounds_x(split(buffer, ' '));
-      x_min = lexicalCast<double>(box_bounds_x.at(0));
-      x_max = lexicalCast<double>(box_bounds_x.at(1));
-      // Read y_min, y_max
-      getline(inStream, buffer);
-      vector<string> box_bounds_y(split(buffer, ' '));
-      y_min = lexicalCast<double>(box_bounds_y.at(0));
-      y_max = lexicalCast<double>(box_bounds_y.at(1));
-      // Read z_min, z_max
-      getline(inStream, buffer);
-      vector<string> box_bounds_z(split(buffer, ' '));
-      z_min = lexicalCast<double>(box_bounds_z.at(0));
-      z_max = lexicalCast<double>(box_bounds_z.at(1));
+  // Do we have an animation?
+  std::streamoff offset = reader.tell();
+  while (reader.getLine(line) && line.trimmed() == "ITEM: TIMESTEP") {
+    if (!readDumpHeader(reader, header, error)) {
+      appendError(error);
+      return false;
     }
-
-    // x,y,z stand for the coordinate axes
-    // s stands for scaled coordinates
-    // u stands for unwrapped coordinates
-    // scale_x = 0. if coordinates are cartesian and 1 if fractional (scaled)
-    getline(inStream, buffer);
-    labels = vector<string>(split(buffer, ' '));
-    for (size_t i = 0; i < labels.size(); ++i) {
-      if (labels[i] == "x" || labels[i] == "xu") {
-        x_idx = i;
-        scale_x = 0.;
-      } else if (labels[i] == "xs" || labels[i] == "xsu") {
-        x_idx = i;
-        scale_x = 1.;
-      } else if (labels[i] == "y" || labels[i] == "yu") {
-        y_idx = i;
-        scale_y = 0.;
-      } else if (labels[i] == "ys" || labels[i] == "ysu") {
-        y_idx = i;
-        scale_y = 1.;
-      } else if (labels[i] == "z" || labels[i] == "zu") {
-        z_idx = i;
-        scale_z = 0.;
-      } else if (labels[i] == "zs" || labels[i] == "zsu") {
-        z_idx = i;
-        scale_z = 1.;
-      } else if (labels[i] == "type")
-        type_idx = i;
-      else if (labels[i] == "id")
-        id_idx = i;
+    if (header.numAtoms != numAtoms)
+      appendError("Number of atoms isn't constant in the trajectory.");
+    header.numAtoms = numAtoms;
+
+    if (!reader.getLines(numAtoms, line)) {
+      // The frames before it are kept, read now or on demand.
+      if (frames && frames->frameCount() > 1)
+        mol.setFrameSource(frames.release());
+      else if (frames)
+        mol.setCoordinate3d(mol.atomPositions3d(), 0);
+      else if (!parseBatch())
+        return false;
+      appendError("Not enough atoms in the last frame.");
+      return false;
     }
-
-    Array<Vector3> positions;
-    positions.reserve(numAtoms);
-
-    for (size_t i = 0; i < numAtoms; ++i) {
-      getline(inStream, buffer);
-      vector<string> tokens(split(buffer, ' '));
-      if (tokens.size() < 5) {
-        appendError("Not enough tokens in this line: " + buffer);
+    if (frames) {
+      frames->addFrame(offset);
+      mol.setTimeStep(header.timestep, coordSet++);
+      mol.setUnitCell(header.unitCell());
+    } else {
+      headers.push_back(header);
+      batch.add(line);
+      if (batch.isFull() && !parseBatch())
         return false;
-      }
-      // If parsed coordinates are fractional, the corresponding unscaling is
-      // done. Else the positions are assigned as parsed.
-      Vector3 pos(
-        (1 - scale_x) * lexicalCast<double>(tokens[x_idx - 2]) +
-          scale_x *
-            (x_min + (x_max - x_min) * lexicalCast<double>(tokens[x_idx - 2])),
-        (1 - scale_y) * lexicalCast<double>(tokens[y_idx - 2]) +
-          scale_y *
-            (y_min + (y_max - y_min) * lexicalCast<double>(tokens[y_idx - 2])),
-        (1 - scale_z) * lexicalCast<double>(tokens[z_idx - 2]) +
-          scale_z *
-            (z_min + (z_max - z_min) * lexicalCast<double>(tokens[z_idx - 2])));
-      positions.push_back(pos);
     }
-
-    mol.setCoordinate3d(positions, coordSet++);
-    mol.setUnitCell(new UnitCell(Vector3(x_max - x_min, 0, 0),
-                                 Vector3(tilt_xy, y_max - y_min, 0),
-                                 Vector3(tilt_xz, tilt_yz, z_max - z_min)));
+    offset = reader.tell();
   }
+  if (batch.size() > 0 && !parseBatch())
+    return false;
+  if (frames && frames->frameCount() > 1)
+    mol.setFrameSource(frames.release());
+  else if (frames)
+    mol.setCoordinate3d(mol.atomPositions3d(), 0);
 
   return true;
 }
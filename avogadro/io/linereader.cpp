@@ -0,0 +1,169 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include "linereader.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Avogadro {
+namespace Io {
+
+using Core::StringView;
+
+namespace {
+
+// The size of the buffer before anything is read.
+const size_t initialBufferSize = 4096;
+
+StringView withoutCarriageReturn(const char* data, size_t size)
+{
+  if (size > 0 && data[size - 1] == '\r')
+    --size;
+  return StringView(data, size);
+}
+
+} // namespace
+
+LineReader::LineReader(std::istream& stream, size_t bufferSize)
+  : m_stream(stream), m_bufferSize(std::max(bufferSize, size_t(1))),
+    m_begin(0), m_end(0), m_offset(stream.tellg()), m_seekable(m_offset >= 0),
+    m_streamEnd(!stream), m_failed(false)
+{
+  if (m_seekable)
+    m_buffer.resize(std::min(m_bufferSize, initialBufferSize));
+}
+
+LineReader::~LineReader()
+{
+  if (!m_seekable)
+    return;
+  m_stream.clear();
+  m_stream.seekg(tell());
+  if (m_failed)
+    m_stream.setstate(std::ios_base::eofbit | std::ios_base::failbit);
+}
+
+bool LineReader::getLine(StringView& line)
+{
+  if (!m_seekable) {
+    if (!std::getline(m_stream, m_line))
+      return false;
+    line = withoutCarriageReturn(m_line.data(), m_line.size());
+    return true;
+  }
+
+  for (;;) {
+    const char* begin = m_buffer.data() + m_begin;
+    const char* newline =
+      static_cast<const char*>(std::memchr(begin, '\n', m_end - m_begin));
+    if (newline) {
+      m_begin += newline - begin + 1;
+      line = withoutCarriageReturn(begin, newline - begin);
+      return true;
+    }
+    if (m_streamEnd) {
+      // The last line may not end with a newline.
+      if (m_begin == m_end) {
+        m_failed = true;
+        return false;
+      }
+      line = withoutCarriageReturn(begin, m_end - m_begin);
+      m_begin = m_end;
+      return true;
+    }
+    fill();
+  }
+}
+
+bool LineReader::getLines(size_t count, StringView& lines)
+{
+  if (count == 0) {
+    lines = StringView();
+    return true;
+  }
+  if (!m_seekable) {
+    std::string line;
+    std::string block;
+    for (size_t i = 0; i < count; ++i) {
+      if (!std::getline(m_stream, line)) {
+        m_line = block;
+        lines = StringView(m_line);
+        return false;
+      }
+      if (i > 0)
+        block += '\n';
+      block += line;
+    }
+    m_line.swap(block);
+    lines = withoutCarriageReturn(m_line.data(), m_line.size());
+    return true;
+  }
+
+  // Find the end of the last line, reading more of the stream as needed.
+  size_t found = 0;
+  size_t end = m_begin;
+  for (;;) {
+    while (found < count) {
+      const void* newline =
+        std::memchr(m_buffer.data() + end, '\n', m_end - end);
+      if (!newline)
+        break;
+      end = static_cast<const char*>(newline) - m_buffer.data() + 1;
+      ++found;
+    }
+    if (found == count) {
+      lines = withoutCarriageReturn(m_buffer.data() + m_begin,
+                                    end - 1 - m_begin);
+      m_begin = end;
+      return true;
+    }
+    if (m_streamEnd) {
+      // The last line may not end with a newline.
+      bool complete = found + 1 == count && end < m_end;
+      lines = withoutCarriageReturn(m_buffer.data() + m_begin,
+                                    m_end - m_begin);
+      m_begin = m_end;
+      m_failed = !complete;
+      return complete;
+    }
+    size_t searched = end - m_begin;
+    fill();
+    end = m_begin + searched;
+  }
+}
+
+std::streamoff LineReader::tell() const
+{
+  if (!m_seekable)
+    return m_stream.tellg();
+  return m_offset + static_cast<std::streamoff>(m_begin);
+}
+
+void LineReader::fill()
+{
+  size_t remaining = m_end - m_begin;
+  if (m_begin > 0) {
+    std::memmove(m_buffer.data(), m_buffer.data() + m_begin, remaining);
+    m_offset += static_cast<std::streamoff>(m_begin);
+    m_begin = 0;
+    m_end = remaining;
+  }
+  // Read more at a time as more of the stream is read, and a line longer
+  // than the whole buffer needs a bigger one in any case.
+  if (m_buffer.size() < m_bufferSize)
+    m_buffer.resize(std::min(m_buffer.size() * 2, m_bufferSize));
+  else if (m_end == m_buffer.size())
+    m_buffer.resize(m_buffer.size() * 2);
+
+  m_stream.read(m_buffer.data() + m_end,
+                static_cast<std::streamsize>(m_buffer.size() - m_end));
+  m_end += static_cast<size_t>(m_stream.gcount());
+  if (!m_stream)
+    m_streamEnd = true;
+}
+
+} // namespace Io
+} // namespace Avogadro
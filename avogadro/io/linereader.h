@@ -0,0 +1,88 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#ifndef AVOGADRO_IO_LINEREADER_H
+#define AVOGADRO_IO_LINEREADER_H
+
+#include "avogadroioexport.h"
+
+#include <avogadro/core/utilities.h>
+
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace Avogadro {
+namespace Io {
+
+/**
+ * @class LineReader linereader.h <avogadro/io/linereader.h>
+ * @brief The LineReader class reads the lines of a text stream through a
+ * large buffer.
+ *
+ * Each line is returned as a view of the buffer rather than copied into a
+ * string, which makes reading large text files much cheaper than with
+ * std::getline. When the reader is destroyed the stream is left just past the
+ * last line that was read, as if it had been read with std::getline, so that
+ * formats holding several molecules can be read one molecule at a time.
+ * Streams that cannot seek are read one line at a time instead.
+ *
+ * The buffer starts small and doubles with each read of the stream, up to
+ * @a bufferSize, so readers made for a short record only read a little more
+ * than the record, while long files are still read in large blocks.
+ */
+class AVOGADROIO_EXPORT LineReader
+{
+public:
+  explicit LineReader(std::istream& stream, size_t bufferSize = 1 << 20);
+  ~LineReader();
+
+  /**
+   * Read the next line into @a line, without its line ending. The line stays
+   * valid until the next call.
+   * @return False at the end of the stream.
+   */
+  bool getLine(Core::StringView& line);
+
+  /**
+   * Read the next @a count lines into @a lines as a single view, with the
+   * line endings between them but not the last one. The lines stay valid
+   * until the next call.
+   * @return False if the stream ends first, leaving what was left of it in
+   * @a lines.
+   */
+  bool getLines(size_t count, Core::StringView& lines);
+
+  /**
+   * @return The offset of the next line in the stream, as tellg() would give.
+   */
+  std::streamoff tell() const;
+
+private:
+  LineReader(const LineReader&);            // Not implemented.
+  LineReader& operator=(const LineReader&); // Not implemented.
+
+  // Move the unread part of the buffer to its start and read more after it.
+  void fill();
+
+  std::istream& m_stream;
+  std::vector<char> m_buffer;
+  // The size the buffer grows to, unless a longer line needs more.
+  size_t m_bufferSize;
+  // The unread part of the buffer, and the stream offset of its start.
+  size_t m_begin;
+  size_t m_end;
+  std::streamoff m_offset;
+  bool m_seekable;
+  bool m_streamEnd;
+  bool m_failed;
+  // The current line when the stream cannot seek.
+  std::string m_line;
+};
+
+} // namespace Io
+} // namespace Avogadro
+
+#endif // AVOGADRO_IO_LINEREADER_H
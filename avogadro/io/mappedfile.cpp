@@ -0,0 +1,81 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include "mappedfile.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define AVO_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Avogadro {
+namespace Io {
+
+MappedFile::MappedFile() : m_data(nullptr), m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+bool MappedFile::open(const std::string& fileName)
+{
+  close();
+#ifdef AVO_HAVE_MMAP
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  // Only regular files have a size that can be mapped.
+  struct stat info;
+  if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(info.st_size);
+  void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file open.
+  ::close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  m_fileName = fileName;
+  m_data = static_cast<const char*>(data);
+  m_size = size;
+  return true;
+#else
+  (void)fileName;
+  return false;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef AVO_HAVE_MMAP
+  if (m_data)
+    ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+  m_fileName.clear();
+  m_data = nullptr;
+  m_size = 0;
+}
+
+bool MappedFile::isSupported()
+{
+#ifdef AVO_HAVE_MMAP
+  return true;
+#else
+  return false;
+#endif
+}
+
+} // namespace Io
+} // namespace Avogadro
@@ -0,0 +1,70 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#ifndef AVOGADRO_IO_MAPPEDFILE_H
+#define AVOGADRO_IO_MAPPEDFILE_H
+
+#include "avogadroioexport.h"
+
+#include <cstddef>
+#include <string>
+
+namespace Avogadro {
+namespace Io {
+
+/**
+ * @class MappedFile mappedfile.h <avogadro/io/mappedfile.h>
+ * @brief The MappedFile class maps the whole of a file into memory, read only.
+ *
+ * The bytes of the file can then be parsed in place, and by several threads
+ * at once, without reading them through a stream. Mapping is only available
+ * where the system provides mmap(), and open() fails elsewhere so that
+ * callers fall back to reading the file as a stream.
+ */
+class AVOGADROIO_EXPORT MappedFile
+{
+public:
+  MappedFile();
+  ~MappedFile();
+
+  /**
+   * Map the file @a fileName, unmapping any file already mapped.
+   * @return False if the file cannot be mapped, including when it is empty.
+   */
+  bool open(const std::string& fileName);
+
+  /**
+   * Unmap the file.
+   */
+  void close();
+
+  bool isOpen() const { return m_data != nullptr; }
+
+  /**
+   * @return The bytes of the file, which stay valid until it is closed.
+   */
+  const char* data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+  const std::string& fileName() const { return m_fileName; }
+
+  /**
+   * @return True if files can be mapped on this system.
+   */
+  static bool isSupported();
+
+private:
+  MappedFile(const MappedFile&);            // Not implemented.
+  MappedFile& operator=(const MappedFile&); // Not implemented.
+
+  std::string m_fileName;
+  const char* m_data;
+  size_t m_size;
+};
+
+} // namespace Io
+} // namespace Avogadro
+
+#endif // AVOGADRO_IO_MAPPEDFILE_H
@@ -0,0 +1,70 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#ifndef AVOGADRO_IO_MEMORYSTREAM_P_H
+#define AVOGADRO_IO_MEMORYSTREAM_P_H
+
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+
+namespace Avogadro {
+namespace Io {
+
+/**
+ * A stream buffer over a range of bytes in memory, which it reads in place.
+ * Seeking is supported, so tellg() and seekg() work as they do for files.
+ */
+class MemoryStreamBuffer : public std::streambuf
+{
+public:
+  MemoryStreamBuffer(const char* data, size_t size)
+  {
+    char* begin = const_cast<char*>(data);
+    setg(begin, begin, begin + size);
+  }
+
+protected:
+  pos_type seekoff(off_type offset, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override
+  {
+    if (!(which & std::ios_base::in))
+      return pos_type(off_type(-1));
+    if (dir == std::ios_base::cur)
+      offset += gptr() - eback();
+    else if (dir == std::ios_base::end)
+      offset += egptr() - eback();
+    if (offset < 0 || offset > egptr() - eback())
+      return pos_type(off_type(-1));
+    setg(eback(), eback() + offset, egptr());
+    return pos_type(offset);
+  }
+
+  pos_type seekpos(pos_type position, std::ios_base::openmode which) override
+  {
+    return seekoff(off_type(position), std::ios_base::beg, which);
+  }
+};
+
+/**
+ * An input stream reading a range of bytes in memory without copying it.
+ */
+class MemoryInputStream : public std::istream
+{
+public:
+  MemoryInputStream(const char* data, size_t size)
+    : std::istream(nullptr), m_buffer(data, size)
+  {
+    rdbuf(&m_buffer);
+  }
+
+private:
+  MemoryStreamBuffer m_buffer;
+};
+
+} // namespace Io
+} // namespace Avogadro
+
+#endif // AVOGADRO_IO_MEMORYSTREAM_P_H
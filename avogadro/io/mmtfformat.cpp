@@ -15,6 +15,9 @@
 ******************************************************************************/
 
 #include "mmtfformat.h"
+
+#include "frameselection_p.h"
+
 #include <avogadro/core/crystaltools.h>
 #include <avogadro/core/cube.h>
 #include <avogadro/core/elements.h>
@@ -26,8 +29,13 @@
 
 #include <mmtf.hpp>
 
+#include <algorithm>
+#include <cctype>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
 
 namespace Avogadro {
 namespace Io {
@@ -55,12 +63,27 @@ MMTFFormat::~MMTFFormat() = default;
 
 bool MMTFFormat::read(std::istream& file, Molecule& molecule)
 {
-  mmtf::StructureData structure;
-  mmtf::decodeFromStream(structure, file);
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  const string buffer = contents.str();
+  return readMapped(buffer.data(), buffer.size(), molecule);
+}
 
-  // This controls which model we load, currently just the first?
-  size_t modelIndex = 0;
-  size_t atomSkip = 0;
+bool MMTFFormat::readMapped(const char* data, size_t size, Molecule& molecule)
+{
+  mmtf::StructureData structure;
+  try {
+    mmtf::decodeFromBuffer(structure, data, size);
+  } catch (const std::exception& e) {
+    appendError(string("Error decoding MMTF: ") + e.what());
+    return false;
+  }
+  if (!structure.hasConsistentData()) {
+    appendError("Error: inconsistent MMTF data.");
+    return false;
+  }
+  if (structure.chainsPerModel.empty())
+    return true;
 
   size_t chainIndex = 0;
   size_t groupIndex = 0;
@@ -81,8 +104,8 @@ bool MMTFFormat::read(std::istream& file, Molecule& molecule)
     molecule.setUnitCell(unitCellObject);
   }
 
-  Index modelChainCount =
-    static_cast<Index>(structure.chainsPerModel[modelIndex]);
+  // The atoms, residues and bonds come from the first model.
+  Index modelChainCount = static_cast<Index>(structure.chainsPerModel[0]);
 
   for (Index j = 0; j < modelChainCount; j++) {
 
@@ -106,7 +129,7 @@ bool MMTFFormat::read(std::istream& file, Molecule& molecule)
       auto& residue = molecule.addResidue(resname, groupId, chainid);
 
       // Save the offset before we go changing it
-      Index atomOffset = atomIndex - atomSkip;
+      Index atomOffset = atomIndex;
       Index groupSize = group.atomNameList.size();
 
       for (Index l = 0; l < groupSize; l++) {
@@ -150,38 +173,296 @@ bool MMTFFormat::read(std::istream& file, Molecule& molecule)
 
     chainIndex++;
   }
+  const size_t modelAtomCount = atomIndex;
+  const size_t modelGroupCount = groupIndex;
 
-  // Use this eventually for multi-model formats
-  modelIndex++;
-
-  // These are for inter-residue bonds
+  // These are for inter-residue bonds, numbered across all of the models.
+  bool hasOrders =
+    structure.bondOrderList.size() == structure.bondAtomList.size() / 2;
   for (size_t i = 0; i < structure.bondAtomList.size() / 2; i++) {
 
     auto atom1 = static_cast<size_t>(structure.bondAtomList[i * 2]);
     auto atom2 = static_cast<size_t>(structure.bondAtomList[i * 2 + 1]);
 
-    /* Code for multiple models
-    // We are below the atoms we care about
-    if (atom1 < atomSkip || atom2 < atomSkip) {
+    // Bonds of the other models repeat those of the first.
+    if (atom1 >= modelAtomCount || atom2 >= modelAtomCount)
       continue;
-    }
 
-    // We are above the atoms we care about
-    if (atom1 > atomIndex || atom2 > atomIndex) {
-      continue;
-    } */
+    unsigned char order = 1;
+    if (hasOrders && structure.bondOrderList[i] > 1)
+      order = static_cast<unsigned char>(structure.bondOrderList[i]);
+    molecule.addBond(atom1, atom2, order);
+  }
 
-    size_t atom_idx1 = atom1 - atomSkip; // atomSkip = 0 for us (1 model)
-    size_t atom_idx2 = atom2 - atomSkip;
-    molecule.addBond(atom_idx1, atom_idx2, 1); // Always a single bond
+  // The other models, e.g. of NMR ensembles, become coordinate sets. A model
+  // with the same group types as the first has the same atoms in the same
+  // order, so its coordinates are just the next slice of the lists.
+  if (structure.chainsPerModel.size() > 1)
+    molecule.setCoordinate3d(molecule.atomPositions3d(), 0);
+  int coordSet = 1;
+  for (size_t model = 1; model < structure.chainsPerModel.size(); ++model) {
+    size_t chainEnd =
+      chainIndex + static_cast<size_t>(structure.chainsPerModel[model]);
+    size_t groupEnd = groupIndex;
+    for (; chainIndex < chainEnd; ++chainIndex)
+      groupEnd += static_cast<size_t>(structure.groupsPerChain[chainIndex]);
+
+    bool sameGroups =
+      groupEnd - groupIndex == modelGroupCount &&
+      std::equal(structure.groupTypeList.begin() + groupIndex,
+                 structure.groupTypeList.begin() + groupEnd,
+                 structure.groupTypeList.begin());
+    if (sameGroups) {
+      Array<Vector3> coords(modelAtomCount);
+      for (size_t i = 0; i < modelAtomCount; ++i, ++atomIndex) {
+        coords[i] =
+          Vector3(static_cast<Real>(structure.xCoordList[atomIndex]),
+                  static_cast<Real>(structure.yCoordList[atomIndex]),
+                  static_cast<Real>(structure.zCoordList[atomIndex]));
+      }
+      molecule.setCoordinate3d(coords, coordSet++);
+    } else {
+      appendError("Model " + std::to_string(model + 1) +
+                  " has different groups than the first and was skipped.");
+      for (size_t g = groupIndex; g < groupEnd; ++g) {
+        const auto& group = structure.groupList[structure.groupTypeList[g]];
+        atomIndex += group.atomNameList.size();
+      }
+    }
+    groupIndex = groupEnd;
   }
 
   return true;
 }
 
+namespace {
+
+// A group, i.e. residue, of the structure being written.
+struct WriterGroup
+{
+  string name;
+  int32_t id;
+  string chain;
+  vector<Index> atoms;
+  vector<string> atomNames;
+  vector<int32_t> bondAtoms;
+  vector<int8_t> bondOrders;
+};
+
+string chainName(char chain)
+{
+  return std::isalnum(static_cast<unsigned char>(chain)) ? string(1, chain)
+                                                         : string("A");
+}
+
+// Identifies a group type, so that identical groups share one.
+string groupTypeKey(const mmtf::GroupType& type)
+{
+  std::ostringstream key;
+  key << type.groupName << '\n';
+  for (size_t i = 0; i < type.atomNameList.size(); ++i) {
+    key << type.atomNameList[i] << ' ' << type.elementList[i] << ' '
+        << type.formalChargeList[i] << '\n';
+  }
+  for (size_t i = 0; i < type.bondOrderList.size(); ++i) {
+    key << type.bondAtomList[2 * i] << ' ' << type.bondAtomList[2 * i + 1]
+        << ' ' << static_cast<int>(type.bondOrderList[i]) << '\n';
+  }
+  return key.str();
+}
+
+} // namespace
+
 bool MMTFFormat::write(std::ostream& out, const Core::Molecule& molecule)
 {
-  return false;
+  const Index atomCount = molecule.atomCount();
+  if (molecule.atomPositions3d().size() != atomCount) {
+    appendError("MMTF files need 3D coordinates for all of the atoms.");
+    return false;
+  }
+
+  // Each residue is a group, and any atoms outside of them make up one more.
+  const Index none = std::numeric_limits<Index>::max();
+  vector<WriterGroup> groups;
+  vector<Index> groupOf(atomCount, none);
+  for (Index r = 0; r < molecule.residueCount(); ++r) {
+    const Core::Residue& residue = molecule.residue(static_cast<int>(r));
+    WriterGroup group;
+    group.name = residue.residueName();
+    group.id = static_cast<int32_t>(residue.residueId());
+    group.chain = chainName(residue.chainId());
+    // Keep the atoms in the order of the molecule rather than of their names.
+    vector<std::pair<Index, string>> atoms;
+    for (const auto& named : residue.atomNameMap()) {
+      Index index = named.second.index();
+      if (index < atomCount && groupOf[index] == none) {
+        groupOf[index] = groups.size();
+        atoms.push_back(std::make_pair(index, named.first));
+      }
+    }
+    if (atoms.empty())
+      continue;
+    std::sort(atoms.begin(), atoms.end());
+    for (size_t i = 0; i < atoms.size(); ++i) {
+      group.atoms.push_back(atoms[i].first);
+      group.atomNames.push_back(atoms[i].second);
+    }
+    groups.push_back(group);
+  }
+  WriterGroup rest;
+  rest.name = "UNL";
+  rest.id = groups.empty() ? 1 : groups.back().id + 1;
+  rest.chain = groups.empty() ? string("A") : groups.back().chain;
+  for (Index i = 0; i < atomCount; ++i) {
+    if (groupOf[i] == none) {
+      groupOf[i] = groups.size();
+      rest.atoms.push_back(i);
+      rest.atomNames.push_back(Elements::symbol(molecule.atomicNumber(i)));
+    }
+  }
+  if (!rest.atoms.empty())
+    groups.push_back(rest);
+
+  // The atoms are written group by group.
+  vector<Index> order;
+  vector<int32_t> position(atomCount);
+  vector<int32_t> groupStart;
+  for (size_t g = 0; g < groups.size(); ++g) {
+    groupStart.push_back(static_cast<int32_t>(order.size()));
+    for (size_t i = 0; i < groups[g].atoms.size(); ++i) {
+      position[groups[g].atoms[i]] = static_cast<int32_t>(order.size());
+      order.push_back(groups[g].atoms[i]);
+    }
+  }
+
+  // Bonds within a group belong to its type, the others to the structure.
+  vector<int32_t> bondAtoms;
+  vector<int8_t> bondOrders;
+  for (Index i = 0; i < molecule.bondCount(); ++i) {
+    const Core::Bond bond = molecule.bond(i);
+    Index atom1 = bond.atom1().index();
+    Index atom2 = bond.atom2().index();
+    int8_t bondOrder = static_cast<int8_t>(bond.order());
+    size_t g = groupOf[atom1];
+    if (g == groupOf[atom2]) {
+      groups[g].bondAtoms.push_back(position[atom1] - groupStart[g]);
+      groups[g].bondAtoms.push_back(position[atom2] - groupStart[g]);
+      groups[g].bondOrders.push_back(bondOrder);
+    } else {
+      bondAtoms.push_back(position[atom1]);
+      bondAtoms.push_back(position[atom2]);
+      bondOrders.push_back(bondOrder);
+    }
+  }
+
+  // Identical groups share a type, as amino acids of a protein do.
+  mmtf::StructureData structure;
+  std::map<string, int32_t> groupTypes;
+  vector<int32_t> groupTypeList;
+  Index intraBondCount = 0;
+  for (size_t g = 0; g < groups.size(); ++g) {
+    mmtf::GroupType type;
+    type.groupName = groups[g].name;
+    type.atomNameList = groups[g].atomNames;
+    for (size_t i = 0; i < groups[g].atoms.size(); ++i) {
+      Index atom = groups[g].atoms[i];
+      type.elementList.push_back(
+        Elements::symbol(molecule.atomicNumber(atom)));
+      type.formalChargeList.push_back(molecule.formalCharge(atom));
+    }
+    type.bondAtomList = groups[g].bondAtoms;
+    type.bondOrderList = groups[g].bondOrders;
+    type.singleLetterCode = '?';
+    intraBondCount += type.bondOrderList.size();
+
+    auto inserted = groupTypes.insert(std::make_pair(
+      groupTypeKey(type), static_cast<int32_t>(structure.groupList.size())));
+    if (inserted.second)
+      structure.groupList.push_back(type);
+    groupTypeList.push_back(inserted.first->second);
+  }
+
+  // The chains are the runs of groups with the same chain name.
+  vector<string> chainIds;
+  vector<int32_t> groupsPerChain;
+  for (size_t g = 0; g < groups.size(); ++g) {
+    if (chainIds.empty() || chainIds.back() != groups[g].chain) {
+      chainIds.push_back(groups[g].chain);
+      groupsPerChain.push_back(0);
+    }
+    ++groupsPerChain.back();
+  }
+
+  // Each coordinate set is a model, all of them with the same groups.
+  vector<int> frames;
+  string error;
+  if (!selectedFrames(molecule, options(), frames, error)) {
+    appendError(error);
+    return false;
+  }
+  int32_t modelCount = 0;
+  for (size_t f = 0; f < frames.size(); ++f) {
+    Array<Vector3> coords = frames[f] < 0 ? molecule.atomPositions3d()
+                                          : molecule.coordinate3d(frames[f]);
+    if (coords.size() != atomCount)
+      continue;
+    int32_t atomOffset = modelCount * static_cast<int32_t>(atomCount);
+    for (size_t i = 0; i < order.size(); ++i) {
+      const Vector3& pos = coords[order[i]];
+      structure.xCoordList.push_back(static_cast<float>(pos.x()));
+      structure.yCoordList.push_back(static_cast<float>(pos.y()));
+      structure.zCoordList.push_back(static_cast<float>(pos.z()));
+    }
+    structure.chainIdList.insert(structure.chainIdList.end(),
+                                 chainIds.begin(), chainIds.end());
+    structure.chainNameList.insert(structure.chainNameList.end(),
+                                   chainIds.begin(), chainIds.end());
+    structure.groupsPerChain.insert(structure.groupsPerChain.end(),
+                                    groupsPerChain.begin(),
+                                    groupsPerChain.end());
+    structure.chainsPerModel.push_back(
+      static_cast<int32_t>(chainIds.size()));
+    structure.groupTypeList.insert(structure.groupTypeList.end(),
+                                   groupTypeList.begin(), groupTypeList.end());
+    for (size_t g = 0; g < groups.size(); ++g)
+      structure.groupIdList.push_back(groups[g].id);
+    for (size_t i = 0; i < bondAtoms.size(); ++i)
+      structure.bondAtomList.push_back(atomOffset + bondAtoms[i]);
+    structure.bondOrderList.insert(structure.bondOrderList.end(),
+                                   bondOrders.begin(), bondOrders.end());
+    ++modelCount;
+  }
+
+  structure.mmtfProducer = "Avogadro";
+  if (molecule.data("name").type() == Variant::String)
+    structure.title = molecule.data("name").toString();
+  if (const Core::UnitCell* cell = molecule.unitCell()) {
+    structure.unitCell.push_back(static_cast<float>(cell->a()));
+    structure.unitCell.push_back(static_cast<float>(cell->b()));
+    structure.unitCell.push_back(static_cast<float>(cell->c()));
+    structure.unitCell.push_back(
+      static_cast<float>(cell->alpha() * RAD_TO_DEG));
+    structure.unitCell.push_back(
+      static_cast<float>(cell->beta() * RAD_TO_DEG));
+    structure.unitCell.push_back(
+      static_cast<float>(cell->gamma() * RAD_TO_DEG));
+  }
+  structure.numModels = modelCount;
+  structure.numChains = modelCount * static_cast<int32_t>(chainIds.size());
+  structure.numGroups = modelCount * static_cast<int32_t>(groups.size());
+  structure.numAtoms = modelCount * static_cast<int32_t>(atomCount);
+  structure.numBonds = modelCount * static_cast<int32_t>(intraBondCount +
+                                                         bondOrders.size());
+
+  // The encoder stores the coordinates as integers, delta and run-length
+  // encoded, to three decimal places.
+  try {
+    mmtf::encodeToStream(structure, out);
+  } catch (const std::exception& e) {
+    appendError(string("Error encoding MMTF: ") + e.what());
+    return false;
+  }
+  return true;
 }
 
 vector<std::string> MMTFFormat::fileExtensions() const
@@ -28,6 +28,10 @@ namespace Io {
 /**
  * @class MMTFFormat mmtf.h <avogadro/io/mmtf.h>
  * @brief Implementation of the MMTF format.
+ *
+ * All of the models in a file are read, the first as the atoms and the others
+ * as coordinate sets. Coordinate sets are written as models, selected by the
+ * "firstFrame", "lastFrame" and "frameStride" options.
  */
 
 class AVOGADROIO_EXPORT MMTFFormat : public FileFormat
@@ -38,7 +42,7 @@ public:
 
   Operations supportedOperations() const override
   {
-    return Read | File | Stream | String;
+    return ReadWrite | File | Stream | String | Mapped;
   }
 
   FileFormat* newInstance() const override { return new MMTFFormat; }
@@ -62,6 +66,8 @@ public:
   std::vector<std::string> mimeTypes() const override;
 
   bool read(std::istream& in, Core::Molecule& molecule) override;
+  bool readMapped(const char* data, size_t size,
+                  Core::Molecule& molecule) override;
   bool write(std::ostream& out, const Core::Molecule& molecule) override;
 };
 
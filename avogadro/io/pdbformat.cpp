@@ -1,5 +1,7 @@
 #include "pdbformat.h"
 
+#include "linereader.h"
+
 #include <avogadro/core/elements.h>
 #include <avogadro/core/molecule.h>
 #include <avogadro/core/residue.h>
@@ -13,37 +15,47 @@ using Avogadro::Core::Array;
 using Avogadro::Core::Atom;
 using Avogadro::Core::Bond;
 using Avogadro::Core::Elements;
-using Avogadro::Core::lexicalCast;
 using Avogadro::Core::Molecule;
+using Avogadro::Core::nextToken;
+using Avogadro::Core::parseNumber;
 using Avogadro::Core::Residue;
-using Avogadro::Core::startsWith;
-using Avogadro::Core::trimmed;
+using Avogadro::Core::StringView;
 
-using std::getline;
-using std::istringstream;
 using std::string;
 using std::vector;
 
 namespace Avogadro {
 namespace Io {
 
+namespace {
+
+// The first word of a fixed column field, as read from a stream.
+StringView word(StringView field)
+{
+  StringView token;
+  nextToken(field, token);
+  return token;
+}
+
+} // namespace
+
 PdbFormat::PdbFormat() {}
 
 PdbFormat::~PdbFormat() {}
 
 bool PdbFormat::read(std::istream& in, Core::Molecule& mol)
 {
-  string buffer;
+  LineReader reader(in);
+  StringView buffer;
   std::vector<int> terList;
-  Residue* r;
+  Residue* r = nullptr;
   size_t currentResidueId = 0;
-  bool ok(false);
   int coordSet = 0;
   Array<Vector3> positions;
 
-  while (getline(in, buffer)) { // Read Each line one by one
+  while (reader.getLine(buffer)) { // Read Each line one by one
 
-    if (startsWith(buffer, "ENDMDL")) {
+    if (buffer.startsWith("ENDMDL")) {
       if (coordSet == 0) {
         mol.setCoordinate3d(mol.atomPositions3d(), coordSet++);
         positions.reserve(mol.atomCount());
@@ -53,62 +65,57 @@ bool PdbFormat::read(std::istream& in, Core::Molecule& mol)
       }
     }
 
-    else if (startsWith(buffer, "ATOM") || startsWith(buffer, "HETATM")) {
+    else if (buffer.startsWith("ATOM") || buffer.startsWith("HETATM")) {
       // First we initialize the residue instance
-      size_t residueId = lexicalCast<size_t>(buffer.substr(22, 4), ok);
-      if (!ok) {
+      size_t residueId = 0;
+      if (!parseNumber(buffer.substr(22, 4), residueId)) {
         appendError("Failed to parse residue sequence number: " +
-                    buffer.substr(22, 4));
+                    buffer.substr(22, 4).toString());
         return false;
       }
 
       if (residueId != currentResidueId) {
         currentResidueId = residueId;
 
-        string residueName = lexicalCast<string>(buffer.substr(17, 3), ok);
-        if (!ok) {
-          appendError("Failed to parse residue name: " + buffer.substr(17, 3));
+        StringView residueName = word(buffer.substr(17, 3));
+        if (residueName.empty()) {
+          appendError("Failed to parse residue name: " +
+                      buffer.substr(17, 3).toString());
           return false;
         }
 
-        char chainId = lexicalCast<char>(buffer.substr(21, 1), ok);
-        if (!ok) {
+        StringView chainId = word(buffer.substr(21, 1));
+        if (chainId.empty()) {
           appendError("Failed to parse chain identifier: " +
-                      buffer.substr(21, 1));
+                      buffer.substr(21, 1).toString());
           return false;
         }
 
-        r = &mol.addResidue(residueName, currentResidueId, chainId);
+        string name = residueName.toString();
+        char chain = chainId[0];
+        r = &mol.addResidue(name, currentResidueId, chain);
       }
 
-      string atomName = lexicalCast<string>(buffer.substr(12, 4), ok);
-      if (!ok) {
-        appendError("Failed to parse atom name: " + buffer.substr(12, 4));
+      StringView atomName = word(buffer.substr(12, 4));
+      if (atomName.empty()) {
+        appendError("Failed to parse atom name: " +
+                    buffer.substr(12, 4).toString());
         return false;
       }
 
       Vector3 pos; // Coordinates
-      pos.x() = lexicalCast<Real>(buffer.substr(30, 8), ok);
-      if (!ok) {
-        appendError("Failed to parse x coordinate: " + buffer.substr(30, 8));
-        return false;
-      }
-
-      pos.y() = lexicalCast<Real>(buffer.substr(38, 8), ok);
-      if (!ok) {
-        appendError("Failed to parse y coordinate: " + buffer.substr(38, 8));
-        return false;
-      }
-
-      pos.z() = lexicalCast<Real>(buffer.substr(46, 8), ok);
-      if (!ok) {
-        appendError("Failed to parse z coordinate: " + buffer.substr(46, 8));
-        return false;
+      const char axes[3] = { 'x', 'y', 'z' };
+      for (int i = 0; i < 3; ++i) {
+        StringView field = buffer.substr(30 + 8 * i, 8);
+        if (!parseNumber(field, pos[i])) {
+          appendError(string("Failed to parse ") + axes[i] +
+                      " coordinate: " + field.toString());
+          return false;
+        }
       }
 
-      string element; // Element symbol, right justififed
-      element = buffer.substr(76, 2);
-      element = trimmed(element);
+      // Element symbol, right justififed
+      string element = buffer.substr(76, 2).trimmed().toString();
       if (element == "SE") // For Sulphur
         element = 'S';
 
@@ -120,28 +127,30 @@ bool PdbFormat::read(std::istream& in, Core::Molecule& mol)
         Atom newAtom = mol.addAtom(atomicNum);
         newAtom.setPosition3d(pos);
         if (r) {
-          r->addResidueAtom(atomName, newAtom);
+          string name = atomName.toString();
+          r->addResidueAtom(name, newAtom);
         }
       } else {
         positions.push_back(pos);
       }
     }
 
-    else if (startsWith(buffer, "TER")) { //  This is very important, each TER
-                                          //  record also counts in the serial.
+    else if (buffer.startsWith("TER")) { //  This is very important, each TER
+                                         //  record also counts in the serial.
       // Need to account for that when comparing with CONECT
-      terList.push_back(lexicalCast<int>(buffer.substr(6, 5), ok));
-
-      if (!ok) {
+      int serial = 0;
+      if (!parseNumber(buffer.substr(6, 5), serial)) {
         appendError("Failed to parse TER serial");
         return false;
       }
+      terList.push_back(serial);
     }
 
-    else if (startsWith(buffer, "CONECT")) {
-      int a = lexicalCast<int>(buffer.substr(6, 5), ok);
-      if (!ok) {
-        appendError("Failed to parse coordinate a " + buffer.substr(6, 5));
+    else if (buffer.startsWith("CONECT")) {
+      int a = 0;
+      if (!parseNumber(buffer.substr(6, 5), a)) {
+        appendError("Failed to parse coordinate a " +
+                    buffer.substr(6, 5).toString());
         return false;
       }
       --a;
@@ -153,16 +162,18 @@ bool PdbFormat::read(std::istream& in, Core::Molecule& mol)
 
       int bCoords[] = { 11, 16, 21, 26 };
       for (int i = 0; i < 4; i++) {
-        if (trimmed(buffer.substr(bCoords[i], 5)) == "")
+        StringView field = buffer.substr(bCoords[i], 5);
+        if (field.trimmed().empty())
           break;
 
         else {
-          int b = lexicalCast<int>(buffer.substr(bCoords[i], 5), ok) - 1;
-          if (!ok) {
+          int b = 0;
+          if (!parseNumber(field, b)) {
             appendError("Failed to parse coordinate b" + std::to_string(i) +
-                        " " + buffer.substr(bCoords[i], 5));
+                        " " + field.toString());
             return false;
           }
+          --b;
 
           for (terCount = 0; terCount < terList.size() && b > terList[terCount];
                ++terCount)
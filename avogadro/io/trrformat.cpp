@@ -15,7 +15,10 @@
 ******************************************************************************/
 
 #include "trrformat.h"
-#include "struct.h"
+
+#include "binaryblock_p.h"
+#include "fileframesource.h"
+#include "frameselection_p.h"
 
 #include <avogadro/core/elements.h>
 #include <avogadro/core/molecule.h>
@@ -25,6 +28,7 @@
 
 #include <iomanip>
 #include <istream>
+#include <memory>
 #include <ostream>
 #include <sstream>
 #include <string>
@@ -56,373 +60,468 @@ using std::isalpha;
 #define DIM 3
 #define NM_TO_ANGSTROM 10.0
 string TRRVERSION = "GMX_trn_file";
-string HEADITEMS[] = { "ir_size",   "e_size",   "box_size", "vir_size",
-                       "pres_size", "top_size", "sym_size", "x_size",
-                       "v_size",    "f_size",   "natoms",   "step",
-                       "nre",       "time",     "lambda" };
 
-int swapInteger(int inp)
-{
-  return (((inp << 24) & 0xff000000) | ((inp << 8) & 0x00ff0000) |
-          ((inp >> 8) & 0x0000ff00) | ((inp >> 24) & 0x000000ff));
-}
+namespace {
 
-char swapEndian(char endian)
+// The header of a frame. The sizes are of the blocks that follow it, in
+// bytes.
+struct TrrHeader
 {
-  if (endian == '>')
-    return '<';
-  else
-    return '>';
-}
+  // The size of the blocks following the header.
+  std::streamoff dataSize() const
+  {
+    return static_cast<std::streamoff>(irSize) + eSize + boxSize + virSize +
+           presSize + topSize + symSize + xSize + vSize + fSize;
+  }
+
+  // Whether frames with the two headers have the same layout.
+  bool sameLayout(const TrrHeader& other) const
+  {
+    return size == other.size && irSize == other.irSize &&
+           eSize == other.eSize && boxSize == other.boxSize &&
+           virSize == other.virSize && presSize == other.presSize &&
+           topSize == other.topSize && symSize == other.symSize &&
+           xSize == other.xSize && vSize == other.vSize &&
+           fSize == other.fSize && natoms == other.natoms;
+  }
+
+  // The size of the header itself.
+  std::streamoff size;
+  int32_t irSize;
+  int32_t eSize;
+  int32_t boxSize;
+  int32_t virSize;
+  int32_t presSize;
+  int32_t topSize;
+  int32_t symSize;
+  int32_t xSize;
+  int32_t vSize;
+  int32_t fSize;
+  int32_t natoms;
+  int32_t step;
+  int32_t nre;
+  double time;
+  double lambda;
+  bool doublePrecision;
+};
 
 /* Checks whether the data stored in the binary file is of float or double type
  */
-int isDouble(map<string, int>& header)
+bool isDouble(const TrrHeader& header)
 {
-  int SIZE_DOUBLE = struct_calcsize("d");
   int size = 0;
-  string headerKeys[] = { "box_size", "x_size", "v_size", "f_size" };
-
-  for (int i = 0; i < (int)(sizeof(headerKeys) / sizeof(*headerKeys)); i++) {
-    if (header[headerKeys[i]] != 0) {
-      if (headerKeys[i] == "box_size") {
-        size = (int)(header[headerKeys[i]] / DIM * DIM);
-        break;
-      } else {
-        size = (int)(header[headerKeys[i]] / (header["natoms"] * DIM));
-        break;
-      }
-    }
-  }
-  return size == SIZE_DOUBLE;
+  if (header.boxSize != 0)
+    size = header.boxSize / (DIM * DIM);
+  else if (header.natoms == 0)
+    size = 0;
+  else if (header.xSize != 0)
+    size = header.xSize / (header.natoms * DIM);
+  else if (header.vSize != 0)
+    size = header.vSize / (header.natoms * DIM);
+  else if (header.fSize != 0)
+    size = header.fSize / (header.natoms * DIM);
+  return size == sizeof(double);
 }
 
-TrrFormat::TrrFormat() {}
-
-TrrFormat::~TrrFormat() {}
-
-bool TrrFormat::read(std::istream& inStream, Core::Molecule& mol)
+// Read the header of the next frame. The byte order of the file is detected
+// from the magic number, and swap set if it is not the byte order of this
+// machine.
+bool readHeader(std::istream& in, bool& swap, TrrHeader& header,
+                string& error)
 {
-  bool doubleStatus;
-  char endian = '>', buff[BUFSIZ], fmt[BUFSIZ], raw[1000];
-  int magic, natoms, slen0, slen1, headval[13];
-  string subs, keyCheck[] = { "box_size", "vir_size", "pres_size" },
-               keyCheck2[] = { "x_size", "v_size", "f_size" };
-  map<string, int> header;
+  std::streamoff start = in.tellg();
 
-  // Determining size of file
-  inStream.seekg(0, inStream.end);
-  int fileLen = inStream.tellg();
-  inStream.seekg(0, inStream.beg);
-
-  // Binary file must start with 1993
-  snprintf(fmt, sizeof(fmt), "%c1i", endian);
-  inStream.read(buff, struct_calcsize(fmt));
-  struct_unpack(buff, fmt, &magic);
-  if (magic != GROMACS_MAGIC) {
-    // Endian conversion
-    magic = swapInteger(magic);
-    endian = swapEndian(endian);
-    if (magic != GROMACS_MAGIC) {
-      appendError("Frame does not start with magic number 1993.");
+  // Binary header must start with 1993
+  int32_t magic[3];
+  if (!readBlock(in, magic, 3, false)) {
+    error = "Unexpected end of file.";
+    return false;
+  }
+  swap = magic[0] != GROMACS_MAGIC;
+  if (swap) {
+    swapBytes32(magic, 3);
+    if (magic[0] != GROMACS_MAGIC) {
+      error = "Frame does not start with magic number 1993.";
       return false;
     }
   }
 
-  snprintf(fmt, sizeof(fmt), "%c2i", endian);
-  inStream.read(buff, struct_calcsize(fmt));
-  struct_unpack(buff, fmt, &slen0, &slen1);
-
   // Reading trajectory version string
-  snprintf(fmt, sizeof(fmt), "%c%ds", endian, slen0 - 1);
-  inStream.read(buff, struct_calcsize(fmt));
-  struct_unpack(buff, fmt, raw);
-  subs = string(raw).substr(0, 12);
-  if (subs != TRRVERSION) {
-    appendError("Gromacs version string mismatch.");
+  char raw[1000];
+  int32_t slen0 = magic[1];
+  if (slen0 < 13 || slen0 > static_cast<int32_t>(sizeof(raw)) ||
+      !in.read(raw, slen0 - 1) || string(raw, 12) != TRRVERSION) {
+    error = "Gromacs version string mismatch.";
     return false;
   }
 
   // "ir_size", "e_size", "box_size", "vir_size", "pres_size",
   // "top_size", "sym_size", "x_size", "v_size", "f_size",
   // "natoms", "step", "nre"
-  snprintf(fmt, sizeof(fmt), "%c13i", endian);
-  inStream.read(buff, struct_calcsize(fmt));
-  struct_unpack(buff, fmt, &headval[0], &headval[1], &headval[2], &headval[3],
-                &headval[4], &headval[5], &headval[6], &headval[7], &headval[8],
-                &headval[9], &headval[10], &headval[11], &headval[12]);
-  for (int i = 0; i < 13; ++i) {
-    header.insert(pair<string, int>(HEADITEMS[i], headval[i]));
+  int32_t headval[13];
+  if (!readBlock(in, headval, 13, swap)) {
+    error = "Unexpected end of file.";
+    return false;
   }
+  header.irSize = headval[0];
+  header.eSize = headval[1];
+  header.boxSize = headval[2];
+  header.virSize = headval[3];
+  header.presSize = headval[4];
+  header.topSize = headval[5];
+  header.symSize = headval[6];
+  header.xSize = headval[7];
+  header.vSize = headval[8];
+  header.fSize = headval[9];
+  header.natoms = headval[10];
+  header.step = headval[11];
+  header.nre = headval[12];
 
   // Reading timestep and lambda
-  doubleStatus = isDouble(header);
-  if (doubleStatus) {
-    double header0, header1;
-    snprintf(fmt, sizeof(fmt), "%c2d", endian);
-    inStream.read(buff, struct_calcsize(fmt));
-    struct_unpack(buff, fmt, &header0, &header1);
-    header.insert(pair<string, int>("time", header0));
-    header.insert(pair<string, int>("lambda", header1));
+  header.doublePrecision = isDouble(header);
+  bool ok;
+  if (header.doublePrecision) {
+    double values[2];
+    ok = readBlock(in, values, 2, swap);
+    header.time = values[0];
+    header.lambda = values[1];
   } else {
-    float header0, header1;
-    snprintf(fmt, sizeof(fmt), "%c2f", endian);
-    inStream.read(buff, struct_calcsize(fmt));
-    struct_unpack(buff, fmt, &header0, &header1);
-    header.insert(pair<string, int>("time", header0));
-    header.insert(pair<string, int>("lambda", header1));
+    float values[2];
+    ok = readBlock(in, values, 2, swap);
+    header.time = values[0];
+    header.lambda = values[1];
+  }
+  if (!ok) {
+    error = "Unexpected end of file.";
+    return false;
   }
 
-  // Reading matrices corresponding to "box_size", "vir_size", "pres_size"
-  for (int _kid = 0; _kid < 3; ++_kid) {
-    if (header[keyCheck[_kid]] != 0) {
-      if (doubleStatus) {
-        snprintf(fmt, sizeof(fmt), "%c%dd", endian, DIM * DIM);
-        double mat[DIM][DIM];
-        inStream.read(buff, struct_calcsize(fmt));
-        struct_unpack(buff, fmt, &mat[0][0], &mat[0][1], &mat[0][2], &mat[1][0],
-                      &mat[1][1], &mat[1][2], &mat[2][0], &mat[2][1],
-                      &mat[2][2]);
-        if (keyCheck[_kid] == "box_size") {
-          mol.setUnitCell(new UnitCell(
-            Vector3(mat[0][0] * NM_TO_ANGSTROM, mat[0][1] * NM_TO_ANGSTROM,
-                    mat[0][2] * NM_TO_ANGSTROM),
-            Vector3(mat[1][0] * NM_TO_ANGSTROM, mat[1][1] * NM_TO_ANGSTROM,
-                    mat[1][2] * NM_TO_ANGSTROM),
-            Vector3(mat[2][0] * NM_TO_ANGSTROM, mat[2][1] * NM_TO_ANGSTROM,
-                    mat[2][2] * NM_TO_ANGSTROM)));
-        }
-      } else {
-        snprintf(fmt, sizeof(fmt), "%c%df", endian, DIM * DIM);
-        float mat[DIM][DIM];
-        inStream.read(buff, struct_calcsize(fmt));
-        struct_unpack(buff, fmt, &mat[0][0], &mat[0][1], &mat[0][2], &mat[1][0],
-                      &mat[1][1], &mat[1][2], &mat[2][0], &mat[2][1],
-                      &mat[2][2]);
-        if (keyCheck[_kid] == "box_size") {
-          mol.setUnitCell(new UnitCell(
-            Vector3(mat[0][0] * NM_TO_ANGSTROM, mat[0][1] * NM_TO_ANGSTROM,
-                    mat[0][2] * NM_TO_ANGSTROM),
-            Vector3(mat[1][0] * NM_TO_ANGSTROM, mat[1][1] * NM_TO_ANGSTROM,
-                    mat[1][2] * NM_TO_ANGSTROM),
-            Vector3(mat[2][0] * NM_TO_ANGSTROM, mat[2][1] * NM_TO_ANGSTROM,
-                    mat[2][2] * NM_TO_ANGSTROM)));
-        }
-      }
+  header.size = static_cast<std::streamoff>(in.tellg()) - start;
+  return true;
+}
+
+// Read count vectors of the precision of the frame with a single read, in
+// Angstrom.
+template <typename Real>
+bool readVectors(std::istream& in, bool swap, int count,
+                 vector<Real>& buffer, Vector3* vectors)
+{
+  buffer.resize(static_cast<size_t>(count) * DIM);
+  if (!readBlock(in, buffer.data(), buffer.size(), swap))
+    return false;
+  const Real* values = buffer.data();
+  for (int i = 0; i < count; ++i, values += DIM) {
+    vectors[i] = Vector3(values[0], values[1], values[2]) * NM_TO_ANGSTROM;
+  }
+  return true;
+}
+
+// Buffers to read the vectors of frames of either precision into.
+struct TrrBuffers
+{
+  vector<float> floats;
+  vector<double> doubles;
+};
+
+bool readVectors(std::istream& in, bool swap, const TrrHeader& header,
+                 int count, TrrBuffers& buffers, Vector3* vectors)
+{
+  if (header.doublePrecision)
+    return readVectors(in, swap, count, buffers.doubles, vectors);
+  return readVectors(in, swap, count, buffers.floats, vectors);
+}
+
+// Read the blocks of a frame following its header: the box, if there is one,
+// and the positions, skipping the velocities and forces. Either of positions
+// and box may be null to skip them too.
+bool readFrameData(std::istream& in, bool swap, const TrrHeader& header,
+                   TrrBuffers& buffers, Array<Vector3>* positions,
+                   Vector3* box)
+{
+  in.seekg(static_cast<std::streamoff>(header.irSize) + header.eSize,
+           std::ios_base::cur);
+  if (header.boxSize != 0 && box) {
+    if (!readVectors(in, swap, header, DIM, buffers, box))
+      return false;
+  } else {
+    in.seekg(header.boxSize, std::ios_base::cur);
+  }
+  in.seekg(static_cast<std::streamoff>(header.virSize) + header.presSize +
+             header.topSize + header.symSize,
+           std::ios_base::cur);
+
+  if (positions) {
+    positions->resize(header.xSize != 0 ? header.natoms : 0);
+    if (header.xSize != 0 &&
+        !readVectors(in, swap, header, header.natoms, buffers,
+                     positions->data())) {
+      return false;
     }
+  } else {
+    in.seekg(header.xSize, std::ios_base::cur);
   }
+  in.seekg(static_cast<std::streamoff>(header.vSize) + header.fSize,
+           std::ios_base::cur);
+  return static_cast<bool>(in);
+}
+
+UnitCell* unitCell(const Vector3* box)
+{
+  return new UnitCell(box[0], box[1], box[2]);
+}
+
+class TrrFrameSource : public FileFrameSource
+{
+public:
+  explicit TrrFrameSource(const string& fileName) : FileFrameSource(fileName)
+  {
+  }
+
+  Core::FrameSource* clone() const override
+  {
+    return new TrrFrameSource(*this);
+  }
+
+protected:
+  bool parseFrame(std::istream& in, Array<Vector3>& coordinates) override
+  {
+    TrrHeader header;
+    string error;
+    bool swap;
+    return readHeader(in, swap, header, error) &&
+           readFrameData(in, swap, header, m_buffers, &coordinates,
+                         nullptr) &&
+           !coordinates.empty();
+  }
+
+private:
+  TrrBuffers m_buffers;
+};
+
+} // namespace
+
+TrrFormat::TrrFormat() {}
+
+TrrFormat::~TrrFormat() {}
+
+bool TrrFormat::read(std::istream& inStream, Core::Molecule& mol)
+{
+  bool swap;
+  TrrHeader header;
+  TrrBuffers buffers;
+  string error;
+  Array<Vector3> positions;
+  Vector3 box[DIM];
+
+  // Determining size of file
+  std::streamoff start = inStream.tellg();
+  inStream.seekg(0, inStream.end);
+  std::streamoff fileLen = inStream.tellg();
+  inStream.seekg(start);
+
+  if (!readHeader(inStream, swap, header, error) ||
+      !readFrameData(inStream, swap, header, buffers, &positions, box)) {
+    appendError(error.empty() ? "Unable to read the first frame." : error);
+    return false;
+  }
+  if (header.boxSize != 0)
+    mol.setUnitCell(unitCell(box));
 
   typedef map<string, unsigned char> AtomTypeMap;
   AtomTypeMap atomTypes;
   unsigned char customElementCounter = CustomElementMin;
 
-  // Reading the coordinates of positions, velocities and forces
-  for (int _kid = 0; _kid < 3; ++_kid) {
-    natoms = header["natoms"];
-    double coordsDouble[DIM];
-    float coordsFloat[DIM];
-    for (int i = 0; i < natoms; ++i) {
-      if (header[keyCheck2[_kid]] != 0) {
-        memset(coordsDouble, 0, sizeof(coordsDouble));
-        memset(coordsFloat, 0, sizeof(coordsFloat));
-        if (doubleStatus) {
-          snprintf(fmt, sizeof(fmt), "%c%dd", endian, DIM);
-          inStream.read(buff, struct_calcsize(fmt));
-          struct_unpack(buff, fmt, &coordsDouble[0], &coordsDouble[1],
-                        &coordsDouble[2]);
-        } else {
-          snprintf(fmt, sizeof(fmt), "%c%df", endian, DIM);
-          inStream.read(buff, struct_calcsize(fmt));
-          struct_unpack(buff, fmt, &coordsFloat[0], &coordsFloat[1],
-                        &coordsFloat[2]);
-        }
+  for (Index i = 0; i < positions.size(); ++i) {
+    AtomTypeMap::const_iterator it;
+    atomTypes.insert(std::make_pair(to_string(i), customElementCounter++));
+    it = atomTypes.find(to_string(i));
+    // if (customElementCounter > CustomElementMax) {
+    //   appendError("Custom element type limit exceeded.");
+    //   return false;
+    // }
+    Atom newAtom = mol.addAtom(it->second);
+    newAtom.setPosition3d(positions[i]);
+  }
 
-        if (keyCheck2[_kid] == "x_size") {
-          // If parsed coordinates are fractional, the corresponding unscaling
-          // is done. Else the positions are assigned as parsed.
-          Vector3 pos(
-            coordsDouble[0] * NM_TO_ANGSTROM + coordsFloat[0] * NM_TO_ANGSTROM,
-            coordsDouble[1] * NM_TO_ANGSTROM + coordsFloat[1] * NM_TO_ANGSTROM,
-            coordsDouble[2] * NM_TO_ANGSTROM + coordsFloat[2] * NM_TO_ANGSTROM);
-
-          AtomTypeMap::const_iterator it;
-          // if (it == atomTypes.end()) {
-          atomTypes.insert(
-            std::make_pair(to_string(i), customElementCounter++));
-          it = atomTypes.find(to_string(i));
-          // if (customElementCounter > CustomElementMax) {
-          //   appendError("Custom element type limit exceeded.");
-          //   return false;
-          // }
-          Atom newAtom = mol.addAtom(it->second);
-          newAtom.setPosition3d(pos);
+  // Set the custom element map if needed
+  if (!atomTypes.empty()) {
+    Molecule::CustomElementMap elementMap;
+    for (AtomTypeMap::const_iterator it = atomTypes.begin(),
+                                     itEnd = atomTypes.end();
+         it != itEnd; ++it) {
+      elementMap.insert(std::make_pair(it->second, "Atom " + it->first));
+    }
+    mol.setCustomElementMap(elementMap);
+  }
+  mol.setTimeStep(header.time, 0);
+
+  if (isMode(Read) && !fileName().empty()) {
+    // Frames of trajectories read from a file are only read when they are
+    // needed.
+    std::unique_ptr<TrrFrameSource> frames(new TrrFrameSource(fileName()));
+    const TrrHeader first = header;
+    const std::streamoff frameSize = first.size + first.dataSize();
+    const Index frameCount = static_cast<Index>((fileLen - start) / frameSize);
+
+    // Usually all of the frames have the same layout, so that frame N can be
+    // found from the size of the first one. Check that the last frame really
+    // is where it should be, and read the time of each frame from its header.
+    bool fixed = frameCount > 1 && (fileLen - start) % frameSize == 0;
+    if (fixed) {
+      inStream.seekg(start + (frameCount - 1) * frameSize);
+      fixed = readHeader(inStream, swap, header, error) &&
+              header.sameLayout(first);
+    }
+    if (fixed) {
+      if (header.boxSize != 0 &&
+          readFrameData(inStream, swap, header, buffers, nullptr, box)) {
+        mol.setUnitCell(unitCell(box));
+      }
+      for (Index i = 1; i < frameCount; ++i) {
+        inStream.seekg(start + i * frameSize);
+        if (!readHeader(inStream, swap, header, error)) {
+          appendError(error);
+          return false;
         }
+        mol.setTimeStep(header.time, i);
       }
-    }
-
-    // Set the custom element map if needed
-    if (!atomTypes.empty()) {
-      Molecule::CustomElementMap elementMap;
-      for (AtomTypeMap::const_iterator it = atomTypes.begin(),
-                                       itEnd = atomTypes.end();
-           it != itEnd; ++it) {
-        elementMap.insert(std::make_pair(it->second, "Atom " + it->first));
+      frames->setFixedFrames(start, frameSize, frameCount);
+    } else {
+      // Otherwise the frames are found by skipping from one header to the
+      // next.
+      inStream.clear();
+      inStream.seekg(start + frameSize);
+      frames->addFrame(start);
+      int coordSet = 1;
+      std::streamoff offset = inStream.tellg();
+      while (inStream && offset < fileLen) {
+        if (!readHeader(inStream, swap, header, error)) {
+          appendError(error);
+          return false;
+        }
+        // Only the box is read, to keep the last one like the other frames.
+        readFrameData(inStream, swap, header, buffers, nullptr, box);
+        if (static_cast<std::streamoff>(inStream.tellg()) > fileLen)
+          break;
+        // Frames without positions are skipped.
+        if (header.natoms == static_cast<int32_t>(mol.atomCount()) &&
+            header.xSize != 0) {
+          if (header.boxSize != 0)
+            mol.setUnitCell(unitCell(box));
+          frames->addFrame(offset);
+          mol.setTimeStep(header.time, coordSet++);
+        }
+        offset = inStream.tellg();
       }
-      mol.setCustomElementMap(elementMap);
     }
+
+    if (frames->frameCount() > 1)
+      mol.setFrameSource(frames.release());
+    else
+      mol.setCoordinate3d(mol.atomPositions3d(), 0);
+    return true;
   }
+
   mol.setCoordinate3d(mol.atomPositions3d(), 0);
 
   // Do we have an animation?
   // EOF check
   int coordSet = 1;
-  while (static_cast<int>(inStream.tellg()) != fileLen) {
-    // Binary header must start with 1993
-    snprintf(fmt, sizeof(fmt), "%c1i", endian);
-    inStream.read(buff, struct_calcsize(fmt));
-    struct_unpack(buff, fmt, &magic);
-    if (magic != GROMACS_MAGIC) {
-      // Endian conversion
-      magic = swapInteger(magic);
-      endian = swapEndian(endian);
-      if (magic != GROMACS_MAGIC) {
-        appendError("Frame does not start with magic number 1993.");
-        return false;
-      }
+  while (inStream && static_cast<std::streamoff>(inStream.tellg()) < fileLen) {
+    if (!readHeader(inStream, swap, header, error)) {
+      appendError(error);
+      return false;
+    }
+    if (header.natoms != static_cast<int32_t>(mol.atomCount()) ||
+        header.xSize == 0) {
+      // Frames without positions are skipped.
+      inStream.seekg(header.dataSize(), std::ios_base::cur);
+      continue;
     }
+    if (!readFrameData(inStream, swap, header, buffers, &positions, box))
+      break;
+    if (header.boxSize != 0)
+      mol.setUnitCell(unitCell(box));
+    mol.setTimeStep(header.time, coordSet);
+    mol.setCoordinate3d(positions, coordSet++);
+  }
+
+  return true;
+}
 
-    snprintf(fmt, sizeof(fmt), "%c2i", endian);
-    inStream.read(buff, struct_calcsize(fmt));
-    struct_unpack(buff, fmt, &slen0, &slen1);
-
-    // Reading trajectory version string
-    snprintf(fmt, sizeof(fmt), "%c%ds", endian, slen0 - 1);
-    inStream.read(buff, struct_calcsize(fmt));
-    struct_unpack(buff, fmt, raw);
-    subs = string(raw).substr(0, 12);
-    if (subs != TRRVERSION) {
-      appendError("Gromacs version string mismatch.");
+bool TrrFormat::write(std::ostream& outStream, const Core::Molecule& mol)
+{
+  vector<int> frames;
+  string error;
+  if (!selectedFrames(mol, options(), frames, error)) {
+    appendError(error);
+    return false;
+  }
+  const int32_t natoms = static_cast<int32_t>(mol.atomCount());
+  const UnitCell* cell = mol.unitCell();
+
+  // TRR files are XDR encoded, which is big endian, in single precision.
+  const bool swap = !hostIsBigEndian();
+  vector<float> box;
+  if (cell) {
+    for (int i = 0; i < DIM; ++i) {
+      Vector3 row = cell->cellMatrix().col(i) / NM_TO_ANGSTROM;
+      for (int j = 0; j < DIM; ++j)
+        box.push_back(static_cast<float>(row[j]));
+    }
+  }
+
+  // Each frame is fetched, written and released in turn, so trajectories that
+  // are read on demand are never all in memory.
+  vector<char> buffer;
+  vector<float> coords(static_cast<size_t>(natoms) * DIM);
+  for (size_t f = 0; f < frames.size(); ++f) {
+    const Array<Vector3> positions = frames[f] < 0
+                                       ? mol.atomPositions3d()
+                                       : mol.coordinate3d(frames[f]);
+    if (static_cast<int32_t>(positions.size()) != natoms) {
+      appendError("Frame " + to_string(frames[f]) +
+                  " does not have a position for each atom.");
       return false;
     }
 
+    bool status = false;
+    float time[2] = { 0.0f, 0.0f }; // The time and lambda
+    if (frames[f] >= 0)
+      time[0] = static_cast<float>(mol.timeStep(frames[f], status));
+
+    buffer.clear();
+    const int32_t magic[3] = { GROMACS_MAGIC, 13, 12 };
+    appendBlock(buffer, magic, 3, swap);
+    buffer.insert(buffer.end(), TRRVERSION.begin(), TRRVERSION.end());
+
     // "ir_size", "e_size", "box_size", "vir_size", "pres_size",
     // "top_size", "sym_size", "x_size", "v_size", "f_size",
     // "natoms", "step", "nre"
-    snprintf(fmt, sizeof(fmt), "%c13i", endian);
-    inStream.read(buff, struct_calcsize(fmt));
-    struct_unpack(buff, fmt, &headval[0], &headval[1], &headval[2], &headval[3],
-                  &headval[4], &headval[5], &headval[6], &headval[7],
-                  &headval[8], &headval[9], &headval[10], &headval[11],
-                  &headval[12]);
-    for (int i = 0; i < 13; ++i) {
-      header.insert(pair<string, int>(HEADITEMS[i], headval[i]));
+    int32_t headval[13] = { 0 };
+    headval[2] = static_cast<int32_t>(box.size() * sizeof(float));
+    headval[7] = natoms * DIM * static_cast<int32_t>(sizeof(float));
+    headval[10] = natoms;
+    headval[11] = frames[f] < 0 ? 0 : frames[f];
+    appendBlock(buffer, headval, 13, swap);
+    appendBlock(buffer, time, 2, swap);
+    appendBlock(buffer, box.data(), box.size(), swap);
+
+    for (int32_t i = 0; i < natoms; ++i) {
+      for (int j = 0; j < DIM; ++j)
+        coords[i * DIM + j] =
+          static_cast<float>(positions[i][j] / NM_TO_ANGSTROM);
     }
+    appendBlock(buffer, coords.data(), coords.size(), swap);
 
-    // Reading timestep and lambda
-    doubleStatus = isDouble(header);
-    if (doubleStatus) {
-      double header0, header1;
-      snprintf(fmt, sizeof(fmt), "%c2d", endian);
-      inStream.read(buff, struct_calcsize(fmt));
-      struct_unpack(buff, fmt, &header0, &header1);
-      header.insert(pair<string, int>("time", header0));
-      header.insert(pair<string, int>("lambda", header1));
-    } else {
-      float header0, header1;
-      snprintf(fmt, sizeof(fmt), "%c2f", endian);
-      inStream.read(buff, struct_calcsize(fmt));
-      struct_unpack(buff, fmt, &header0, &header1);
-      header.insert(pair<string, int>("time", header0));
-      header.insert(pair<string, int>("lambda", header1));
-    }
-
-    // Reading matrices corresponding to "box_size", "vir_size", "pres_size"
-    for (int _kid = 0; _kid < 3; ++_kid) {
-      if (header[keyCheck[_kid]] != 0) {
-        natoms = header["natoms"];
-        if (doubleStatus) {
-          snprintf(fmt, sizeof(fmt), "%c%dd", endian, DIM * DIM);
-          double mat[DIM][DIM];
-          inStream.read(buff, struct_calcsize(fmt));
-          struct_unpack(buff, fmt, &mat[0][0], &mat[0][1], &mat[0][2],
-                        &mat[1][0], &mat[1][1], &mat[1][2], &mat[2][0],
-                        &mat[2][1], &mat[2][2]);
-          if (keyCheck[_kid] == "box_size") {
-            mol.setUnitCell(new UnitCell(
-              Vector3(mat[0][0] * NM_TO_ANGSTROM, mat[0][1] * NM_TO_ANGSTROM,
-                      mat[0][2] * NM_TO_ANGSTROM),
-              Vector3(mat[1][0] * NM_TO_ANGSTROM, mat[1][1] * NM_TO_ANGSTROM,
-                      mat[1][2] * NM_TO_ANGSTROM),
-              Vector3(mat[2][0] * NM_TO_ANGSTROM, mat[2][1] * NM_TO_ANGSTROM,
-                      mat[2][2] * NM_TO_ANGSTROM)));
-          }
-        } else {
-          snprintf(fmt, sizeof(fmt), "%c%df", endian, DIM * DIM);
-          float mat[DIM][DIM];
-          inStream.read(buff, struct_calcsize(fmt));
-          struct_unpack(buff, fmt, &mat[0][0], &mat[0][1], &mat[0][2],
-                        &mat[1][0], &mat[1][1], &mat[1][2], &mat[2][0],
-                        &mat[2][1], &mat[2][2]);
-          if (keyCheck[_kid] == "box_size") {
-            mol.setUnitCell(new UnitCell(
-              Vector3(mat[0][0] * NM_TO_ANGSTROM, mat[0][1] * NM_TO_ANGSTROM,
-                      mat[0][2] * NM_TO_ANGSTROM),
-              Vector3(mat[1][0] * NM_TO_ANGSTROM, mat[1][1] * NM_TO_ANGSTROM,
-                      mat[1][2] * NM_TO_ANGSTROM),
-              Vector3(mat[2][0] * NM_TO_ANGSTROM, mat[2][1] * NM_TO_ANGSTROM,
-                      mat[2][2] * NM_TO_ANGSTROM)));
-          }
-        }
-      }
-    }
-
-    natoms = header["natoms"];
-    Array<Vector3> positions;
-    positions.reserve(natoms);
-
-    // Reading the coordinates of positions, velocities and forces
-    for (int _kid = 0; _kid < 3; ++_kid) {
-      double coordsDouble[DIM];
-      float coordsFloat[DIM];
-      for (int i = 0; i < natoms; ++i) {
-        if (header[keyCheck2[_kid]] != 0) {
-          memset(coordsDouble, 0, sizeof(coordsDouble));
-          memset(coordsFloat, 0, sizeof(coordsFloat));
-          if (doubleStatus) {
-            snprintf(fmt, sizeof(fmt), "%c%dd", endian, DIM);
-            inStream.read(buff, struct_calcsize(fmt));
-            struct_unpack(buff, fmt, &coordsDouble[0], &coordsDouble[1],
-                          &coordsDouble[2]);
-          } else {
-            snprintf(fmt, sizeof(fmt), "%c%df", endian, DIM);
-            inStream.read(buff, struct_calcsize(fmt));
-            struct_unpack(buff, fmt, &coordsFloat[0], &coordsFloat[1],
-                          &coordsFloat[2]);
-          }
-
-          if (keyCheck2[_kid] == "x_size") {
-            // If parsed coordinates are fractional, the corresponding unscaling
-            // is done. Else the positions are assigned as parsed.
-            Vector3 pos(coordsDouble[0] * NM_TO_ANGSTROM +
-                          coordsFloat[0] * NM_TO_ANGSTROM,
-                        coordsDouble[1] * NM_TO_ANGSTROM +
-                          coordsFloat[1] * NM_TO_ANGSTROM,
-                        coordsDouble[2] * NM_TO_ANGSTROM +
-                          coordsFloat[2] * NM_TO_ANGSTROM);
-            positions.push_back(pos);
-          }
-        }
-      }
+    outStream.write(buffer.data(), buffer.size());
+    if (!outStream) {
+      appendError("Unable to write the trajectory.");
+      return false;
     }
-    mol.setCoordinate3d(positions, coordSet++);
-    positions.clear();
   }
-  return true;
-}
 
-bool TrrFormat::write(std::ostream& outStream, const Core::Molecule& mol)
-{
-  return false;
+  return true;
 }
 
 std::vector<std::string> TrrFormat::fileExtensions() const
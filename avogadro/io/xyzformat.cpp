@@ -16,6 +16,10 @@
 
 #include "xyzformat.h"
 
+#include "fileframesource.h"
+#include "framebatch_p.h"
+#include "linereader.h"
+
 #include <avogadro/core/elements.h>
 #include <avogadro/core/molecule.h>
 #include <avogadro/core/utilities.h>
@@ -25,6 +29,7 @@
 
 #include <iomanip>
 #include <istream>
+#include <memory>
 #include <ostream>
 #include <sstream>
 #include <string>
@@ -33,7 +38,6 @@ using json = nlohmann::json;
 
 using std::string;
 using std::endl;
-using std::getline;
 using std::string;
 using std::vector;
 
@@ -44,14 +48,71 @@ using Core::Array;
 using Core::Atom;
 using Core::Elements;
 using Core::Molecule;
-using Core::lexicalCast;
-using Core::split;
-using Core::trimmed;
+using Core::nextLine;
+using Core::parseNumber;
+using Core::StringView;
+using Core::tokenize;
 
 #ifndef _WIN32
 using std::isalpha;
 #endif
 
+namespace {
+
+// Parse the position from the tokens of an atom line.
+Vector3 position(const vector<StringView>& tokens)
+{
+  Vector3 pos(Vector3::Zero());
+  for (int i = 0; i < 3; ++i)
+    parseNumber(tokens[i + 1], pos[i]);
+  return pos;
+}
+
+// Parse the positions from a block of numAtoms atom lines, leaving the
+// offending line in line on failure.
+bool parsePositions(StringView block, size_t numAtoms,
+                    Array<Vector3>& positions, StringView& line)
+{
+  positions.resize(numAtoms);
+  vector<StringView> tokens;
+  for (size_t i = 0; i < numAtoms; ++i) {
+    nextLine(block, line);
+    if (tokenize(line, tokens) < 4)
+      return false;
+    positions[i] = position(tokens);
+  }
+  return true;
+}
+
+class XyzFrameSource : public FileFrameSource
+{
+public:
+  XyzFrameSource(const string& fileName, size_t numAtoms)
+    : FileFrameSource(fileName), m_numAtoms(numAtoms)
+  {
+  }
+
+  Core::FrameSource* clone() const override
+  {
+    return new XyzFrameSource(*this);
+  }
+
+protected:
+  bool parseFrame(std::istream& in, Array<Vector3>& coordinates) override
+  {
+    LineReader reader(in);
+    StringView block;
+    StringView line;
+    return reader.getLines(m_numAtoms, block) &&
+           parsePositions(block, m_numAtoms, coordinates, line);
+  }
+
+private:
+  size_t m_numAtoms;
+};
+
+} // namespace
+
 XyzFormat::XyzFormat()
 {
 }
@@ -68,39 +129,49 @@ bool XyzFormat::read(std::istream& inStream, Core::Molecule& mol)
   else
     opts = json::object();
 
+  // The atom count may follow blank lines.
+  LineReader reader(inStream);
+  StringView line;
   size_t numAtoms = 0;
-  if (!(inStream >> numAtoms)) {
+  while (reader.getLine(line) && line.trimmed().empty())
+    ;
+  if (!parseNumber(line, numAtoms)) {
     appendError("Error parsing number of atoms.");
     return false;
   }
 
-  string buffer;
-  getline(inStream, buffer); // Finish the first line
-  getline(inStream, buffer);
-  if (!buffer.empty())
-    mol.setData("name", trimmed(buffer));
+  if (reader.getLine(line) && !line.empty())
+    mol.setData("name", line.trimmed().toString());
+
+  // Frames of trajectories read from a file are indexed, and only read when
+  // they are needed.
+  std::unique_ptr<XyzFrameSource> frames;
+  if (isMode(Read) && !fileName().empty()) {
+    frames.reset(new XyzFrameSource(fileName(), numAtoms));
+    frames->addFrame(reader.tell());
+  }
 
   // Parse atoms
+  vector<StringView> tokens;
   for (size_t i = 0; i < numAtoms; ++i) {
-    getline(inStream, buffer);
-    vector<string> tokens(split(buffer, ' '));
-
-    if (tokens.size() < 4) {
-      appendError("Not enough tokens in this line: " + buffer);
+    if (!reader.getLine(line))
+      line = StringView();
+    if (tokenize(line, tokens) < 4) {
+      appendError("Not enough tokens in this line: " + line.toString());
       return false;
     }
 
     unsigned char atomicNum(0);
-    if (isalpha(tokens[0][0]))
-      atomicNum = Elements::atomicNumberFromSymbol(tokens[0]);
-    else
-      atomicNum = static_cast<unsigned char>(lexicalCast<short int>(tokens[0]));
-
-    Vector3 pos(lexicalCast<double>(tokens[1]), lexicalCast<double>(tokens[2]),
-                lexicalCast<double>(tokens[3]));
+    if (isalpha(tokens[0][0])) {
+      atomicNum = Elements::atomicNumberFromSymbol(tokens[0].toString());
+    } else {
+      short int number = 0;
+      parseNumber(tokens[0], number);
+      atomicNum = static_cast<unsigned char>(number);
+    }
 
     Atom newAtom = mol.addAtom(atomicNum);
-    newAtom.setPosition3d(pos);
+    newAtom.setPosition3d(position(tokens));
   }
 
   // Check that all atoms were handled.
@@ -108,47 +179,65 @@ bool XyzFormat::read(std::istream& inStream, Core::Molecule& mol)
     std::ostringstream errorStream;
     errorStream << "Error parsing atom at index " << mol.atomCount()
                 << " (line " << 3 + mol.atomCount() << ").\n"
-                << buffer;
+                << line.toString();
     appendError(errorStream.str());
     return false;
   }
 
-  // Do we have an animation?
-  size_t numAtoms2;
-  if (getline(inStream, buffer) && (numAtoms2 = lexicalCast<int>(buffer)) &&
-      numAtoms == numAtoms2) {
-    getline(inStream, buffer); // Skip the blank
-    mol.setCoordinate3d(mol.atomPositions3d(), 0);
-    int coordSet = 1;
-    while (numAtoms == numAtoms2) {
+  // Frames that are not read lazily are collected into batches, and each
+  // batch is parsed on several threads. The frames are then added in order,
+  // as far as the first one that failed.
+  int coordSet = 1;
+  FrameBatch batch;
+  auto parseBatch = [&]() -> bool {
+    size_t failed =
+      batch.parse([numAtoms](size_t, StringView text, Array<Vector3>& coords) {
+        StringView badLine;
+        return parsePositions(text, numAtoms, coords, badLine);
+      });
+    for (size_t i = 0; i < failed; ++i) {
+      if (coordSet == 1)
+        mol.setCoordinate3d(mol.atomPositions3d(), 0);
+      mol.setCoordinate3d(batch.frame(i), coordSet++);
+    }
+    if (failed < batch.size()) {
       Array<Vector3> positions;
-      positions.reserve(numAtoms);
-
-      for (size_t i = 0; i < numAtoms; ++i) {
-        getline(inStream, buffer);
-        vector<string> tokens(split(buffer, ' '));
-        if (tokens.size() < 4) {
-          appendError("Not enough tokens in this line: " + buffer);
-          return false;
-        }
-        Vector3 pos(lexicalCast<double>(tokens[1]),
-                    lexicalCast<double>(tokens[2]),
-                    lexicalCast<double>(tokens[3]));
-        positions.push_back(pos);
-      }
-
-      mol.setCoordinate3d(positions, coordSet++);
-
-      if (!getline(inStream, buffer)) {
-        numAtoms2 = lexicalCast<int>(buffer);
-        if (numAtoms == numAtoms2)
-          break;
-      }
-
-      std::getline(inStream, buffer); // Skip the blank
-      positions.clear();
+      parsePositions(batch.text(failed), numAtoms, positions, line);
+      appendError("Not enough tokens in this line: " + line.toString());
+      return false;
+    }
+    batch.clear();
+    return true;
+  };
+
+  // Do we have an animation? Each further frame repeats the atom count and a
+  // comment line.
+  size_t frameAtoms = 0;
+  while (reader.getLine(line) && parseNumber(line, frameAtoms) &&
+         frameAtoms == numAtoms) {
+    reader.getLine(line); // Skip the comment
+    std::streamoff offset = reader.tell();
+    if (!reader.getLines(numAtoms, line)) {
+      // The frames before it are kept, read now or on demand.
+      if (frames && frames->frameCount() > 1)
+        mol.setFrameSource(frames.release());
+      else if (!frames && !parseBatch())
+        return false;
+      appendError("Not enough atoms in the last frame.");
+      return false;
+    }
+    if (frames) {
+      frames->addFrame(offset);
+    } else {
+      batch.add(line);
+      if (batch.isFull() && !parseBatch())
+        return false;
     }
   }
+  if (batch.size() > 0 && !parseBatch())
+    return false;
+  if (frames && frames->frameCount() > 1)
+    mol.setFrameSource(frames.release());
 
   // This format has no connectivity information, so perceive basics at least.
   if (opts.value("perceiveBonds", true))
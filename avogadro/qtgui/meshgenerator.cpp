@@ -23,6 +23,9 @@
 
 #include <QDebug>
 #include <QReadWriteLock>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
 
 namespace Avogadro {
 namespace QtGui {
@@ -30,6 +33,29 @@ namespace QtGui {
 using Core::Cube;
 using Core::Mesh;
 
+// A slab of cubes, planes begin to end - 1 in x, marched by one thread.
+struct MeshGenerator::Slab
+{
+  int begin;
+  int end;
+  Core::Array<Vector3f> vertices;
+  Core::Array<Vector3f> normals;
+  Core::Array<unsigned int> triangles;
+  // The vertex indices on the y and z edges of the first and last planes.
+  std::vector<int> firstEdges[2];
+  std::vector<int> lastEdges[2];
+  // The index of each vertex in the merged mesh.
+  std::vector<unsigned int> map;
+};
+
+struct MeshGenerator::SlabFunctor
+{
+  typedef void result_type;
+  explicit SlabFunctor(MeshGenerator* generator) : m_generator(generator) {}
+  void operator()(Slab& slab) const { m_generator->marchSlab(slab); }
+  MeshGenerator* m_generator;
+};
+
 MeshGenerator::MeshGenerator(QObject* p)
   : QThread(p), m_iso(0.0), m_reverseWinding(false), m_cube(0), m_mesh(0),
     m_stepSize(0.0, 0.0, 0.0), m_min(0.0, 0.0, 0.0), m_dim(0, 0, 0),
@@ -43,7 +69,7 @@ MeshGenerator::MeshGenerator(const Cube* cube_, Mesh* mesh_, float iso,
     m_stepSize(0.0, 0.0, 0.0), m_min(0.0, 0.0, 0.0), m_dim(0, 0, 0),
     m_progmin(0), m_progmax(0)
 {
-  initialize(cube_, mesh_, iso);
+  initialize(cube_, mesh_, iso, reverse);
 }
 
 MeshGenerator::~MeshGenerator()
@@ -87,33 +113,29 @@ void MeshGenerator::run()
   m_mesh->setStable(false);
   m_mesh->clear();
 
-  m_vertices.reserve(m_dim.x() * m_dim.y() * m_dim.z() * 3);
-  m_normals.reserve(m_dim.x() * m_dim.y() * m_dim.z() * 3);
-
-  // Now to march the cube
-  for (int i = 0; i < m_dim.x() - 1; ++i) {
-    for (int j = 0; j < m_dim.y() - 1; ++j) {
-      for (int k = 0; k < m_dim.z() - 1; ++k) {
-        marchingCube(Vector3i(i, j, k));
-      }
+  std::vector<Slab> slabs;
+  if (m_dim.x() > 1 && m_dim.y() > 1 && m_dim.z() > 1) {
+    // Use a few slabs per thread so that they stay busy when the surface only
+    // passes through part of the cube.
+    int planes = m_dim.x() - 1;
+    int slabCount =
+      std::min(planes, std::max(1, QThread::idealThreadCount() * 4));
+    slabs.resize(slabCount);
+    for (int i = 0; i < slabCount; ++i) {
+      slabs[i].begin = planes * i / slabCount;
+      slabs[i].end = planes * (i + 1) / slabCount;
     }
-    if (m_vertices.capacity() < m_vertices.size() + m_dim.y() * m_dim.x() * 3) {
-      m_vertices.reserve(m_vertices.capacity() * 2);
-      m_normals.reserve(m_normals.capacity() * 2);
-    }
-    emit progressValueChanged(i);
+
+    // Now to march the cube
+    m_progress.store(0);
+    QtConcurrent::blockingMap(slabs, SlabFunctor(this));
   }
 
   m_cube->lock()->unlock();
 
   // Copy the data across
-  m_mesh->setVertices(m_vertices);
-  m_mesh->setNormals(m_normals);
+  mergeSlabs(slabs);
   m_mesh->setStable(true);
-
-  // Now we are done give all that memory back
-  m_vertices.resize(0);
-  m_normals.resize(0);
 }
 
 void MeshGenerator::clear()
@@ -147,96 +169,177 @@ inline float MeshGenerator::offset(float val1, float val2)
   return (m_iso - val1) / (val2 - val1);
 }
 
-unsigned long MeshGenerator::duplicate(const Vector3i&, const Vector3f&)
+template <typename T>
+void MeshGenerator::planeEdges(Slab& slab, const T* data, int i, int axis,
+                               std::vector<int>& edges)
 {
-  // FIXME Not implemented yet.
-  return 0;
+  const size_t planeSize = static_cast<size_t>(m_dim.y()) * m_dim.z();
+  const T* plane = data + i * planeSize;
+
+  // The distance in the data to the other end of the edge, and the last edge
+  // start in y and z.
+  size_t step = axis == 0 ? planeSize : (axis == 1 ? m_dim.z() : 1);
+  int jEnd = axis == 1 ? m_dim.y() - 1 : m_dim.y();
+  int kEnd = axis == 2 ? m_dim.z() - 1 : m_dim.z();
+
+  std::fill(edges.begin(), edges.end(), -1);
+  for (int j = 0; j < jEnd; ++j) {
+    for (int k = 0; k < kEnd; ++k) {
+      size_t p = static_cast<size_t>(j) * m_dim.z() + k;
+      float val1 = static_cast<float>(plane[p]);
+      float val2 = static_cast<float>(plane[p + step]);
+      // Only edges with one end inside of the surface are intersected
+      if ((val1 <= m_iso) == (val2 <= m_iso))
+        continue;
+
+      Vector3f gridPos(static_cast<float>(i), static_cast<float>(j),
+                       static_cast<float>(k));
+      gridPos[axis] += offset(val1, val2);
+      Vector3f pos = m_min + gridPos.cwiseProduct(m_stepSize);
+
+      edges[p] = static_cast<int>(slab.vertices.size());
+      slab.vertices.push_back(pos);
+      slab.normals.push_back(m_reverseWinding ? -normal(pos) : normal(pos));
+    }
+  }
 }
 
-bool MeshGenerator::marchingCube(const Vector3i& pos)
+void MeshGenerator::marchSlab(Slab& slab)
 {
-  float afCubeValue[8];
-  Vector3f asEdgeVertex[12];
-  Vector3f asEdgeNorm[12];
-
-  // Calculate the position in the Cube
-  Vector3f fPos;
-  for (unsigned int i = 0; i < 3; ++i)
-    fPos[i] = static_cast<float>(pos[i]) * m_stepSize[i] + m_min[i];
-
-  // Make a local copy of the values at the cube's corners
-  for (int i = 0; i < 8; ++i) {
-    afCubeValue[i] = static_cast<float>(
-      m_cube->value(Vector3i(pos + Vector3i(a2iVertexOffset[i]))));
-  }
+  // The values are read in the precision of the cube, without converting it.
+  if (m_cube->precision() == Cube::Float)
+    marchSlab(slab, m_cube->floatData()->data());
+  else
+    marchSlab(slab, m_cube->data()->data());
+}
 
-  // Find which vertices are inside of the surface and which are outside
-  long iFlagIndex = 0;
-  for (int i = 0; i < 8; ++i) {
-    if (afCubeValue[i] <= m_iso) {
-      iFlagIndex |= 1 << i;
+template <typename T>
+void MeshGenerator::marchSlab(Slab& slab, const T* data)
+{
+  const int ny = m_dim.y();
+  const int nz = m_dim.z();
+  const size_t planeSize = static_cast<size_t>(ny) * nz;
+
+  // The edge cache, holding the vertex index of each intersected edge. Only
+  // the y and z edges of two planes and the x edges between them are needed.
+  std::vector<int> xEdges(planeSize);
+  std::vector<int> yEdges(planeSize), nextYEdges(planeSize);
+  std::vector<int> zEdges(planeSize), nextZEdges(planeSize);
+  planeEdges(slab, data, slab.begin, 1, yEdges);
+  planeEdges(slab, data, slab.begin, 2, zEdges);
+  slab.firstEdges[0] = yEdges;
+  slab.firstEdges[1] = zEdges;
+
+  for (int i = slab.begin; i < slab.end; ++i) {
+    planeEdges(slab, data, i, 0, xEdges);
+    planeEdges(slab, data, i + 1, 1, nextYEdges);
+    planeEdges(slab, data, i + 1, 2, nextZEdges);
+
+    const T* lower = data + i * planeSize;
+    const T* upper = lower + planeSize;
+    for (int j = 0; j < ny - 1; ++j) {
+      for (int k = 0; k < nz - 1; ++k) {
+        size_t p = static_cast<size_t>(j) * nz + k;
+
+        // The values at the cube's corners, ordered as in a2iVertexOffset
+        const T corners[8] = { lower[p],          upper[p],
+                               upper[p + nz],     lower[p + nz],
+                               lower[p + 1],      upper[p + 1],
+                               upper[p + nz + 1], lower[p + nz + 1] };
+
+        // Find which vertices are inside of the surface and which are outside
+        int iFlagIndex = 0;
+        for (int c = 0; c < 8; ++c) {
+          if (static_cast<float>(corners[c]) <= m_iso)
+            iFlagIndex |= 1 << c;
+        }
+        if (aiCubeEdgeFlags[iFlagIndex] == 0)
+          continue;
+
+        // The vertices on the cube's edges, ordered as in a2iEdgeConnection
+        const int edgeVertex[12] = {
+          xEdges[p],     nextYEdges[p],      xEdges[p + nz],
+          yEdges[p],     xEdges[p + 1],      nextYEdges[p + 1],
+          xEdges[p + nz + 1], yEdges[p + 1], zEdges[p],
+          nextZEdges[p], nextZEdges[p + nz], zEdges[p + nz]
+        };
+
+        // Store the triangles that were found, there can be up to five
+        const int* table = a2iTriangleConnectionTable[iFlagIndex];
+        for (int t = 0; t < 15 && table[t] >= 0; t += 3) {
+          // Make sure we get the triangle winding the right way around!
+          if (!m_reverseWinding) {
+            for (int v = 0; v < 3; ++v)
+              slab.triangles.push_back(edgeVertex[table[t + v]]);
+          } else {
+            for (int v = 2; v >= 0; --v)
+              slab.triangles.push_back(edgeVertex[table[t + v]]);
+          }
+        }
+      }
     }
+
+    yEdges.swap(nextYEdges);
+    zEdges.swap(nextZEdges);
+    emit progressValueChanged(m_progress.fetchAndAddRelaxed(1) + 1);
   }
 
-  // Find which edges are intersected by the surface
-  long iEdgeFlags = aiCubeEdgeFlags[iFlagIndex];
+  slab.lastEdges[0].swap(yEdges);
+  slab.lastEdges[1].swap(zEdges);
+}
 
-  // No intersections if the cube is entirely inside or outside of the surface
-  if (iEdgeFlags == 0) {
-    return false;
+void MeshGenerator::mergeSlabs(std::vector<Slab>& slabs)
+{
+  // The vertices on the last plane of a slab are also on the first plane of
+  // the next one, number all of the others consecutively.
+  unsigned int vertexCount = 0;
+  size_t triangleCount = 0;
+  for (size_t s = 0; s < slabs.size(); ++s) {
+    Slab& slab = slabs[s];
+    std::vector<bool> shared(slab.vertices.size(), false);
+    for (int a = 0; s + 1 < slabs.size() && a < 2; ++a) {
+      for (size_t e = 0; e < slab.lastEdges[a].size(); ++e) {
+        if (slab.lastEdges[a][e] >= 0)
+          shared[slab.lastEdges[a][e]] = true;
+      }
+    }
+    slab.map.resize(slab.vertices.size());
+    for (size_t v = 0; v < slab.vertices.size(); ++v) {
+      if (!shared[v])
+        slab.map[v] = vertexCount++;
+    }
+    triangleCount += slab.triangles.size();
   }
 
-  // Find the point of intersection of the surface with each edge
-  // Then find the normal to the surface at those points
-  for (int i = 0; i < 12; ++i) {
-    // if there is an intersection on this edge
-    if (iEdgeFlags & (1 << i)) {
-      float fOffset = offset(afCubeValue[a2iEdgeConnection[i][0]],
-                             afCubeValue[a2iEdgeConnection[i][1]]);
-
-      asEdgeVertex[i] =
-        Vector3f(fPos.x() +
-                   (a2fVertexOffset[a2iEdgeConnection[i][0]][0] +
-                    fOffset * a2fEdgeDirection[i][0]) *
-                     m_stepSize[0],
-                 fPos.y() +
-                   (a2fVertexOffset[a2iEdgeConnection[i][0]][1] +
-                    fOffset * a2fEdgeDirection[i][1]) *
-                     m_stepSize[1],
-                 fPos.z() +
-                   (a2fVertexOffset[a2iEdgeConnection[i][0]][2] +
-                    fOffset * a2fEdgeDirection[i][2]) *
-                     m_stepSize[2]);
-
-      /// FIXME Optimize this to only calculate normals when required
-      asEdgeNorm[i] = normal(asEdgeVertex[i]);
+  // Point the shared vertices at the copy owned by the next slab.
+  for (size_t s = 0; s + 1 < slabs.size(); ++s) {
+    for (int a = 0; a < 2; ++a) {
+      const std::vector<int>& last = slabs[s].lastEdges[a];
+      const std::vector<int>& first = slabs[s + 1].firstEdges[a];
+      for (size_t e = 0; e < last.size(); ++e) {
+        if (last[e] >= 0)
+          slabs[s].map[last[e]] = slabs[s + 1].map[first[e]];
+      }
     }
   }
 
-  // Store the triangles that were found, there can be up to five per cube
-  for (int i = 0; i < 5; ++i) {
-    if (a2iTriangleConnectionTable[iFlagIndex][3 * i] < 0)
-      break;
-    int iVertex = 0;
-    iEdgeFlags = a2iTriangleConnectionTable[iFlagIndex][3 * i];
-    // Make sure we get the triangle winding the right way around!
-    if (!m_reverseWinding) {
-      for (int j = 0; j < 3; ++j) {
-        iVertex = a2iTriangleConnectionTable[iFlagIndex][3 * i + j];
-        m_indices.push_back(static_cast<unsigned int>(m_vertices.size()));
-        m_normals.push_back(asEdgeNorm[iVertex]);
-        m_vertices.push_back(asEdgeVertex[iVertex]);
-      }
-    } else {
-      for (int j = 2; j >= 0; --j) {
-        iVertex = a2iTriangleConnectionTable[iFlagIndex][3 * i + j];
-        m_indices.push_back(static_cast<unsigned int>(m_vertices.size()));
-        m_normals.push_back(-asEdgeNorm[iVertex]);
-        m_vertices.push_back(asEdgeVertex[iVertex]);
-      }
+  Core::Array<Vector3f> vertices(vertexCount);
+  Core::Array<Vector3f> normals(vertexCount);
+  Core::Array<unsigned int> triangles;
+  triangles.reserve(triangleCount);
+  for (size_t s = 0; s < slabs.size(); ++s) {
+    const Slab& slab = slabs[s];
+    for (size_t v = 0; v < slab.vertices.size(); ++v) {
+      vertices[slab.map[v]] = slab.vertices[v];
+      normals[slab.map[v]] = slab.normals[v];
     }
+    for (size_t t = 0; t < slab.triangles.size(); ++t)
+      triangles.push_back(slab.map[slab.triangles[t]]);
   }
-  return true;
+
+  m_mesh->setVertices(vertices);
+  m_mesh->setNormals(normals);
+  m_mesh->setTriangles(triangles);
 }
 
 // Lists the positions, relative to vertex0, of the 8 vertices of a cube
@@ -23,6 +23,9 @@
 #include <avogadro/core/array.h>
 #include <avogadro/core/vector.h>
 
+#include <vector>
+
+#include <QtCore/QAtomicInt>
 #include <QtCore/QThread>
 
 namespace Avogadro {
@@ -49,6 +52,11 @@ namespace QtGui {
  * You must first initialize the class and then call run() to actually
  * polygonize the isosurface. Connect to the classes finished() signal to
  * do something once the polygonization is complete.
+ *
+ * The cube is split into slabs along x that are marched in parallel. Each
+ * vertex is computed once per intersected grid edge and shared by all of the
+ * triangles that use it, so the resulting Mesh is indexed (see
+ * Core::Mesh::triangles()).
  */
 
 class AVOGADROQTGUI_EXPORT MeshGenerator : public QThread
@@ -88,6 +96,8 @@ public:
   /**
    * Use this function to begin Mesh generation. Uses an asynchronous thread,
    * and so avoids locking the user interface while the isosurface is found.
+   * The slabs are marched on the global QThreadPool and merged once they are
+   * all complete.
    */
   void run() override;
 
@@ -123,6 +133,9 @@ signals:
   void progressValueChanged(int);
 
 protected:
+  struct Slab;
+  struct SlabFunctor;
+
   /**
    * Get the normal to the supplied point. This operation is quite expensive
    * and so should be avoided wherever possible.
@@ -139,12 +152,31 @@ protected:
    */
   float offset(float val1, float val2);
 
-  unsigned long duplicate(const Vector3i& c, const Vector3f& pos);
+  /**
+   * Add a vertex for each grid edge starting on plane @a i that intersects
+   * the surface, recording its index in @a edges (-1 for no intersection).
+   * @param data The values of the cube, in its precision.
+   * @param i The x index of the grid plane.
+   * @param axis The direction of the edges, 0 for x (edges between plane i
+   * and i + 1), 1 for y and 2 for z.
+   */
+  template <typename T>
+  void planeEdges(Slab& slab, const T* data, int i, int axis,
+                  std::vector<int>& edges);
+
+  /**
+   * March all of the cubes in the slab, creating the vertices and triangles
+   * of the slab's part of the isosurface.
+   */
+  void marchSlab(Slab& slab);
+  template <typename T>
+  void marchSlab(Slab& slab, const T* data);
 
   /**
-   * Perform a marching cubes step on a single cube.
+   * Merge the slabs into the final mesh, joining the vertices on the planes
+   * shared by neighboring slabs.
    */
-  bool marchingCube(const Vector3i& pos);
+  void mergeSlabs(std::vector<Slab>& slabs);
 
   float m_iso;              /** The value of the isosurface. */
   bool m_reverseWinding;    /** Whether the winding and normals are reversed */
@@ -153,8 +185,7 @@ protected:
   Vector3f m_stepSize;      /** The step size vector for cube */
   Vector3f m_min;           /** The minimum point in the cube. */
   Vector3i m_dim;           /** The dimensions of the cube. */
-  Core::Array<Vector3f> m_vertices, m_normals;
-  Core::Array<unsigned int> m_indices;
+  QAtomicInt m_progress;    /** The number of planes marched so far. */
   int m_progmin;
   int m_progmax;
 
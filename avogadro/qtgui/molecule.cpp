@@ -20,6 +20,27 @@
 namespace Avogadro {
 namespace QtGui {
 
+namespace {
+// After a batch removal the remaining atoms (or bonds) keep their order, point
+// the unique IDs at their new indices. Entries flagged in removed lose their
+// id.
+void remapUniqueIds(Core::Array<Index>& uniqueIds,
+                    const std::vector<bool>& removed)
+{
+  std::vector<Index> newIndex(removed.size(), MaxIndex);
+  Index next = 0;
+  for (size_t i = 0; i < removed.size(); ++i) {
+    if (!removed[i])
+      newIndex[i] = next++;
+  }
+  for (Index uid = 0; uid < uniqueIds.size(); ++uid) {
+    Index& id = uniqueIds[uid];
+    if (id != MaxIndex)
+      id = id < newIndex.size() ? newIndex[id] : MaxIndex;
+  }
+}
+} // namespace
+
 Molecule::Molecule(QObject* parent_)
   : QObject(parent_), m_undoMolecule(new RWMolecule(*this, this))
 {
@@ -113,45 +134,17 @@ bool Molecule::removeAtom(Index index)
   // Unique ID of an atom that was removed:
   m_atomUniqueIds[uniqueId] = MaxIndex;
 
-  // Before removing the atom we must first remove any bonds to it.
-  Core::Array<BondType> atomBonds = Core::Molecule::bonds(atom(index));
-  while (atomBonds.size()) {
-    removeBond(atomBonds.back());
-    atomBonds = Core::Molecule::bonds(atom(index));
-  }
-
+  // The last atom will be moved into this position, update its unique ID.
   Index newSize = static_cast<Index>(m_atomicNumbers.size() - 1);
   if (index != newSize) {
-    // We need to move the last atom to this position, and update its unique ID.
-    m_atomicNumbers[index] = m_atomicNumbers.back();
-    if (m_positions2d.size() == m_atomicNumbers.size())
-      m_positions2d[index] = m_positions2d.back();
-    if (m_positions3d.size() == m_atomicNumbers.size())
-      m_positions3d[index] = m_positions3d.back();
-
-    // Find any bonds to the moved atom and update their index.
-    atomBonds = Core::Molecule::bonds(atom(newSize));
-    foreach (const BondType& currentBond, atomBonds) {
-      std::pair<Index, Index> pair = m_bondPairs[currentBond.index()];
-      if (pair.first == newSize)
-        pair.first = index;
-      else if (pair.second == newSize)
-        pair.second = index;
-      m_bondPairs[currentBond.index()] = pair;
-    }
-
     Index movedAtomUID = findAtomUniqueId(newSize);
     assert(movedAtomUID != MaxIndex);
     m_atomUniqueIds[movedAtomUID] = index;
   }
-  // Resize the arrays for the smaller molecule.
-  if (m_positions2d.size() == m_atomicNumbers.size())
-    m_positions2d.resize(newSize);
-  if (m_positions3d.size() == m_atomicNumbers.size())
-    m_positions3d.resize(newSize);
-  m_atomicNumbers.resize(newSize);
-
-  return true;
+
+  // The base class removes the bonds (through our removeBond, so their unique
+  // IDs are kept up to date) and compacts the atom arrays and bond index.
+  return Core::Molecule::removeAtom(index);
 }
 
 bool Molecule::removeAtom(const AtomType& atom_)
@@ -159,6 +152,29 @@ bool Molecule::removeAtom(const AtomType& atom_)
   return removeAtom(atom_.index());
 }
 
+bool Molecule::removeAtoms(const std::vector<Index>& indices)
+{
+  std::vector<bool> removed(atomCount(), false);
+  for (std::vector<Index>::const_iterator it = indices.begin(),
+                                          itEnd = indices.end();
+       it != itEnd; ++it) {
+    if (*it >= atomCount())
+      return false;
+    removed[*it] = true;
+  }
+
+  // Any bonds to the removed atoms are removed with them.
+  std::vector<bool> removedBonds(bondCount(), false);
+  for (Index i = 0; i < bondCount(); ++i) {
+    std::pair<Index, Index> pair = bondPair(i);
+    removedBonds[i] = removed[pair.first] || removed[pair.second];
+  }
+
+  remapUniqueIds(m_atomUniqueIds, removed);
+  remapUniqueIds(m_bondUniqueIds, removedBonds);
+  return Core::Molecule::removeAtoms(indices);
+}
+
 Molecule::AtomType Molecule::atomByUniqueId(Index uniqueId)
 {
   if (uniqueId >= static_cast<Index>(m_atomUniqueIds.size()) ||
@@ -224,20 +240,13 @@ bool Molecule::removeBond(Index index)
 
   Index newSize = static_cast<Index>(m_bondOrders.size() - 1);
   if (index != newSize) {
-    // We need to move the last bond to this position, and update its unique ID.
-    m_bondOrders[index] = m_bondOrders.back();
-    m_bondPairs[index] = m_bondPairs.back();
-
+    // The last bond will be moved into this position, update its unique ID.
     Index movedBondUID = findBondUniqueId(newSize);
     assert(movedBondUID != MaxIndex);
     m_bondUniqueIds[movedBondUID] = index;
   }
 
-  // Resize the arrays for the smaller molecule.
-  m_bondOrders.resize(newSize);
-  m_bondPairs.resize(newSize);
-
-  return true;
+  return Core::Molecule::removeBond(index);
 }
 
 bool Molecule::removeBond(const BondType& bond_)
@@ -255,6 +264,21 @@ bool Molecule::removeBond(Index a, Index b)
   return removeBond(bond(a, b).index());
 }
 
+bool Molecule::removeBonds(const std::vector<Index>& indices)
+{
+  std::vector<bool> removed(bondCount(), false);
+  for (std::vector<Index>::const_iterator it = indices.begin(),
+                                          itEnd = indices.end();
+       it != itEnd; ++it) {
+    if (*it >= bondCount())
+      return false;
+    removed[*it] = true;
+  }
+
+  remapUniqueIds(m_bondUniqueIds, removed);
+  return Core::Molecule::removeBonds(indices);
+}
+
 Molecule::BondType Molecule::bondByUniqueId(Index uniqueId)
 {
   if (uniqueId >= static_cast<Index>(m_bondUniqueIds.size()) ||
@@ -81,9 +81,17 @@ public:
     Bonds = 0x02,
     UnitCell = 0x04,
     /** Operations that can affect the above types. */
-    Added = 0x1024,
-    Removed = 0x2048,
-    Modified = 0x4096
+    Added = 0x400,
+    Removed = 0x800,
+    Modified = 0x1000,
+    /**
+     * Narrower descriptions of a change to the atoms, which lets views update
+     * in place rather than build everything again. Positions goes with
+     * Modified when only atom positions changed, and Selection when only the
+     * selected atoms changed.
+     */
+    Positions = 0x2000,
+    Selection = 0x4000
   };
   Q_DECLARE_FLAGS(MoleculeChanges, MoleculeChange)
 
@@ -115,6 +123,15 @@ public:
    */
   bool removeAtom(const AtomType& atom) override;
 
+  /**
+   * @brief Remove several atoms from the molecule in a single pass.
+   * @param indices The indices of the atoms to be removed.
+   * @return True on success, false if any index is out of range.
+   * @note The unique IDs of the remaining atoms and bonds are updated in the
+   * same pass.
+   */
+  bool removeAtoms(const std::vector<Index>& indices) override;
+
   /**
    * @brief Get the atom referenced by the @p uniqueId, the isValid method
    * should be queried to ensure the id still referenced a valid atom.
@@ -196,6 +213,13 @@ public:
   bool removeBond(Index atom1, Index atom2) override;
   /** @} */
 
+  /**
+   * @brief Remove several bonds from the molecule in a single pass.
+   * @param indices The indices of the bonds to be removed.
+   * @return True on success, false if any index is out of range.
+   */
+  bool removeBonds(const std::vector<Index>& indices) override;
+
   /**
    * @brief Get the bond referenced by the @p uniqueId, the isValid method
    * should be queried to ensure the id still referenced a valid bond.
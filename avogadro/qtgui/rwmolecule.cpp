@@ -54,6 +54,7 @@ protected:
   {
     return m_mol.m_molecule.atomicNumbers();
   }
+  Array<Vector2>& positions2d() { return m_mol.m_molecule.atomPositions2d(); }
   Array<Vector3>& positions3d() { return m_mol.m_molecule.atomPositions3d(); }
   Array<AtomHybridization>& hybridizations()
   {
@@ -293,13 +294,232 @@ bool RWMolecule::removeAtom(Index atomId)
   return true;
 }
 
+namespace {
+// The entries of values at the sorted ids, or nothing if the array is not in
+// use (i.e. it does not have an entry for every atom or bond).
+template <typename T>
+Array<T> takeEntries(const Array<T>& values, const std::vector<Index>& ids,
+                     Index count)
+{
+  Array<T> entries;
+  if (values.size() != count)
+    return entries;
+  entries.reserve(ids.size());
+  for (std::vector<Index>::const_iterator it = ids.begin(), itEnd = ids.end();
+       it != itEnd; ++it) {
+    entries.push_back(values[*it]);
+  }
+  return entries;
+}
+
+// Merge entries taken with takeEntries back in at their original indices.
+template <typename T>
+void restoreEntries(Array<T>& values, const std::vector<Index>& ids,
+                    const Array<T>& entries)
+{
+  if (ids.empty() || entries.size() != ids.size())
+    return;
+  const Array<T>& remaining = values;
+  Array<T> merged;
+  merged.reserve(remaining.size() + ids.size());
+  Index next = 0;
+  size_t k = 0;
+  for (Index i = 0; i < remaining.size() + ids.size(); ++i) {
+    if (k < ids.size() && ids[k] == i)
+      merged.push_back(entries[k++]);
+    else
+      merged.push_back(remaining[next++]);
+  }
+  values.swap(merged);
+}
+
+// Unique ids of the entries at ids, found in a single pass over the map.
+std::vector<Index> uniqueIdsOf(const Array<Index>& uniqueIds,
+                               const std::vector<Index>& ids, Index count)
+{
+  std::vector<Index> uidOf(count, MaxIndex);
+  for (Index uid = 0; uid < uniqueIds.size(); ++uid) {
+    if (uniqueIds[uid] < count)
+      uidOf[uniqueIds[uid]] = uid;
+  }
+  std::vector<Index> result;
+  result.reserve(ids.size());
+  for (std::vector<Index>::const_iterator it = ids.begin(), itEnd = ids.end();
+       it != itEnd; ++it) {
+    result.push_back(uidOf[*it]);
+  }
+  return result;
+}
+
+// Index each of the remaining entries had before the sorted ids were removed.
+std::vector<Index> indicesBeforeRemoval(Index remaining,
+                                        const std::vector<Index>& ids)
+{
+  std::vector<Index> oldIndex(remaining);
+  Index old = 0;
+  size_t k = 0;
+  for (Index i = 0; i < remaining; ++i, ++old) {
+    while (k < ids.size() && ids[k] == old) {
+      ++k;
+      ++old;
+    }
+    oldIndex[i] = old;
+  }
+  return oldIndex;
+}
+
+// Removes a batch of atoms and bonds in one go. Only the removed entries are
+// stored, undo merges them back in between the remaining ones.
+class RemoveAtomsCommand : public RWMolecule::UndoCommand
+{
+  std::vector<Index> m_atomIds;
+  std::vector<Index> m_atomUids;
+  Array<unsigned char> m_atomicNumbers;
+  Array<Vector2> m_positions2d;
+  Array<Vector3> m_positions3d;
+  Array<AtomHybridization> m_hybridizations;
+  Array<signed char> m_formalCharges;
+  Array<Vector3> m_forceVectors;
+  std::vector<bool> m_selected;
+
+  std::vector<Index> m_bondIds;
+  std::vector<Index> m_bondUids;
+  Array<std::pair<Index, Index>> m_bondPairs;
+  Array<unsigned char> m_bondOrders;
+
+public:
+  // Both id lists must be sorted, and bondIds must include every bond to the
+  // removed atoms.
+  RemoveAtomsCommand(RWMolecule& m, const std::vector<Index>& atomIds,
+                     const std::vector<Index>& bondIds)
+    : UndoCommand(m), m_atomIds(atomIds), m_bondIds(bondIds)
+  {
+    const Molecule& mol = m.molecule();
+    Index atoms = mol.atomCount();
+    m_atomUids = uniqueIdsOf(atomUniqueIds(), m_atomIds, atoms);
+    m_atomicNumbers = takeEntries(mol.atomicNumbers(), m_atomIds, atoms);
+    m_positions2d = takeEntries(mol.atomPositions2d(), m_atomIds, atoms);
+    m_positions3d = takeEntries(mol.atomPositions3d(), m_atomIds, atoms);
+    m_hybridizations = takeEntries(mol.hybridizations(), m_atomIds, atoms);
+    m_formalCharges = takeEntries(mol.formalCharges(), m_atomIds, atoms);
+    m_forceVectors = takeEntries(mol.forceVectors(), m_atomIds, atoms);
+    m_selected.reserve(m_atomIds.size());
+    for (size_t k = 0; k < m_atomIds.size(); ++k)
+      m_selected.push_back(mol.atomSelected(m_atomIds[k]));
+
+    Index bonds = mol.bondCount();
+    m_bondUids = uniqueIdsOf(bondUniqueIds(), m_bondIds, bonds);
+    m_bondPairs = takeEntries(mol.bondPairs(), m_bondIds, bonds);
+    m_bondOrders = takeEntries(mol.bondOrders(), m_bondIds, bonds);
+  }
+
+  void redo() override
+  {
+    // Bonds first, so no remaining bond refers to a removed atom.
+    if (!m_bondIds.empty())
+      m_mol.molecule().removeBonds(m_bondIds);
+    if (!m_atomIds.empty())
+      m_mol.molecule().removeAtoms(m_atomIds);
+  }
+
+  void undo() override
+  {
+    Molecule& mol = m_mol.molecule();
+    if (!m_atomIds.empty()) {
+      std::vector<Index> oldIndex =
+        indicesBeforeRemoval(mol.atomCount(), m_atomIds);
+
+      // The remaining bonds and unique ids refer to the compacted indices.
+      Array<std::pair<Index, Index>>& pairs = bondPairs();
+      for (Index i = 0; i < pairs.size(); ++i) {
+        pairs[i].first = oldIndex[pairs[i].first];
+        pairs[i].second = oldIndex[pairs[i].second];
+      }
+      Array<Index>& uids = atomUniqueIds();
+      for (Index uid = 0; uid < uids.size(); ++uid) {
+        if (uids[uid] < oldIndex.size())
+          uids[uid] = oldIndex[uids[uid]];
+      }
+      for (size_t k = 0; k < m_atomIds.size(); ++k) {
+        if (m_atomUids[k] != MaxIndex)
+          uids[m_atomUids[k]] = m_atomIds[k];
+      }
+
+      std::vector<bool> selected(oldIndex.size());
+      for (Index i = 0; i < oldIndex.size(); ++i)
+        selected[i] = mol.atomSelected(i);
+
+      restoreEntries(atomicNumbers(), m_atomIds, m_atomicNumbers);
+      restoreEntries(positions2d(), m_atomIds, m_positions2d);
+      restoreEntries(positions3d(), m_atomIds, m_positions3d);
+      restoreEntries(hybridizations(), m_atomIds, m_hybridizations);
+      restoreEntries(formalCharges(), m_atomIds, m_formalCharges);
+      restoreEntries(forceVectors(), m_atomIds, m_forceVectors);
+
+      for (Index i = 0; i < oldIndex.size(); ++i)
+        mol.setAtomSelected(oldIndex[i], selected[i]);
+      for (size_t k = 0; k < m_atomIds.size(); ++k)
+        mol.setAtomSelected(m_atomIds[k], m_selected[k]);
+    }
+
+    if (!m_bondIds.empty()) {
+      std::vector<Index> oldIndex =
+        indicesBeforeRemoval(mol.bondCount(), m_bondIds);
+      Array<Index>& uids = bondUniqueIds();
+      for (Index uid = 0; uid < uids.size(); ++uid) {
+        if (uids[uid] < oldIndex.size())
+          uids[uid] = oldIndex[uids[uid]];
+      }
+      for (size_t k = 0; k < m_bondIds.size(); ++k) {
+        if (m_bondUids[k] != MaxIndex)
+          uids[m_bondUids[k]] = m_bondIds[k];
+      }
+
+      restoreEntries(bondPairs(), m_bondIds, m_bondPairs);
+      restoreEntries(bondOrders(), m_bondIds, m_bondOrders);
+    }
+  }
+};
+} // namespace
+
+bool RWMolecule::removeAtoms(const std::vector<Index>& atomIds)
+{
+  std::vector<Index> ids(atomIds);
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  if (ids.empty() || ids.back() >= atomCount())
+    return false;
+
+  // Every bond to one of the atoms is removed along with it.
+  std::vector<bool> removed(atomCount(), false);
+  for (std::vector<Index>::const_iterator it = ids.begin(), itEnd = ids.end();
+       it != itEnd; ++it) {
+    removed[*it] = true;
+  }
+  std::vector<Index> bondIds;
+  const Array<std::pair<Index, Index>>& pairs = bondPairs();
+  for (Index i = 0; i < pairs.size(); ++i) {
+    if (removed[pairs[i].first] || removed[pairs[i].second])
+      bondIds.push_back(i);
+  }
+
+  RemoveAtomsCommand* comm = new RemoveAtomsCommand(*this, ids, bondIds);
+  comm->setText(tr("Remove Atoms"));
+  m_undoStack.push(comm);
+  return true;
+}
+
 void RWMolecule::clearAtoms()
 {
-  m_undoStack.beginMacro(tr("Clear Atoms"));
+  if (atomCount() == 0)
+    return;
 
-  while (atomCount() != 0)
-    removeAtom(0);
+  std::vector<Index> ids(atomCount());
+  for (Index i = 0; i < ids.size(); ++i)
+    ids[i] = i;
 
+  m_undoStack.beginMacro(tr("Clear Atoms"));
+  removeAtoms(ids);
   m_undoStack.endMacro();
 }
 
@@ -742,13 +962,32 @@ bool RWMolecule::removeBond(Index bondId)
   return true;
 }
 
+bool RWMolecule::removeBonds(const std::vector<Index>& bondIds)
+{
+  std::vector<Index> ids(bondIds);
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  if (ids.empty() || ids.back() >= bondCount())
+    return false;
+
+  RemoveAtomsCommand* comm =
+    new RemoveAtomsCommand(*this, std::vector<Index>(), ids);
+  comm->setText(tr("Remove Bonds"));
+  m_undoStack.push(comm);
+  return true;
+}
+
 void RWMolecule::clearBonds()
 {
-  m_undoStack.beginMacro(tr("Clear Bonds"));
+  if (bondCount() == 0)
+    return;
 
-  while (bondCount() != 0)
-    removeBond(0);
+  std::vector<Index> ids(bondCount());
+  for (Index i = 0; i < ids.size(); ++i)
+    ids[i] = i;
 
+  m_undoStack.beginMacro(tr("Clear Bonds"));
+  removeBonds(ids);
   m_undoStack.endMacro();
 }
 
@@ -1076,7 +1315,8 @@ void RWMolecule::wrapAtomsToCell()
   comm->setText(tr("Wrap Atoms to Cell"));
   m_undoStack.push(comm);
 
-  Molecule::MoleculeChanges changes = Molecule::Atoms | Molecule::Modified;
+  Molecule::MoleculeChanges changes =
+    Molecule::Atoms | Molecule::Modified | Molecule::Positions;
   emitChanged(changes);
 }
 
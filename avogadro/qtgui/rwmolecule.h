@@ -149,6 +149,16 @@ public:
   bool removeAtom(const AtomType& atom);
   /** @} */
 
+  /**
+   * Delete several atoms from this molecule as a single undo command.
+   * @param atomIds The indices of the atoms to remove, in any order.
+   * @return True on success, false if @a atomIds is empty or contains an
+   * invalid index.
+   * @note This also removes all bonds connected to the atoms. Unlike
+   * removeAtom(), the remaining atoms keep their relative order.
+   */
+  bool removeAtoms(const std::vector<Index>& atomIds);
+
   /**
    * Delete all atoms from this molecule.
    * @note This also removes all bonds.
@@ -362,6 +372,15 @@ public:
   bool removeBond(const AtomType& atom1, const AtomType& atom2);
   /** @} */
 
+  /**
+   * Remove several bonds as a single undo command.
+   * @param bondIds The indices of the bonds to remove, in any order.
+   * @return True on success, false if @a bondIds is empty or contains an
+   * invalid index.
+   * @note Unlike removeBond(), the remaining bonds keep their relative order.
+   */
+  bool removeBonds(const std::vector<Index>& bondIds);
+
   /**
    * Remove all bonds from the molecule.
    */
@@ -803,11 +822,12 @@ inline Core::Array<RWMolecule::BondType> RWMolecule::bonds(
 inline Core::Array<RWMolecule::BondType> RWMolecule::bonds(
   const Index& atomId) const
 {
+  Core::Array<Molecule::BondType> atomBonds = m_molecule.bonds(atomId);
   Core::Array<RWMolecule::BondType> result;
-  for (Index i = 0; i < m_molecule.m_bondPairs.size(); ++i)
-    if (m_molecule.m_bondPairs[i].first == atomId ||
-        m_molecule.m_bondPairs[i].second == atomId)
-      result.push_back(BondType(const_cast<RWMolecule*>(this), i));
+  result.reserve(atomBonds.size());
+  for (Index i = 0; i < atomBonds.size(); ++i)
+    result.push_back(
+      BondType(const_cast<RWMolecule*>(this), atomBonds[i].index()));
   return result;
 }
 
@@ -823,7 +843,7 @@ inline unsigned char RWMolecule::bondOrder(Index bondId) const
 
 inline const Core::Array<std::pair<Index, Index>>& RWMolecule::bondPairs() const
 {
-  return m_molecule.bondPairs();
+  return molecule().bondPairs();
 }
 
 inline std::pair<Index, Index> RWMolecule::bondPair(Index bondId) const
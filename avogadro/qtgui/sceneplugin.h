@@ -60,6 +60,19 @@ public:
   virtual void processEditable(const RWMolecule& molecule,
                                Rendering::GroupNode& node);
 
+  /**
+   * Update the primitives process() added to @p node in place after
+   * @p molecule changed. @p changes is a combination of
+   * Molecule::MoleculeChange flags, and the atoms and bonds are the same ones
+   * process() saw. This is called for position and selection changes, so
+   * plugins that can avoid building their primitives again should.
+   * @return True if the primitives were updated, false if process() must be
+   * called on a new node instead, which is what the default implementation
+   * asks for.
+   */
+  virtual bool processChanges(const Core::Molecule& molecule,
+                              Rendering::GroupNode& node, unsigned int changes);
+
   /**
    * The name of the scene plugin, will be displayed in the user interface.
    */
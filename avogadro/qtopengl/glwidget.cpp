@@ -37,7 +37,7 @@ namespace QtOpenGL {
 
 GLWidget::GLWidget(QWidget* p)
   : QOpenGLWidget(p), m_activeTool(nullptr), m_defaultTool(nullptr),
-    m_renderTimer(nullptr)
+    m_renderTimer(nullptr), m_errorsPrinted(0)
 {
   setFocusPolicy(Qt::ClickFocus);
   connect(&m_scenePlugins,
@@ -49,6 +49,10 @@ GLWidget::GLWidget(QWidget* p)
 
 GLWidget::~GLWidget()
 {
+  // The shader programs must be deleted in the context they were built in.
+  makeCurrent();
+  m_renderer.finalize();
+  doneCurrent();
 }
 
 void GLWidget::setMolecule(QtGui::Molecule* mol)
@@ -59,7 +63,8 @@ void GLWidget::setMolecule(QtGui::Molecule* mol)
   m_molecule = mol;
   foreach (QtGui::ToolPlugin* tool, m_tools)
     tool->setMolecule(m_molecule);
-  connect(m_molecule, SIGNAL(changed(unsigned int)), SLOT(updateScene()));
+  connect(m_molecule, SIGNAL(changed(unsigned int)),
+          SLOT(moleculeChanged(unsigned int)));
 }
 
 QtGui::Molecule* GLWidget::molecule()
@@ -74,6 +79,9 @@ const QtGui::Molecule* GLWidget::molecule() const
 
 void GLWidget::updateScene()
 {
+  m_pluginNodes.clear();
+  m_toolNodes.clear();
+
   // Build up the scene with the scene plugins, creating the appropriate nodes.
   QtGui::Molecule* mol = m_molecule;
   if (!mol)
@@ -87,28 +95,81 @@ void GLWidget::updateScene()
              m_scenePlugins.activeScenePlugins()) {
       Rendering::GroupNode* engineNode = new Rendering::GroupNode(moleculeNode);
       scenePlugin->process(*mol, *engineNode);
+      m_pluginNodes.append(qMakePair(scenePlugin, engineNode));
     }
 
     // Let the tools perform any drawing they need to do.
     if (m_activeTool) {
       Rendering::GroupNode* toolNode = new Rendering::GroupNode(moleculeNode);
       m_activeTool->draw(*toolNode);
+      m_toolNodes.append(qMakePair(m_activeTool, toolNode));
     }
 
     if (m_defaultTool) {
       Rendering::GroupNode* toolNode = new Rendering::GroupNode(moleculeNode);
       m_defaultTool->draw(*toolNode);
+      m_toolNodes.append(qMakePair(m_defaultTool, toolNode));
     }
 
     m_renderer.resetGeometry();
     update();
   }
-  if (mol != m_molecule)
+  if (mol != m_molecule) {
+    // The nodes were made for a molecule that is about to go away.
+    m_pluginNodes.clear();
+    m_toolNodes.clear();
     delete mol;
+  }
+}
+
+void GLWidget::moleculeChanged(unsigned int c)
+{
+  QtGui::Molecule::MoleculeChanges changes =
+    static_cast<QtGui::Molecule::MoleculeChanges>(c);
+
+  // Only moved or selected atoms can be updated in place, and only in a scene
+  // made for the same scene plugins and tools.
+  bool inPlace = m_molecule && !m_pluginNodes.isEmpty() &&
+                 changes & (QtGui::Molecule::Positions |
+                            QtGui::Molecule::Selection);
+  QList<QtGui::ScenePlugin*> scenePlugins = m_scenePlugins.activeScenePlugins();
+  inPlace = inPlace && scenePlugins.size() == m_pluginNodes.size();
+  for (int i = 0; inPlace && i < m_pluginNodes.size(); ++i)
+    inPlace = m_pluginNodes[i].first == scenePlugins[i];
+  QList<QtGui::ToolPlugin*> tools;
+  if (m_activeTool)
+    tools.append(m_activeTool);
+  if (m_defaultTool)
+    tools.append(m_defaultTool);
+  inPlace = inPlace && tools.size() == m_toolNodes.size();
+  for (int i = 0; inPlace && i < m_toolNodes.size(); ++i)
+    inPlace = m_toolNodes[i].first == tools[i];
+
+  // Every plugin must manage, or the whole scene is built again.
+  for (int i = 0; inPlace && i < m_pluginNodes.size(); ++i) {
+    inPlace = m_pluginNodes[i].first->processChanges(
+      *m_molecule, *m_pluginNodes[i].second, c);
+  }
+  if (!inPlace) {
+    updateScene();
+    return;
+  }
+
+  // The tools draw little, so they start over.
+  for (int i = 0; i < m_toolNodes.size(); ++i) {
+    m_toolNodes[i].second->clear();
+    m_toolNodes[i].first->draw(*m_toolNodes[i].second);
+  }
+
+  if (changes & QtGui::Molecule::Positions)
+    m_renderer.resetGeometry();
+  update();
 }
 
 void GLWidget::clearScene()
 {
+  m_pluginNodes.clear();
+  m_toolNodes.clear();
   m_renderer.scene().clear();
 }
 
@@ -240,6 +301,13 @@ void GLWidget::resizeGL(int width_, int height_)
 void GLWidget::paintGL()
 {
   m_renderer.render();
+
+  // The renderer keeps each error once, so only the new ones are printed.
+  std::string errors = m_renderer.error();
+  if (errors.size() > m_errorsPrinted) {
+    qWarning("%s", errors.substr(m_errorsPrinted).c_str());
+    m_errorsPrinted = errors.size();
+  }
 }
 
 void GLWidget::mouseDoubleClickEvent(QMouseEvent* e)
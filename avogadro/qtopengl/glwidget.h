@@ -22,6 +22,7 @@
 #include <avogadro/qtgui/scenepluginmodel.h>
 #include <avogadro/rendering/glrenderer.h>
 
+#include <QtCore/QPair>
 #include <QtCore/QPointer>
 #include <QtWidgets/QOpenGLWidget>
 
@@ -31,6 +32,7 @@ namespace Avogadro {
 
 namespace QtGui {
 class Molecule;
+class ScenePlugin;
 class ToolPlugin;
 }
 
@@ -176,6 +178,13 @@ protected slots:
    */
   void updateTimeout();
 
+  /**
+   * Update the scene after the molecule changed. Moved or selected atoms are
+   * updated in place when the scene plugins support it, so that interactive
+   * edits of large molecules do not build the whole scene again.
+   */
+  void moleculeChanged(unsigned int changes);
+
 protected:
   /** This is where the GL context is initialized. */
   void initializeGL() override;
@@ -204,7 +213,15 @@ private:
   Rendering::GLRenderer m_renderer;
   QtGui::ScenePluginModel m_scenePlugins;
 
+  // The nodes made for each scene plugin and tool by updateScene(), which
+  // moleculeChanged() updates in place.
+  QList<QPair<QtGui::ScenePlugin*, Rendering::GroupNode*>> m_pluginNodes;
+  QList<QPair<QtGui::ToolPlugin*, Rendering::GroupNode*>> m_toolNodes;
+
   QTimer* m_renderTimer;
+
+  // How much of the renderer's error() has already been printed.
+  size_t m_errorsPrinted;
 };
 
 } // End QtOpenGL namespace
@@ -48,7 +48,7 @@ bool OpenDxReader::readFile(const QString& fileName)
   Vector3i dim(0, 0, 0);
   Vector3 origin(0, 0, 0);
   QVector<Vector3> spacings;
-  std::vector<double> values;
+  std::vector<float> values;
 
   while (!file.atEnd()) {
     QByteArray line = file.readLine();
@@ -81,7 +81,7 @@ bool OpenDxReader::readFile(const QString& fileName)
     } else {
       // data line
       while (!stream.atEnd()) {
-        double value;
+        float value;
         stream >> value;
         values.push_back(value);
         stream.skipWhiteSpace();
@@ -92,8 +92,10 @@ bool OpenDxReader::readFile(const QString& fileName)
   Vector3 spacing(spacings[0][0], spacings[1][1], spacings[2][2]);
 
   // create potential cube
+  // APBS writes six significant figures, which single precision holds.
   m_cube = new Cube;
   m_cube->setCubeType(Cube::ESP);
+  m_cube->setPrecision(Cube::Float);
   m_cube->setLimits(origin, dim, spacing);
   m_cube->setData(values);
 
@@ -18,6 +18,7 @@
 
 #include <avogadro/core/elements.h>
 #include <avogadro/core/molecule.h>
+#include <avogadro/qtgui/molecule.h>
 #include <avogadro/qtgui/rwmolecule.h>
 #include <avogadro/rendering/cylindergeometry.h>
 #include <avogadro/rendering/geometrynode.h>
@@ -36,10 +37,11 @@ namespace QtPlugins {
 
 using Core::Elements;
 using Core::Molecule;
+using Rendering::CylinderColor;
+using Rendering::CylinderGeometry;
 using Rendering::GeometryNode;
 using Rendering::GroupNode;
 using Rendering::SphereGeometry;
-using Rendering::CylinderGeometry;
 
 BallAndStick::BallAndStick(QObject* p)
   : ScenePlugin(p), m_enabled(true), m_group(nullptr), m_setupWidget(nullptr),
@@ -66,56 +68,133 @@ void BallAndStick::process(const Molecule& molecule, Rendering::GroupNode& node)
 
   for (Index i = 0; i < molecule.atomCount(); ++i) {
     Core::Atom atom = molecule.atom(i);
-    unsigned char atomicNumber = atom.atomicNumber();
-    if (atomicNumber == 1 && !m_showHydrogens)
+    if (atom.atomicNumber() == 1 && !m_showHydrogens)
       continue;
-    const unsigned char* c = Elements::color(atomicNumber);
-    Vector3ub color(c[0], c[1], c[2]);
-    float radius = static_cast<float>(Elements::radiusVDW(atomicNumber));
-    if (atom.selected()) {
-      color = Vector3ub(0, 0, 255);
-      radius *= 1.2;
-    }
-    spheres->addSphere(atom.position3d().cast<float>(), color, radius * 0.3f);
+    Vector3ub color;
+    float radius;
+    atomStyle(atom, color, radius);
+    spheres->addSphere(atom.position3d().cast<float>(), color, radius);
   }
 
-  float bondRadius = 0.1f;
   CylinderGeometry* cylinders = new CylinderGeometry;
   cylinders->identifier().molecule = &molecule;
   cylinders->identifier().type = Rendering::BondType;
   geometry->addDrawable(cylinders);
+  std::vector<CylinderColor> bondCylinders;
   for (Index i = 0; i < molecule.bondCount(); ++i) {
-    Core::Bond bond = molecule.bond(i);
-    if (!m_showHydrogens && (bond.atom1().atomicNumber() == 1 ||
-                             bond.atom2().atomicNumber() == 1)) {
+    bondCylinders.clear();
+    addBondCylinders(molecule.bond(i), bondCylinders);
+    for (size_t j = 0; j < bondCylinders.size(); ++j) {
+      const CylinderColor& c = bondCylinders[j];
+      cylinders->addCylinder(c.end1, c.end2, c.radius, c.color, c.color2, i);
+    }
+  }
+}
+
+bool BallAndStick::processChanges(const Molecule& molecule,
+                                  Rendering::GroupNode& node,
+                                  unsigned int changes)
+{
+  // Moving or selecting atoms keeps the same primitives, anything else may
+  // add or remove some.
+  if (!(changes & (QtGui::Molecule::Positions | QtGui::Molecule::Selection)) ||
+      changes & (QtGui::Molecule::Added | QtGui::Molecule::Removed |
+                 QtGui::Molecule::Bonds)) {
+    return false;
+  }
+
+  GeometryNode* geometry =
+    node.childCount() == 1 ? dynamic_cast<GeometryNode*>(node.child(0))
+                           : nullptr;
+  if (!geometry || geometry->drawables().size() != 2)
+    return false;
+  SphereGeometry* spheres =
+    dynamic_cast<SphereGeometry*>(geometry->drawable(0));
+  CylinderGeometry* cylinders =
+    dynamic_cast<CylinderGeometry*>(geometry->drawable(1));
+  if (!spheres || !cylinders || spheres->identifier().molecule != &molecule)
+    return false;
+
+  size_t sphere = 0;
+  for (Index i = 0; i < molecule.atomCount(); ++i) {
+    Core::Atom atom = molecule.atom(i);
+    if (atom.atomicNumber() == 1 && !m_showHydrogens)
       continue;
+    if (sphere == spheres->size())
+      return false;
+    Vector3ub color;
+    float radius;
+    atomStyle(atom, color, radius);
+    spheres->setSphere(sphere++, atom.position3d().cast<float>(), color,
+                       radius);
+  }
+  if (sphere != spheres->size())
+    return false;
+
+  // The bonds only need to follow the atoms they join.
+  if (changes & QtGui::Molecule::Positions) {
+    std::vector<CylinderColor> bondCylinders;
+    bondCylinders.reserve(cylinders->size());
+    for (Index i = 0; i < molecule.bondCount(); ++i)
+      addBondCylinders(molecule.bond(i), bondCylinders);
+    if (bondCylinders.size() != cylinders->size())
+      return false;
+    for (size_t i = 0; i < bondCylinders.size(); ++i) {
+      const CylinderColor& c = bondCylinders[i];
+      cylinders->setCylinder(i, c.end1, c.end2, c.radius, c.color, c.color2);
     }
-    Vector3f pos1 = bond.atom1().position3d().cast<float>();
-    Vector3f pos2 = bond.atom2().position3d().cast<float>();
-    Vector3ub color1(Elements::color(bond.atom1().atomicNumber()));
-    Vector3ub color2(Elements::color(bond.atom2().atomicNumber()));
-    Vector3f bondVector = pos2 - pos1;
-    float bondLength = bondVector.norm();
-    bondVector /= bondLength;
-    switch (m_multiBonds ? bond.order() : 1) {
-      case 3: {
-        Vector3f delta = bondVector.unitOrthogonal() * (2.0f * bondRadius);
-        cylinders->addCylinder(pos1 + delta, pos2 + delta, bondRadius, color1,
-                               color2, i);
-        cylinders->addCylinder(pos1 - delta, pos2 - delta, bondRadius, color1,
-                               color2, i);
-      }
-      default:
-      case 1:
-        cylinders->addCylinder(pos1, pos2, bondRadius, color1, color2, i);
-        break;
-      case 2: {
-        Vector3f delta = bondVector.unitOrthogonal() * bondRadius;
-        cylinders->addCylinder(pos1 + delta, pos2 + delta, bondRadius, color1,
-                               color2, i);
-        cylinders->addCylinder(pos1 - delta, pos2 - delta, bondRadius, color1,
-                               color2, i);
-      }
+  }
+  return true;
+}
+
+void BallAndStick::atomStyle(const Core::Atom& atom, Vector3ub& color,
+                             float& radius) const
+{
+  unsigned char atomicNumber = atom.atomicNumber();
+  const unsigned char* c = Elements::color(atomicNumber);
+  color = Vector3ub(c[0], c[1], c[2]);
+  radius = static_cast<float>(Elements::radiusVDW(atomicNumber));
+  if (atom.selected()) {
+    color = Vector3ub(0, 0, 255);
+    radius *= 1.2;
+  }
+  radius *= 0.3f;
+}
+
+void BallAndStick::addBondCylinders(
+  const Core::Bond& bond, std::vector<CylinderColor>& cylinders) const
+{
+  if (!m_showHydrogens &&
+      (bond.atom1().atomicNumber() == 1 || bond.atom2().atomicNumber() == 1)) {
+    return;
+  }
+  float bondRadius = 0.1f;
+  Vector3f pos1 = bond.atom1().position3d().cast<float>();
+  Vector3f pos2 = bond.atom2().position3d().cast<float>();
+  Vector3ub color1(Elements::color(bond.atom1().atomicNumber()));
+  Vector3ub color2(Elements::color(bond.atom2().atomicNumber()));
+  Vector3f bondVector = pos2 - pos1;
+  float bondLength = bondVector.norm();
+  bondVector /= bondLength;
+  switch (m_multiBonds ? bond.order() : 1) {
+    case 3: {
+      Vector3f delta = bondVector.unitOrthogonal() * (2.0f * bondRadius);
+      cylinders.push_back(CylinderColor(pos1 + delta, pos2 + delta, bondRadius,
+                                        color1, color2));
+      cylinders.push_back(CylinderColor(pos1 - delta, pos2 - delta, bondRadius,
+                                        color1, color2));
+    }
+    default:
+    case 1:
+      cylinders.push_back(
+        CylinderColor(pos1, pos2, bondRadius, color1, color2));
+      break;
+    case 2: {
+      Vector3f delta = bondVector.unitOrthogonal() * bondRadius;
+      cylinders.push_back(CylinderColor(pos1 + delta, pos2 + delta, bondRadius,
+                                        color1, color2));
+      cylinders.push_back(CylinderColor(pos1 - delta, pos2 - delta, bondRadius,
+                                        color1, color2));
     }
   }
 }
@@ -19,7 +19,21 @@
 
 #include <avogadro/qtgui/sceneplugin.h>
 
+#include <avogadro/core/vector.h>
+
+#include <vector>
+
 namespace Avogadro {
+
+namespace Core {
+class Atom;
+class Bond;
+}
+
+namespace Rendering {
+struct CylinderColor;
+}
+
 namespace QtPlugins {
 
 /**
@@ -40,6 +54,10 @@ public:
   void processEditable(const QtGui::RWMolecule& molecule,
                        Rendering::GroupNode& node) override;
 
+  bool processChanges(const Core::Molecule& molecule,
+                      Rendering::GroupNode& node,
+                      unsigned int changes) override;
+
   QString name() const override { return tr("Ball and Stick"); }
 
   QString description() const override
@@ -58,6 +76,13 @@ private slots:
   void showHydrogens(bool show);
 
 private:
+  // The color and radius of the sphere drawn for @a atom.
+  void atomStyle(const Core::Atom& atom, Vector3ub& color,
+                 float& radius) const;
+  // Append the cylinders drawn for @a bond, if it is shown.
+  void addBondCylinders(const Core::Bond& bond,
+                        std::vector<Rendering::CylinderColor>& cylinders) const;
+
   bool m_enabled;
 
   Rendering::GroupNode* m_group;
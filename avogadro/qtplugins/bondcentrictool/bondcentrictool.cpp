@@ -719,7 +719,8 @@ QUndoCommand* BondCentricTool::rotateBondedAtom(QMouseEvent* e)
   // Perform transformation
   transformFragment();
   updateBondVector();
-  m_molecule->emitChanged(Molecule::Modified | Molecule::Atoms);
+  m_molecule->emitChanged(Molecule::Modified | Molecule::Atoms |
+                          Molecule::Positions);
   emit drawablesChanged();
 
   m_lastDragPoint = e->pos();
@@ -764,7 +765,8 @@ QUndoCommand* BondCentricTool::adjustBondLength(QMouseEvent* e)
 
   // Perform transformation
   transformFragment();
-  m_molecule->emitChanged(QtGui::Molecule::Modified | QtGui::Molecule::Atoms);
+  m_molecule->emitChanged(QtGui::Molecule::Modified | QtGui::Molecule::Atoms |
+                          QtGui::Molecule::Positions);
   emit drawablesChanged();
 
   m_lastDragPoint = e->pos();
@@ -830,7 +832,8 @@ QUndoCommand* BondCentricTool::rotateNeighborAtom(QMouseEvent* e)
   // Perform transformation
   transformFragment();
   updateBondVector();
-  m_molecule->emitChanged(QtGui::Molecule::Modified | QtGui::Molecule::Atoms);
+  m_molecule->emitChanged(QtGui::Molecule::Modified | QtGui::Molecule::Atoms |
+                          QtGui::Molecule::Positions);
   emit drawablesChanged();
 
   m_lastDragPoint = e->pos();
@@ -17,12 +17,14 @@
 #include "bonding.h"
 
 #include <avogadro/core/elements.h>
+#include <avogadro/core/neighborperceiver.h>
 #include <avogadro/qtgui/molecule.h>
 
 #include <QtCore/QSettings>
 #include <QtWidgets/QAction>
 #include <QtWidgets/QDialog>
 
+#include <algorithm>
 #include <vector>
 
 #include "ui_bondingdialog.h"
@@ -105,7 +107,8 @@ void Bonding::setValues()
 void Bonding::bond()
 {
   // Yes, this is largely reproduced from Core::Molecule::perceiveBondsSimple
-  //  .. but that class doesn't know about selections
+  //  .. but that class doesn't know about selections. Both share the same
+  //  Core::NeighborPerceiver grid to avoid comparing every pair of atoms.
   if (!m_molecule)
     return;
 
@@ -115,43 +118,52 @@ void Bonding::bond()
 
   // cache atomic radii
   std::vector<double> radii(m_molecule->atomCount());
+  double maxRadius = 0.0;
   for (size_t i = 0; i < radii.size(); i++) {
     radii[i] = Elements::radiusCovalent(m_molecule->atomicNumbers()[i]);
     if (radii[i] <= 0.0)
       radii[i] = 0.0;
+    maxRadius = std::max(maxRadius, radii[i]);
   }
 
   bool emptySelection = m_molecule->isSelectionEmpty();
   double minSq = m_minDistance * m_minDistance;
 
-  // Main bond perception loop based on a simple distance metric.
+  const Array<Vector3>& positions = m_molecule->atomPositions3d();
+  const Array<unsigned char>& atomicNumbers = m_molecule->atomicNumbers();
+  Core::NeighborPerceiver perceiver(positions, 2.0 * maxRadius + m_tolerance);
+
+  // Main bond perception loop based on a simple distance metric, only
+  // comparing atoms in neighboring cells of the perceiver's grid.
+  std::vector<std::pair<Index, Index>> pairs;
+  Array<Index> neighbors;
   for (Index i = 0; i < m_molecule->atomCount(); ++i) {
     if (!emptySelection && !m_molecule->atomSelected(i))
       continue;
 
-    Vector3 ipos = m_molecule->atomPositions3d()[i];
-    for (Index j = i + 1; j < m_molecule->atomCount(); ++j) {
+    const Vector3& ipos = positions[i];
+    perceiver.getNeighborsInclusive(neighbors, ipos);
+    for (Index n = 0; n < neighbors.size(); ++n) {
+      Index j = neighbors[n];
+      if (j <= i)
+        continue;
       if (!emptySelection && !m_molecule->atomSelected(j))
         continue;
-
-      double cutoff = radii[i] + radii[j] + m_tolerance;
-      Vector3 jpos = m_molecule->atomPositions3d()[j];
-      Vector3 diff = jpos - ipos;
-
-      if (std::fabs(diff[0]) > cutoff || std::fabs(diff[1]) > cutoff ||
-          std::fabs(diff[2]) > cutoff ||
-          (m_molecule->atomicNumbers()[i] == 1 &&
-           m_molecule->atomicNumbers()[j] == 1)) {
+      if (atomicNumbers[i] == 1 && atomicNumbers[j] == 1)
         continue;
-      }
 
       // check radius and add bond if needed
-      double cutoffSq = cutoff * cutoff;
-      double diffsq = diff.squaredNorm();
-      if (diffsq < cutoffSq && diffsq > minSq)
-        m_molecule->addBond(m_molecule->atom(i), m_molecule->atom(j), 1);
+      double cutoff = radii[i] + radii[j] + m_tolerance;
+      double diffsq = (positions[j] - ipos).squaredNorm();
+      if (diffsq < cutoff * cutoff && diffsq > minSq)
+        pairs.push_back(std::make_pair(i, j));
     }
   }
+
+  std::sort(pairs.begin(), pairs.end());
+  for (size_t k = 0; k < pairs.size(); ++k)
+    m_molecule->addBond(pairs[k].first, pairs[k].second, 1);
+
   m_molecule->emitChanged(QtGui::Molecule::Bonds);
 }
 
@@ -162,7 +174,7 @@ void Bonding::clearBonds()
   if (m_molecule->isSelectionEmpty())
     m_molecule->clearBonds();
   else {
-    std::vector<size_t> bondIndices;
+    std::vector<Index> bondIndices;
     for (Index i = 0; i < m_molecule->atomCount(); ++i) {
       if (!m_molecule->atomSelected(i))
         continue;
@@ -175,12 +187,9 @@ void Bonding::clearBonds()
       }
     } // end looping through atoms
 
-    // now delete the bonds
-    for (std::vector<size_t>::const_reverse_iterator it = bondIndices.rbegin(),
-                                                     itEnd = bondIndices.rend();
-         it != itEnd; ++it) {
-      m_molecule->removeBond(*it);
-    }
+    // now delete the bonds (a bond between two selected atoms is listed twice)
+    if (!bondIndices.empty())
+      m_molecule->removeBonds(bondIndices);
   } // end else(selected atoms)
   m_molecule->emitChanged(QtGui::Molecule::Bonds);
 }
@@ -18,6 +18,7 @@
 
 #include <avogadro/core/elements.h>
 #include <avogadro/core/molecule.h>
+#include <avogadro/qtgui/molecule.h>
 #include <avogadro/rendering/cylindergeometry.h>
 #include <avogadro/rendering/geometrynode.h>
 #include <avogadro/rendering/groupnode.h>
@@ -77,6 +78,52 @@ void Licorice::process(const Molecule& molecule, Rendering::GroupNode& node)
   }
 }
 
+bool Licorice::processChanges(const Molecule& molecule,
+                              Rendering::GroupNode& node, unsigned int changes)
+{
+  // Moving or selecting atoms keeps the same primitives, anything else may
+  // add or remove some.
+  if (!(changes & (QtGui::Molecule::Positions | QtGui::Molecule::Selection)) ||
+      changes & (QtGui::Molecule::Added | QtGui::Molecule::Removed |
+                 QtGui::Molecule::Bonds)) {
+    return false;
+  }
+
+  GeometryNode* geometry =
+    node.childCount() == 1 ? dynamic_cast<GeometryNode*>(node.child(0))
+                           : nullptr;
+  if (!geometry || geometry->drawables().size() != 2)
+    return false;
+  SphereGeometry* spheres =
+    dynamic_cast<SphereGeometry*>(geometry->drawable(0));
+  CylinderGeometry* cylinders =
+    dynamic_cast<CylinderGeometry*>(geometry->drawable(1));
+  if (!spheres || !cylinders || spheres->identifier().molecule != &molecule ||
+      spheres->size() != molecule.atomCount() ||
+      cylinders->size() != molecule.bondCount()) {
+    return false;
+  }
+
+  // The selection is not shown, so only moved atoms change anything.
+  if (!(changes & QtGui::Molecule::Positions))
+    return true;
+  float radius(0.2f);
+  for (Index i = 0; i < molecule.atomCount(); ++i) {
+    Core::Atom atom = molecule.atom(i);
+    Vector3ub color(Elements::color(atom.atomicNumber()));
+    spheres->setSphere(i, atom.position3d().cast<float>(), color, radius);
+  }
+  for (Index i = 0; i < molecule.bondCount(); ++i) {
+    Core::Bond bond = molecule.bond(i);
+    Vector3ub color1(Elements::color(bond.atom1().atomicNumber()));
+    Vector3ub color2(Elements::color(bond.atom2().atomicNumber()));
+    cylinders->setCylinder(i, bond.atom1().position3d().cast<float>(),
+                           bond.atom2().position3d().cast<float>(), radius,
+                           color1, color2);
+  }
+  return true;
+}
+
 bool Licorice::isEnabled() const
 {
   return m_enabled;
@@ -37,6 +37,10 @@ public:
   void process(const Core::Molecule& molecule,
                Rendering::GroupNode& node) override;
 
+  bool processChanges(const Core::Molecule& molecule,
+                      Rendering::GroupNode& node,
+                      unsigned int changes) override;
+
   QString name() const override { return tr("Licorice"); }
 
   QString description() const override
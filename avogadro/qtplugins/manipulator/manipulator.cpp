@@ -150,7 +150,8 @@ QUndoCommand* Manipulator::mouseMoveEvent(QMouseEvent* e)
     m_lastMouse3D = newPos;
   }
 
-  m_molecule->emitChanged(Molecule::Atoms | Molecule::Modified);
+  m_molecule->emitChanged(Molecule::Atoms | Molecule::Modified |
+                          Molecule::Positions);
   e->accept();
   return nullptr;
 }
@@ -218,11 +218,14 @@ void PlayerTool::animate(int advance)
       m_currentFrame = advance > 0 ? 0 : m_molecule->coordinate3dCount() - 1;
       m_molecule->setCoordinate3d(m_currentFrame);
     }
+    Molecule::MoleculeChanges changes =
+      Molecule::Atoms | Molecule::Modified | Molecule::Positions;
     if (m_dynamicBonding->isChecked()) {
       m_molecule->clearBonds();
       m_molecule->perceiveBondsSimple();
+      changes = Molecule::Atoms | Molecule::Added;
     }
-    m_molecule->emitChanged(Molecule::Atoms | Molecule::Added);
+    m_molecule->emitChanged(changes);
     m_slider->setValue(m_currentFrame);
     m_frameIdx->setValue(m_currentFrame + 1);
   }
@@ -261,11 +264,14 @@ void PlayerTool::recordMovie()
              EXPORT_HEIGHT, 100 / m_animationFPS->value());
     for (int i = 0; i < m_molecule->coordinate3dCount(); ++i) {
       m_molecule->setCoordinate3d(i);
+      Molecule::MoleculeChanges changes =
+        Molecule::Atoms | Molecule::Modified | Molecule::Positions;
       if (bonding) {
         m_molecule->clearBonds();
         m_molecule->perceiveBondsSimple();
+        changes = Molecule::Atoms | Molecule::Modified;
       }
-      m_molecule->emitChanged(Molecule::Atoms | Molecule::Modified);
+      m_molecule->emitChanged(changes);
 
       QImage exportImage;
       m_glWidget->raise();
@@ -304,11 +310,14 @@ void PlayerTool::recordMovie()
                        EXPORT_HEIGHT, "MJPG", m_animationFPS->value(), NULL);
     for (int i = 0; i < m_molecule->coordinate3dCount(); ++i) {
       m_molecule->setCoordinate3d(i);
+      Molecule::MoleculeChanges changes =
+        Molecule::Atoms | Molecule::Modified | Molecule::Positions;
       if (bonding) {
         m_molecule->clearBonds();
         m_molecule->perceiveBondsSimple();
+        changes = Molecule::Atoms | Molecule::Modified;
       }
-      m_molecule->emitChanged(Molecule::Atoms | Molecule::Modified);
+      m_molecule->emitChanged(changes);
 
       QImage exportImage;
       m_glWidget->raise();
@@ -335,11 +344,14 @@ void PlayerTool::recordMovie()
   } else if (selfFilter == tr("Movie (*.mp4)")) {
     for (int i = 0; i < m_molecule->coordinate3dCount(); ++i) {
       m_molecule->setCoordinate3d(i);
+      Molecule::MoleculeChanges changes =
+        Molecule::Atoms | Molecule::Modified | Molecule::Positions;
       if (bonding) {
         m_molecule->clearBonds();
         m_molecule->perceiveBondsSimple();
+        changes = Molecule::Atoms | Molecule::Modified;
       }
-      m_molecule->emitChanged(Molecule::Atoms | Molecule::Modified);
+      m_molecule->emitChanged(changes);
       QString fileName = QString::number(i);
       while (fileName.length() < numberLength)
         fileName.prepend('0');
@@ -137,19 +137,19 @@ void PlotRmsd::displayDialog()
 
 void PlotRmsd::generateRmsdPattern(RmsdData& results)
 {
-  m_molecule->setCoordinate3d(0);
-  Array<Vector3> ref = m_molecule->atomPositions3d();
-
-  for (size_t i = 0; i < m_molecule->coordinate3dCount(); ++i) {
-    m_molecule->setCoordinate3d(i);
-    Array<Vector3> positions = m_molecule->atomPositions3d();
+  // The frames are fetched one at a time, without touching the current
+  // positions, so long trajectories read on demand are never all in memory.
+  Array<Vector3> ref = m_molecule->coordinate3d(0);
+
+  int frameCount = m_molecule->coordinate3dCount();
+  for (int i = 0; i < frameCount; ++i) {
+    Array<Vector3> positions = m_molecule->coordinate3d(i);
+    if (positions.empty() || positions.size() != ref.size())
+      continue;
     double sum = 0;
-    for (size_t j = 0; j < positions.size(); ++j) {
-      sum += (positions[j][0] - ref[j][0]) * (positions[j][0] - ref[j][0]) +
-             (positions[j][1] - ref[j][1]) * (positions[j][1] - ref[j][1]) +
-             (positions[j][2] - ref[j][2]) * (positions[j][2] - ref[j][2]);
-    }
-    sum = sqrt(sum / m_molecule->coordinate3dCount());
+    for (size_t j = 0; j < positions.size(); ++j)
+      sum += (positions[j] - ref[j]).squaredNorm();
+    sum = sqrt(sum / positions.size());
     results.push_back(std::make_pair(static_cast<double>(i), sum));
   }
 }
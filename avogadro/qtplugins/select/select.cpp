@@ -80,7 +80,7 @@ void Select::selectAll()
     for (Index i = 0; i < m_molecule->atomCount(); ++i)
       m_molecule->atom(i).setSelected(true);
 
-    m_molecule->emitChanged(Molecule::Atoms);
+    m_molecule->emitChanged(Molecule::Atoms | Molecule::Selection);
   }
 }
 
@@ -90,7 +90,7 @@ void Select::selectNone()
     for (Index i = 0; i < m_molecule->atomCount(); ++i)
       m_molecule->atom(i).setSelected(false);
 
-    m_molecule->emitChanged(Molecule::Atoms);
+    m_molecule->emitChanged(Molecule::Atoms | Molecule::Selection);
   }
 }
 
@@ -100,7 +100,7 @@ void Select::invertSelection()
     for (Index i = 0; i < m_molecule->atomCount(); ++i)
       m_molecule->atom(i).setSelected(!m_molecule->atomSelected(i));
 
-    m_molecule->emitChanged(Molecule::Atoms);
+    m_molecule->emitChanged(Molecule::Atoms | Molecule::Selection);
   }
 }
 
@@ -22,9 +22,12 @@
 
 #include <avogadro/qtopengl/glwidget.h>
 
+#include <avogadro/rendering/camera.h>
 #include <avogadro/rendering/geometrynode.h>
 #include <avogadro/rendering/glrenderer.h>
 #include <avogadro/rendering/groupnode.h>
+#include <avogadro/rendering/identifierbuffer.h>
+#include <avogadro/rendering/linestripgeometry.h>
 #include <avogadro/rendering/meshgeometry.h>
 #include <avogadro/rendering/scene.h>
 
@@ -37,20 +40,42 @@
 #include <QtGui/QMouseEvent>
 #include <QtWidgets/QAction>
 
+#include <algorithm>
+#include <vector>
+
 using Avogadro::Core::Array;
 using Avogadro::Core::Atom;
 using Avogadro::Rendering::GeometryNode;
 using Avogadro::Rendering::GroupNode;
 using Avogadro::Rendering::Identifier;
+using Avogadro::Rendering::LineStripGeometry;
 using Avogadro::Rendering::MeshGeometry;
 using Avogadro::QtGui::Molecule;
 
 namespace Avogadro {
 namespace QtPlugins {
 
+namespace {
+// Whether the point (x,y) is inside of the polygon, by the even-odd rule.
+bool contains(const std::vector<Vector2i>& polygon, float x, float y)
+{
+  bool inside = false;
+  for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+    const Vector2f a = polygon[i].cast<float>();
+    const Vector2f b = polygon[j].cast<float>();
+    if ((a.y() <= y) != (b.y() <= y) &&
+        x < a.x() + (y - a.y()) / (b.y() - a.y()) * (b.x() - a.x())) {
+      inside = !inside;
+    }
+  }
+  return inside;
+}
+} // namespace
+
 SelectionTool::SelectionTool(QObject* parent_)
   : QtGui::ToolPlugin(parent_), m_activateAction(new QAction(this)),
-    m_molecule(nullptr), m_renderer(nullptr), m_drawSelectionBox(false)
+    m_molecule(nullptr), m_renderer(nullptr), m_selecting(false),
+    m_drawSelectionBox(false)
 {
   m_activateAction->setText(tr("Selection"));
   m_activateAction->setIcon(QIcon(":/icons/selectiontool.png"));
@@ -71,46 +96,67 @@ QUndoCommand* SelectionTool::mousePressEvent(QMouseEvent* e)
     return nullptr;
 
   m_drawSelectionBox = false;
+  m_lasso.clear();
   m_start = Vector2(e->pos().x(), e->pos().y());
   m_end = m_start;
-  Identifier hit = m_renderer->hit(e->pos().x(), e->pos().y());
 
-  // If an atom is clicked, accept the event, but don't add it to the atom list
-  // until the button is released (this way the user can cancel the click by
-  // moving off the atom, and the click won't get passed to the default tool).
-  if (hit.type == Rendering::AtomType)
-    e->accept();
+  // With Alt held a lasso is drawn around the atoms to select, and with Shift
+  // held a box is, wherever it starts. Otherwise only presses on atoms are
+  // taken, other drags are left to the navigation tool. A clicked atom is not
+  // added to the atom list until the button is released, so the click can be
+  // turned into a box by dragging instead.
+  if (e->modifiers() == Qt::AltModifier) {
+    m_lasso.push_back(Vector2i(e->pos().x(), e->pos().y()));
+  } else if (e->modifiers() != Qt::ShiftModifier) {
+    Identifier hit = m_renderer->hit(e->pos().x(), e->pos().y());
+    if (hit.type != Rendering::AtomType)
+      return nullptr;
+  }
 
-  // Remove the global accept to prevent the rectangle selection area from being
-  // rendered as the selection code is not yet in place for the scene.
-  // e->accept();
+  // Draw the identifier buffer with the frames rendered while the selection
+  // is dragged, so that the atoms inside of it can be found when it is
+  // released.
+  m_selecting = true;
+  m_renderer->setIdentifierBufferEnabled(true);
+  e->accept();
 
   return nullptr;
 }
 
 QUndoCommand* SelectionTool::mouseReleaseEvent(QMouseEvent* e)
 {
-  // If the click is released on an atom, add it to the list
-  if (e->button() != Qt::LeftButton || !m_renderer)
+  if (e->button() != Qt::LeftButton || !m_renderer || !m_selecting)
     return nullptr;
 
-  m_drawSelectionBox = false;
-  m_start = Vector2(e->pos().x(), e->pos().y());
-  m_end = m_start;
-  Identifier hit = m_renderer->hit(e->pos().x(), e->pos().y());
-
-  // Now add the atom on release.
-  if (hit.type == Rendering::AtomType) {
-    if (addAtom(hit))
+  m_selecting = false;
+  m_end = Vector2(e->pos().x(), e->pos().y());
+  if (!m_lasso.empty()) {
+    // Add all of the visible atoms in the lasso on release.
+    selectArea(m_lasso);
+    m_lasso.clear();
+    emit drawablesChanged();
+  } else if (m_drawSelectionBox) {
+    // Add all of the visible atoms in the box on release.
+    m_drawSelectionBox = false;
+    const int x1 = static_cast<int>(m_start.x());
+    const int y1 = static_cast<int>(m_start.y());
+    const int x2 = static_cast<int>(m_end.x());
+    const int y2 = static_cast<int>(m_end.y());
+    std::vector<Vector2i> box;
+    box.push_back(Vector2i(x1, y1));
+    box.push_back(Vector2i(x2, y1));
+    box.push_back(Vector2i(x2, y2));
+    box.push_back(Vector2i(x1, y2));
+    selectArea(box);
+    emit drawablesChanged();
+  } else {
+    // If the click is released on an atom, add it to the list.
+    Identifier hit = m_renderer->hit(e->pos().x(), e->pos().y());
+    if (hit.type == Rendering::AtomType && addAtom(hit))
       emit drawablesChanged();
-    e->accept();
   }
-
-// Disable this code until rectange selection is ready.
-#if 0
-  emit drawablesChanged();
+  m_renderer->setIdentifierBufferEnabled(false);
   e->accept();
-#endif
 
   return nullptr;
 }
@@ -126,16 +172,27 @@ QUndoCommand* SelectionTool::mouseDoubleClickEvent(QMouseEvent* e)
   return nullptr;
 }
 
-QUndoCommand* SelectionTool::mouseMoveEvent(QMouseEvent*)
+QUndoCommand* SelectionTool::mouseMoveEvent(QMouseEvent* e)
 {
-// Disable this code until rectange selection is ready.
-#if 0
-  m_drawSelectionBox = true;
+  if (!(e->buttons() & Qt::LeftButton) || !m_renderer || !m_selecting)
+    return nullptr;
+
   m_end = Vector2(e->pos().x(), e->pos().y());
-  emit drawablesChanged();
+  if (!m_lasso.empty()) {
+    const Vector2i point(e->pos().x(), e->pos().y());
+    if (point != m_lasso.back()) {
+      m_lasso.push_back(point);
+      emit drawablesChanged();
+    }
+  } else {
+    // Small movements while clicking on an atom do not start a box.
+    if ((m_end - m_start).norm() > 2.0)
+      m_drawSelectionBox = true;
+    if (m_drawSelectionBox)
+      emit drawablesChanged();
+  }
 
   e->accept();
-#endif
   return nullptr;
 }
 
@@ -146,10 +203,28 @@ QUndoCommand* SelectionTool::keyPressEvent(QKeyEvent* e)
 
 void SelectionTool::draw(Rendering::GroupNode& node)
 {
-  if (!m_drawSelectionBox) {
-    node.clear();
+  node.clear();
+  if (m_lasso.size() > 1) {
+    GeometryNode* geo = new GeometryNode;
+    node.addChild(geo);
+    LineStripGeometry* lines = new LineStripGeometry;
+    lines->setRenderPass(Rendering::Overlay2DPass);
+    lines->setColor(Vector3ub(200, 200, 0));
+
+    // Close the lasso back to where it was started.
+    const float height =
+      static_cast<float>(m_renderer->overlayCamera().height());
+    Array<Vector3f> verts;
+    for (size_t i = 0; i <= m_lasso.size(); ++i) {
+      const Vector2i& point = m_lasso[i % m_lasso.size()];
+      verts.push_back(Vector3f(point.x(), height - point.y(), 0.0f));
+    }
+    lines->addLineStrip(verts, 2.0f);
+    geo->addDrawable(lines);
     return;
   }
+  if (!m_drawSelectionBox)
+    return;
 
   GeometryNode* geo = new GeometryNode;
   node.addChild(geo);
@@ -189,19 +264,62 @@ void SelectionTool::draw(Rendering::GroupNode& node)
   geo->addDrawable(mesh);
 }
 
+void SelectionTool::selectArea(const std::vector<Vector2i>& polygon)
+{
+  if (!m_molecule || polygon.size() < 3)
+    return;
+
+  const Rendering::IdentifierBuffer& buffer = m_renderer->identifierBuffer();
+  std::vector<Identifier> hits = buffer.hits(polygon);
+
+  // Without the identifier buffer fall back to the atoms whose centers are in
+  // the area, hidden or not.
+  if (buffer.isEmpty()) {
+    const Rendering::Camera& camera = m_renderer->camera();
+    const float scale = camera.devicePixelRatio();
+    for (Index i = 0; i < m_molecule->atomCount(); ++i) {
+      const Vector3f position = camera.project(
+        m_molecule->atomPosition3d(i).cast<float>());
+      const float x = position.x() / scale;
+      const float y = (camera.height() - position.y()) / scale;
+      if (contains(polygon, x, y) && position.z() >= 0.0f &&
+          position.z() <= 1.0f) {
+        Identifier id;
+        id.molecule = static_cast<const Core::Molecule*>(m_molecule);
+        id.type = Rendering::AtomType;
+        id.index = i;
+        hits.push_back(id);
+      }
+    }
+  }
+
+  bool changed = false;
+  for (size_t i = 0; i < hits.size(); ++i) {
+    const Identifier& atom = hits[i];
+    if (atom.type != Rendering::AtomType ||
+        atom.index >= m_molecule->atomCount() || m_atoms.contains(atom)) {
+      continue;
+    }
+    m_atoms.push_back(atom);
+    m_molecule->atom(atom.index).setSelected(true);
+    changed = true;
+  }
+  if (changed)
+    m_molecule->emitChanged(Molecule::Atoms | Molecule::Selection);
+}
+
 bool SelectionTool::addAtom(const Rendering::Identifier& atom)
 {
   int idx = m_atoms.indexOf(atom);
   if (idx >= 0) {
     m_atoms.removeAt(idx);
     m_molecule->atom(atom.index).setSelected(false);
-    return true;
   } else {
     m_atoms.push_back(atom);
     m_molecule->atom(atom.index).setSelected(true);
-    return true;
   }
-  m_molecule->emitChanged(Molecule::Atoms);
+  m_molecule->emitChanged(Molecule::Atoms | Molecule::Selection);
+  return true;
 }
 
 } // namespace QtPlugins
@@ -29,11 +29,18 @@
 
 #include <QtCore/QVector>
 
+#include <vector>
+
 namespace Avogadro {
 namespace QtPlugins {
 
 /**
  * @brief SelectionTool selects atoms and bonds from the screen.
+ *
+ * Click an atom to toggle it, or drag from an atom to select the atoms in a
+ * box. Drags that start elsewhere are left to the navigation tool, unless
+ * Shift is held to drag a box from anywhere. The navigation tool still zooms
+ * with the middle button then. Hold Alt to draw a lasso instead.
  */
 class SelectionTool : public QtGui::ToolPlugin
 {
@@ -61,14 +68,20 @@ public:
 
 private:
   bool addAtom(const Rendering::Identifier& atom);
+  // Add the atoms visible inside of the polygon in display coordinates.
+  void selectArea(const std::vector<Vector2i>& polygon);
 
   QAction* m_activateAction;
   QtGui::Molecule* m_molecule;
   Rendering::GLRenderer* m_renderer;
   QVector<Rendering::Identifier> m_atoms;
+  // Whether a press was taken to select atoms, until it is released.
+  bool m_selecting;
   bool m_drawSelectionBox;
   Vector2 m_start;
   Vector2 m_end;
+  // The points of the lasso being drawn, in display coordinates.
+  std::vector<Vector2i> m_lasso;
 };
 
 inline void SelectionTool::setMolecule(QtGui::Molecule* mol)
@@ -25,6 +25,8 @@
 
 #include <QtConcurrent/QtConcurrentMap>
 
+#include <algorithm>
+
 namespace Avogadro {
 namespace QtPlugins {
 
@@ -43,16 +45,25 @@ class BasisSetConcurrent
   }
 };
 
-struct GaussianShell
+// A tile is a contiguous range of grid points, one plane of the cube. The
+// tiles are written straight into the target cubes by the worker threads,
+// which record the range of each tile as they fill it, and the ranges of the
+// cubes are reduced from theirs once they are all done.
+struct GaussianTile
 {
-  GaussianSetTools* tools; // A pointer to the tools, can't write to member vars
-  Cube* tCube;             // The target cube, used to initialise temp cubes too
-  unsigned int pos;        // The index of the point to calculate the MO for
-  unsigned int state;      // The MO number to calculate
+  GaussianSetTools* tools;   // The tools, shared by all of the tiles
+  std::vector<Cube*>* cubes; // The target cubes, one per orbital
+  std::vector<int>* states;  // The MO numbers to calculate, one per cube
+  Index first;               // The index of the first point in the tile
+  Index count;               // The number of points in the tile
+  bool done;                 // Whether the tile has been calculated
+  // The range of the values in the tile, one per cube
+  std::vector<double> minValues;
+  std::vector<double> maxValues;
 };
 
 GaussianSetConcurrent::GaussianSetConcurrent(QObject* p)
-  : QObject(p), m_gaussianShells(nullptr), m_set(nullptr), m_tools(nullptr)
+  : QObject(p), m_tiles(nullptr), m_set(nullptr), m_tools(nullptr)
 {
   // Watch for the future
   connect(&m_watcher, SIGNAL(finished()), this, SLOT(calculationComplete()));
@@ -60,7 +71,7 @@ GaussianSetConcurrent::GaussianSetConcurrent(QObject* p)
 
 GaussianSetConcurrent::~GaussianSetConcurrent()
 {
-  delete m_gaussianShells;
+  delete m_tiles;
 }
 
 void GaussianSetConcurrent::setMolecule(Core::Molecule* mol)
@@ -77,81 +88,131 @@ bool GaussianSetConcurrent::calculateMolecularOrbital(Core::Cube* cube,
                                                       unsigned int state,
                                                       bool beta)
 {
+  return calculateMolecularOrbitals(std::vector<Cube*>(1, cube),
+                                    std::vector<unsigned int>(1, state), beta);
+}
+
+bool GaussianSetConcurrent::calculateMolecularOrbitals(
+  const std::vector<Core::Cube*>& cubes,
+  const std::vector<unsigned int>& states, bool beta)
+{
+  if (!m_tools || cubes.size() != states.size())
+    return false;
+
   // We can do some initial set up of the tools here to set electron type.
   if (!beta)
     m_tools->setElectronType(BasisSet::Alpha);
   else
     m_tools->setElectronType(BasisSet::Beta);
 
-  return setUpCalculation(cube, state, GaussianSetConcurrent::processOrbital);
+  return setUpCalculation(cubes, std::vector<int>(states.begin(), states.end()),
+                          GaussianSetConcurrent::processOrbitals);
 }
 
 bool GaussianSetConcurrent::calculateElectronDensity(Core::Cube* cube)
 {
-  return setUpCalculation(cube, 0, GaussianSetConcurrent::processDensity);
+  return setUpCalculation(std::vector<Cube*>(1, cube), std::vector<int>(),
+                          GaussianSetConcurrent::processDensity);
 }
 
 bool GaussianSetConcurrent::calculateSpinDensity(Core::Cube* cube)
 {
-  return setUpCalculation(cube, 0, GaussianSetConcurrent::processSpinDensity);
+  return setUpCalculation(std::vector<Cube*>(1, cube), std::vector<int>(),
+                          GaussianSetConcurrent::processSpinDensity);
 }
 
 void GaussianSetConcurrent::calculationComplete()
 {
-  (*m_gaussianShells)[0].tCube->lock()->unlock();
-  delete m_gaussianShells;
-  m_gaussianShells = 0;
-  emit finished();
+  for (size_t i = 0; i < m_cubes.size(); ++i) {
+    bool found = false;
+    double minValue = 0.0;
+    double maxValue = 0.0;
+    for (int j = 0; j < m_tiles->size(); ++j) {
+      const GaussianTile& tile = (*m_tiles)[j];
+      if (!tile.done)
+        continue;
+      minValue =
+        found ? std::min(minValue, tile.minValues[i]) : tile.minValues[i];
+      maxValue =
+        found ? std::max(maxValue, tile.maxValues[i]) : tile.maxValues[i];
+      found = true;
+    }
+    if (found)
+      m_cubes[i]->setValueRange(minValue, maxValue);
+    m_cubes[i]->lock()->unlock();
+  }
+  m_cubes.clear();
+  delete m_tiles;
+  m_tiles = nullptr;
+
+  if (m_watcher.isCanceled())
+    emit canceled();
+  else
+    emit finished();
 }
 
-bool GaussianSetConcurrent::setUpCalculation(Core::Cube* cube,
-                                             unsigned int state,
-                                             void (*func)(GaussianShell&))
+bool GaussianSetConcurrent::setUpCalculation(
+  const std::vector<Core::Cube*>& cubes, const std::vector<int>& states,
+  void (*func)(GaussianTile&))
 {
-  if (!m_set || !m_tools)
+  if (!m_set || !m_tools || cubes.empty() || m_tiles)
     return false;
 
   m_set->initCalculation();
 
-  // Set up the points we want to calculate the density at.
-  m_gaussianShells =
-    new QVector<GaussianShell>(static_cast<int>(cube->data()->size()));
-
-  for (int i = 0; i < m_gaussianShells->size(); ++i) {
-    (*m_gaussianShells)[i].tools = m_tools;
-    (*m_gaussianShells)[i].tCube = cube;
-    (*m_gaussianShells)[i].pos = i;
-    (*m_gaussianShells)[i].state = state;
+  m_cubes = cubes;
+  m_states = states;
+
+  // Split the grid into tiles of one plane each, the thread pool hands them
+  // out to whichever thread is free and reports progress per tile.
+  Vector3i dim = cubes[0]->dimensions();
+  Index tileSize = static_cast<Index>(dim.y()) * dim.z();
+  m_tiles = new QVector<GaussianTile>(dim.x());
+  for (int i = 0; i < m_tiles->size(); ++i) {
+    (*m_tiles)[i].tools = m_tools;
+    (*m_tiles)[i].cubes = &m_cubes;
+    (*m_tiles)[i].states = &m_states;
+    (*m_tiles)[i].first = i * tileSize;
+    (*m_tiles)[i].count = tileSize;
+    (*m_tiles)[i].done = false;
+    (*m_tiles)[i].minValues.resize(m_cubes.size());
+    (*m_tiles)[i].maxValues.resize(m_cubes.size());
   }
 
-  // Lock the cube until we are done.
-  cube->lock()->lock();
+  // Lock the cubes until we are done.
+  for (size_t i = 0; i < m_cubes.size(); ++i)
+    m_cubes[i]->lock()->lock();
 
   // The main part of the mapped reduced function...
-  m_future = QtConcurrent::map(*m_gaussianShells, func);
+  m_future = QtConcurrent::map(*m_tiles, func);
   // Connect our watcher to our future
   m_watcher.setFuture(m_future);
 
   return true;
 }
 
-void GaussianSetConcurrent::processOrbital(GaussianShell& shell)
+void GaussianSetConcurrent::processOrbitals(GaussianTile& tile)
 {
-  Vector3 pos = shell.tCube->position(shell.pos);
-  shell.tCube->setValue(
-    shell.pos, shell.tools->calculateMolecularOrbital(pos, shell.state));
+  tile.done = tile.count > 0 &&
+              tile.tools->calculateMolecularOrbitals(
+                *tile.cubes, *tile.states, tile.first, tile.count,
+                tile.minValues.data(), tile.maxValues.data());
 }
 
-void GaussianSetConcurrent::processDensity(GaussianShell& shell)
+void GaussianSetConcurrent::processDensity(GaussianTile& tile)
 {
-  Vector3 pos = shell.tCube->position(shell.pos);
-  shell.tCube->setValue(shell.pos, shell.tools->calculateElectronDensity(pos));
+  tile.done = tile.count > 0 &&
+              tile.tools->calculateElectronDensity(
+                *(*tile.cubes)[0], tile.first, tile.count,
+                &tile.minValues[0], &tile.maxValues[0]);
 }
 
-void GaussianSetConcurrent::processSpinDensity(GaussianShell& shell)
+void GaussianSetConcurrent::processSpinDensity(GaussianTile& tile)
 {
-  Vector3 pos = shell.tCube->position(shell.pos);
-  shell.tCube->setValue(shell.pos, shell.tools->calculateSpinDensity(pos));
+  tile.done = tile.count > 0 &&
+              tile.tools->calculateSpinDensity(
+                *(*tile.cubes)[0], tile.first, tile.count, &tile.minValues[0],
+                &tile.maxValues[0]);
 }
 }
 }
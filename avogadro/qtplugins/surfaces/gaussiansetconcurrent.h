@@ -21,6 +21,8 @@
 #include <QtCore/QFutureWatcher>
 #include <QtCore/QObject>
 
+#include <vector>
+
 namespace Avogadro {
 
 namespace Core {
@@ -32,7 +34,7 @@ class GaussianSetTools;
 
 namespace QtPlugins {
 
-struct GaussianShell;
+struct GaussianTile;
 
 /**
  * @brief The GaussianSetConcurrent class uses GaussianSetTools to calculate
@@ -52,6 +54,14 @@ public:
 
   bool calculateMolecularOrbital(Core::Cube* cube, unsigned int state,
                                  bool beta = false);
+
+  /**
+   * Calculate several molecular orbitals in a single pass over the grid, one
+   * orbital per cube. The cubes must all share the same limits.
+   */
+  bool calculateMolecularOrbitals(const std::vector<Core::Cube*>& cubes,
+                                  const std::vector<unsigned int>& states,
+                                  bool beta = false);
   bool calculateElectronDensity(Core::Cube* cube);
   bool calculateSpinDensity(Core::Cube* cube);
 
@@ -63,27 +73,34 @@ signals:
    */
   void finished();
 
+  /**
+   * Emitted instead of finished() once a canceled calculation has stopped.
+   */
+  void canceled();
+
 private slots:
   /**
-   * Slot to set the cube data once Qt Concurrent is done
+   * Slot to release the cubes once Qt Concurrent is done or canceled.
    */
   void calculationComplete();
 
 private:
   QFuture<void> m_future;
   QFutureWatcher<void> m_watcher;
-  Core::Cube* m_cube;
-  QVector<GaussianShell>* m_gaussianShells;
+  QVector<GaussianTile>* m_tiles;
+  std::vector<Core::Cube*> m_cubes;
+  std::vector<int> m_states;
 
   Core::GaussianSet* m_set;
   Core::GaussianSetTools* m_tools;
 
-  bool setUpCalculation(Core::Cube* cube, unsigned int state,
-                        void (*func)(GaussianShell&));
+  bool setUpCalculation(const std::vector<Core::Cube*>& cubes,
+                        const std::vector<int>& states,
+                        void (*func)(GaussianTile&));
 
-  static void processOrbital(GaussianShell& shell);
-  static void processDensity(GaussianShell& shell);
-  static void processSpinDensity(GaussianShell& shell);
+  static void processOrbitals(GaussianTile& tile);
+  static void processDensity(GaussianTile& tile);
+  static void processSpinDensity(GaussianTile& tile);
 };
 }
 }
@@ -25,6 +25,10 @@
 
 #include <QtConcurrent/QtConcurrentMap>
 
+#include <algorithm>
+#include <limits>
+#include <vector>
+
 namespace Avogadro {
 namespace QtPlugins {
 
@@ -32,16 +36,41 @@ using Core::SlaterSet;
 using Core::SlaterSetTools;
 using Core::Cube;
 
-struct SlaterShell
+// A tile is a contiguous range of grid points, one plane of the cube. The
+// tiles are written straight into the target cube by the worker threads, and
+// the range of the cube is reduced from theirs once they are all done.
+struct SlaterTile
 {
   SlaterSetTools* tools; // A pointer to the tools, cannot write to member vars
-  Cube* tCube;           // The target cube, used to initialise temp cubes too
-  unsigned int pos;      // The index of the point to calculate the MO for
+  Cube* tCube;           // The target cube
   unsigned int state;    // The MO number to calculate
+  Index first;           // The index of the first point in the tile
+  Index count;           // The number of points in the tile
+  bool done;             // Whether the tile has been calculated
+  double minValue;       // The range of the values in the tile
+  double maxValue;
 };
 
+namespace {
+
+// Calculate the values of the tile and write them to the cube at once,
+// recording their range on the way.
+template <typename Func>
+void fillTile(SlaterTile& tile, const Func& func)
+{
+  std::vector<double> values(tile.count);
+  for (Index i = 0; i < tile.count; ++i)
+    values[i] = func(tile.tCube->position(tile.first + i));
+  tile.minValue = std::numeric_limits<double>::max();
+  tile.maxValue = std::numeric_limits<double>::lowest();
+  tile.done = tile.count > 0 &&
+              tile.tCube->fillValues(tile.first, tile.count, values.data(),
+                                     tile.minValue, tile.maxValue);
+}
+} // namespace
+
 SlaterSetConcurrent::SlaterSetConcurrent(QObject* p)
-  : QObject(p), m_shells(nullptr), m_set(nullptr), m_tools(nullptr)
+  : QObject(p), m_tiles(nullptr), m_set(nullptr), m_tools(nullptr)
 {
   // Watch for the future
   connect(&m_watcher, SIGNAL(finished()), this, SLOT(calculationComplete()));
@@ -49,7 +78,7 @@ SlaterSetConcurrent::SlaterSetConcurrent(QObject* p)
 
 SlaterSetConcurrent::~SlaterSetConcurrent()
 {
-  delete m_shells;
+  delete m_tiles;
 }
 
 void SlaterSetConcurrent::setMolecule(Core::Molecule* mol)
@@ -80,58 +109,84 @@ bool SlaterSetConcurrent::calculateSpinDensity(Core::Cube* cube)
 
 void SlaterSetConcurrent::calculationComplete()
 {
-  (*m_shells)[0].tCube->lock()->unlock();
-  delete m_shells;
-  m_shells = 0;
-  emit finished();
+  Cube* cube = (*m_tiles)[0].tCube;
+  bool found = false;
+  double minValue = 0.0;
+  double maxValue = 0.0;
+  for (int i = 0; i < m_tiles->size(); ++i) {
+    const SlaterTile& tile = (*m_tiles)[i];
+    if (!tile.done)
+      continue;
+    minValue = found ? std::min(minValue, tile.minValue) : tile.minValue;
+    maxValue = found ? std::max(maxValue, tile.maxValue) : tile.maxValue;
+    found = true;
+  }
+  if (found)
+    cube->setValueRange(minValue, maxValue);
+  cube->lock()->unlock();
+  delete m_tiles;
+  m_tiles = nullptr;
+
+  if (m_watcher.isCanceled())
+    emit canceled();
+  else
+    emit finished();
 }
 
 bool SlaterSetConcurrent::setUpCalculation(Core::Cube* cube, unsigned int state,
-                                           void (*func)(SlaterShell&))
+                                           void (*func)(SlaterTile&))
 {
-  if (!m_set || !m_tools)
+  if (!m_set || !m_tools || !cube || m_tiles)
     return false;
 
   m_set->initCalculation();
 
-  // Set up the points we want to calculate the density at.
-  m_shells = new QVector<SlaterShell>(static_cast<int>(cube->data()->size()));
-
-  for (int i = 0; i < m_shells->size(); ++i) {
-    (*m_shells)[i].tools = m_tools;
-    (*m_shells)[i].tCube = cube;
-    (*m_shells)[i].pos = i;
-    (*m_shells)[i].state = state;
+  // Split the grid into tiles of one plane each, the thread pool hands them
+  // out to whichever thread is free and reports progress per tile.
+  Vector3i dim = cube->dimensions();
+  if (dim.x() < 1)
+    return false;
+  Index tileSize = static_cast<Index>(dim.y()) * dim.z();
+  m_tiles = new QVector<SlaterTile>(dim.x());
+  for (int i = 0; i < m_tiles->size(); ++i) {
+    (*m_tiles)[i].tools = m_tools;
+    (*m_tiles)[i].tCube = cube;
+    (*m_tiles)[i].state = state;
+    (*m_tiles)[i].first = i * tileSize;
+    (*m_tiles)[i].count = tileSize;
+    (*m_tiles)[i].done = false;
   }
 
   // Lock the cube until we are done.
   cube->lock()->lock();
 
   // The main part of the mapped reduced function...
-  m_future = QtConcurrent::map(*m_shells, func);
+  m_future = QtConcurrent::map(*m_tiles, func);
   // Connect our watcher to our future
   m_watcher.setFuture(m_future);
 
   return true;
 }
 
-void SlaterSetConcurrent::processOrbital(SlaterShell& shell)
+void SlaterSetConcurrent::processOrbital(SlaterTile& tile)
 {
-  Vector3 pos = shell.tCube->position(shell.pos);
-  shell.tCube->setValue(
-    shell.pos, shell.tools->calculateMolecularOrbital(pos, shell.state));
+  fillTile(tile, [&tile](const Vector3& position) {
+    return tile.tools->calculateMolecularOrbital(position, tile.state);
+  });
 }
 
-void SlaterSetConcurrent::processDensity(SlaterShell& shell)
+void SlaterSetConcurrent::processDensity(SlaterTile& tile)
 {
-  Vector3 pos = shell.tCube->position(shell.pos);
-  shell.tCube->setValue(shell.pos, shell.tools->calculateElectronDensity(pos));
+  fillTile(tile, [&tile](const Vector3& position) {
+    return tile.tools->calculateElectronDensity(position);
+  });
 }
 
-void SlaterSetConcurrent::processSpinDensity(SlaterShell& shell)
+void SlaterSetConcurrent::processSpinDensity(SlaterTile& tile)
 {
-  Vector3 pos = shell.tCube->position(shell.pos);
-  shell.tCube->setValue(shell.pos, shell.tools->calculateSpinDensity(pos));
+  fillTile(tile, [&tile](const Vector3& position) {
+    return tile.tools->calculateSpinDensity(position);
+  });
 }
 }
 }
@@ -32,7 +32,7 @@ class SlaterSetTools;
 
 namespace QtPlugins {
 
-struct SlaterShell;
+struct SlaterTile;
 
 /**
  * @brief The SlaterSetConcurrent class uses SlaterSetTools to calculate values
@@ -62,27 +62,31 @@ signals:
    */
   void finished();
 
+  /**
+   * Emitted instead of finished() once a canceled calculation has stopped.
+   */
+  void canceled();
+
 private slots:
   /**
-   * Slot to set the cube data once Qt Concurrent is done
+   * Slot to release the cube once Qt Concurrent is done or canceled.
    */
   void calculationComplete();
 
 private:
   QFuture<void> m_future;
   QFutureWatcher<void> m_watcher;
-  Core::Cube* m_cube;
-  QVector<SlaterShell>* m_shells;
+  QVector<SlaterTile>* m_tiles;
 
   Core::SlaterSet* m_set;
   Core::SlaterSetTools* m_tools;
 
   bool setUpCalculation(Core::Cube* cube, unsigned int state,
-                        void (*func)(SlaterShell&));
+                        void (*func)(SlaterTile&));
 
-  static void processOrbital(SlaterShell& shell);
-  static void processDensity(SlaterShell& shell);
-  static void processSpinDensity(SlaterShell& shell);
+  static void processOrbital(SlaterTile& tile);
+  static void processDensity(SlaterTile& tile);
+  static void processSpinDensity(SlaterTile& tile);
 };
 }
 }
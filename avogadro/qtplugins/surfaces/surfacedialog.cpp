@@ -31,6 +31,7 @@ SurfaceDialog::SurfaceDialog(QWidget* parent_, Qt::WindowFlags f)
 
   m_ui->orbitalCombo->setVisible(false);
   m_ui->spinCombo->setVisible(false);
+  m_ui->precomputeCheckBox->setVisible(false);
   m_ui->chargeCombo->setVisible(false);
   m_ui->recordButton->setVisible(false);
 
@@ -66,6 +67,8 @@ void SurfaceDialog::surfaceComboChanged(int n)
   } else {
     m_ui->orbitalCombo->setEnabled(false);
   }
+  m_ui->precomputeCheckBox->setEnabled(type ==
+                                       Surfaces::Type::MolecularOrbital);
 }
 
 void SurfaceDialog::resolutionComboChanged(int n)
@@ -111,6 +114,7 @@ void SurfaceDialog::setupBasis(int numElectrons, int numMOs, bool beta)
 
   m_ui->orbitalCombo->setVisible(true);
   m_ui->orbitalCombo->setEnabled(false);
+  m_ui->precomputeCheckBox->setVisible(true);
 
   m_ui->surfaceCombo->addItem(tr("Molecular Orbital"),
                               Surfaces::Type::MolecularOrbital);
@@ -204,6 +208,11 @@ bool SurfaceDialog::beta()
   return m_ui->spinCombo->currentIndex() == 1;
 }
 
+bool SurfaceDialog::precomputeOrbitals()
+{
+  return m_ui->precomputeCheckBox->isChecked();
+}
+
 float SurfaceDialog::isosurfaceValue()
 {
   return static_cast<float>(m_ui->isosurfaceDoubleSpinBox->value());
@@ -61,6 +61,12 @@ public:
    */
   bool beta();
 
+  /**
+   * Only relevant for molecular orbitals, should the neighboring orbitals be
+   * calculated along with the selected one?
+   */
+  bool precomputeOrbitals();
+
   float isosurfaceValue();
 
   float resolution();
@@ -30,7 +30,10 @@ namespace {
 #include <avogadro/core/variant.h>
 
 #include <avogadro/core/cube.h>
+#include <avogadro/core/elements.h>
 #include <avogadro/core/mesh.h>
+#include <avogadro/core/molecularsurface.h>
+#include <avogadro/core/mutex.h>
 #include <avogadro/qtgui/meshgenerator.h>
 #include <avogadro/qtgui/molecule.h>
 #include <avogadro/qtopengl/activeobjects.h>
@@ -51,13 +54,18 @@ namespace {
 #include <QtCore/QBuffer>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDebug>
+#include <QtCore/QFutureWatcher>
 #include <QtCore/QProcess>
+#include <QtConcurrent/QtConcurrentRun>
 #include <QtGui/QOpenGLFramebufferObject>
 #include <QtWidgets/QAction>
 #include <QtWidgets/QFileDialog>
 #include <QtWidgets/QMessageBox>
 #include <QtWidgets/QProgressDialog>
 
+#include <algorithm>
+#include <vector>
+
 namespace Avogadro {
 namespace QtPlugins {
 
@@ -70,6 +78,9 @@ class Surfaces::PIMPL
 public:
   GifWriter* gifWriter = nullptr;
   gwavi_t* gwaviWriter = nullptr;
+  QFutureWatcher<void> surfaceWatcher;
+  // The cube locked for the surface being calculated, if any.
+  Core::Cube* surfaceCube = nullptr;
 };
 
 Surfaces::Surfaces(QObject* p) : ExtensionPlugin(p), d(new PIMPL())
@@ -79,6 +90,8 @@ Surfaces::Surfaces(QObject* p) : ExtensionPlugin(p), d(new PIMPL())
   connect(action, SIGNAL(triggered()), SLOT(surfacesActivated()));
   m_actions.push_back(action);
 
+  connect(&d->surfaceWatcher, SIGNAL(finished()), SLOT(surfaceFinished()));
+
   // Register quantum file formats
   Io::FileFormatManager::registerFormat(new QuantumIO::GAMESSUSOutput);
   Io::FileFormatManager::registerFormat(new QuantumIO::GaussianFchk);
@@ -91,12 +104,17 @@ Surfaces::Surfaces(QObject* p) : ExtensionPlugin(p), d(new PIMPL())
 
 Surfaces::~Surfaces()
 {
+  waitForSurface();
   delete d;
   delete m_cube;
+  clearOrbitalCubes();
 }
 
 void Surfaces::setMolecule(QtGui::Molecule* mol)
 {
+  // The surface being calculated belongs to the old molecule.
+  waitForSurface();
+
   if (mol->basisSet()) {
     m_basis = mol->basisSet();
   } else if (mol->cubes().size() != 0) {
@@ -107,6 +125,7 @@ void Surfaces::setMolecule(QtGui::Molecule* mol)
   m_mesh1 = nullptr;
   m_mesh2 = nullptr;
   m_molecule = mol;
+  clearOrbitalCubes();
 }
 
 QList<QAction*> Surfaces::actions() const
@@ -170,8 +189,6 @@ void Surfaces::calculateSurface()
     case SolventAccessible:
     case SolventExcluded:
       calculateEDT();
-      // pass a molecule and return a Cube for m_cube
-      //   displayMesh();
       break;
 
     case ElectronDensity:
@@ -190,8 +207,78 @@ void Surfaces::calculateSurface()
 
 void Surfaces::calculateEDT()
 {
-  // pass the molecule to the EDT, plus the surface type
-  // get back a Cube object in m_cube
+  if (!m_molecule || !m_dialog || d->surfaceWatcher.isRunning())
+    return;
+
+  Core::MolecularSurface::Type type;
+  switch (m_dialog->surfaceType()) {
+    case VanDerWaals:
+      type = Core::MolecularSurface::VanDerWaals;
+      break;
+    case SolventAccessible:
+      type = Core::MolecularSurface::SolventAccessible;
+      break;
+    default:
+      type = Core::MolecularSurface::SolventExcluded;
+      break;
+  }
+
+  // Reset state, as for the QM surfaces.
+  waitForSurface();
+  clearOrbitalCubes();
+  m_molecule->clearCubes();
+  m_molecule->clearMeshes();
+  m_mesh1 = nullptr;
+  m_mesh2 = nullptr;
+  m_molecule->emitChanged(Molecule::Atoms | Molecule::Added);
+
+  // The surface is calculated from a copy of the atoms, so the molecule can
+  // still be edited in the meantime.
+  const Core::Molecule& molecule = *m_molecule;
+  const Core::Array<Vector3>& atomPositions = molecule.atomPositions3d();
+  std::vector<Vector3> positions(atomPositions.begin(), atomPositions.end());
+  std::vector<double> radii(molecule.atomCount());
+  for (Index i = 0; i < radii.size(); ++i)
+    radii[i] = Core::Elements::radiusVDW(molecule.atomicNumber(i));
+
+  // The padding leaves room for the largest atoms plus the probe.
+  m_cube = m_molecule->addCube();
+  m_cube->setLimits(*m_molecule, m_dialog->resolution(), 5.0);
+  m_isoValue = 0.0f;
+
+  // The cube is locked until the surface is done, and unlocked again in
+  // surfaceFinished() on this thread.
+  Core::Cube* cube = m_cube;
+  cube->lock()->lock();
+  d->surfaceCube = cube;
+  d->surfaceWatcher.setFuture(
+    QtConcurrent::run([cube, positions, radii, type]() {
+      Core::MolecularSurface surface;
+      surface.calculate(positions, radii, *cube, type);
+    }));
+}
+
+void Surfaces::surfaceFinished()
+{
+  // Nothing to show if the cube was released early by waitForSurface().
+  if (!d->surfaceCube)
+    return;
+
+  d->surfaceCube->lock()->unlock();
+  d->surfaceCube = nullptr;
+  displayMesh();
+}
+
+void Surfaces::waitForSurface()
+{
+  // The cube belongs to the molecule, it must not be deleted while the
+  // surface is written into it.
+  if (d->surfaceWatcher.isRunning())
+    d->surfaceWatcher.waitForFinished();
+  if (d->surfaceCube) {
+    d->surfaceCube->lock()->unlock();
+    d->surfaceCube = nullptr;
+  }
 }
 
 void Surfaces::calculateQM()
@@ -200,6 +287,7 @@ void Surfaces::calculateQM()
     return; // nothing to do
 
   // Reset state a little more frequently, minimal cost, avoid bugs.
+  waitForSurface();
   m_molecule->clearCubes();
   m_molecule->clearMeshes();
   m_cube = nullptr;
@@ -226,8 +314,9 @@ void Surfaces::calculateQM()
   // TODO: Check to see if this cube or surface has already been computed
   if (!m_progressDialog) {
     m_progressDialog = new QProgressDialog(qobject_cast<QWidget*>(parent()));
-    m_progressDialog->setCancelButtonText(nullptr);
+    m_progressDialog->setCancelButtonText(tr("Cancel"));
     m_progressDialog->setWindowModality(Qt::NonModal);
+    connect(m_progressDialog, SIGNAL(canceled()), SLOT(cancelCalculation()));
     connectSlots = true;
   }
 
@@ -251,9 +340,31 @@ void Surfaces::calculateQM()
 
   else if (type == MolecularOrbital) {
     progressText = tr("Calculating molecular orbital %L1").arg(index);
-    if (dynamic_cast<GaussianSet*>(m_basis)) {
-      m_gaussianConcurrent->calculateMolecularOrbital(m_cube, index,
-                                                      m_dialog->beta());
+    auto gaussian = dynamic_cast<GaussianSet*>(m_basis);
+    bool beta = m_dialog->beta();
+    if (gaussian && loadOrbitalCube(index, beta)) {
+      // Already calculated along with a neighboring orbital.
+      displayMesh();
+      return;
+    } else if (gaussian && m_dialog->precomputeOrbitals()) {
+      // Calculate the orbitals around the requested one in a single pass.
+      clearOrbitalCubes();
+      int count = static_cast<int>(
+        gaussian->moMatrix(beta ? GaussianSet::Beta : GaussianSet::Paired)
+          .cols());
+      for (int i = std::max(0, index - 2); i <= std::min(count - 1, index + 2);
+           ++i) {
+        auto cube = new Cube;
+        cube->setLimits(*m_cube);
+        m_orbitalCubes.push_back(cube);
+        m_orbitalIndices.push_back(static_cast<unsigned int>(i));
+      }
+      m_orbitalsBeta = beta;
+      m_pendingOrbital = index;
+      m_gaussianConcurrent->calculateMolecularOrbitals(m_orbitalCubes,
+                                                       m_orbitalIndices, beta);
+    } else if (gaussian) {
+      m_gaussianConcurrent->calculateMolecularOrbital(m_cube, index, beta);
     } else {
       m_slaterConcurrent->calculateMolecularOrbital(m_cube, index);
     }
@@ -276,6 +387,8 @@ void Surfaces::calculateQM()
               SIGNAL(progressRangeChanged(int, int)), m_progressDialog,
               SLOT(setRange(int, int)));
       connect(m_gaussianConcurrent, SIGNAL(finished()), SLOT(displayMesh()));
+      connect(m_gaussianConcurrent, SIGNAL(canceled()),
+              SLOT(calculationCanceled()));
     }
   } else {
     // slaters
@@ -285,15 +398,70 @@ void Surfaces::calculateQM()
     m_progressDialog->setValue(m_slaterConcurrent->watcher().progressValue());
     m_progressDialog->show();
 
-    connect(&m_slaterConcurrent->watcher(), SIGNAL(progressValueChanged(int)),
-            m_progressDialog, SLOT(setValue(int)));
-    connect(&m_slaterConcurrent->watcher(),
-            SIGNAL(progressRangeChanged(int, int)), m_progressDialog,
-            SLOT(setRange(int, int)));
-    connect(m_slaterConcurrent, SIGNAL(finished()), SLOT(displayMesh()));
+    if (connectSlots) {
+      connect(&m_slaterConcurrent->watcher(),
+              SIGNAL(progressValueChanged(int)), m_progressDialog,
+              SLOT(setValue(int)));
+      connect(&m_slaterConcurrent->watcher(),
+              SIGNAL(progressRangeChanged(int, int)), m_progressDialog,
+              SLOT(setRange(int, int)));
+      connect(m_slaterConcurrent, SIGNAL(finished()), SLOT(displayMesh()));
+      connect(m_slaterConcurrent, SIGNAL(canceled()),
+              SLOT(calculationCanceled()));
+    }
   }
 }
 
+void Surfaces::cancelCalculation()
+{
+  // The workers finish the tiles they have started and skip the rest, the
+  // concurrent calculators then report back through canceled().
+  if (m_gaussianConcurrent)
+    m_gaussianConcurrent->watcher().cancel();
+  if (m_slaterConcurrent)
+    m_slaterConcurrent->watcher().cancel();
+}
+
+void Surfaces::calculationCanceled()
+{
+  // Partially computed cubes cannot be reused.
+  clearOrbitalCubes();
+  if (m_progressDialog)
+    m_progressDialog->hide();
+  if (m_dialog)
+    m_dialog->reenableCalculateButton();
+}
+
+void Surfaces::clearOrbitalCubes()
+{
+  for (size_t i = 0; i < m_orbitalCubes.size(); ++i)
+    delete m_orbitalCubes[i];
+  m_orbitalCubes.clear();
+  m_orbitalIndices.clear();
+  m_pendingOrbital = -1;
+}
+
+bool Surfaces::loadOrbitalCube(unsigned int index, bool beta)
+{
+  if (!m_cube || beta != m_orbitalsBeta)
+    return false;
+
+  for (size_t i = 0; i < m_orbitalIndices.size(); ++i) {
+    const Cube* cube = m_orbitalCubes[i];
+    // The grid depends on the geometry and resolution, so it must match too.
+    if (m_orbitalIndices[i] == index &&
+        cube->dimensions() == m_cube->dimensions() &&
+        cube->min() == m_cube->min() && cube->spacing() == m_cube->spacing()) {
+      if (cube->precision() == Cube::Float)
+        m_cube->setData(*cube->floatData());
+      else
+        m_cube->setData(*cube->data());
+      return true;
+    }
+  }
+  return false;
+}
+
 void Surfaces::calculateCube()
 {
   if (!m_dialog || m_cubes.size() == 0)
@@ -314,6 +482,8 @@ void Surfaces::stepChanged(int n)
   auto g = dynamic_cast<GaussianSet*>(m_basis);
   if (g) {
     g->setActiveSetStep(n - 1);
+    waitForSurface();
+    clearOrbitalCubes();
     m_molecule->clearCubes();
     m_molecule->clearMeshes();
     m_cube = nullptr;
@@ -328,6 +498,13 @@ void Surfaces::displayMesh()
   if (!m_cube)
     return;
 
+  if (m_pendingOrbital >= 0) {
+    // The orbitals were calculated into the precomputed cubes.
+    loadOrbitalCube(static_cast<unsigned int>(m_pendingOrbital),
+                    m_orbitalsBeta);
+    m_pendingOrbital = -1;
+  }
+
   if (!m_mesh1)
     m_mesh1 = m_molecule->addMesh();
   if (!m_meshGenerator1) {
@@ -336,6 +513,15 @@ void Surfaces::displayMesh()
   }
   m_meshGenerator1->initialize(m_cube, m_mesh1, m_isoValue);
 
+  // The van der Waals and solvent surfaces only have one side.
+  Type type = m_dialog ? m_dialog->surfaceType() : Unknown;
+  if (type == VanDerWaals || type == SolventAccessible ||
+      type == SolventExcluded) {
+    m_meshGenerator1->start();
+    m_meshesLeft = 1;
+    return;
+  }
+
   // TODO - only do this if we're generating an orbital
   //    and we need two meshes
   //   How do we know? - likely ask the cube if it's an MO?
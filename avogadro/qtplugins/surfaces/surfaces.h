@@ -82,9 +82,12 @@ private slots:
   void calculateEDT();
   void calculateQM();
   void calculateCube();
+  void cancelCalculation();
+  void calculationCanceled();
 
   void stepChanged(int);
 
+  void surfaceFinished();
   void displayMesh();
   void meshFinished();
 
@@ -92,6 +95,11 @@ private slots:
   void movieFrame();
 
 private:
+  // Wait for the surface being calculated, if any, and unlock its cube.
+  void waitForSurface();
+  void clearOrbitalCubes();
+  bool loadOrbitalCube(unsigned int index, bool beta);
+
   QList<QAction*> m_actions;
   QProgressDialog* m_progressDialog = nullptr;
 
@@ -108,6 +116,13 @@ private:
   QtGui::MeshGenerator* m_meshGenerator1 = nullptr;
   QtGui::MeshGenerator* m_meshGenerator2 = nullptr;
 
+  // Orbitals calculated in the same pass as the last requested orbital, so
+  // that its neighbors can be shown without recalculating.
+  std::vector<Core::Cube*> m_orbitalCubes;
+  std::vector<unsigned int> m_orbitalIndices;
+  bool m_orbitalsBeta = false;
+  int m_pendingOrbital = -1;
+
   float m_isoValue = 0.01;
   int m_meshesLeft = 0;
 
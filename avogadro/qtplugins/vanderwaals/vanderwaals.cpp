@@ -18,6 +18,7 @@
 
 #include <avogadro/core/elements.h>
 #include <avogadro/core/molecule.h>
+#include <avogadro/qtgui/molecule.h>
 #include <avogadro/rendering/geometrynode.h>
 #include <avogadro/rendering/groupnode.h>
 #include <avogadro/rendering/spheregeometry.h>
@@ -59,6 +60,44 @@ void VanDerWaals::process(const Core::Molecule& molecule,
   }
 }
 
+bool VanDerWaals::processChanges(const Core::Molecule& molecule,
+                                 Rendering::GroupNode& node,
+                                 unsigned int changes)
+{
+  // Moving or selecting atoms keeps the same spheres, anything else may add
+  // or remove some.
+  if (!(changes & (QtGui::Molecule::Positions | QtGui::Molecule::Selection)) ||
+      changes & (QtGui::Molecule::Added | QtGui::Molecule::Removed |
+                 QtGui::Molecule::Bonds)) {
+    return false;
+  }
+
+  GeometryNode* geometry =
+    node.childCount() == 1 ? dynamic_cast<GeometryNode*>(node.child(0))
+                           : nullptr;
+  if (!geometry || geometry->drawables().size() != 1)
+    return false;
+  SphereGeometry* spheres =
+    dynamic_cast<SphereGeometry*>(geometry->drawable(0));
+  if (!spheres || spheres->identifier().molecule != &molecule ||
+      spheres->size() != molecule.atomCount()) {
+    return false;
+  }
+
+  // The selection is not shown, so only moved atoms change anything.
+  if (!(changes & QtGui::Molecule::Positions))
+    return true;
+  for (Index i = 0; i < molecule.atomCount(); ++i) {
+    Core::Atom atom = molecule.atom(i);
+    unsigned char atomicNumber = atom.atomicNumber();
+    const unsigned char* c = Elements::color(atomicNumber);
+    Vector3ub color(c[0], c[1], c[2]);
+    spheres->setSphere(i, atom.position3d().cast<float>(), color,
+                       static_cast<float>(Elements::radiusVDW(atomicNumber)));
+  }
+  return true;
+}
+
 bool VanDerWaals::isEnabled() const
 {
   return m_enabled;
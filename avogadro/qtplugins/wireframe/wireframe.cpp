@@ -18,6 +18,7 @@
 
 #include <avogadro/core/elements.h>
 #include <avogadro/core/molecule.h>
+#include <avogadro/qtgui/molecule.h>
 #include <avogadro/rendering/geometrynode.h>
 #include <avogadro/rendering/groupnode.h>
 #include <avogadro/rendering/linestripgeometry.h>
@@ -82,6 +83,47 @@ void Wireframe::process(const Molecule& molecule, Rendering::GroupNode& node)
   }
 }
 
+bool Wireframe::processChanges(const Molecule& molecule,
+                               Rendering::GroupNode& node,
+                               unsigned int changes)
+{
+  // Moving or selecting atoms keeps the same lines, anything else may add or
+  // remove some.
+  if (!(changes & (QtGui::Molecule::Positions | QtGui::Molecule::Selection)) ||
+      changes & (QtGui::Molecule::Added | QtGui::Molecule::Removed |
+                 QtGui::Molecule::Bonds)) {
+    return false;
+  }
+
+  GeometryNode* geometry =
+    node.childCount() == 1 ? dynamic_cast<GeometryNode*>(node.child(0))
+                           : nullptr;
+  if (!geometry || geometry->drawables().size() != 1)
+    return false;
+  LineStripGeometry* lines =
+    dynamic_cast<LineStripGeometry*>(geometry->drawable(0));
+  if (!lines || lines->identifier().molecule != &molecule)
+    return false;
+
+  // The selection is not shown, so only moved atoms change anything.
+  if (!(changes & QtGui::Molecule::Positions))
+    return true;
+  const size_t vertexCount = lines->vertices().size();
+  size_t vertex = 0;
+  for (Index i = 0; i < molecule.bondCount(); ++i) {
+    Core::Bond bond = molecule.bond(i);
+    if (!m_showHydrogens && (bond.atom1().atomicNumber() == 1 ||
+                             bond.atom2().atomicNumber() == 1)) {
+      continue;
+    }
+    if (vertex + 2 > vertexCount)
+      return false;
+    lines->setVertex(vertex++, bond.atom1().position3d().cast<float>());
+    lines->setVertex(vertex++, bond.atom2().position3d().cast<float>());
+  }
+  return vertex == vertexCount;
+}
+
 bool Wireframe::isEnabled() const
 {
   return m_enabled;
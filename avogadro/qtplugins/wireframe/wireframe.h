@@ -36,6 +36,10 @@ public:
   void process(const Core::Molecule& molecule,
                Rendering::GroupNode& node) override;
 
+  bool processChanges(const Core::Molecule& molecule,
+                      Rendering::GroupNode& node,
+                      unsigned int changes) override;
+
   QString name() const override { return tr("Wireframe"); }
 
   QString description() const override
@@ -121,11 +121,13 @@ bool GaussianCube::read(std::istream& in, Core::Molecule& molecule)
     // Get a cube object from molecule
     Core::Cube* cube = molecule.addCube();
 
+    // The file has six significant figures, which single precision holds.
+    cube->setPrecision(Core::Cube::Float);
     cube->setLimits(min, dim, spacing);
-    std::vector<double> values;
+    std::vector<float> values;
     // push_back is slow for this, resize vector first
-    values.resize(dim(0) * dim(1) * dim(2));
-    for (unsigned int j = 0; j < values.size(); ++j)
+    values.resize(cube->pointCount());
+    for (size_t j = 0; j < values.size(); ++j)
       in >> values[j];
     // clear buffer, if more than one cube
     getline(in, line);
@@ -22,7 +22,6 @@
 
 #include "bufferobject.h"
 
-#include "shader.h"
 #include "shaderprogram.h"
 
 #include "visitor.h"
@@ -882,15 +881,16 @@ class SphereAmbientOcclusionRenderer : public AmbientOcclusionRenderer
 public:
   SphereAmbientOcclusionRenderer(BufferObject& vbo, BufferObject& ibo,
                                  int numSpheres, int numVertices,
-                                 int numIndices)
-    : m_vbo(vbo)
+                                 int numIndices, ShaderProgram& depthProgram,
+                                 ShaderProgram& aoProgram)
+    : m_depthProgram(depthProgram)
+    , m_aoProgram(aoProgram)
+    , m_vbo(vbo)
     , m_ibo(ibo)
     , m_numSpheres(numSpheres)
     , m_numVertices(numVertices)
     , m_numIndices(numIndices)
-  {
-    initialize();
-  }
+  {}
 
   void renderDepth(const Eigen::Matrix4f& modelView,
                    const Eigen::Matrix4f& projection) override
@@ -1016,61 +1016,10 @@ public:
     m_aoProgram.release();
   }
 
-  void destroy()
-  {
-    // depth shader
-    m_depthProgram.detachShader(m_depthVertexShader);
-    m_depthProgram.detachShader(m_depthFragmentShader);
-    m_depthFragmentShader.cleanup();
-    m_depthVertexShader.cleanup();
-    // ao shader
-    m_aoProgram.detachShader(m_aoVertexShader);
-    m_aoProgram.detachShader(m_aoFragmentShader);
-    m_aoVertexShader.cleanup();
-    m_aoFragmentShader.cleanup();
-  }
-
 private:
-  void initialize()
-  {
-    // compile depth shaders
-    m_depthVertexShader.setType(Shader::Vertex);
-    m_depthVertexShader.setSource(sphere_ao_depth_vs);
-    if (!m_depthVertexShader.compile())
-      cout << m_depthVertexShader.error() << endl;
-    m_depthFragmentShader.setType(Shader::Fragment);
-    m_depthFragmentShader.setSource(sphere_ao_depth_fs);
-    if (!m_depthFragmentShader.compile())
-      cout << m_depthFragmentShader.error() << endl;
-    // link depth program
-    m_depthProgram.attachShader(m_depthVertexShader);
-    m_depthProgram.attachShader(m_depthFragmentShader);
-    if (!m_depthProgram.link())
-      cout << m_depthProgram.error() << endl;
-
-    // compile AO shaders
-    m_aoVertexShader.setType(Shader::Vertex);
-    m_aoVertexShader.setSource(sphere_ao_bake_vs);
-    if (!m_aoVertexShader.compile())
-      cout << m_aoVertexShader.error() << endl;
-    m_aoFragmentShader.setType(Shader::Fragment);
-    m_aoFragmentShader.setSource(sphere_ao_bake_fs);
-    if (!m_aoFragmentShader.compile())
-      cout << m_aoFragmentShader.error() << endl;
-    // link AO program
-    m_aoProgram.attachShader(m_aoVertexShader);
-    m_aoProgram.attachShader(m_aoFragmentShader);
-    if (!m_aoProgram.link())
-      cout << m_aoProgram.error() << endl;
-  }
-
-  Shader m_depthVertexShader;
-  Shader m_depthFragmentShader;
-  ShaderProgram m_depthProgram;
-
-  Shader m_aoVertexShader;
-  Shader m_aoFragmentShader;
-  ShaderProgram m_aoProgram;
+  // Owned by the shader cache of the geometry.
+  ShaderProgram& m_depthProgram;
+  ShaderProgram& m_aoProgram;
 
   BufferObject& m_vbo;
   BufferObject& m_ibo;
@@ -1083,15 +1032,14 @@ class AmbientOcclusionSphereGeometry::Private
 {
 public:
   Private()
-    : aoTextureSize(1024)
+    : program(nullptr)
+    , aoTextureSize(1024)
   {}
 
   BufferObject vbo;
   BufferObject ibo;
 
-  Shader vertexShader;
-  Shader fragmentShader;
-  ShaderProgram program;
+  ShaderProgram* program;
 
   size_t numberOfVertices;
   size_t numberOfIndices;
@@ -1132,6 +1080,14 @@ void AmbientOcclusionSphereGeometry::update()
 
   // Check if the VBOs are ready, if not get them ready.
   if (!d->vbo.ready() || m_dirty) {
+    // The programs that bake the occlusion into the texture.
+    ShaderProgram* depthProgram =
+      shaderProgram(sphere_ao_depth_vs, sphere_ao_depth_fs);
+    ShaderProgram* aoProgram =
+      shaderProgram(sphere_ao_bake_vs, sphere_ao_bake_fs);
+    if (!depthProgram || !aoProgram)
+      return;
+
     std::vector<unsigned int> sphereIndices;
     std::vector<ColorTextureVertex> sphereVertices;
     sphereIndices.reserve(m_indices.size() * 4);
@@ -1211,31 +1167,17 @@ void AmbientOcclusionSphereGeometry::update()
     SphereAmbientOcclusionRenderer aoSphereRenderer(
       d->vbo, d->ibo, static_cast<int>(m_spheres.size()),
       static_cast<int>(d->numberOfVertices),
-      static_cast<int>(d->numberOfIndices));
+      static_cast<int>(d->numberOfIndices), *depthProgram, *aoProgram);
     AmbientOcclusionBaker baker(&aoSphereRenderer, d->aoTextureSize);
     baker.accumulateAO(center, radius + 2.0f);
     d->aoTexture = baker.aoTexture();
     baker.destroy();
-    aoSphereRenderer.destroy();
 
     m_dirty = false;
   }
 
-  // Build and link the shader if it has not been used yet.
-  if (d->vertexShader.type() == Shader::Unknown) {
-    d->vertexShader.setType(Shader::Vertex);
-    d->vertexShader.setSource(sphere_ao_render_vs);
-    d->fragmentShader.setType(Shader::Fragment);
-    d->fragmentShader.setSource(sphere_ao_render_fs);
-    if (!d->vertexShader.compile())
-      cout << d->vertexShader.error() << endl;
-    if (!d->fragmentShader.compile())
-      cout << d->fragmentShader.error() << endl;
-    d->program.attachShader(d->vertexShader);
-    d->program.attachShader(d->fragmentShader);
-    if (!d->program.link())
-      cout << d->program.error() << endl;
-  }
+  // The cache builds the program the first time it is asked for it.
+  d->program = shaderProgram(sphere_ao_render_vs, sphere_ao_render_fs);
 }
 
 void AmbientOcclusionSphereGeometry::render(const Camera& camera)
@@ -1249,58 +1191,61 @@ void AmbientOcclusionSphereGeometry::render(const Camera& camera)
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, d->aoTexture);
 
-  if (!d->program.bind())
-    cout << d->program.error() << endl;
+  if (!d->program)
+    return;
+  if (!d->program->bind())
+    cout << d->program->error() << endl;
 
   d->vbo.bind();
   d->ibo.bind();
 
   // Set up our attribute arrays.
-  if (!d->program.enableAttributeArray("a_pos"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray("a_pos", ColorTextureVertex::vertexOffset(),
-                                    sizeof(ColorTextureVertex), FloatType, 3,
-                                    ShaderProgram::NoNormalize)) {
-    cout << d->program.error() << endl;
+  if (!d->program->enableAttributeArray("a_pos"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray(
+        "a_pos", ColorTextureVertex::vertexOffset(), sizeof(ColorTextureVertex),
+        FloatType, 3, ShaderProgram::NoNormalize)) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.enableAttributeArray("a_corner"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray(
+  if (!d->program->enableAttributeArray("a_corner"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray(
         "a_corner", ColorTextureVertex::textureCoordOffset(),
         sizeof(ColorTextureVertex), FloatType, 2, ShaderProgram::NoNormalize)) {
-    cout << d->program.error() << endl;
+    cout << d->program->error() << endl;
   }
-  if (!d->program.enableAttributeArray("a_tileOffset"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray(
+  if (!d->program->enableAttributeArray("a_tileOffset"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray(
         "a_tileOffset", ColorTextureVertex::textureCoord2Offset(),
         sizeof(ColorTextureVertex), FloatType, 2, ShaderProgram::NoNormalize)) {
-    cout << d->program.error() << endl;
+    cout << d->program->error() << endl;
   }
-  if (!d->program.enableAttributeArray("a_color"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray(
+  if (!d->program->enableAttributeArray("a_color"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray(
         "a_color", ColorTextureVertex::colorOffset(),
         sizeof(ColorTextureVertex), UCharType, 3, ShaderProgram::Normalize)) {
-    cout << d->program.error() << endl;
+    cout << d->program->error() << endl;
   }
 
   // Set up our uniforms
-  if (!d->program.setUniformValue("u_modelView", camera.modelView().matrix())) {
-    cout << d->program.error() << endl;
+  if (!d->program->setUniformValue("u_modelView",
+                                   camera.modelView().matrix())) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.setUniformValue(
+  if (!d->program->setUniformValue(
         "u_invModelView",
         Eigen::Matrix3f(
           camera.modelView().matrix().block<3, 3>(0, 0).inverse()))) {
-    cout << d->program.error() << endl;
+    cout << d->program->error() << endl;
   }
-  if (!d->program.setUniformValue("u_projection",
-                                  camera.projection().matrix())) {
-    cout << d->program.error() << endl;
+  if (!d->program->setUniformValue("u_projection",
+                                   camera.projection().matrix())) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.setUniformValue("u_tex", 0)) {
-    cout << d->program.error() << endl;
+  if (!d->program->setUniformValue("u_tex", 0)) {
+    cout << d->program->error() << endl;
   }
 
   // To avoid texture interpolation from neighboring tiles, texture coords are
@@ -1316,11 +1261,11 @@ void AmbientOcclusionSphereGeometry::render(const Camera& camera)
   // values matching exactly one tile. The numerator is one minus a factor
   // to ensure half a tile on each side is never reached to avoid texture
   // interpolation taking values from neighboring texels into account.
-  if (!d->program.setUniformValue(
+  if (!d->program->setUniformValue(
         "u_texScale", (1.0f - 2.0f * texel / tile) /
                         (2.0f * std::ceil(std::sqrt(
-                                  static_cast<float>(m_spheres.size())))))) {
-    cout << d->program.error() << endl;
+                                   static_cast<float>(m_spheres.size())))))) {
+    cout << d->program->error() << endl;
   }
 
   // Render the loaded spheres using the shader and bound VBO.
@@ -1331,12 +1276,12 @@ void AmbientOcclusionSphereGeometry::render(const Camera& camera)
   d->vbo.release();
   d->ibo.release();
 
-  d->program.disableAttributeArray("a_pos");
-  d->program.disableAttributeArray("a_color");
-  d->program.disableAttributeArray("a_corner");
-  d->program.disableAttributeArray("a_tileOffset");
+  d->program->disableAttributeArray("a_pos");
+  d->program->disableAttributeArray("a_color");
+  d->program->disableAttributeArray("a_corner");
+  d->program->disableAttributeArray("a_tileOffset");
 
-  d->program.release();
+  d->program->release();
 }
 
 std::multimap<float, Identifier> AmbientOcclusionSphereGeometry::hits(
@@ -20,7 +20,6 @@
 #include "bufferobject.h"
 #include "camera.h"
 #include "scene.h"
-#include "shader.h"
 #include "shaderprogram.h"
 #include "visitor.h"
 
@@ -48,10 +47,9 @@ namespace Rendering {
 class ArrowGeometry::Private
 {
 public:
-  Private() {}
+  Private() : program(nullptr) {}
 
-  Shader vertexShader;
-  ShaderProgram program;
+  ShaderProgram* program;
 };
 
 ArrowGeometry::ArrowGeometry() : m_dirty(false), d(new Private) {}
@@ -76,16 +74,8 @@ void ArrowGeometry::update()
   if (m_vertices.empty())
     return;
 
-  // Build and link the shader if it has not been used yet.
-  if (d->vertexShader.type() == Shader::Unknown) {
-    d->vertexShader.setType(Shader::Vertex);
-    d->vertexShader.setSource(arrow_vs);
-    if (!d->vertexShader.compile())
-      cout << d->vertexShader.error() << endl;
-    d->program.attachShader(d->vertexShader);
-    if (!d->program.link())
-      cout << d->program.error() << endl;
-  }
+  // The cache builds the program the first time it is asked for it.
+  d->program = shaderProgram(arrow_vs, nullptr);
 }
 
 void ArrowGeometry::render(const Camera& camera)
@@ -96,15 +86,18 @@ void ArrowGeometry::render(const Camera& camera)
   // Prepare the shader program if necessary.
   update();
 
-  if (!d->program.bind())
-    cout << d->program.error() << endl;
+  if (!d->program)
+    return;
+  if (!d->program->bind())
+    cout << d->program->error() << endl;
 
   // Set up our uniforms (model-view and projection matrices right now).
-  if (!d->program.setUniformValue("modelView", camera.modelView().matrix())) {
-    cout << d->program.error() << endl;
+  if (!d->program->setUniformValue("modelView", camera.modelView().matrix())) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.setUniformValue("projection", camera.projection().matrix())) {
-    cout << d->program.error() << endl;
+  if (!d->program->setUniformValue("projection",
+                                   camera.projection().matrix())) {
+    cout << d->program->error() << endl;
   }
 
   // Render the arrows using the shader.
@@ -117,7 +110,7 @@ void ArrowGeometry::render(const Camera& camera)
     drawCone(v3, m_vertices[startIndex].second, 0.05, 1.0);
   }
 
-  d->program.release();
+  d->program->release();
 }
 
 void ArrowGeometry::clear()
@@ -0,0 +1,147 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include "boundingvolumehierarchy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Avogadro {
+namespace Rendering {
+
+namespace {
+// The most primitives in a leaf.
+const size_t leafSize = 4;
+} // namespace
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+}
+
+void BoundingVolumeHierarchy::build(const std::vector<Box>& boxes)
+{
+  clear();
+  if (boxes.empty())
+    return;
+
+  std::vector<Vector3f> centers;
+  centers.reserve(boxes.size());
+  m_primitives.reserve(boxes.size());
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    centers.push_back(0.5f * (boxes[i].min + boxes[i].max));
+    m_primitives.push_back(i);
+  }
+
+  m_nodes.reserve(2 * boxes.size() / leafSize + 1);
+  m_nodes.push_back(Node());
+  buildNode(0, 0, boxes.size(), boxes, centers);
+}
+
+void BoundingVolumeHierarchy::clear()
+{
+  m_nodes.clear();
+  m_primitives.clear();
+}
+
+void BoundingVolumeHierarchy::intersect(const Vector3f& origin,
+                                        const Vector3f& direction,
+                                        std::vector<size_t>& primitives) const
+{
+  if (m_nodes.empty())
+    return;
+
+  const Vector3f inverse = direction.cwiseInverse();
+  std::vector<size_t> stack(1, 0);
+  while (!stack.empty()) {
+    const Node& node = m_nodes[stack.back()];
+    stack.pop_back();
+    float nodeDistance;
+    if (!lineDistance(node, origin, inverse, nodeDistance))
+      continue;
+    if (node.count > 0) {
+      primitives.insert(primitives.end(), m_primitives.begin() + node.first,
+                        m_primitives.begin() + node.first + node.count);
+    } else {
+      stack.push_back(node.first);
+      stack.push_back(node.first + 1);
+    }
+  }
+}
+
+void BoundingVolumeHierarchy::buildNode(size_t node, size_t begin, size_t end,
+                                        const std::vector<Box>& boxes,
+                                        const std::vector<Vector3f>& centers)
+{
+  Vector3f min = boxes[m_primitives[begin]].min;
+  Vector3f max = boxes[m_primitives[begin]].max;
+  Vector3f centerMin = centers[m_primitives[begin]];
+  Vector3f centerMax = centerMin;
+  for (size_t i = begin + 1; i < end; ++i) {
+    const size_t primitive = m_primitives[i];
+    min = min.cwiseMin(boxes[primitive].min);
+    max = max.cwiseMax(boxes[primitive].max);
+    centerMin = centerMin.cwiseMin(centers[primitive]);
+    centerMax = centerMax.cwiseMax(centers[primitive]);
+  }
+  m_nodes[node].min = min;
+  m_nodes[node].max = max;
+
+  // Split the primitives in half along the longest side of the box around
+  // their centers, unless there are few enough of them for a leaf.
+  int axis;
+  const float extent = (centerMax - centerMin).maxCoeff(&axis);
+  if (end - begin <= leafSize || extent <= 0.0f) {
+    m_nodes[node].first = begin;
+    m_nodes[node].count = end - begin;
+    return;
+  }
+
+  const size_t middle = begin + (end - begin) / 2;
+  std::nth_element(m_primitives.begin() + begin,
+                   m_primitives.begin() + middle, m_primitives.begin() + end,
+                   [&centers, axis](size_t a, size_t b) {
+                     return centers[a][axis] < centers[b][axis];
+                   });
+
+  const size_t children = m_nodes.size();
+  m_nodes[node].first = children;
+  m_nodes[node].count = 0;
+  m_nodes.push_back(Node());
+  m_nodes.push_back(Node());
+  buildNode(children, begin, middle, boxes, centers);
+  buildNode(children + 1, middle, end, boxes, centers);
+}
+
+bool BoundingVolumeHierarchy::lineDistance(const Node& node,
+                                           const Vector3f& origin,
+                                           const Vector3f& inverseDirection,
+                                           float& distance)
+{
+  // Clip the line to each pair of planes around the node in turn.
+  float tNear = -std::numeric_limits<float>::max();
+  float tFar = std::numeric_limits<float>::max();
+  for (int i = 0; i < 3; ++i) {
+    if (std::isinf(inverseDirection[i])) {
+      // The line is parallel to the planes.
+      if (origin[i] < node.min[i] || origin[i] > node.max[i])
+        return false;
+      continue;
+    }
+    float t1 = (node.min[i] - origin[i]) * inverseDirection[i];
+    float t2 = (node.max[i] - origin[i]) * inverseDirection[i];
+    if (t1 > t2)
+      std::swap(t1, t2);
+    tNear = std::max(tNear, t1);
+    tFar = std::min(tFar, t2);
+    if (tNear > tFar)
+      return false;
+  }
+  distance = std::max(0.0f, std::max(tNear, -tFar));
+  return true;
+}
+
+} // End Rendering namespace
+} // End Avogadro namespace
@@ -0,0 +1,163 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#ifndef AVOGADRO_RENDERING_BOUNDINGVOLUMEHIERARCHY_H
+#define AVOGADRO_RENDERING_BOUNDINGVOLUMEHIERARCHY_H
+
+#include "avogadrorenderingexport.h"
+
+#include <avogadro/core/vector.h>
+
+#include <utility>
+#include <vector>
+
+namespace Avogadro {
+namespace Rendering {
+
+/**
+ * @class BoundingVolumeHierarchy boundingvolumehierarchy.h
+ * <avogadro/rendering/boundingvolumehierarchy.h>
+ * @brief The BoundingVolumeHierarchy class finds the primitives near a ray.
+ *
+ * The hierarchy is a binary tree of axis aligned boxes over the boxes of the
+ * primitives of a geometry, which is used to pick from large geometries
+ * without testing the ray against every primitive.
+ */
+class AVOGADRORENDERING_EXPORT BoundingVolumeHierarchy
+{
+public:
+  /** The box around a primitive. */
+  struct Box
+  {
+    Box(const Vector3f& min_, const Vector3f& max_) : min(min_), max(max_) {}
+    Vector3f min;
+    Vector3f max;
+  };
+
+  BoundingVolumeHierarchy();
+
+  /**
+   * Build the hierarchy over @a boxes, which are identified by their index.
+   */
+  void build(const std::vector<Box>& boxes);
+
+  /** Remove all of the primitives. */
+  void clear();
+
+  /** @return True if the hierarchy holds no primitives. */
+  bool isEmpty() const { return m_nodes.empty(); }
+
+  /**
+   * Get the primitives whose boxes the line through @a origin along
+   * @a direction passes through, in no particular order.
+   */
+  void intersect(const Vector3f& origin, const Vector3f& direction,
+                 std::vector<size_t>& primitives) const;
+
+  /**
+   * Find the primitive hit closest to @a origin along the line through it.
+   * The primitives are visited roughly front to back, skipping those whose
+   * boxes are further away than the closest hit found so far.
+   * @param test Called as test(index, distance) for each primitive visited,
+   * it returns true and sets the distance if the primitive is hit.
+   * @param index Set to the index of the closest primitive hit.
+   * @param distance Set to the distance of the closest primitive hit.
+   * @return False if no primitive was hit.
+   */
+  template <typename Test>
+  bool closest(const Vector3f& origin, const Vector3f& direction,
+               const Test& test, size_t& index, float& distance) const;
+
+private:
+  struct Node
+  {
+    Vector3f min;
+    Vector3f max;
+    // A leaf holds count primitives from first on, any other node has its
+    // two children at first and first + 1.
+    size_t first;
+    size_t count;
+  };
+
+  void buildNode(size_t node, size_t begin, size_t end,
+                 const std::vector<Box>& boxes,
+                 const std::vector<Vector3f>& centers);
+
+  /**
+   * Get the distance from @a origin to the closest point of the node on the
+   * line, or 0 if the line is inside of the node at the origin.
+   * @return False if the line misses the node.
+   */
+  static bool lineDistance(const Node& node, const Vector3f& origin,
+                           const Vector3f& inverseDirection, float& distance);
+
+  std::vector<Node> m_nodes;
+  std::vector<size_t> m_primitives;
+};
+
+template <typename Test>
+bool BoundingVolumeHierarchy::closest(const Vector3f& origin,
+                                      const Vector3f& direction,
+                                      const Test& test, size_t& index,
+                                      float& distance) const
+{
+  const Vector3f inverse = direction.cwiseInverse();
+  float nodeDistance;
+  if (m_nodes.empty() ||
+      !lineDistance(m_nodes[0], origin, inverse, nodeDistance)) {
+    return false;
+  }
+
+  bool found = false;
+  std::vector<std::pair<float, size_t>> stack;
+  stack.push_back(std::make_pair(nodeDistance, size_t(0)));
+  while (!stack.empty()) {
+    const std::pair<float, size_t> next = stack.back();
+    stack.pop_back();
+    if (found && next.first > distance)
+      continue;
+
+    const Node& node = m_nodes[next.second];
+    if (node.count > 0) {
+      for (size_t i = node.first; i < node.first + node.count; ++i) {
+        float primitiveDistance;
+        if (test(m_primitives[i], primitiveDistance) &&
+            (!found || primitiveDistance < distance)) {
+          found = true;
+          index = m_primitives[i];
+          distance = primitiveDistance;
+        }
+      }
+      continue;
+    }
+
+    // Push the further child first, so that the nearer one is visited next.
+    float childDistance[2];
+    bool childHit[2];
+    for (size_t c = 0; c < 2; ++c) {
+      childHit[c] = lineDistance(m_nodes[node.first + c], origin, inverse,
+                                 childDistance[c]);
+    }
+    const size_t nearer =
+      !childHit[1] || (childHit[0] && childDistance[0] <= childDistance[1])
+        ? 0
+        : 1;
+    const size_t further = 1 - nearer;
+    if (childHit[further]) {
+      stack.push_back(
+        std::make_pair(childDistance[further], node.first + further));
+    }
+    if (childHit[nearer]) {
+      stack.push_back(
+        std::make_pair(childDistance[nearer], node.first + nearer));
+    }
+  }
+  return found;
+}
+
+} // End Rendering namespace
+} // End Avogadro namespace
+
+#endif // AVOGADRO_RENDERING_BOUNDINGVOLUMEHIERARCHY_H
@@ -70,6 +70,15 @@ public:
   template <class ContainerT>
   bool upload(const ContainerT& array, ObjectType type);
 
+  /**
+   * Replace part of the data uploaded last, starting @a offset values of
+   * ContainerT::value_type into the buffer. The size of the buffer does not
+   * change, so the values must fit inside of it. This is much cheaper than
+   * uploading everything again when only a few values have changed.
+   */
+  template <class ContainerT>
+  bool update(const ContainerT& array, size_t offset);
+
   /** Bind the buffer object ready for rendering.
    * @note Only one ARRAY_BUFFER and one ELEMENT_ARRAY_BUFFER may be bound at
    * any time. */
@@ -83,6 +92,7 @@ public:
 
 private:
   bool uploadInternal(const void* buffer, size_t size, ObjectType objectType);
+  bool updateInternal(const void* buffer, size_t offset, size_t size);
 
   struct Private;
   Private* d;
@@ -104,6 +114,16 @@ inline bool BufferObject::upload(const ContainerT& array,
                         objectType);
 }
 
+template <class ContainerT>
+inline bool BufferObject::update(const ContainerT& array, size_t offset)
+{
+  if (array.empty())
+    return true;
+  const size_t valueSize = sizeof(typename ContainerT::value_type);
+  return updateInternal(&array[0], offset * valueSize,
+                        array.size() * valueSize);
+}
+
 } // End Rendering namespace
 } // End Avogadro namespace
 
@@ -20,13 +20,16 @@
 #include "scene.h"
 #include "visitor.h"
 
+#include "boundingvolumehierarchy.h"
 #include "bufferobject.h"
+#include "identifierbuffer.h"
 
-#include "shader.h"
 #include "shaderprogram.h"
 
 namespace {
 #include "cylinders_fs.h"
+#include "cylinders_instanced_fs.h"
+#include "cylinders_instanced_vs.h"
 #include "cylinders_vs.h"
 }
 
@@ -34,6 +37,7 @@ namespace {
 
 #include <avogadro/core/matrix.h>
 
+#include <algorithm>
 #include <iostream>
 
 using std::cout;
@@ -42,29 +46,232 @@ using std::endl;
 namespace Avogadro {
 namespace Rendering {
 
+namespace {
+// The number of points around each cylinder.
+const unsigned int resolution = 12;
+
+// Offsets of the members of the CylinderColor records used for instancing.
+const int end1Offset = 0;
+const int end2Offset = static_cast<int>(sizeof(Vector3f));
+const int radiusOffset = end2Offset + static_cast<int>(sizeof(Vector3f));
+const int color1Offset = radiusOffset + static_cast<int>(sizeof(float));
+const int color2Offset = color1Offset + static_cast<int>(sizeof(Vector3ub));
+
+// The corners of the box around a cylinder as a single triangle strip.
+const float boxStrip[14][3] = {
+  { -1, 1, 1 },  { 1, 1, 1 },   { -1, -1, 1 }, { 1, -1, 1 },  { 1, -1, -1 },
+  { 1, 1, 1 },   { 1, 1, -1 },  { -1, 1, 1 },  { -1, 1, -1 }, { -1, -1, 1 },
+  { -1, -1, -1 }, { 1, -1, -1 }, { -1, 1, -1 }, { 1, 1, -1 }
+};
+
+// Two vertices, one at either end, for each of the points around the tube.
+void appendVertices(const CylinderColor& cylinder,
+                    std::vector<ColorNormalVertex>& vertices)
+{
+  const float resolutionRadians =
+    2.0f * static_cast<float>(M_PI) / static_cast<float>(resolution);
+  const Vector3f& position1 = cylinder.end1;
+  const Vector3f& position2 = cylinder.end2;
+  const Vector3f direction = (position2 - position1).normalized();
+
+  // Generate the radial vectors
+  Vector3f radial = direction.unitOrthogonal() * cylinder.radius;
+  Eigen::AngleAxisf transform(resolutionRadians, direction);
+  ColorNormalVertex vert(cylinder.color, -direction, position1);
+  ColorNormalVertex vert2(cylinder.color2, -direction, position1);
+  for (unsigned int j = 0; j < resolution; ++j) {
+    vert.normal = radial;
+    vert.vertex = position1 + radial;
+    vertices.push_back(vert);
+    vert2.normal = vert.normal;
+    vert2.vertex = position2 + radial;
+    vertices.push_back(vert2);
+    radial = transform * radial;
+  }
+}
+
+// Intersect the ray with the side of the cylinder, setting depth to the
+// distance from the origin of the ray to where it enters.
+bool intersect(const CylinderColor& cylinder, const Vector3f& rayOrigin,
+               const Vector3f& rayEnd, const Vector3f& rayDirection,
+               float& depth)
+{
+  // Check for cylinder intersection with the ray.
+  Vector3f ao = rayOrigin - cylinder.end1;
+  Vector3f ab = cylinder.end2 - cylinder.end1;
+  Vector3f aoxab = ao.cross(ab);
+  Vector3f vxab = rayDirection.cross(ab);
+
+  float A = vxab.dot(vxab);
+  float B = 2.0f * vxab.dot(aoxab);
+  float C = aoxab.dot(aoxab) - ab.dot(ab) * (cylinder.radius * cylinder.radius);
+  float D = B * B - 4.0f * A * C;
+
+  // no intersection
+  if (D < 0.0f)
+    return false;
+
+  float t = std::min((-B + std::sqrt(D)) / (2.0f * A),
+                     (-B - std::sqrt(D)) / (2.0f * A));
+
+  Vector3f ip = rayOrigin + (rayDirection * t);
+  Vector3f ip1 = ip - cylinder.end1;
+  Vector3f ip2 = ip - (cylinder.end1 + ab);
+
+  // intersection below base or above top of the cylinder
+  if (ip1.dot(ab) < 0.0f || ip2.dot(ab) > 0.0f)
+    return false;
+
+  // Test for clipping
+  Vector3f distance = ip - rayOrigin;
+  if (distance.dot(rayDirection) < 0.0f ||
+      (ip - rayEnd).dot(rayDirection) > 0.0f)
+    return false;
+
+  depth = distance.norm();
+  return true;
+}
+} // namespace
+
 class CylinderGeometry::Private
 {
 public:
-  Private() {}
+  Private() : program(nullptr), instanced(false), identifierCount(0) {}
 
   BufferObject vbo;
   BufferObject ibo;
+  // The corners of the box drawn for each instance.
+  BufferObject corners;
+
+  ShaderProgram* program;
 
-  Shader vertexShader;
-  Shader fragmentShader;
-  ShaderProgram program;
+  // Whether the vbo holds one CylinderColor per cylinder, rather than the
+  // vertices of its tube.
+  bool instanced;
 
   size_t numberOfVertices;
   size_t numberOfIndices;
+
+  BoundingVolumeHierarchy hierarchy;
+
+  // The colors identifying the cylinders in the IdentifierBuffer.
+  BufferObject identifiers;
+  size_t identifierCount;
+
+  // Draw the cylinders with their own colors, or with their identifiers as
+  // drawable number if it is not zero.
+  void renderInstanced(const Camera& camera, size_t count, int number = 0);
+  void updateHierarchy(const std::vector<CylinderColor>& cylinders);
 };
 
-CylinderGeometry::CylinderGeometry() : m_dirty(false), d(new Private)
+void CylinderGeometry::Private::renderInstanced(const Camera& camera,
+                                                size_t count, int number)
+{
+  if (!program->bind())
+    cout << program->error() << endl;
+
+  // The corners advance per vertex, the cylinders once per instance.
+  corners.bind();
+  if (!program->enableAttributeArray("corner") ||
+      !program->useAttributeArray("corner", 0, sizeof(Vector3f), FloatType, 3,
+                                  ShaderProgram::NoNormalize)) {
+    cout << program->error() << endl;
+  }
+  vbo.bind();
+  if (!program->enableAttributeArray("end1") ||
+      !program->useAttributeArray("end1", end1Offset, sizeof(CylinderColor),
+                                  FloatType, 3, ShaderProgram::NoNormalize) ||
+      !program->setAttributeArrayDivisor("end1", 1)) {
+    cout << program->error() << endl;
+  }
+  if (!program->enableAttributeArray("end2") ||
+      !program->useAttributeArray("end2", end2Offset, sizeof(CylinderColor),
+                                  FloatType, 3, ShaderProgram::NoNormalize) ||
+      !program->setAttributeArrayDivisor("end2", 1)) {
+    cout << program->error() << endl;
+  }
+  if (!program->enableAttributeArray("cylinderRadius") ||
+      !program->useAttributeArray("cylinderRadius", radiusOffset,
+                                  sizeof(CylinderColor), FloatType, 1,
+                                  ShaderProgram::NoNormalize) ||
+      !program->setAttributeArrayDivisor("cylinderRadius", 1)) {
+    cout << program->error() << endl;
+  }
+  if (!program->enableAttributeArray("color2") ||
+      !program->useAttributeArray("color2", color2Offset, sizeof(CylinderColor),
+                                  UCharType, 3, ShaderProgram::Normalize) ||
+      !program->setAttributeArrayDivisor("color2", 1)) {
+    cout << program->error() << endl;
+  }
+  if (number != 0) {
+    identifiers.bind();
+    if (!program->enableAttributeArray("color1") ||
+        !program->useAttributeArray("color1", 0, sizeof(Vector3ub), UCharType,
+                                    3, ShaderProgram::Normalize) ||
+        !program->setAttributeArrayDivisor("color1", 1) ||
+        !program->setUniformValue("identifier", number / 255.0f)) {
+      cout << program->error() << endl;
+    }
+  } else if (!program->enableAttributeArray("color1") ||
+             !program->useAttributeArray("color1", color1Offset,
+                                         sizeof(CylinderColor), UCharType, 3,
+                                         ShaderProgram::Normalize) ||
+             !program->setAttributeArrayDivisor("color1", 1)) {
+    cout << program->error() << endl;
+  }
+
+  if (!program->setUniformValue("modelView", camera.modelView().matrix()))
+    cout << program->error() << endl;
+  if (!program->setUniformValue("projection", camera.projection().matrix()))
+    cout << program->error() << endl;
+
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 14, static_cast<GLsizei>(count));
+
+  vbo.release();
+  if (number != 0)
+    program->setUniformValue("identifier", 0.0f);
+
+  // The divisors belong to the attribute locations, not to the program.
+  program->setAttributeArrayDivisor("end1", 0);
+  program->setAttributeArrayDivisor("end2", 0);
+  program->setAttributeArrayDivisor("cylinderRadius", 0);
+  program->setAttributeArrayDivisor("color1", 0);
+  program->setAttributeArrayDivisor("color2", 0);
+  program->disableAttributeArray("corner");
+  program->disableAttributeArray("end1");
+  program->disableAttributeArray("end2");
+  program->disableAttributeArray("cylinderRadius");
+  program->disableAttributeArray("color1");
+  program->disableAttributeArray("color2");
+
+  program->release();
+}
+
+void CylinderGeometry::Private::updateHierarchy(
+  const std::vector<CylinderColor>& cylinders)
+{
+  std::vector<BoundingVolumeHierarchy::Box> boxes;
+  boxes.reserve(cylinders.size());
+  for (size_t i = 0; i < cylinders.size(); ++i) {
+    const CylinderColor& cylinder = cylinders[i];
+    const Vector3f radius = Vector3f::Constant(cylinder.radius);
+    boxes.push_back(BoundingVolumeHierarchy::Box(
+      cylinder.end1.cwiseMin(cylinder.end2) - radius,
+      cylinder.end1.cwiseMax(cylinder.end2) + radius));
+  }
+  hierarchy.build(boxes);
+}
+
+CylinderGeometry::CylinderGeometry()
+  : m_dirty(false), m_changedBegin(0), m_changedEnd(0),
+    m_hierarchyDirty(true), d(new Private)
 {
 }
 
 CylinderGeometry::CylinderGeometry(const CylinderGeometry& other)
   : Drawable(other), m_cylinders(other.m_cylinders), m_indices(other.m_indices),
-    m_indexMap(other.m_indexMap), m_dirty(true), d(new Private)
+    m_indexMap(other.m_indexMap), m_dirty(true), m_changedBegin(0),
+    m_changedEnd(0), m_hierarchyDirty(true), d(new Private)
 {
 }
 
@@ -83,19 +290,39 @@ void CylinderGeometry::update()
   if (m_indices.empty() || m_cylinders.empty())
     return;
 
+  // Draw one instance per cylinder where the context allows it, which
+  // uploads a small fraction of the data and needs no indices. The vertices
+  // are drawn instead if the instanced program cannot be built, and the
+  // buffers are laid out again when that changes.
+  ShaderProgram* instancedProgram = nullptr;
+  if (ShaderProgram::instancedArraysSupported()) {
+    instancedProgram =
+      shaderProgram(cylinders_instanced_vs, cylinders_instanced_fs);
+  }
+  const bool instanced = instancedProgram != nullptr;
+  if (d->vbo.ready() && d->instanced != instanced)
+    m_dirty = true;
+
   // Check if the VBOs are ready, if not get them ready.
-  if (!d->vbo.ready() || m_dirty) {
-    // Set some defaults for our cylinders.
-    const unsigned int resolution = 12; // points per circle
-    const float resolutionRadians =
-      2.0f * static_cast<float>(M_PI) / static_cast<float>(resolution);
-    std::vector<Vector3f> radials;
-    radials.reserve(resolution);
+  if ((!d->vbo.ready() || m_dirty) && instanced) {
+    if (!d->vbo.upload(m_cylinders, BufferObject::ArrayBuffer))
+      cout << d->vbo.error() << endl;
+    if (!d->corners.ready()) {
+      std::vector<Vector3f> corners;
+      for (int i = 0; i < 14; ++i)
+        corners.push_back(Vector3f(boxStrip[i]));
+      if (!d->corners.upload(corners, BufferObject::ArrayBuffer))
+        cout << d->corners.error() << endl;
+    }
+    d->instanced = true;
 
+    m_dirty = false;
+    m_changedBegin = m_changedEnd = 0;
+  } else if (!d->vbo.ready() || m_dirty) {
     std::vector<unsigned int> cylinderIndices;
     std::vector<ColorNormalVertex> cylinderVertices;
-    // cylinderIndices.reserve(m_indices.size() * 4);
-    // cylinderVertices.reserve(m_cylinders.size() * 4);
+    cylinderIndices.reserve(m_indices.size() * 6 * resolution);
+    cylinderVertices.reserve(m_cylinders.size() * 2 * resolution);
 
     std::vector<size_t>::const_iterator itIndex = m_indices.begin();
     std::vector<CylinderColor>::const_iterator itCylinder = m_cylinders.begin();
@@ -103,36 +330,10 @@ void CylinderGeometry::update()
     for (unsigned int i = 0;
          itIndex != m_indices.end() && itCylinder != m_cylinders.end();
          ++i, ++itIndex, ++itCylinder) {
-
-      const Vector3f& position1 = itCylinder->end1;
-      const Vector3f& position2 = itCylinder->end2;
-      const Vector3f direction = (position2 - position1).normalized();
-      float radius = itCylinder->radius;
-
-      // Generate the radial vectors
-      Vector3f radial = direction.unitOrthogonal() * radius;
-      Eigen::AngleAxisf transform(resolutionRadians, direction);
-      radials.clear();
-      for (unsigned int j = 0; j < resolution; ++j) {
-        radials.push_back(radial);
-        radial = transform * radial;
-      }
-
-      // Cylinder
-      ColorNormalVertex vert(itCylinder->color, -direction, position1);
-      ColorNormalVertex vert2(itCylinder->color2, -direction, position1);
       const unsigned int tubeStart =
         static_cast<unsigned int>(cylinderVertices.size());
-      for (std::vector<Vector3f>::const_iterator it = radials.begin(),
-                                                 itEnd = radials.end();
-           it != itEnd; ++it) {
-        vert.normal = *it;
-        vert.vertex = position1 + *it;
-        cylinderVertices.push_back(vert);
-        vert2.normal = vert.normal;
-        vert2.vertex = position2 + *it;
-        cylinderVertices.push_back(vert2);
-      }
+      appendVertices(*itCylinder, cylinderVertices);
+
       // Now to stitch it together.
       for (unsigned int j = 0; j < resolution; ++j) {
         unsigned int r1 = j + j;
@@ -151,25 +352,33 @@ void CylinderGeometry::update()
     d->ibo.upload(cylinderIndices, BufferObject::ElementArrayBuffer);
     d->numberOfVertices = cylinderVertices.size();
     d->numberOfIndices = cylinderIndices.size();
+    d->instanced = false;
 
     m_dirty = false;
+    m_changedBegin = m_changedEnd = 0;
+  } else if (m_changedBegin < m_changedEnd && d->instanced) {
+    std::vector<CylinderColor> cylinders(m_cylinders.begin() + m_changedBegin,
+                                         m_cylinders.begin() + m_changedEnd);
+    if (!d->vbo.update(cylinders, m_changedBegin))
+      cout << d->vbo.error() << endl;
+    m_changedBegin = m_changedEnd = 0;
+  } else if (m_changedBegin < m_changedEnd) {
+    // Only the vertices of the cylinders changed by setCylinder() are
+    // replaced, the way they are stitched together stays the same.
+    std::vector<ColorNormalVertex> cylinderVertices;
+    cylinderVertices.reserve((m_changedEnd - m_changedBegin) * 2 * resolution);
+    for (size_t i = m_changedBegin; i < m_changedEnd; ++i)
+      appendVertices(m_cylinders[i], cylinderVertices);
+    if (!d->vbo.update(cylinderVertices, 2 * resolution * m_changedBegin))
+      cout << d->vbo.error() << endl;
+    m_changedBegin = m_changedEnd = 0;
   }
 
-  // Build and link the shader if it has not been used yet.
-  if (d->vertexShader.type() == Shader::Unknown) {
-    d->vertexShader.setType(Shader::Vertex);
-    d->vertexShader.setSource(cylinders_vs);
-    d->fragmentShader.setType(Shader::Fragment);
-    d->fragmentShader.setSource(cylinders_fs);
-    if (!d->vertexShader.compile())
-      cout << d->vertexShader.error() << endl;
-    if (!d->fragmentShader.compile())
-      cout << d->fragmentShader.error() << endl;
-    d->program.attachShader(d->vertexShader);
-    d->program.attachShader(d->fragmentShader);
-    if (!d->program.link())
-      cout << d->program.error() << endl;
-  }
+  // The cache builds the program the first time it is asked for it.
+  if (d->instanced)
+    d->program = instancedProgram;
+  else
+    d->program = shaderProgram(cylinders_vs, cylinders_fs);
 }
 
 void CylinderGeometry::render(const Camera& camera)
@@ -180,45 +389,53 @@ void CylinderGeometry::render(const Camera& camera)
   // Prepare the VBOs, IBOs and shader program if necessary.
   update();
 
-  if (!d->program.bind())
-    cout << d->program.error() << endl;
+  if (!d->program)
+    return;
+  if (d->instanced) {
+    d->renderInstanced(camera, m_cylinders.size());
+    return;
+  }
+
+  if (!d->program->bind())
+    cout << d->program->error() << endl;
 
   d->vbo.bind();
   d->ibo.bind();
 
   // Set up our attribute arrays.
-  if (!d->program.enableAttributeArray("vertex"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray("vertex", ColorNormalVertex::vertexOffset(),
-                                    sizeof(ColorNormalVertex), FloatType, 3,
-                                    ShaderProgram::NoNormalize)) {
-    cout << d->program.error() << endl;
+  if (!d->program->enableAttributeArray("vertex"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray(
+        "vertex", ColorNormalVertex::vertexOffset(), sizeof(ColorNormalVertex),
+        FloatType, 3, ShaderProgram::NoNormalize)) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.enableAttributeArray("color"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray("color", ColorNormalVertex::colorOffset(),
-                                    sizeof(ColorNormalVertex), UCharType, 3,
-                                    ShaderProgram::Normalize)) {
-    cout << d->program.error() << endl;
+  if (!d->program->enableAttributeArray("color"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray("color", ColorNormalVertex::colorOffset(),
+                                     sizeof(ColorNormalVertex), UCharType, 3,
+                                     ShaderProgram::Normalize)) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.enableAttributeArray("normal"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray("normal", ColorNormalVertex::normalOffset(),
-                                    sizeof(ColorNormalVertex), FloatType, 3,
-                                    ShaderProgram::NoNormalize)) {
-    cout << d->program.error() << endl;
+  if (!d->program->enableAttributeArray("normal"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray(
+        "normal", ColorNormalVertex::normalOffset(), sizeof(ColorNormalVertex),
+        FloatType, 3, ShaderProgram::NoNormalize)) {
+    cout << d->program->error() << endl;
   }
 
   // Set up our uniforms (model-view and projection matrices right now).
-  if (!d->program.setUniformValue("modelView", camera.modelView().matrix())) {
-    cout << d->program.error() << endl;
+  if (!d->program->setUniformValue("modelView", camera.modelView().matrix())) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.setUniformValue("projection", camera.projection().matrix())) {
-    cout << d->program.error() << endl;
+  if (!d->program->setUniformValue("projection",
+                                   camera.projection().matrix())) {
+    cout << d->program->error() << endl;
   }
   Matrix3f normalMatrix = camera.modelView().linear().inverse().transpose();
-  if (!d->program.setUniformValue("normalMatrix", normalMatrix))
-    std::cout << d->program.error() << std::endl;
+  if (!d->program->setUniformValue("normalMatrix", normalMatrix))
+    std::cout << d->program->error() << std::endl;
 
   // Render the loaded spheres using the shader and bound VBO.
   glDrawRangeElements(GL_TRIANGLES, 0, static_cast<GLuint>(d->numberOfVertices),
@@ -228,11 +445,39 @@ void CylinderGeometry::render(const Camera& camera)
   d->vbo.release();
   d->ibo.release();
 
-  d->program.disableAttributeArray("vector");
-  d->program.disableAttributeArray("color");
-  d->program.disableAttributeArray("normal");
+  d->program->disableAttributeArray("vector");
+  d->program->disableAttributeArray("color");
+  d->program->disableAttributeArray("normal");
 
-  d->program.release();
+  d->program->release();
+}
+
+bool CylinderGeometry::renderIdentifiers(const Camera& camera, int number)
+{
+  if (m_indices.empty() || m_cylinders.empty())
+    return true;
+
+  update();
+
+  // The identifiers are passed in place of the colors of the instances.
+  if (!d->program || !d->instanced)
+    return false;
+  if (d->identifierCount != m_cylinders.size()) {
+    std::vector<Vector3ub> colors(m_cylinders.size());
+    for (size_t i = 0; i < colors.size(); ++i) {
+      const size_t index = m_indexMap.size() ? m_indexMap.find(i)->second : i;
+      if (index >= IdentifierBuffer::maxIndex())
+        return false;
+      colors[i] = IdentifierBuffer::color(index);
+    }
+    if (!d->identifiers.upload(colors, BufferObject::ArrayBuffer)) {
+      cout << d->identifiers.error() << endl;
+      return false;
+    }
+    d->identifierCount = m_cylinders.size();
+  }
+  d->renderInstanced(camera, m_cylinders.size(), number);
+  return true;
 }
 
 std::multimap<float, Identifier> CylinderGeometry::hits(
@@ -240,58 +485,67 @@ std::multimap<float, Identifier> CylinderGeometry::hits(
   const Vector3f& rayDirection) const
 {
   std::multimap<float, Identifier> result;
+  if (m_identifier.type == InvalidType)
+    return result;
+  if (m_hierarchyDirty) {
+    d->updateHierarchy(m_cylinders);
+    m_hierarchyDirty = false;
+  }
 
-  for (size_t i = 0; i < m_cylinders.size(); ++i) {
-    const CylinderColor& cylinder = m_cylinders[i];
-
-    // Check for cylinder intersection with the ray.
-    Vector3f ao = rayOrigin - cylinder.end1;
-    Vector3f ab = cylinder.end2 - cylinder.end1;
-    Vector3f aoxab = ao.cross(ab);
-    Vector3f vxab = rayDirection.cross(ab);
-
-    float A = vxab.dot(vxab);
-    float B = 2.0f * vxab.dot(aoxab);
-    float C =
-      aoxab.dot(aoxab) - ab.dot(ab) * (cylinder.radius * cylinder.radius);
-    float D = B * B - 4.0f * A * C;
-
-    // no intersection
-    if (D < 0.0f)
-      continue;
-
-    float t = std::min((-B + std::sqrt(D)) / (2.0f * A),
-                       (-B - std::sqrt(D)) / (2.0f * A));
-
-    Vector3f ip = rayOrigin + (rayDirection * t);
-    Vector3f ip1 = ip - cylinder.end1;
-    Vector3f ip2 = ip - (cylinder.end1 + ab);
-
-    // intersection below base or above top of the cylinder
-    if (ip1.dot(ab) < 0.0f || ip2.dot(ab) > 0.0f)
-      continue;
-
-    // Test for clipping
-    Vector3f distance = ip - rayOrigin;
-    if (distance.dot(rayDirection) < 0.0f ||
-        (ip - rayEnd).dot(rayDirection) > 0.0f)
+  // Only the cylinders whose boxes the ray passes through can be hit.
+  std::vector<size_t> candidates;
+  d->hierarchy.intersect(rayOrigin, rayDirection, candidates);
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    float depth;
+    if (!intersect(m_cylinders[candidates[i]], rayOrigin, rayEnd,
+                   rayDirection, depth)) {
       continue;
-
+    }
     Identifier id;
     id.molecule = m_identifier.molecule;
     id.type = m_identifier.type;
-    id.index = i;
+    id.index = candidates[i];
     if (m_indexMap.size())
-      id.index = m_indexMap.find(i)->second;
-    if (id.type != InvalidType) {
-      float depth = distance.norm();
-      result.insert(std::pair<float, Identifier>(depth, id));
-    }
+      id.index = m_indexMap.find(candidates[i])->second;
+    result.insert(std::pair<float, Identifier>(depth, id));
   }
 
   return result;
 }
 
+Identifier CylinderGeometry::hit(const Vector3f& rayOrigin,
+                                 const Vector3f& rayEnd,
+                                 const Vector3f& rayDirection,
+                                 float& distance) const
+{
+  if (m_identifier.type == InvalidType)
+    return Identifier();
+  if (m_hierarchyDirty) {
+    d->updateHierarchy(m_cylinders);
+    m_hierarchyDirty = false;
+  }
+
+  size_t index;
+  const std::vector<CylinderColor>& cylinders = m_cylinders;
+  if (!d->hierarchy.closest(
+        rayOrigin, rayDirection,
+        [&](size_t i, float& depth) {
+          return intersect(cylinders[i], rayOrigin, rayEnd, rayDirection,
+                           depth);
+        },
+        index, distance)) {
+    return Identifier();
+  }
+
+  Identifier id;
+  id.molecule = m_identifier.molecule;
+  id.type = m_identifier.type;
+  id.index = index;
+  if (m_indexMap.size())
+    id.index = m_indexMap.find(index)->second;
+  return id;
+}
+
 void CylinderGeometry::addCylinder(const Vector3f& pos1, const Vector3f& pos2,
                                    float radius, const Vector3ub& color)
 {
@@ -303,6 +557,7 @@ void CylinderGeometry::addCylinder(const Vector3f& pos1, const Vector3f& pos2,
                                    const Vector3ub& colorEnd)
 {
   m_dirty = true;
+  m_hierarchyDirty = true;
   m_cylinders.push_back(
     CylinderColor(pos1, pos2, radius, colorStart, colorEnd));
   m_indices.push_back(m_indices.size());
@@ -324,11 +579,37 @@ void CylinderGeometry::addCylinder(const Vector3f& pos1, const Vector3f& pos2,
   addCylinder(pos1, pos2, radius, colorStart, colorEnd);
 }
 
+void CylinderGeometry::setCylinder(size_t index, const Vector3f& pos1,
+                                   const Vector3f& pos2, float radius,
+                                   const Vector3ub& colorStart,
+                                   const Vector3ub& colorEnd)
+{
+  CylinderColor& cylinder = m_cylinders[index];
+  if (cylinder.end1 == pos1 && cylinder.end2 == pos2 &&
+      cylinder.radius == radius && cylinder.color == colorStart &&
+      cylinder.color2 == colorEnd) {
+    return;
+  }
+  cylinder = CylinderColor(pos1, pos2, radius, colorStart, colorEnd);
+  m_hierarchyDirty = true;
+  if (m_changedBegin == m_changedEnd) {
+    m_changedBegin = index;
+    m_changedEnd = index + 1;
+  } else {
+    m_changedBegin = std::min(m_changedBegin, index);
+    m_changedEnd = std::max(m_changedEnd, index + 1);
+  }
+}
+
 void CylinderGeometry::clear()
 {
   m_cylinders.clear();
   m_indices.clear();
   m_indexMap.clear();
+  m_changedBegin = m_changedEnd = 0;
+  m_hierarchyDirty = true;
+  // The identifiers depend on the index map.
+  d->identifierCount = 0;
 }
 
 } // End namespace Rendering
@@ -47,6 +47,13 @@ struct CylinderColor
  * <avogadro/rendering/cylindergeometry.h>
  * @brief The CylinderGeometry contains one or more cylinders.
  * @author Marcus D. Hanwell
+ *
+ * Where the context supports instanced arrays (OpenGL 3.3) each cylinder is
+ * uploaded as its CylinderColor and ray cast in the box around it, otherwise
+ * it is tessellated into a tube.
+ *
+ * Picking goes through a BoundingVolumeHierarchy over the cylinders, which is
+ * built again on the first pick after the cylinders change.
  */
 
 class AVOGADRORENDERING_EXPORT CylinderGeometry : public Drawable
@@ -75,6 +82,16 @@ public:
    */
   void render(const Camera& camera) override;
 
+  /**
+   * @brief Render the cylinders into the IdentifierBuffer, which needs them to
+   * be drawn as instances.
+   * @param camera The current camera to be used for rendering.
+   * @param number The number of the geometry in the buffer.
+   * @return False if the cylinders could not be drawn as instances, or there
+   * are more of them than the buffer can tell apart.
+   */
+  bool renderIdentifiers(const Camera& camera, int number);
+
   /**
    * Return the primitives that are hit by the ray.
    * @param rayOrigin Origin of the ray.
@@ -86,6 +103,14 @@ public:
     const Vector3f& rayOrigin, const Vector3f& rayEnd,
     const Vector3f& rayDirection) const override;
 
+  /**
+   * Return the cylinder closest to the origin of the ray, without finding the
+   * others it hits.
+   */
+  Identifier hit(const Vector3f& rayOrigin, const Vector3f& rayEnd,
+                 const Vector3f& rayDirection,
+                 float& distance) const override;
+
   /**
    * @brief Add a cylinder to the geometry object.
    * @param position Base of the cylinder.
@@ -136,7 +161,17 @@ public:
                    size_t index);
 
   /**
-   * Get a reference to the cylinders.
+   * @brief Change the cylinder at @a index in place. Only the cylinders that
+   * changed are uploaded again when the geometry is next rendered.
+   */
+  void setCylinder(size_t index, const Vector3f& pos1, const Vector3f& pos2,
+                   float radius, const Vector3ub& color1,
+                   const Vector3ub& color2);
+
+  /**
+   * Get a reference to the cylinders. Use setCylinder() to change them,
+   * changes made through the reference are neither uploaded nor seen by
+   * picking.
    */
   std::vector<CylinderColor>& cylinders() { return m_cylinders; }
   const std::vector<CylinderColor>& cylinders() const { return m_cylinders; }
@@ -157,6 +192,11 @@ private:
   std::map<size_t, size_t> m_indexMap;
 
   bool m_dirty;
+  // The range of cylinders changed by setCylinder() since the last upload.
+  size_t m_changedBegin;
+  size_t m_changedEnd;
+  // Whether the picking hierarchy needs to be built again.
+  mutable bool m_hierarchyDirty;
 
   class Private;
   Private* d;
@@ -177,6 +217,7 @@ inline void swap(CylinderGeometry& lhs, CylinderGeometry& rhs)
   swap(lhs.m_indices, rhs.m_indices);
   swap(lhs.m_indexMap, rhs.m_indexMap);
   lhs.m_dirty = rhs.m_dirty = true;
+  lhs.m_hierarchyDirty = rhs.m_hierarchyDirty = true;
 }
 
 } // End namespace Rendering
@@ -0,0 +1,73 @@
+varying vec3 eyePosition;
+varying vec3 eyeEnd1;
+varying vec3 eyeAxis;
+varying float radius;
+varying vec3 fColor1;
+varying vec3 fColor2;
+
+uniform mat4 projection;
+
+// The number of the drawable over 255 while drawing the IdentifierBuffer, when
+// the first color identifies the cylinder.
+uniform float identifier;
+
+void main()
+{
+  // Cast the ray through this fragment of the box at the cylinder, from the
+  // eye for a perspective projection and along -z for an orthographic one.
+  float axisLength = length(eyeAxis);
+  vec3 A = eyeAxis / axisLength;
+  vec3 D;
+  vec3 O;
+  if (projection[2][3] != 0.0) {
+    D = normalize(eyePosition);
+    O = vec3(0.0);
+  }
+  else {
+    D = vec3(0.0, 0.0, -1.0);
+    O = eyePosition - D * (axisLength + 4.0 * radius);
+  }
+
+  // Intersect the ray with the infinite cylinder around the axis.
+  vec3 oc = O - eyeEnd1;
+  vec3 d = D - dot(D, A) * A;
+  vec3 o = oc - dot(oc, A) * A;
+  float a = dot(d, d);
+  float b = dot(d, o);
+  float c = dot(o, o) - radius * radius;
+  float disc = b * b - a * c;
+  if (disc < 0.0 || a == 0.0)
+    discard;
+
+  // Like the tessellated cylinders the tube has no caps, so where the front
+  // of the tube is cut off the inside of its back shows through.
+  float root = sqrt(disc);
+  float t = (-b - root) / a;
+  float h = dot(O + t * D - eyeEnd1, A);
+  if (h < 0.0 || h > axisLength) {
+    t = (-b + root) / a;
+    h = dot(O + t * D - eyeEnd1, A);
+    if (h < 0.0 || h > axisLength)
+      discard;
+  }
+  vec3 P = O + t * D;
+
+  vec3 N = normalize(P - eyeEnd1 - h * A);
+  vec3 L = normalize(vec3(0, 1, 1));
+  vec3 E = vec3(0, 0, 1);
+  vec3 H = normalize(L + E);
+  float df = max(0.0, dot(N, L));
+  float sf = max(0.0, dot(N, H));
+  vec3 fColor = mix(fColor1, fColor2, h / axisLength);
+  vec3 ambient = 0.4 * fColor;
+  vec3 diffuse = 0.55 * fColor;
+  vec3 specular = 0.5 * (vec3(1, 1, 1) - fColor);
+  vec3 color = ambient + df * diffuse + pow(sf, 20.0) * specular;
+  gl_FragColor = vec4(color, 1.0);
+  if (identifier > 0.0)
+    gl_FragColor = vec4(fColor1, identifier);
+
+  // determine fragment depth
+  vec4 pos = projection * vec4(P, 1.0);
+  gl_FragDepth = (pos.z / pos.w + 1.0) / 2.0;
+}
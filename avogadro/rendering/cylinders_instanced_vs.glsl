@@ -0,0 +1,39 @@
+// One instance per cylinder, drawn on the faces of the box around it. The
+// corners of the box are at +/-1.
+attribute vec3 corner;
+attribute vec3 end1;
+attribute vec3 end2;
+attribute float cylinderRadius;
+attribute vec3 color1;
+attribute vec3 color2;
+
+uniform mat4 modelView;
+uniform mat4 projection;
+
+varying vec3 eyePosition;
+varying vec3 eyeEnd1;
+varying vec3 eyeAxis;
+varying float radius;
+varying vec3 fColor1;
+varying vec3 fColor2;
+
+void main()
+{
+  vec3 axis = end2 - end1;
+  vec3 direction = normalize(axis);
+  vec3 side = abs(direction.x) < 0.9 ? vec3(1.0, 0.0, 0.0)
+                                     : vec3(0.0, 1.0, 0.0);
+  vec3 u = normalize(cross(direction, side));
+  vec3 v = cross(direction, u);
+  vec3 position = end1 + (0.5 * corner.x + 0.5) * axis +
+                  cylinderRadius * (corner.y * u + corner.z * v);
+
+  vec4 eye = modelView * vec4(position, 1.0);
+  eyePosition = eye.xyz;
+  eyeEnd1 = (modelView * vec4(end1, 1.0)).xyz;
+  eyeAxis = (modelView * vec4(end2, 1.0)).xyz - eyeEnd1;
+  radius = cylinderRadius;
+  fColor1 = color1;
+  fColor2 = color2;
+  gl_Position = projection * eye;
+}
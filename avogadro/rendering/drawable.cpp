@@ -16,24 +16,28 @@
 
 #include "drawable.h"
 
+#include "shadercache.h"
 #include "visitor.h"
 
 namespace Avogadro {
 namespace Rendering {
 
 Drawable::Drawable()
-  : m_parent(nullptr), m_visible(true), m_renderPass(OpaquePass)
+  : m_parent(nullptr), m_visible(true), m_renderPass(OpaquePass),
+    m_shaderCache(nullptr), m_ownShaderCache(nullptr)
 {
 }
 
 Drawable::Drawable(const Drawable& other)
   : m_parent(other.m_parent), m_visible(other.m_visible),
-    m_renderPass(other.m_renderPass), m_identifier(other.m_identifier)
+    m_renderPass(other.m_renderPass), m_identifier(other.m_identifier),
+    m_shaderCache(other.m_shaderCache), m_ownShaderCache(nullptr)
 {
 }
 
 Drawable::~Drawable()
 {
+  delete m_ownShaderCache;
 }
 
 void Drawable::accept(Visitor& visitor)
@@ -52,6 +56,17 @@ std::multimap<float, Identifier> Drawable::hits(const Vector3f&,
   return std::multimap<float, Identifier>();
 }
 
+Identifier Drawable::hit(const Vector3f& rayOrigin, const Vector3f& rayEnd,
+                         const Vector3f& rayDirection, float& distance) const
+{
+  std::multimap<float, Identifier> results =
+    hits(rayOrigin, rayEnd, rayDirection);
+  if (results.empty())
+    return Identifier();
+  distance = results.begin()->first;
+  return results.begin()->second;
+}
+
 void Drawable::clear()
 {
 }
@@ -61,5 +76,22 @@ void Drawable::setParent(GeometryNode* parent_)
   m_parent = parent_;
 }
 
+ShaderProgram* Drawable::shaderProgram(const char* vertexSource,
+                                       const char* fragmentSource)
+{
+  ShaderCache* cache = m_shaderCache;
+  if (!cache) {
+    if (!m_ownShaderCache)
+      m_ownShaderCache = new ShaderCache;
+    cache = m_ownShaderCache;
+  }
+  size_t built = cache->size();
+  ShaderProgram* program = cache->program(vertexSource, fragmentSource);
+  // The cache only says why the first time, rather than on every frame.
+  if (!program && cache->size() > built)
+    m_error = cache->error();
+  return program;
+}
+
 } // End namespace Rendering
 } // End namespace Avogadro
@@ -24,12 +24,15 @@
 #include <avogadro/core/vector.h>
 
 #include <map>
+#include <string>
 
 namespace Avogadro {
 namespace Rendering {
 
 class Camera;
 class GeometryNode;
+class ShaderCache;
+class ShaderProgram;
 class Visitor;
 
 /**
@@ -91,6 +94,16 @@ public:
    */
   virtual void render(const Camera& camera);
 
+  /**
+   * The shader programs of the context the drawable is rendered in, which the
+   * renderer sets before rendering it. When there is none the drawable builds
+   * its own programs.
+   * @{
+   */
+  void setShaderCache(ShaderCache* cache) { m_shaderCache = cache; }
+  ShaderCache* shaderCache() const { return m_shaderCache; }
+  /** @} */
+
   /**
    * Get the indentifier for the object, this stores the parent Molecule and
    * the type represented by the geometry.
@@ -109,11 +122,26 @@ public:
     const Vector3f& rayOrigin, const Vector3f& rayEnd,
     const Vector3f& rayDirection) const;
 
+  /**
+   * Return the primitive closest to the origin of the ray. The default takes
+   * the first of hits(), geometries with many primitives find it directly.
+   * @param rayOrigin Origin of the ray.
+   * @param rayEnd End point of the ray.
+   * @param rayDirection Normalized direction of the ray.
+   * @param distance Set to the distance to the primitive along the ray.
+   * @return The primitive, or an invalid Identifier if none were hit.
+   */
+  virtual Identifier hit(const Vector3f& rayOrigin, const Vector3f& rayEnd,
+                         const Vector3f& rayDirection, float& distance) const;
+
   /**
    * Clear the contents of the node.
    */
   virtual void clear();
 
+  /** Get the reason the drawable could last not be rendered, if any. */
+  std::string error() const { return m_error; }
+
 protected:
   friend class GeometryNode;
 
@@ -123,10 +151,25 @@ protected:
    */
   void setParent(GeometryNode* parent);
 
+  /**
+   * Get the program linked from the shader sources from the shader cache,
+   * building it if it has not been built yet.
+   * @return nullptr if the program could not be built, error() says why.
+   */
+  ShaderProgram* shaderProgram(const char* vertexSource,
+                               const char* fragmentSource);
+
   GeometryNode* m_parent;
   bool m_visible;
   RenderPass m_renderPass;
   Identifier m_identifier;
+
+  ShaderCache* m_shaderCache;
+  // Used when the drawable is rendered without a shader cache. Its programs
+  // are left to the context, as no context may be current when it is deleted.
+  ShaderCache* m_ownShaderCache;
+
+  std::string m_error;
 };
 
 inline Drawable& Drawable::operator=(Drawable rhs)
@@ -143,6 +186,9 @@ inline void swap(Drawable& lhs, Drawable& rhs)
   swap(lhs.m_visible, rhs.m_visible);
   swap(lhs.m_renderPass, rhs.m_renderPass);
   swap(lhs.m_identifier, rhs.m_identifier);
+  swap(lhs.m_shaderCache, rhs.m_shaderCache);
+  swap(lhs.m_ownShaderCache, rhs.m_ownShaderCache);
+  swap(lhs.m_error, rhs.m_error);
 }
 
 } // End namespace Rendering
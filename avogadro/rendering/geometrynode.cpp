@@ -111,5 +111,26 @@ std::multimap<float, Identifier> GeometryNode::hits(
   return result;
 }
 
+Identifier GeometryNode::hit(const Vector3f& rayOrigin, const Vector3f& rayEnd,
+                             const Vector3f& rayDirection,
+                             float& distance) const
+{
+  Identifier result;
+  for (std::vector<Drawable*>::const_iterator it = m_drawables.begin();
+       it != m_drawables.end(); ++it) {
+    if (!(*it)->isVisible())
+      continue;
+    float drawableDistance;
+    Identifier id =
+      (*it)->hit(rayOrigin, rayEnd, rayDirection, drawableDistance);
+    if (id.type != InvalidType &&
+        (result.type == InvalidType || drawableDistance < distance)) {
+      result = id;
+      distance = drawableDistance;
+    }
+  }
+  return result;
+}
+
 } // End namespace Rendering
 } // End namespace Avogadro
@@ -99,6 +99,17 @@ public:
                                         const Vector3f& rayEnd,
                                         const Vector3f& rayDirection) const;
 
+  /**
+   * Return the primitive closest to the origin of the ray.
+   * @param rayOrigin Origin of the ray.
+   * @param rayEnd End point of the ray.
+   * @param rayDirection Normalized direction of the ray.
+   * @param distance Set to the distance to the primitive along the ray.
+   * @return The primitive, or an invalid Identifier if none were hit.
+   */
+  Identifier hit(const Vector3f& rayOrigin, const Vector3f& rayEnd,
+                 const Vector3f& rayDirection, float& distance) const;
+
 protected:
   std::vector<Drawable*> m_drawables;
 };
@@ -37,6 +37,7 @@ namespace Rendering {
 GLRenderer::GLRenderer()
   : m_valid(false)
   , m_textRenderStrategy(nullptr)
+  , m_identifierBufferEnabled(false)
   , m_center(Vector3f::Zero())
   , m_radius(20.0)
 {
@@ -64,6 +65,13 @@ void GLRenderer::initialize()
   }
 }
 
+void GLRenderer::finalize()
+{
+  m_shaderCache.clear();
+  m_identifierBuffer.clear();
+  m_identifierBuffer.releaseFramebuffer();
+}
+
 void GLRenderer::resize(int width, int height)
 {
   if (!m_valid)
@@ -85,6 +93,7 @@ void GLRenderer::render()
   applyProjection();
 
   GLRenderVisitor visitor(m_camera, m_textRenderStrategy);
+  visitor.setShaderCache(&m_shaderCache);
   // Setup for opaque geometry
   visitor.setRenderPass(OpaquePass);
   glEnable(GL_DEPTH_TEST);
@@ -107,6 +116,34 @@ void GLRenderer::render()
   visitor.setCamera(m_overlayCamera);
   glDisable(GL_DEPTH_TEST);
   m_scene.rootNode().accept(visitor);
+  appendErrors(visitor.errors());
+
+  if (m_identifierBufferEnabled &&
+      !m_identifierBuffer.render(m_scene.rootNode(), m_camera,
+                                 &m_shaderCache)) {
+    appendErrors(m_identifierBuffer.error() + "\n");
+    m_identifierBufferEnabled = false;
+  }
+}
+
+void GLRenderer::appendErrors(const std::string& errors)
+{
+  // Errors recur on every frame or press, so each line is only kept once.
+  std::string::size_type begin = 0;
+  std::string::size_type end;
+  while ((end = errors.find('\n', begin)) != std::string::npos) {
+    std::string line = errors.substr(begin, end + 1 - begin);
+    if (m_error.find(line) == std::string::npos)
+      m_error += line;
+    begin = end + 1;
+  }
+}
+
+void GLRenderer::setIdentifierBufferEnabled(bool enabled)
+{
+  m_identifierBufferEnabled = enabled;
+  if (!enabled)
+    m_identifierBuffer.clear();
 }
 
 void GLRenderer::resetCamera()
@@ -220,5 +257,52 @@ std::multimap<float, Identifier> GLRenderer::hits(int x, int y) const
   return hits(&m_scene.rootNode(), origin, end, direction);
 }
 
+Identifier GLRenderer::hit(const GroupNode* group, const Vector3f& rayOrigin,
+                           const Vector3f& rayEnd,
+                           const Vector3f& rayDirection, float& distance) const
+{
+  Identifier result;
+  if (!group)
+    return result;
+
+  for (std::vector<Node*>::const_iterator it = group->children().begin();
+       it != group->children().end(); ++it) {
+    Identifier id;
+    float childDistance;
+    const Node* itNode = *it;
+    const GroupNode* childGroup = dynamic_cast<const GroupNode*>(itNode);
+    const GeometryNode* childGeometry = (*it)->cast<GeometryNode>();
+    if (childGroup)
+      id = hit(childGroup, rayOrigin, rayEnd, rayDirection, childDistance);
+    else if (childGeometry)
+      id = childGeometry->hit(rayOrigin, rayEnd, rayDirection, childDistance);
+    if (id.type != InvalidType &&
+        (result.type == InvalidType || childDistance < distance)) {
+      result = id;
+      distance = childDistance;
+    }
+  }
+  return result;
+}
+
+Identifier GLRenderer::hit(int x, int y) const
+{
+  // The identifier buffer holds what the last render() drew at each pixel.
+  if (m_identifierBufferEnabled && !m_identifierBuffer.isEmpty())
+    return m_identifierBuffer.hit(x, y);
+
+  // Our ray:
+  const Vector3f origin(m_camera.unProject(
+    Vector3f(static_cast<float>(x), static_cast<float>(y), 0.f)));
+  const Vector3f end(m_camera.unProject(
+    Vector3f(static_cast<float>(x), static_cast<float>(y), 1.f)));
+  const Vector3f direction((end - origin).normalized());
+
+  // Only the closest hit is wanted, which the geometries find without
+  // collecting and sorting all of the others.
+  float distance;
+  return hit(&m_scene.rootNode(), origin, end, direction, distance);
+}
+
 } // End Rendering namespace
 } // End Avogadro namespace
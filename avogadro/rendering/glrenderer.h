@@ -21,9 +21,11 @@
 
 #include "bufferobject.h"
 #include "camera.h"
+#include "identifierbuffer.h"
 #include "primitive.h"
 #include "scene.h"
 #include "shader.h"
+#include "shadercache.h"
 #include "shaderprogram.h"
 
 #include <map>
@@ -50,6 +52,13 @@ public:
   /** Initialize the OpenGL context for rendering. */
   void initialize();
 
+  /**
+   * Delete the GL objects the renderer built in its context, requires that
+   * the context is current. Call before the context is destroyed, the
+   * destructor makes no GL calls.
+   */
+  void finalize();
+
   /** Resize the context in response to window management events. */
   void resize(int width, int height);
 
@@ -69,16 +78,42 @@ public:
    */
   std::multimap<float, Identifier> hits(int x, int y) const;
 
-  /** Return the top primitive under the display coordinate (x,y).
+  /** Return the top primitive under the display coordinate (x,y). This is
+   * looked up in the identifier buffer when it is enabled and was drawn, and
+   * found by casting a ray otherwise.
    */
   Identifier hit(int x, int y) const;
 
+  /**
+   * Draw the IdentifierBuffer after the scene on each render(), so that
+   * identifierBuffer() finds what was drawn at any pixel without casting rays.
+   * This costs another pass over the pickable geometry and reading it back,
+   * so it is best enabled only while a tool needs it. Off by default.
+   * @{
+   */
+  void setIdentifierBufferEnabled(bool enabled);
+  bool isIdentifierBufferEnabled() const { return m_identifierBufferEnabled; }
+  /** @} */
+
+  /**
+   * Get the primitives drawn by the last render(), which is empty unless
+   * setIdentifierBufferEnabled() was called before it and the context
+   * supports the buffer.
+   */
+  const IdentifierBuffer& identifierBuffer() const
+  {
+    return m_identifierBuffer;
+  }
+
   /** Check whether the GL context is valid and supports required features.
    * \sa error() to get more information if the context is not valid.
    */
   bool isValid() const { return m_valid; }
 
-  /** Get the error message if the context is not valid. Empty if valid. */
+  /**
+   * Get the error messages of the renderer, such as why the context is not
+   * valid, or why the identifier buffer could not be drawn and was disabled.
+   */
   std::string error() const { return m_error; }
 
   /** Get the camera for this renderer. */
@@ -93,6 +128,9 @@ public:
   const Scene& scene() const { return m_scene; }
   Scene& scene() { return m_scene; }
 
+  /** Get the shader programs built for the renderer's context. */
+  ShaderCache& shaderCache() { return m_shaderCache; }
+
   /**
    * Get/set the text rendering strategy for this object. The renderer takes
    * ownership of the strategy object. @{
@@ -108,6 +146,12 @@ private:
    */
   void applyProjection();
 
+  /**
+   * Append the newline terminated @a errors to error(), skipping those it
+   * already holds.
+   */
+  void appendErrors(const std::string& errors);
+
   /**
    * @brief Detect hits in a group node.
    */
@@ -124,12 +168,22 @@ private:
                                         const Vector3f& rayEnd,
                                         const Vector3f& rayDirection) const;
 
+  /**
+   * @brief Find the closest hit in a group node.
+   */
+  Identifier hit(const GroupNode* group, const Vector3f& rayOrigin,
+                 const Vector3f& rayEnd, const Vector3f& rayDirection,
+                 float& distance) const;
+
   bool m_valid;
   std::string m_error;
   Camera m_camera;
   Camera m_overlayCamera;
   Scene m_scene;
   TextRenderStrategy* m_textRenderStrategy;
+  ShaderCache m_shaderCache;
+  IdentifierBuffer m_identifierBuffer;
+  bool m_identifierBufferEnabled;
 
   Vector3f m_center;
   float m_radius;
@@ -165,14 +219,6 @@ inline TextRenderStrategy* GLRenderer::textRenderStrategy()
   return m_textRenderStrategy;
 }
 
-inline Identifier GLRenderer::hit(int x, int y) const
-{
-  std::multimap<float, Identifier> results = hits(x, y);
-  if (results.size())
-    return results.begin()->second;
-  return Identifier();
-}
-
 } // End Rendering namespace
 } // End Avogadro namespace
 
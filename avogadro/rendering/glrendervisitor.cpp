@@ -29,7 +29,8 @@ namespace Rendering {
 
 GLRenderVisitor::GLRenderVisitor(const Camera& camera_,
                                  const TextRenderStrategy* trs)
-  : m_camera(camera_), m_textRenderStrategy(trs), m_renderPass(NotRendering)
+  : m_camera(camera_), m_textRenderStrategy(trs), m_renderPass(NotRendering),
+    m_shaderCache(nullptr)
 {
 }
 
@@ -39,32 +40,27 @@ GLRenderVisitor::~GLRenderVisitor()
 
 void GLRenderVisitor::visit(Drawable& geometry)
 {
-  if (geometry.renderPass() == m_renderPass)
-    geometry.render(m_camera);
+  render(geometry);
 }
 
 void GLRenderVisitor::visit(SphereGeometry& geometry)
 {
-  if (geometry.renderPass() == m_renderPass)
-    geometry.render(m_camera);
+  render(geometry);
 }
 
 void GLRenderVisitor::visit(AmbientOcclusionSphereGeometry& geometry)
 {
-  if (geometry.renderPass() == m_renderPass)
-    geometry.render(m_camera);
+  render(geometry);
 }
 
 void GLRenderVisitor::visit(CylinderGeometry& geometry)
 {
-  if (geometry.renderPass() == m_renderPass)
-    geometry.render(m_camera);
+  render(geometry);
 }
 
 void GLRenderVisitor::visit(MeshGeometry& geometry)
 {
-  if (geometry.renderPass() == m_renderPass)
-    geometry.render(m_camera);
+  render(geometry);
 }
 
 void GLRenderVisitor::visit(TextLabel2D& geometry)
@@ -72,7 +68,9 @@ void GLRenderVisitor::visit(TextLabel2D& geometry)
   if (geometry.renderPass() == m_renderPass) {
     if (m_textRenderStrategy)
       geometry.buildTexture(*m_textRenderStrategy);
+    geometry.setShaderCache(m_shaderCache);
     geometry.render(m_camera);
+    collectError(geometry);
   }
 }
 
@@ -81,14 +79,31 @@ void GLRenderVisitor::visit(TextLabel3D& geometry)
   if (geometry.renderPass() == m_renderPass) {
     if (m_textRenderStrategy)
       geometry.buildTexture(*m_textRenderStrategy);
+    geometry.setShaderCache(m_shaderCache);
     geometry.render(m_camera);
+    collectError(geometry);
   }
 }
 
 void GLRenderVisitor::visit(LineStripGeometry& geometry)
 {
-  if (geometry.renderPass() == m_renderPass)
+  render(geometry);
+}
+
+void GLRenderVisitor::render(Drawable& geometry)
+{
+  if (geometry.renderPass() == m_renderPass) {
+    geometry.setShaderCache(m_shaderCache);
     geometry.render(m_camera);
+    collectError(geometry);
+  }
+}
+
+void GLRenderVisitor::collectError(const Drawable& geometry)
+{
+  std::string error = geometry.error();
+  if (!error.empty() && m_errors.find(error + "\n") == std::string::npos)
+    m_errors += error + "\n";
 }
 
 } // End namespace Rendering
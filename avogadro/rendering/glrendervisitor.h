@@ -22,8 +22,11 @@
 #include "avogadrorendering.h"
 #include "camera.h"
 
+#include <string>
+
 namespace Avogadro {
 namespace Rendering {
+class ShaderCache;
 class TextRenderStrategy;
 
 /**
@@ -84,10 +87,31 @@ public:
   }
   /** @} */
 
+  /**
+   * The shader programs of the context being rendered to, which are handed to
+   * each drawable before it is rendered.
+   */
+  void setShaderCache(ShaderCache* cache) { m_shaderCache = cache; }
+  ShaderCache* shaderCache() const { return m_shaderCache; }
+
+  /**
+   * The reasons the drawables visited so far could not be rendered, one per
+   * line, each listed once.
+   */
+  std::string errors() const { return m_errors; }
+
 private:
+  // Render the drawable if it belongs to the current pass.
+  void render(Drawable& geometry);
+
+  // Note why the drawable could not be rendered, if it could not.
+  void collectError(const Drawable& geometry);
+
   Camera m_camera;
   const TextRenderStrategy* m_textRenderStrategy;
   RenderPass m_renderPass;
+  ShaderCache* m_shaderCache;
+  std::string m_errors;
 };
 
 } // End namespace Rendering
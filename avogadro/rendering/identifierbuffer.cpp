@@ -0,0 +1,375 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include "identifierbuffer.h"
+
+#include "avogadrogl.h"
+
+#include "ambientocclusionspheregeometry.h"
+#include "camera.h"
+#include "cylindergeometry.h"
+#include "groupnode.h"
+#include "shaderprogram.h"
+#include "spheregeometry.h"
+#include "visitor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+namespace Avogadro {
+namespace Rendering {
+
+namespace {
+// The most drawables the alpha channel can tell apart, zero is the background.
+const size_t maxDrawables = 255;
+
+// Collect the pickable drawables in the order they are visited.
+class PickableVisitor : public Visitor
+{
+public:
+  PickableVisitor() : unsupported(false) {}
+
+  void visit(Node&) override { return; }
+  void visit(GroupNode&) override { return; }
+  void visit(GeometryNode&) override { return; }
+  void visit(Drawable&) override { return; }
+  void visit(SphereGeometry& geometry) override
+  {
+    if (pickable(geometry))
+      spheres.push_back(&geometry);
+  }
+  void visit(AmbientOcclusionSphereGeometry& geometry) override
+  {
+    if (pickable(geometry))
+      unsupported = true;
+  }
+  void visit(CylinderGeometry& geometry) override
+  {
+    if (pickable(geometry))
+      cylinders.push_back(&geometry);
+  }
+  void visit(MeshGeometry&) override { return; }
+  void visit(TextLabel2D&) override { return; }
+  void visit(TextLabel3D&) override { return; }
+  void visit(LineStripGeometry&) override { return; }
+
+  std::vector<SphereGeometry*> spheres;
+  std::vector<CylinderGeometry*> cylinders;
+  // Whether there are pickable drawables that cannot be drawn into the buffer.
+  bool unsupported;
+
+private:
+  // Overlays are drawn on top of the molecule, and are not part of it.
+  bool pickable(const Drawable& geometry) const
+  {
+    return geometry.isVisible() && geometry.identifier().type != InvalidType &&
+           (geometry.renderPass() == OpaquePass ||
+            geometry.renderPass() == TranslucentPass);
+  }
+};
+
+// Order identifiers so that duplicates from different drawables meet.
+bool lessThan(const Identifier& a, const Identifier& b)
+{
+  if (a.molecule != b.molecule)
+    return a.molecule < b.molecule;
+  if (a.type != b.type)
+    return a.type < b.type;
+  return a.index < b.index;
+}
+} // namespace
+
+class IdentifierBuffer::Private
+{
+public:
+  Private() : framebuffer(0), color(0), depth(0), width(0), height(0) {}
+
+  GLuint framebuffer;
+  GLuint color;
+  GLuint depth;
+  // The size the renderbuffers were allocated with.
+  int width;
+  int height;
+};
+
+IdentifierBuffer::IdentifierBuffer()
+  : d(new Private), m_width(0), m_height(0), m_pixelScale(1.0f)
+{
+}
+
+IdentifierBuffer::~IdentifierBuffer()
+{
+  delete d;
+}
+
+void IdentifierBuffer::releaseFramebuffer()
+{
+  if (d->framebuffer != 0) {
+    glDeleteFramebuffers(1, &d->framebuffer);
+    glDeleteRenderbuffers(1, &d->color);
+    glDeleteRenderbuffers(1, &d->depth);
+  }
+  d->framebuffer = d->color = d->depth = 0;
+  d->width = d->height = 0;
+}
+
+bool IdentifierBuffer::render(GroupNode& root, const Camera& camera,
+                              ShaderCache* cache)
+{
+  clear();
+  if (!ShaderProgram::instancedArraysSupported()) {
+    m_error = "GL version 3.3 is needed to pick from the identifier buffer.";
+    return false;
+  }
+  const int width = camera.width();
+  const int height = camera.height();
+  if (width <= 0 || height <= 0) {
+    m_error = "The camera has no viewport.";
+    return false;
+  }
+
+  // The widget may draw into a framebuffer of its own, which is restored at
+  // the end.
+  GLint drawFramebuffer;
+  GLint readFramebuffer;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+
+  if (d->framebuffer == 0) {
+    glGenFramebuffers(1, &d->framebuffer);
+    glGenRenderbuffers(1, &d->color);
+    glGenRenderbuffers(1, &d->depth);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, d->framebuffer);
+  if (width != d->width || height != d->height) {
+    glBindRenderbuffer(GL_RENDERBUFFER, d->color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, d->depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width,
+                          height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, d->color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, d->depth);
+    d->width = width;
+    d->height = height;
+  }
+
+  // The drawables past the last number could not be told apart, and those
+  // that cannot be drawn would not be found. Rather than leave them out, fail
+  // so that the caller falls back to casting rays.
+  PickableVisitor visitor;
+  root.accept(visitor);
+  bool result = false;
+  if (visitor.spheres.size() + visitor.cylinders.size() > maxDrawables) {
+    m_error = "There are too many drawables for the identifier buffer.";
+  } else if (visitor.unsupported) {
+    m_error = "Ambient occlusion spheres cannot be drawn into the identifier "
+              "buffer.";
+  } else if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+             GL_FRAMEBUFFER_COMPLETE) {
+    m_error = "The identifier framebuffer is incomplete.";
+  } else {
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    std::vector<Identifier> drawables;
+    bool drawn = true;
+    for (size_t i = 0; drawn && i < visitor.spheres.size(); ++i) {
+      drawables.push_back(visitor.spheres[i]->identifier());
+      visitor.spheres[i]->setShaderCache(cache);
+      drawn = visitor.spheres[i]->renderIdentifiers(
+        camera, static_cast<int>(drawables.size()));
+    }
+    for (size_t i = 0; drawn && i < visitor.cylinders.size(); ++i) {
+      drawables.push_back(visitor.cylinders[i]->identifier());
+      visitor.cylinders[i]->setShaderCache(cache);
+      drawn = visitor.cylinders[i]->renderIdentifiers(
+        camera, static_cast<int>(drawables.size()));
+    }
+
+    if (drawn) {
+      std::vector<unsigned char> pixels(4 * static_cast<size_t>(width) *
+                                        height);
+      glPixelStorei(GL_PACK_ALIGNMENT, 1);
+      glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                   &pixels[0]);
+      result = setPixels(pixels, width, height, drawables,
+                         camera.devicePixelRatio());
+    } else {
+      m_error = "A pickable drawable could not be drawn into the identifier "
+                "buffer.";
+    }
+  }
+
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+  if (!result)
+    clear();
+  return result;
+}
+
+Vector3ub IdentifierBuffer::color(size_t index)
+{
+  // Zero is the background, so the primitives are counted from one.
+  const size_t value = index + 1;
+  return Vector3ub(static_cast<unsigned char>(value & 0xff),
+                   static_cast<unsigned char>((value >> 8) & 0xff),
+                   static_cast<unsigned char>((value >> 16) & 0xff));
+}
+
+bool IdentifierBuffer::setPixels(const std::vector<unsigned char>& pixels,
+                                 int width, int height,
+                                 const std::vector<Identifier>& drawables,
+                                 float pixelScale)
+{
+  clear();
+  if (width <= 0 || height <= 0 ||
+      pixels.size() != 4 * static_cast<size_t>(width) * height ||
+      drawables.size() > maxDrawables) {
+    m_error = "The pixels do not match the size of the identifier buffer, or "
+              "there are too many drawables.";
+    return false;
+  }
+  m_pixels = pixels;
+  m_drawables = drawables;
+  m_width = width;
+  m_height = height;
+  m_pixelScale = pixelScale;
+  return true;
+}
+
+void IdentifierBuffer::clear()
+{
+  m_pixels.clear();
+  m_drawables.clear();
+}
+
+Identifier IdentifierBuffer::hit(int x, int y) const
+{
+  const Vector2i p = pixel(x, y);
+  if (m_pixels.empty() || p.x() < 0 || p.y() < 0 || p.x() >= m_width ||
+      p.y() >= m_height) {
+    return Identifier();
+  }
+  return identifier(value(p.x(), p.y()));
+}
+
+std::vector<Identifier> IdentifierBuffer::hits(int x1, int y1, int x2,
+                                               int y2) const
+{
+  std::vector<Vector2i> polygon;
+  polygon.push_back(Vector2i(x1, y1));
+  polygon.push_back(Vector2i(x2, y1));
+  polygon.push_back(Vector2i(x2, y2));
+  polygon.push_back(Vector2i(x1, y2));
+  return hits(polygon);
+}
+
+std::vector<Identifier> IdentifierBuffer::hits(
+  const std::vector<Vector2i>& polygon) const
+{
+  std::vector<Identifier> result;
+  if (m_pixels.empty() || polygon.size() < 3)
+    return result;
+
+  // The corners are points rather than pixels, the top of the display is at
+  // the height of the framebuffer.
+  std::vector<Vector2f> corners;
+  corners.reserve(polygon.size());
+  for (size_t i = 0; i < polygon.size(); ++i) {
+    corners.push_back(Vector2f(m_pixelScale * polygon[i].x(),
+                               m_height - m_pixelScale * polygon[i].y()));
+  }
+  Vector2f min = corners[0];
+  Vector2f max = corners[0];
+  for (size_t i = 1; i < corners.size(); ++i) {
+    min = min.cwiseMin(corners[i]);
+    max = max.cwiseMax(corners[i]);
+  }
+  const int rowBegin = std::max(0, static_cast<int>(std::floor(min.y())));
+  const int rowEnd =
+    std::min(m_height, static_cast<int>(std::floor(max.y())) + 1);
+  const int columnBegin = std::max(0, static_cast<int>(std::floor(min.x())));
+  const int columnEnd =
+    std::min(m_width, static_cast<int>(std::floor(max.x())) + 1);
+
+  // Fill each row between the edges it crosses, testing pixel centers.
+  std::set<unsigned int> values;
+  std::vector<float> crossings;
+  for (int row = rowBegin; row < rowEnd; ++row) {
+    const float y = row + 0.5f;
+    crossings.clear();
+    for (size_t i = 0; i < corners.size(); ++i) {
+      const Vector2f& a = corners[i];
+      const Vector2f& b = corners[(i + 1) % corners.size()];
+      if ((a.y() <= y) != (b.y() <= y))
+        crossings.push_back(a.x() + (y - a.y()) / (b.y() - a.y()) *
+                                      (b.x() - a.x()));
+    }
+    std::sort(crossings.begin(), crossings.end());
+    for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+      const int begin = std::max(
+        columnBegin, static_cast<int>(std::ceil(crossings[i] - 0.5f)));
+      const int end = std::min(
+        columnEnd, static_cast<int>(std::ceil(crossings[i + 1] - 0.5f)));
+      // Neighboring pixels mostly belong to the same primitive.
+      unsigned int last = 0;
+      for (int column = begin; column < end; ++column) {
+        const unsigned int pixelValue = value(column, row);
+        if (pixelValue != last && pixelValue != 0)
+          values.insert(pixelValue);
+        last = pixelValue;
+      }
+    }
+  }
+
+  for (std::set<unsigned int>::const_iterator it = values.begin();
+       it != values.end(); ++it) {
+    Identifier id = identifier(*it);
+    if (id.type != InvalidType)
+      result.push_back(id);
+  }
+  std::sort(result.begin(), result.end(), lessThan);
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+unsigned int IdentifierBuffer::value(int x, int y) const
+{
+  const unsigned char* rgba =
+    &m_pixels[4 * (static_cast<size_t>(y) * m_width + x)];
+  return static_cast<unsigned int>(rgba[0]) |
+         (static_cast<unsigned int>(rgba[1]) << 8) |
+         (static_cast<unsigned int>(rgba[2]) << 16) |
+         (static_cast<unsigned int>(rgba[3]) << 24);
+}
+
+Identifier IdentifierBuffer::identifier(unsigned int value) const
+{
+  const size_t number = value >> 24;
+  const size_t index = value & 0xffffff;
+  if (number == 0 || number > m_drawables.size() || index == 0)
+    return Identifier();
+
+  Identifier id = m_drawables[number - 1];
+  id.index = index - 1;
+  return id;
+}
+
+Vector2i IdentifierBuffer::pixel(int x, int y) const
+{
+  // Match Camera::unProject(), which flips the display coordinates.
+  const int column = static_cast<int>(std::floor(m_pixelScale * x));
+  const int row = static_cast<int>(std::floor(m_pixelScale * y));
+  return Vector2i(column, m_height - 1 - row);
+}
+
+} // End Rendering namespace
+} // End Avogadro namespace
@@ -0,0 +1,146 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#ifndef AVOGADRO_RENDERING_IDENTIFIERBUFFER_H
+#define AVOGADRO_RENDERING_IDENTIFIERBUFFER_H
+
+#include "avogadrorenderingexport.h"
+
+#include "primitive.h"
+
+#include <avogadro/core/vector.h>
+
+#include <string> // For member variables.
+#include <vector> // For member variables.
+
+namespace Avogadro {
+namespace Rendering {
+
+class Camera;
+class GroupNode;
+class ShaderCache;
+
+/**
+ * @class IdentifierBuffer identifierbuffer.h
+ * <avogadro/rendering/identifierbuffer.h>
+ * @brief The IdentifierBuffer class finds the primitives drawn at each pixel.
+ *
+ * The pickable spheres and cylinders of the scene are drawn into an offscreen
+ * framebuffer, with each pixel holding the number of the drawable in its alpha
+ * channel and the index of the primitive plus one in its other channels. The
+ * framebuffer is read back once after it is drawn, so that finding what is
+ * under the mouse costs a lookup, and finding everything visible in an area of
+ * the screen costs a pass over its pixels.
+ *
+ * The primitives are drawn as instances, so the buffer needs OpenGL 3.3.
+ * Positions are in the display coordinates used by GLRenderer::hits(), with
+ * the origin at the top left.
+ */
+class AVOGADRORENDERING_EXPORT IdentifierBuffer
+{
+public:
+  IdentifierBuffer();
+  ~IdentifierBuffer();
+
+  /**
+   * Draw the pickable primitives below @a root as seen by @a camera and read
+   * them back. The context must be current.
+   * @return False if the buffer could not be drawn, in which case it is left
+   * empty and error() says why.
+   */
+  bool render(GroupNode& root, const Camera& camera, ShaderCache* cache);
+
+  /**
+   * Set the buffer to pixels drawn and read back by the caller, as render()
+   * does after drawing the scene.
+   * @param pixels The RGBA pixels, the bottom row first, each holding the
+   * number of a drawable in @a drawables in its alpha channel (counted from
+   * one, zero is the background) and the color() of a primitive.
+   * @param width The number of pixels in a row.
+   * @param height The number of rows.
+   * @param drawables The molecule and type of each of the drawables.
+   * @param pixelScale The number of pixels to a display coordinate.
+   * @return False if the pixels do not match the size, or there are too many
+   * drawables, in which case the buffer is left empty.
+   */
+  bool setPixels(const std::vector<unsigned char>& pixels, int width,
+                 int height, const std::vector<Identifier>& drawables,
+                 float pixelScale = 1.0f);
+
+  /** Forget the primitives read back by the last render(). */
+  void clear();
+
+  /**
+   * Delete the framebuffer render() draws into. The context it was made in
+   * must be current. The destructor makes no GL calls, as the context may not
+   * be current or may already be gone.
+   */
+  void releaseFramebuffer();
+
+  /** @return True if there is nothing to look up. */
+  bool isEmpty() const { return m_pixels.empty(); }
+
+  /**
+   * Get the primitive at the display coordinate (x,y).
+   * @return The primitive, or an invalid Identifier if there is none.
+   */
+  Identifier hit(int x, int y) const;
+
+  /**
+   * Get each primitive visible in the rectangle with corners at the display
+   * coordinates (x1,y1) and (x2,y2), once.
+   */
+  std::vector<Identifier> hits(int x1, int y1, int x2, int y2) const;
+
+  /**
+   * Get each primitive visible inside of the polygon with corners at the
+   * display coordinates in @a polygon, such as a lasso drawn by the user,
+   * once.
+   */
+  std::vector<Identifier> hits(const std::vector<Vector2i>& polygon) const;
+
+  /**
+   * Get the color a drawable passes to its shaders in place of the color of
+   * the primitive with @a index while the buffer is drawn. The index must be
+   * less than maxIndex().
+   */
+  static Vector3ub color(size_t index);
+
+  /** The first primitive index that cannot be told apart from the others. */
+  static size_t maxIndex() { return (size_t(1) << 24) - 1; }
+
+  /** Get the error message from the last render() that failed. */
+  std::string error() const { return m_error; }
+
+private:
+  IdentifierBuffer(const IdentifierBuffer&);            // Not implemented.
+  IdentifierBuffer& operator=(const IdentifierBuffer&); // Not implemented.
+
+  // Get the pixel at column x and row y of the framebuffer, with the red
+  // channel in the lowest byte.
+  unsigned int value(int x, int y) const;
+  // Decode a pixel.
+  Identifier identifier(unsigned int value) const;
+  // Convert a display coordinate to the column and row of the framebuffer.
+  Vector2i pixel(int x, int y) const;
+
+  class Private;
+  Private* d;
+
+  // The pixels of the framebuffer, RGBA bottom row first.
+  std::vector<unsigned char> m_pixels;
+  // The molecule and type of each drawable, by its number less one.
+  std::vector<Identifier> m_drawables;
+  int m_width;
+  int m_height;
+  float m_pixelScale;
+
+  std::string m_error;
+};
+
+} // End Rendering namespace
+} // End Avogadro namespace
+
+#endif // AVOGADRO_RENDERING_IDENTIFIERBUFFER_H
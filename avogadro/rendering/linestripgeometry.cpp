@@ -20,7 +20,6 @@
 #include "bufferobject.h"
 #include "camera.h"
 #include "scene.h"
-#include "shader.h"
 #include "shaderprogram.h"
 #include "visitor.h"
 
@@ -52,13 +51,11 @@ const size_t LineStripGeometry::InvalidIndex =
 class LineStripGeometry::Private
 {
 public:
-  Private() {}
+  Private() : program(nullptr) {}
 
   BufferObject vbo;
 
-  Shader vertexShader;
-  Shader fragmentShader;
-  ShaderProgram program;
+  ShaderProgram* program;
 };
 
 LineStripGeometry::LineStripGeometry()
@@ -95,21 +92,8 @@ void LineStripGeometry::update()
     m_dirty = false;
   }
 
-  // Build and link the shader if it has not been used yet.
-  if (d->vertexShader.type() == Shader::Unknown) {
-    d->vertexShader.setType(Shader::Vertex);
-    d->vertexShader.setSource(linestrip_vs);
-    d->fragmentShader.setType(Shader::Fragment);
-    d->fragmentShader.setSource(linestrip_fs);
-    if (!d->vertexShader.compile())
-      cout << d->vertexShader.error() << endl;
-    if (!d->fragmentShader.compile())
-      cout << d->fragmentShader.error() << endl;
-    d->program.attachShader(d->vertexShader);
-    d->program.attachShader(d->fragmentShader);
-    if (!d->program.link())
-      cout << d->program.error() << endl;
-  }
+  // The cache builds the program the first time it is asked for it.
+  d->program = shaderProgram(linestrip_vs, linestrip_fs);
 }
 
 void LineStripGeometry::render(const Camera& camera)
@@ -121,33 +105,36 @@ void LineStripGeometry::render(const Camera& camera)
   // Prepare the VBO and shader program if necessary.
   update();
 
-  if (!d->program.bind())
-    cout << d->program.error() << endl;
+  if (!d->program)
+    return;
+  if (!d->program->bind())
+    cout << d->program->error() << endl;
 
   d->vbo.bind();
 
   // Set up our attribute arrays.
-  if (!d->program.enableAttributeArray("vertex"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray("vertex", PackedVertex::vertexOffset(),
-                                    sizeof(PackedVertex), FloatType, 3,
-                                    ShaderProgram::NoNormalize)) {
-    cout << d->program.error() << endl;
+  if (!d->program->enableAttributeArray("vertex"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray("vertex", PackedVertex::vertexOffset(),
+                                     sizeof(PackedVertex), FloatType, 3,
+                                     ShaderProgram::NoNormalize)) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.enableAttributeArray("color"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray("color", PackedVertex::colorOffset(),
-                                    sizeof(PackedVertex), UCharType, 4,
-                                    ShaderProgram::Normalize)) {
-    cout << d->program.error() << endl;
+  if (!d->program->enableAttributeArray("color"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray("color", PackedVertex::colorOffset(),
+                                     sizeof(PackedVertex), UCharType, 4,
+                                     ShaderProgram::Normalize)) {
+    cout << d->program->error() << endl;
   }
 
   // Set up our uniforms (model-view and projection matrices right now).
-  if (!d->program.setUniformValue("modelView", camera.modelView().matrix())) {
-    cout << d->program.error() << endl;
+  if (!d->program->setUniformValue("modelView", camera.modelView().matrix())) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.setUniformValue("projection", camera.projection().matrix())) {
-    cout << d->program.error() << endl;
+  if (!d->program->setUniformValue("projection",
+                                   camera.projection().matrix())) {
+    cout << d->program->error() << endl;
   }
 
   // Render the linestrips using the shader and bound VBO.
@@ -175,10 +162,10 @@ void LineStripGeometry::render(const Camera& camera)
 
   d->vbo.release();
 
-  d->program.disableAttributeArray("vector");
-  d->program.disableAttributeArray("color");
+  d->program->disableAttributeArray("vector");
+  d->program->disableAttributeArray("color");
 
-  d->program.release();
+  d->program->release();
 }
 
 void LineStripGeometry::clear()
@@ -260,5 +247,11 @@ size_t LineStripGeometry::addLineStrip(const Core::Array<Vector3f>& vertices,
   return result;
 }
 
+void LineStripGeometry::setVertex(size_t index, const Vector3f& position)
+{
+  m_vertices[index].vertex = position;
+  m_dirty = true;
+}
+
 } // End namespace Rendering
 } // End namespace Avogadro
@@ -90,6 +90,11 @@ public:
   size_t addLineStrip(const Core::Array<Vector3f>& vertices, float lineWidth);
   /** @} */
 
+  /**
+   * Move the vertex at @a index, keeping its color, e.g. to follow an atom.
+   */
+  void setVertex(size_t index, const Vector3f& position);
+
   /**
    * The default color of the lines. This is used to set the color of new
    * vertices when no explicit vertex color is specified.
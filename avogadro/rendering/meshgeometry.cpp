@@ -20,7 +20,6 @@
 #include "bufferobject.h"
 #include "camera.h"
 #include "scene.h"
-#include "shader.h"
 #include "shaderprogram.h"
 #include "visitor.h"
 
@@ -52,14 +51,12 @@ const unsigned int MeshGeometry::InvalidIndex =
 class MeshGeometry::Private
 {
 public:
-  Private() {}
+  Private() : program(nullptr) {}
 
   BufferObject vbo;
   BufferObject ibo;
 
-  Shader vertexShader;
-  Shader fragmentShader;
-  ShaderProgram program;
+  ShaderProgram* program;
 
   size_t numberOfVertices;
   size_t numberOfIndices;
@@ -102,21 +99,8 @@ void MeshGeometry::update()
     m_dirty = false;
   }
 
-  // Build and link the shader if it has not been used yet.
-  if (d->vertexShader.type() == Shader::Unknown) {
-    d->vertexShader.setType(Shader::Vertex);
-    d->vertexShader.setSource(mesh_vs);
-    d->fragmentShader.setType(Shader::Fragment);
-    d->fragmentShader.setSource(mesh_fs);
-    if (!d->vertexShader.compile())
-      cout << d->vertexShader.error() << endl;
-    if (!d->fragmentShader.compile())
-      cout << d->fragmentShader.error() << endl;
-    d->program.attachShader(d->vertexShader);
-    d->program.attachShader(d->fragmentShader);
-    if (!d->program.link())
-      cout << d->program.error() << endl;
-  }
+  // The cache builds the program the first time it is asked for it.
+  d->program = shaderProgram(mesh_vs, mesh_fs);
 }
 
 void MeshGeometry::render(const Camera& camera)
@@ -127,45 +111,48 @@ void MeshGeometry::render(const Camera& camera)
   // Prepare the VBOs, IBOs and shader program if necessary.
   update();
 
-  if (!d->program.bind())
-    cout << d->program.error() << endl;
+  if (!d->program)
+    return;
+  if (!d->program->bind())
+    cout << d->program->error() << endl;
 
   d->vbo.bind();
   d->ibo.bind();
 
   // Set up our attribute arrays.
-  if (!d->program.enableAttributeArray("vertex"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray("vertex", PackedVertex::vertexOffset(),
-                                    sizeof(PackedVertex), FloatType, 3,
-                                    ShaderProgram::NoNormalize)) {
-    cout << d->program.error() << endl;
+  if (!d->program->enableAttributeArray("vertex"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray("vertex", PackedVertex::vertexOffset(),
+                                     sizeof(PackedVertex), FloatType, 3,
+                                     ShaderProgram::NoNormalize)) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.enableAttributeArray("color"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray("color", PackedVertex::colorOffset(),
-                                    sizeof(PackedVertex), UCharType, 4,
-                                    ShaderProgram::Normalize)) {
-    cout << d->program.error() << endl;
+  if (!d->program->enableAttributeArray("color"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray("color", PackedVertex::colorOffset(),
+                                     sizeof(PackedVertex), UCharType, 4,
+                                     ShaderProgram::Normalize)) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.enableAttributeArray("normal"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray("normal", PackedVertex::normalOffset(),
-                                    sizeof(PackedVertex), FloatType, 3,
-                                    ShaderProgram::NoNormalize)) {
-    cout << d->program.error() << endl;
+  if (!d->program->enableAttributeArray("normal"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray("normal", PackedVertex::normalOffset(),
+                                     sizeof(PackedVertex), FloatType, 3,
+                                     ShaderProgram::NoNormalize)) {
+    cout << d->program->error() << endl;
   }
 
   // Set up our uniforms (model-view and projection matrices right now).
-  if (!d->program.setUniformValue("modelView", camera.modelView().matrix())) {
-    cout << d->program.error() << endl;
+  if (!d->program->setUniformValue("modelView", camera.modelView().matrix())) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.setUniformValue("projection", camera.projection().matrix())) {
-    cout << d->program.error() << endl;
+  if (!d->program->setUniformValue("projection",
+                                   camera.projection().matrix())) {
+    cout << d->program->error() << endl;
   }
   Matrix3f normalMatrix = camera.modelView().linear().inverse().transpose();
-  if (!d->program.setUniformValue("normalMatrix", normalMatrix))
-    std::cout << d->program.error() << std::endl;
+  if (!d->program->setUniformValue("normalMatrix", normalMatrix))
+    std::cout << d->program->error() << std::endl;
 
   // Render the loaded spheres using the shader and bound VBO.
   glDrawRangeElements(GL_TRIANGLES, 0,
@@ -176,11 +163,11 @@ void MeshGeometry::render(const Camera& camera)
   d->vbo.release();
   d->ibo.release();
 
-  d->program.disableAttributeArray("vector");
-  d->program.disableAttributeArray("color");
-  d->program.disableAttributeArray("normal");
+  d->program->disableAttributeArray("vector");
+  d->program->disableAttributeArray("color");
+  d->program->disableAttributeArray("normal");
 
-  d->program.release();
+  d->program->release();
 }
 
 unsigned int MeshGeometry::addVertices(const Core::Array<Vector3f>& v,
@@ -0,0 +1,115 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include "shadercache.h"
+
+#include "shader.h"
+#include "shaderprogram.h"
+
+namespace Avogadro {
+namespace Rendering {
+
+class ShaderCache::Program
+{
+public:
+  Program() : valid(false) {}
+
+  // Delete the GL objects, the context they were built in must be current.
+  void release()
+  {
+    program.cleanup();
+    vertexShader.cleanup();
+    fragmentShader.cleanup();
+  }
+
+  bool build(const char* vertexSource, const char* fragmentSource,
+             std::string& error);
+
+  Shader vertexShader;
+  Shader fragmentShader;
+  ShaderProgram program;
+  bool valid;
+};
+
+bool ShaderCache::Program::build(const char* vertexSource,
+                                 const char* fragmentSource,
+                                 std::string& error)
+{
+  vertexShader.setType(Shader::Vertex);
+  vertexShader.setSource(vertexSource);
+  if (!vertexShader.compile()) {
+    error = vertexShader.error();
+    return false;
+  }
+  if (!program.attachShader(vertexShader)) {
+    error = program.error();
+    return false;
+  }
+  if (fragmentSource) {
+    fragmentShader.setType(Shader::Fragment);
+    fragmentShader.setSource(fragmentSource);
+    if (!fragmentShader.compile()) {
+      error = fragmentShader.error();
+      return false;
+    }
+    if (!program.attachShader(fragmentShader)) {
+      error = program.error();
+      return false;
+    }
+  }
+  if (!program.link()) {
+    error = program.error();
+    return false;
+  }
+  valid = true;
+  return true;
+}
+
+ShaderCache::ShaderCache()
+{
+}
+
+ShaderCache::~ShaderCache()
+{
+  // No context may be current here, so leave the GL objects to it.
+  for (std::map<std::pair<const char*, const char*>, Program*>::iterator it =
+         m_programs.begin();
+       it != m_programs.end(); ++it) {
+    delete it->second;
+  }
+}
+
+ShaderProgram* ShaderCache::program(const char* vertexSource,
+                                    const char* fragmentSource)
+{
+  if (!vertexSource) {
+    m_error = "A program needs a vertex shader.";
+    return nullptr;
+  }
+
+  std::pair<const char*, const char*> key(vertexSource, fragmentSource);
+  std::map<std::pair<const char*, const char*>, Program*>::iterator it =
+    m_programs.find(key);
+  if (it == m_programs.end()) {
+    Program* program = new Program;
+    program->build(vertexSource, fragmentSource, m_error);
+    it = m_programs.insert(std::make_pair(key, program)).first;
+  }
+  return it->second->valid ? &it->second->program : nullptr;
+}
+
+void ShaderCache::clear()
+{
+  for (std::map<std::pair<const char*, const char*>, Program*>::iterator it =
+         m_programs.begin();
+       it != m_programs.end(); ++it) {
+    it->second->release();
+    delete it->second;
+  }
+  m_programs.clear();
+}
+
+} // End Rendering namespace
+} // End Avogadro namespace
@@ -0,0 +1,74 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#ifndef AVOGADRO_RENDERING_SHADERCACHE_H
+#define AVOGADRO_RENDERING_SHADERCACHE_H
+
+#include "avogadrorenderingexport.h"
+
+#include <map>     // For member variables.
+#include <string>  // For member variables.
+#include <utility> // For member variables.
+
+namespace Avogadro {
+namespace Rendering {
+
+class ShaderProgram;
+
+/**
+ * @class ShaderCache shadercache.h <avogadro/rendering/shadercache.h>
+ * @brief The ShaderCache class builds each shader program once per context.
+ *
+ * Drawables of the same type all use the same shaders. The GLRenderer owns
+ * one ShaderCache for its context and hands it to the drawables as they are
+ * rendered, so rebuilding the scene does not compile and link them again.
+ *
+ * The destructor makes no GL calls, as the context may not be current or may
+ * already be gone. Call clear() while the context is current to delete the
+ * programs sooner than the context itself.
+ */
+class AVOGADRORENDERING_EXPORT ShaderCache
+{
+public:
+  ShaderCache();
+  ~ShaderCache();
+
+  /**
+   * Get the program linked from the vertex and fragment shader sources,
+   * building it the first time it is asked for. Programs are found by the
+   * addresses of their sources, which are the strings compiled into the
+   * library. A program that failed to build is not tried again.
+   * @param vertexSource The source of the vertex shader.
+   * @param fragmentSource The source of the fragment shader, or nullptr for a
+   * program with only a vertex shader.
+   * @return The program, or nullptr if it could not be built.
+   */
+  ShaderProgram* program(const char* vertexSource, const char* fragmentSource);
+
+  /** The number of programs built so far, including failed ones. */
+  size_t size() const { return m_programs.size(); }
+
+  /**
+   * Delete all of the programs. The context they were built in must be
+   * current, and programs returned earlier must no longer be used.
+   */
+  void clear();
+
+  /** Get the error message from the last program that failed to build. */
+  std::string error() const { return m_error; }
+
+private:
+  ShaderCache(const ShaderCache&);            // Not implemented.
+  ShaderCache& operator=(const ShaderCache&); // Not implemented.
+
+  class Program;
+  std::map<std::pair<const char*, const char*>, Program*> m_programs;
+  std::string m_error;
+};
+
+} // End Rendering namespace
+} // End Avogadro namespace
+
+#endif // AVOGADRO_RENDERING_SHADERCACHE_H
@@ -218,6 +218,7 @@ bool ShaderProgram::link()
   }
   m_linked = true;
   m_attributes.clear();
+  m_uniforms.clear();
   return true;
 }
 
@@ -236,6 +237,20 @@ void ShaderProgram::release()
   releaseAllTextureUnits();
 }
 
+void ShaderProgram::cleanup()
+{
+  if (m_handle == 0)
+    return;
+
+  glDeleteProgram(static_cast<GLuint>(m_handle));
+  m_handle = 0;
+  m_vertexShader = 0;
+  m_fragmentShader = 0;
+  m_linked = false;
+  m_attributes.clear();
+  m_uniforms.clear();
+}
+
 bool ShaderProgram::enableAttributeArray(const std::string& name)
 {
   GLint location = static_cast<GLint>(findAttributeArray(name));
@@ -276,6 +291,29 @@ bool ShaderProgram::useAttributeArray(const std::string& name, int offset,
   return true;
 }
 
+bool ShaderProgram::setAttributeArrayDivisor(const std::string& name,
+                                             unsigned int divisor)
+{
+  GLint location = static_cast<GLint>(findAttributeArray(name));
+  if (location == -1) {
+    m_error = "Could not set divisor of attribute " + name +
+              ". No such attribute.";
+    return false;
+  }
+  if (!instancedArraysSupported()) {
+    m_error = "Could not set divisor of attribute " + name +
+              ". Instanced arrays are not supported.";
+    return false;
+  }
+  glVertexAttribDivisor(location, divisor);
+  return true;
+}
+
+bool ShaderProgram::instancedArraysSupported()
+{
+  return GLEW_VERSION_3_3 != 0;
+}
+
 bool ShaderProgram::setTextureSampler(const std::string& name,
                                       const Texture2D& texture)
 {
@@ -464,9 +502,16 @@ inline int ShaderProgram::findAttributeArray(const std::string& name)
 {
   if (name.empty() || !m_linked)
     return -1;
-  const GLchar* namePtr = static_cast<const GLchar*>(name.c_str());
-  GLint location = static_cast<int>(
-    glGetAttribLocation(static_cast<GLuint>(m_handle), namePtr));
+  std::map<std::string, int>::const_iterator it = m_attributes.find(name);
+  GLint location;
+  if (it != m_attributes.end()) {
+    location = static_cast<GLint>(it->second);
+  } else {
+    const GLchar* namePtr = static_cast<const GLchar*>(name.c_str());
+    location = static_cast<int>(
+      glGetAttribLocation(static_cast<GLuint>(m_handle), namePtr));
+    m_attributes[name] = location;
+  }
   if (location == -1) {
     m_error = "Specified attribute not found in current shader program: ";
     m_error += name;
@@ -479,9 +524,16 @@ inline int ShaderProgram::findUniform(const std::string& name)
 {
   if (name.empty() || !m_linked)
     return -1;
-  const GLchar* namePtr = static_cast<const GLchar*>(name.c_str());
-  GLint location = static_cast<int>(
-    glGetUniformLocation(static_cast<GLuint>(m_handle), namePtr));
+  std::map<std::string, int>::const_iterator it = m_uniforms.find(name);
+  GLint location;
+  if (it != m_uniforms.end()) {
+    location = static_cast<GLint>(it->second);
+  } else {
+    const GLchar* namePtr = static_cast<const GLchar*>(name.c_str());
+    location = static_cast<int>(
+      glGetUniformLocation(static_cast<GLuint>(m_handle), namePtr));
+    m_uniforms[name] = location;
+  }
   if (location == -1)
     m_error = "Uniform " + name + " not found in current shader program.";
 
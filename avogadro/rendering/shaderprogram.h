@@ -91,6 +91,9 @@ public:
   /** Releases the shader program from the current context. */
   void release();
 
+  /** Delete the program, which needs the context it was made in. */
+  void cleanup();
+
   /** Get the error message (empty if none) for the shader program. */
   std::string error() const { return m_error; }
 
@@ -122,6 +125,20 @@ public:
                          Avogadro::Type elementType, int elementTupleSize,
                          NormalizeOption normalize);
 
+  /** Advance the named attribute array once every @a divisor instances drawn
+   * by glDrawArraysInstanced() instead of once per vertex, which is what a
+   * divisor of 0 restores. Attribute state is shared by all programs, so a
+   * divisor that was set must be reset to 0 after drawing.
+   * @return false if the attribute array does not exist, or if instanced
+   * arrays are not supported.
+   */
+  bool setAttributeArrayDivisor(const std::string& name, unsigned int divisor);
+
+  /** @return True if the current context supports instanced arrays, which
+   * needs OpenGL 3.3.
+   */
+  static bool instancedArraysSupported();
+
   /** Upload the supplied array of tightly packed values to the named attribute.
    * BufferObject attributes should be preferred and this may be removed in
    * future.
@@ -175,7 +192,9 @@ protected:
 
   std::string m_error;
 
+  // The locations looked up since the program was last linked.
   std::map<std::string, int> m_attributes;
+  std::map<std::string, int> m_uniforms;
 
   std::map<const Texture2D*, int> m_textureUnitBindings;
   std::vector<bool> m_boundTextureUnits;
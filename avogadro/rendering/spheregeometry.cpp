@@ -19,20 +19,23 @@
 #include "camera.h"
 #include "scene.h"
 
+#include "boundingvolumehierarchy.h"
 #include "bufferobject.h"
+#include "identifierbuffer.h"
 
-#include "shader.h"
 #include "shaderprogram.h"
 
 #include "visitor.h"
 
 namespace {
 #include "spheres_fs.h"
+#include "spheres_instanced_vs.h"
 #include "spheres_vs.h"
 }
 
 #include "avogadrogl.h"
 
+#include <algorithm>
 #include <iostream>
 
 using std::cout;
@@ -41,29 +44,173 @@ using std::endl;
 namespace Avogadro {
 namespace Rendering {
 
+namespace {
+// Offsets of the members of the SphereColor records used for instancing.
+const int centerOffset = 0;
+const int radiusOffset = static_cast<int>(sizeof(Vector3f));
+const int colorOffset = radiusOffset + static_cast<int>(sizeof(float));
+
+// The four corners of the quad the sphere is drawn on.
+void appendVertices(const SphereColor& sphere,
+                    std::vector<ColorTextureVertex>& vertices)
+{
+  float r = sphere.radius;
+  ColorTextureVertex vert(sphere.center, sphere.color, Vector2f(-r, -r));
+  vertices.push_back(vert);
+  vert.textureCoord = Vector2f(-r, r);
+  vertices.push_back(vert);
+  vert.textureCoord = Vector2f(r, -r);
+  vertices.push_back(vert);
+  vert.textureCoord = Vector2f(r, r);
+  vertices.push_back(vert);
+}
+
+// Intersect the ray with the sphere, setting depth to the distance from the
+// origin of the ray to the nearest side of the sphere.
+bool intersect(const SphereColor& sphere, const Vector3f& rayOrigin,
+               const Vector3f& rayEnd, const Vector3f& rayDirection,
+               float& depth)
+{
+  Vector3f distance = sphere.center - rayOrigin;
+  float B = distance.dot(rayDirection);
+  float C = distance.dot(distance) - (sphere.radius * sphere.radius);
+  float D = B * B - C;
+
+  // Test for intersection
+  if (D < 0)
+    return false;
+
+  // Test for clipping
+  if (B < 0 || (sphere.center - rayEnd).dot(rayDirection) > 0)
+    return false;
+
+  float rootD = static_cast<float>(sqrt(D));
+  depth = std::min(std::abs(B + rootD), std::abs(B - rootD));
+  return true;
+}
+} // namespace
+
 class SphereGeometry::Private
 {
 public:
-  Private() {}
+  Private() : program(nullptr), instanced(false), identifierCount(0) {}
 
   BufferObject vbo;
   BufferObject ibo;
+  // The corners of the quad drawn for each instance.
+  BufferObject corners;
 
-  Shader vertexShader;
-  Shader fragmentShader;
-  ShaderProgram program;
+  ShaderProgram* program;
+
+  // Whether the vbo holds one SphereColor per sphere, rather than the four
+  // vertices of its quad.
+  bool instanced;
 
   size_t numberOfVertices;
   size_t numberOfIndices;
+
+  BoundingVolumeHierarchy hierarchy;
+
+  // The colors identifying the spheres in the IdentifierBuffer.
+  BufferObject identifiers;
+  size_t identifierCount;
+
+  // Draw the spheres with their own colors, or with their identifiers as
+  // drawable number if it is not zero.
+  void renderInstanced(const Camera& camera, size_t count, int number = 0);
+  void updateHierarchy(const Core::Array<SphereColor>& spheres);
 };
 
-SphereGeometry::SphereGeometry() : m_dirty(false), d(new Private)
+void SphereGeometry::Private::renderInstanced(const Camera& camera,
+                                              size_t count, int number)
+{
+  if (!program->bind())
+    cout << program->error() << endl;
+
+  // The corners advance per vertex, the spheres once per instance.
+  corners.bind();
+  if (!program->enableAttributeArray("corner") ||
+      !program->useAttributeArray("corner", 0, sizeof(Vector2f), FloatType, 2,
+                                  ShaderProgram::NoNormalize)) {
+    cout << program->error() << endl;
+  }
+  vbo.bind();
+  if (!program->enableAttributeArray("center") ||
+      !program->useAttributeArray("center", centerOffset, sizeof(SphereColor),
+                                  FloatType, 3, ShaderProgram::NoNormalize) ||
+      !program->setAttributeArrayDivisor("center", 1)) {
+    cout << program->error() << endl;
+  }
+  if (!program->enableAttributeArray("sphereRadius") ||
+      !program->useAttributeArray("sphereRadius", radiusOffset,
+                                  sizeof(SphereColor), FloatType, 1,
+                                  ShaderProgram::NoNormalize) ||
+      !program->setAttributeArrayDivisor("sphereRadius", 1)) {
+    cout << program->error() << endl;
+  }
+  if (number != 0) {
+    identifiers.bind();
+    if (!program->enableAttributeArray("color") ||
+        !program->useAttributeArray("color", 0, sizeof(Vector3ub), UCharType,
+                                    3, ShaderProgram::Normalize) ||
+        !program->setAttributeArrayDivisor("color", 1) ||
+        !program->setUniformValue("identifier", number / 255.0f)) {
+      cout << program->error() << endl;
+    }
+  } else if (!program->enableAttributeArray("color") ||
+             !program->useAttributeArray("color", colorOffset,
+                                         sizeof(SphereColor), UCharType, 3,
+                                         ShaderProgram::Normalize) ||
+             !program->setAttributeArrayDivisor("color", 1)) {
+    cout << program->error() << endl;
+  }
+
+  if (!program->setUniformValue("modelView", camera.modelView().matrix()))
+    cout << program->error() << endl;
+  if (!program->setUniformValue("projection", camera.projection().matrix()))
+    cout << program->error() << endl;
+
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+
+  vbo.release();
+  if (number != 0)
+    program->setUniformValue("identifier", 0.0f);
+
+  // The divisors belong to the attribute locations, not to the program.
+  program->setAttributeArrayDivisor("center", 0);
+  program->setAttributeArrayDivisor("sphereRadius", 0);
+  program->setAttributeArrayDivisor("color", 0);
+  program->disableAttributeArray("corner");
+  program->disableAttributeArray("center");
+  program->disableAttributeArray("sphereRadius");
+  program->disableAttributeArray("color");
+
+  program->release();
+}
+
+void SphereGeometry::Private::updateHierarchy(
+  const Core::Array<SphereColor>& spheres)
+{
+  std::vector<BoundingVolumeHierarchy::Box> boxes;
+  boxes.reserve(spheres.size());
+  for (size_t i = 0; i < spheres.size(); ++i) {
+    const Vector3f radius = Vector3f::Constant(spheres[i].radius);
+    boxes.push_back(BoundingVolumeHierarchy::Box(spheres[i].center - radius,
+                                                 spheres[i].center + radius));
+  }
+  hierarchy.build(boxes);
+}
+
+SphereGeometry::SphereGeometry()
+  : m_dirty(false), m_changedBegin(0), m_changedEnd(0),
+    m_hierarchyDirty(true), d(new Private)
 {
 }
 
 SphereGeometry::SphereGeometry(const SphereGeometry& other)
   : Drawable(other), m_spheres(other.m_spheres), m_indices(other.m_indices),
-    m_dirty(true), d(new Private)
+    m_dirty(true), m_changedBegin(0), m_changedEnd(0), m_hierarchyDirty(true),
+    d(new Private)
 {
 }
 
@@ -82,11 +229,38 @@ void SphereGeometry::update()
   if (m_indices.empty() || m_spheres.empty())
     return;
 
+  // Draw one instance per sphere where the context allows it, which uploads
+  // a small fraction of the data and needs no indices. The vertices are drawn
+  // instead if the instanced program cannot be built, and the buffers are
+  // laid out again when that changes.
+  ShaderProgram* instancedProgram = nullptr;
+  if (ShaderProgram::instancedArraysSupported())
+    instancedProgram = shaderProgram(spheres_instanced_vs, spheres_fs);
+  const bool instanced = instancedProgram != nullptr;
+  if (d->vbo.ready() && d->instanced != instanced)
+    m_dirty = true;
+
   // Check if the VBOs are ready, if not get them ready.
-  if (!d->vbo.ready() || m_dirty) {
+  if ((!d->vbo.ready() || m_dirty) && instanced) {
+    if (!d->vbo.upload(m_spheres, BufferObject::ArrayBuffer))
+      cout << d->vbo.error() << endl;
+    if (!d->corners.ready()) {
+      std::vector<Vector2f> corners;
+      corners.push_back(Vector2f(-1.0f, -1.0f));
+      corners.push_back(Vector2f(1.0f, -1.0f));
+      corners.push_back(Vector2f(-1.0f, 1.0f));
+      corners.push_back(Vector2f(1.0f, 1.0f));
+      if (!d->corners.upload(corners, BufferObject::ArrayBuffer))
+        cout << d->corners.error() << endl;
+    }
+    d->instanced = true;
+
+    m_dirty = false;
+    m_changedBegin = m_changedEnd = 0;
+  } else if (!d->vbo.ready() || m_dirty) {
     std::vector<unsigned int> sphereIndices;
     std::vector<ColorTextureVertex> sphereVertices;
-    sphereIndices.reserve(m_indices.size() * 4);
+    sphereIndices.reserve(m_indices.size() * 6);
     sphereVertices.reserve(m_spheres.size() * 4);
 
     std::vector<size_t>::const_iterator itIndex = m_indices.begin();
@@ -96,17 +270,8 @@ void SphereGeometry::update()
          itIndex != m_indices.end() && itSphere != m_spheres.end();
          ++i, ++itIndex, ++itSphere) {
       // Use our packed data structure...
-      float r = itSphere->radius;
       unsigned int index = 4 * static_cast<unsigned int>(*itIndex);
-      ColorTextureVertex vert(itSphere->center, itSphere->color,
-                              Vector2f(-r, -r));
-      sphereVertices.push_back(vert);
-      vert.textureCoord = Vector2f(-r, r);
-      sphereVertices.push_back(vert);
-      vert.textureCoord = Vector2f(r, -r);
-      sphereVertices.push_back(vert);
-      vert.textureCoord = Vector2f(r, r);
-      sphereVertices.push_back(vert);
+      appendVertices(*itSphere, sphereVertices);
 
       // 6 indexed vertices to draw a quad...
       sphereIndices.push_back(index + 0);
@@ -115,8 +280,6 @@ void SphereGeometry::update()
       sphereIndices.push_back(index + 3);
       sphereIndices.push_back(index + 2);
       sphereIndices.push_back(index + 1);
-
-      // m_spheres.push_back(Sphere(position, r, id, color));
     }
 
     if (!d->vbo.upload(sphereVertices, BufferObject::ArrayBuffer))
@@ -127,25 +290,32 @@ void SphereGeometry::update()
 
     d->numberOfVertices = sphereVertices.size();
     d->numberOfIndices = sphereIndices.size();
+    d->instanced = false;
 
     m_dirty = false;
+    m_changedBegin = m_changedEnd = 0;
+  } else if (m_changedBegin < m_changedEnd && d->instanced) {
+    std::vector<SphereColor> spheres(m_spheres.begin() + m_changedBegin,
+                                     m_spheres.begin() + m_changedEnd);
+    if (!d->vbo.update(spheres, m_changedBegin))
+      cout << d->vbo.error() << endl;
+    m_changedBegin = m_changedEnd = 0;
+  } else if (m_changedBegin < m_changedEnd) {
+    // Only the vertices of the spheres changed by setSphere() are replaced.
+    std::vector<ColorTextureVertex> sphereVertices;
+    sphereVertices.reserve((m_changedEnd - m_changedBegin) * 4);
+    for (size_t i = m_changedBegin; i < m_changedEnd; ++i)
+      appendVertices(m_spheres[i], sphereVertices);
+    if (!d->vbo.update(sphereVertices, 4 * m_changedBegin))
+      cout << d->vbo.error() << endl;
+    m_changedBegin = m_changedEnd = 0;
   }
 
-  // Build and link the shader if it has not been used yet.
-  if (d->vertexShader.type() == Shader::Unknown) {
-    d->vertexShader.setType(Shader::Vertex);
-    d->vertexShader.setSource(spheres_vs);
-    d->fragmentShader.setType(Shader::Fragment);
-    d->fragmentShader.setSource(spheres_fs);
-    if (!d->vertexShader.compile())
-      cout << d->vertexShader.error() << endl;
-    if (!d->fragmentShader.compile())
-      cout << d->fragmentShader.error() << endl;
-    d->program.attachShader(d->vertexShader);
-    d->program.attachShader(d->fragmentShader);
-    if (!d->program.link())
-      cout << d->program.error() << endl;
-  }
+  // The cache builds the program the first time it is asked for it.
+  if (d->instanced)
+    d->program = instancedProgram;
+  else
+    d->program = shaderProgram(spheres_vs, spheres_fs);
 }
 
 void SphereGeometry::render(const Camera& camera)
@@ -156,41 +326,49 @@ void SphereGeometry::render(const Camera& camera)
   // Prepare the VBOs, IBOs and shader program if necessary.
   update();
 
-  if (!d->program.bind())
-    cout << d->program.error() << endl;
+  if (!d->program)
+    return;
+  if (d->instanced) {
+    d->renderInstanced(camera, m_spheres.size());
+    return;
+  }
+
+  if (!d->program->bind())
+    cout << d->program->error() << endl;
 
   d->vbo.bind();
   d->ibo.bind();
 
   // Set up our attribute arrays.
-  if (!d->program.enableAttributeArray("vertex"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray(
+  if (!d->program->enableAttributeArray("vertex"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray(
         "vertex", ColorTextureVertex::vertexOffset(),
         sizeof(ColorTextureVertex), FloatType, 3, ShaderProgram::NoNormalize)) {
-    cout << d->program.error() << endl;
+    cout << d->program->error() << endl;
   }
-  if (!d->program.enableAttributeArray("color"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray("color", ColorTextureVertex::colorOffset(),
-                                    sizeof(ColorTextureVertex), UCharType, 3,
-                                    ShaderProgram::Normalize)) {
-    cout << d->program.error() << endl;
+  if (!d->program->enableAttributeArray("color"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray("color", ColorTextureVertex::colorOffset(),
+                                     sizeof(ColorTextureVertex), UCharType, 3,
+                                     ShaderProgram::Normalize)) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.enableAttributeArray("texCoordinate"))
-    cout << d->program.error() << endl;
-  if (!d->program.useAttributeArray(
+  if (!d->program->enableAttributeArray("texCoordinate"))
+    cout << d->program->error() << endl;
+  if (!d->program->useAttributeArray(
         "texCoordinate", ColorTextureVertex::textureCoordOffset(),
         sizeof(ColorTextureVertex), FloatType, 2, ShaderProgram::NoNormalize)) {
-    cout << d->program.error() << endl;
+    cout << d->program->error() << endl;
   }
 
   // Set up our uniforms (model-view and projection matrices right now).
-  if (!d->program.setUniformValue("modelView", camera.modelView().matrix())) {
-    cout << d->program.error() << endl;
+  if (!d->program->setUniformValue("modelView", camera.modelView().matrix())) {
+    cout << d->program->error() << endl;
   }
-  if (!d->program.setUniformValue("projection", camera.projection().matrix())) {
-    cout << d->program.error() << endl;
+  if (!d->program->setUniformValue("projection",
+                                   camera.projection().matrix())) {
+    cout << d->program->error() << endl;
   }
 
   // Render the loaded spheres using the shader and bound VBO.
@@ -201,11 +379,37 @@ void SphereGeometry::render(const Camera& camera)
   d->vbo.release();
   d->ibo.release();
 
-  d->program.disableAttributeArray("vector");
-  d->program.disableAttributeArray("color");
-  d->program.disableAttributeArray("texCoordinates");
+  d->program->disableAttributeArray("vector");
+  d->program->disableAttributeArray("color");
+  d->program->disableAttributeArray("texCoordinates");
+
+  d->program->release();
+}
+
+bool SphereGeometry::renderIdentifiers(const Camera& camera, int number)
+{
+  if (m_indices.empty() || m_spheres.empty())
+    return true;
 
-  d->program.release();
+  update();
+
+  // The identifiers are passed in place of the colors of the instances.
+  if (!d->program || !d->instanced)
+    return false;
+  if (d->identifierCount != m_spheres.size()) {
+    if (m_spheres.size() > IdentifierBuffer::maxIndex())
+      return false;
+    std::vector<Vector3ub> colors(m_spheres.size());
+    for (size_t i = 0; i < colors.size(); ++i)
+      colors[i] = IdentifierBuffer::color(i);
+    if (!d->identifiers.upload(colors, BufferObject::ArrayBuffer)) {
+      cout << d->identifiers.error() << endl;
+      return false;
+    }
+    d->identifierCount = m_spheres.size();
+  }
+  d->renderInstanced(camera, m_spheres.size(), number);
+  return true;
 }
 
 std::multimap<float, Identifier> SphereGeometry::hits(
@@ -213,49 +417,97 @@ std::multimap<float, Identifier> SphereGeometry::hits(
   const Vector3f& rayDirection) const
 {
   std::multimap<float, Identifier> result;
+  if (m_identifier.type == InvalidType)
+    return result;
+  if (m_hierarchyDirty) {
+    d->updateHierarchy(m_spheres);
+    m_hierarchyDirty = false;
+  }
 
-  // Check for intersection.
-  for (size_t i = 0; i < m_spheres.size(); ++i) {
-    const SphereColor& sphere = m_spheres[i];
-
-    Vector3f distance = sphere.center - rayOrigin;
-    float B = distance.dot(rayDirection);
-    float C = distance.dot(distance) - (sphere.radius * sphere.radius);
-    float D = B * B - C;
-
-    // Test for intersection
-    if (D < 0)
-      continue;
-
-    // Test for clipping
-    if (B < 0 || (sphere.center - rayEnd).dot(rayDirection) > 0)
+  // Only the spheres whose boxes the ray passes through can be hit.
+  std::vector<size_t> candidates;
+  d->hierarchy.intersect(rayOrigin, rayDirection, candidates);
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    float depth;
+    if (!intersect(m_spheres[candidates[i]], rayOrigin, rayEnd, rayDirection,
+                   depth)) {
       continue;
-
+    }
     Identifier id;
     id.molecule = m_identifier.molecule;
     id.type = m_identifier.type;
-    id.index = i;
-    if (id.type != InvalidType) {
-      float rootD = static_cast<float>(sqrt(D));
-      float depth = std::min(std::abs(B + rootD), std::abs(B - rootD));
-      result.insert(std::pair<float, Identifier>(depth, id));
-    }
+    id.index = candidates[i];
+    result.insert(std::pair<float, Identifier>(depth, id));
   }
   return result;
 }
 
+Identifier SphereGeometry::hit(const Vector3f& rayOrigin,
+                               const Vector3f& rayEnd,
+                               const Vector3f& rayDirection,
+                               float& distance) const
+{
+  if (m_identifier.type == InvalidType)
+    return Identifier();
+  if (m_hierarchyDirty) {
+    d->updateHierarchy(m_spheres);
+    m_hierarchyDirty = false;
+  }
+
+  size_t index;
+  const Core::Array<SphereColor>& spheres = m_spheres;
+  if (!d->hierarchy.closest(
+        rayOrigin, rayDirection,
+        [&](size_t i, float& depth) {
+          return intersect(spheres[i], rayOrigin, rayEnd, rayDirection, depth);
+        },
+        index, distance)) {
+    return Identifier();
+  }
+
+  Identifier id;
+  id.molecule = m_identifier.molecule;
+  id.type = m_identifier.type;
+  id.index = index;
+  return id;
+}
+
 void SphereGeometry::addSphere(const Vector3f& position, const Vector3ub& color,
                                float radius)
 {
   m_dirty = true;
+  m_hierarchyDirty = true;
   m_spheres.push_back(SphereColor(position, radius, color));
   m_indices.push_back(m_indices.size());
 }
 
+void SphereGeometry::setSphere(size_t index, const Vector3f& position,
+                               const Vector3ub& color, float radius)
+{
+  SphereColor& sphere = m_spheres[index];
+  if (sphere.center == position && sphere.color == color &&
+      sphere.radius == radius) {
+    return;
+  }
+  sphere.center = position;
+  sphere.color = color;
+  sphere.radius = radius;
+  m_hierarchyDirty = true;
+  if (m_changedBegin == m_changedEnd) {
+    m_changedBegin = index;
+    m_changedEnd = index + 1;
+  } else {
+    m_changedBegin = std::min(m_changedBegin, index);
+    m_changedEnd = std::max(m_changedEnd, index + 1);
+  }
+}
+
 void SphereGeometry::clear()
 {
   m_spheres.clear();
   m_indices.clear();
+  m_changedBegin = m_changedEnd = 0;
+  m_hierarchyDirty = true;
 }
 
 } // End namespace Rendering
@@ -47,6 +47,13 @@ struct SphereColor
  * spheres are not a densely packed one-to-one mapping with the objects indices
  * they can also optionally use an identifier that will point to some numeric
  * ID for the purposes of picking.
+ *
+ * Where the context supports instanced arrays (OpenGL 3.3) each sphere is
+ * uploaded as its SphereColor and drawn as one instance of a quad, otherwise
+ * the four vertices of its quad are uploaded.
+ *
+ * Picking goes through a BoundingVolumeHierarchy over the spheres, which is
+ * built again on the first pick after the spheres change.
  */
 
 class AVOGADRORENDERING_EXPORT SphereGeometry : public Drawable
@@ -75,6 +82,16 @@ public:
    */
   void render(const Camera& camera) override;
 
+  /**
+   * @brief Render the spheres into the IdentifierBuffer, which needs them to
+   * be drawn as instances.
+   * @param camera The current camera to be used for rendering.
+   * @param number The number of the geometry in the buffer.
+   * @return False if the spheres could not be drawn as instances, or there are
+   * more of them than the buffer can tell apart.
+   */
+  bool renderIdentifiers(const Camera& camera, int number);
+
   /**
    * Return the primitives that are hit by the ray.
    * @param rayOrigin Origin of the ray.
@@ -86,6 +103,14 @@ public:
     const Vector3f& rayOrigin, const Vector3f& rayEnd,
     const Vector3f& rayDirection) const override;
 
+  /**
+   * Return the sphere closest to the origin of the ray, without finding the
+   * others it hits.
+   */
+  Identifier hit(const Vector3f& rayOrigin, const Vector3f& rayEnd,
+                 const Vector3f& rayDirection,
+                 float& distance) const override;
+
   /**
    * Add a sphere to the geometry object.
    */
@@ -93,7 +118,16 @@ public:
                  float radius);
 
   /**
-   * Get a reference to the spheres.
+   * Change the sphere at @a index in place. Only the spheres that changed are
+   * uploaded again when the geometry is next rendered, which keeps moving or
+   * selecting a few atoms of a large molecule cheap.
+   */
+  void setSphere(size_t index, const Vector3f& position, const Vector3ub& color,
+                 float radius);
+
+  /**
+   * Get a reference to the spheres. Use setSphere() to change them, changes
+   * made through the reference are neither uploaded nor seen by picking.
    */
   Core::Array<SphereColor>& spheres() { return m_spheres; }
   const Core::Array<SphereColor>& spheres() const { return m_spheres; }
@@ -113,6 +147,11 @@ private:
   Core::Array<size_t> m_indices;
 
   bool m_dirty;
+  // The range of spheres changed by setSphere() since the last upload.
+  size_t m_changedBegin;
+  size_t m_changedEnd;
+  // Whether the picking hierarchy needs to be built again.
+  mutable bool m_hierarchyDirty;
 
   class Private;
   Private* d;
@@ -132,6 +171,7 @@ inline void swap(SphereGeometry& lhs, SphereGeometry& rhs)
   swap(lhs.m_spheres, rhs.m_spheres);
   swap(lhs.m_indices, rhs.m_indices);
   lhs.m_dirty = rhs.m_dirty = true;
+  lhs.m_hierarchyDirty = rhs.m_hierarchyDirty = true;
 }
 
 } // End namespace Rendering
@@ -6,6 +6,10 @@ varying float radius;
 
 uniform mat4 projection;
 
+// The number of the drawable over 255 while drawing the IdentifierBuffer, when
+// the color identifies the sphere.
+uniform float identifier;
+
 void main()
 {
   // Figure out if we are inside our sphere.
@@ -24,6 +28,8 @@ void main()
   vec3 specular = 0.5 * (vec3(1, 1, 1) - fColor);
   vec3 color = ambient + df * diffuse + pow(sf, 20.0) * specular;
   gl_FragColor = vec4(color, 1.0);
+  if (identifier > 0.0)
+    gl_FragColor = vec4(fColor, identifier);
 
   // determine fragment depth
   vec4 pos = eyePosition;
@@ -19,7 +19,6 @@
 #include "avogadrogl.h"
 #include "bufferobject.h"
 #include "camera.h"
-#include "shader.h"
 #include "shaderprogram.h"
 #include "textrenderstrategy.h"
 #include "texture2d.h"
@@ -60,7 +59,6 @@ public:
   BufferObject vbo;
 
   // Sentinals:
-  bool shadersInvalid;
   bool textureInvalid;
   bool vboInvalid;
 
@@ -69,11 +67,6 @@ public:
   float radius;
   Texture2D texture;
 
-  // Shaders
-  Shader vertexShader;
-  Shader fragmentShader;
-  ShaderProgram shaderProgram;
-
   RenderImpl();
   ~RenderImpl() {}
 
@@ -83,14 +76,12 @@ public:
   void setOffsets(const Vector2i& dimensions, TextProperties::HAlign hAlign,
                   TextProperties::VAlign vAlign);
 
-  void render(const Camera& cam);
-  void compileShaders();
+  void render(const Camera& cam, ShaderProgram& program);
   void uploadVbo();
 };
 
 TextLabelBase::RenderImpl::RenderImpl()
-  : vertices(4), shadersInvalid(true), textureInvalid(true), vboInvalid(true),
-    radius(0.0)
+  : vertices(4), textureInvalid(true), vboInvalid(true), radius(0.0)
 {
   texture.setMinFilter(Texture2D::Nearest);
   texture.setMagFilter(Texture2D::Nearest);
@@ -162,7 +153,8 @@ void TextLabelBase::RenderImpl::setOffsets(const Vector2i& dimensions,
   vboInvalid = true;
 }
 
-void TextLabelBase::RenderImpl::render(const Camera& cam)
+void TextLabelBase::RenderImpl::render(const Camera& cam,
+                                       ShaderProgram& program)
 {
   // The texture should be valid at this point.
   if (textureInvalid) {
@@ -173,8 +165,6 @@ void TextLabelBase::RenderImpl::render(const Camera& cam)
   }
 
   // Prepare GL
-  if (shadersInvalid)
-    compileShaders();
   if (vboInvalid)
     uploadVbo();
 
@@ -190,26 +180,26 @@ void TextLabelBase::RenderImpl::render(const Camera& cam)
   }
 
   // Setup shaders
-  if (!shaderProgram.bind() || !shaderProgram.setUniformValue("mv", mv) ||
-      !shaderProgram.setUniformValue("proj", proj) ||
-      !shaderProgram.setUniformValue("vpDims", vpDims) ||
-      !shaderProgram.setUniformValue("anchor", anchor) ||
-      !shaderProgram.setUniformValue("radius", radius) ||
-      !shaderProgram.setTextureSampler("texture", texture) ||
-
-      !shaderProgram.enableAttributeArray("offset") ||
-      !shaderProgram.useAttributeArray("offset", PackedVertex::offsetOffset(),
-                                       sizeof(PackedVertex), IntType, 2,
-                                       ShaderProgram::NoNormalize) ||
-
-      !shaderProgram.enableAttributeArray("texCoord") ||
-      !shaderProgram.useAttributeArray("texCoord", PackedVertex::tcoordOffset(),
-                                       sizeof(PackedVertex), FloatType, 2,
-                                       ShaderProgram::NoNormalize)) {
+  if (!program.bind() || !program.setUniformValue("mv", mv) ||
+      !program.setUniformValue("proj", proj) ||
+      !program.setUniformValue("vpDims", vpDims) ||
+      !program.setUniformValue("anchor", anchor) ||
+      !program.setUniformValue("radius", radius) ||
+      !program.setTextureSampler("texture", texture) ||
+
+      !program.enableAttributeArray("offset") ||
+      !program.useAttributeArray("offset", PackedVertex::offsetOffset(),
+                                 sizeof(PackedVertex), IntType, 2,
+                                 ShaderProgram::NoNormalize) ||
+
+      !program.enableAttributeArray("texCoord") ||
+      !program.useAttributeArray("texCoord", PackedVertex::tcoordOffset(),
+                                 sizeof(PackedVertex), FloatType, 2,
+                                 ShaderProgram::NoNormalize)) {
     std::cerr << "Error setting up TextLabelBase shader program: "
-              << shaderProgram.error() << std::endl;
+              << program.error() << std::endl;
     vbo.release();
-    shaderProgram.release();
+    program.release();
     return;
   }
 
@@ -217,38 +207,12 @@ void TextLabelBase::RenderImpl::render(const Camera& cam)
   glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
   // Release resources:
-  shaderProgram.disableAttributeArray("texCoords");
-  shaderProgram.disableAttributeArray("offset");
-  shaderProgram.release();
+  program.disableAttributeArray("texCoords");
+  program.disableAttributeArray("offset");
+  program.release();
   vbo.release();
 }
 
-void TextLabelBase::RenderImpl::compileShaders()
-{
-  vertexShader.setType(Shader::Vertex);
-  vertexShader.setSource(textlabelbase_vs);
-  if (!vertexShader.compile()) {
-    std::cerr << vertexShader.error() << std::endl;
-    return;
-  }
-
-  fragmentShader.setType(Shader::Fragment);
-  fragmentShader.setSource(textlabelbase_fs);
-  if (!fragmentShader.compile()) {
-    std::cerr << fragmentShader.error() << std::endl;
-    return;
-  }
-
-  shaderProgram.attachShader(vertexShader);
-  shaderProgram.attachShader(fragmentShader);
-  if (!shaderProgram.link()) {
-    std::cerr << shaderProgram.error() << std::endl;
-    return;
-  }
-
-  shadersInvalid = false;
-}
-
 void TextLabelBase::RenderImpl::uploadVbo()
 {
   if (!vbo.upload(vertices, BufferObject::ArrayBuffer))
@@ -276,7 +240,9 @@ TextLabelBase::~TextLabelBase()
 
 void TextLabelBase::render(const Camera& camera)
 {
-  m_render->render(camera);
+  ShaderProgram* program = shaderProgram(textlabelbase_vs, textlabelbase_fs);
+  if (program)
+    m_render->render(camera, *program);
 }
 
 void TextLabelBase::buildTexture(const TextRenderStrategy& tren)
@@ -361,7 +327,6 @@ float TextLabelBase::getRadiusInternal() const
 
 void TextLabelBase::markDirty()
 {
-  m_render->shadersInvalid = true;
   m_render->textureInvalid = true;
   m_render->vboInvalid = true;
 }
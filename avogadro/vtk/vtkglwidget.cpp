@@ -51,7 +51,7 @@ vtkVolume* cubeVolume(Core::Cube* cube)
            << cube->dimensions().y() << cube->dimensions().z();
 
   qDebug() << "min/max:" << cube->minValue() << cube->maxValue();
-  qDebug() << cube->data()->size();
+  qDebug() << cube->pointCount();
 
   vtkNew<vtkImageData> data;
   // data->SetNumberOfScalarComponents(1, nullptr);
@@ -64,13 +64,11 @@ vtkVolume* cubeVolume(Core::Cube* cube)
   data->AllocateScalars(VTK_DOUBLE, 1);
 
   double* dataPtr = static_cast<double*>(data->GetScalarPointer());
-  std::vector<double>* cubePtr = cube->data();
 
   for (int i = 0; i < dim.x(); ++i)
     for (int j = 0; j < dim.y(); ++j)
       for (int k = 0; k < dim.z(); ++k) {
-        dataPtr[(k * dim.y() + j) * dim.x() + i] =
-          (*cubePtr)[(i * dim.y() + j) * dim.z() + k];
+        dataPtr[(k * dim.y() + j) * dim.x() + i] = cube->value(i, j, k);
       }
 
   double range[2];
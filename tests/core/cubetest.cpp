@@ -18,6 +18,10 @@
 
 #include <avogadro/core/cube.h>
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 using Avogadro::Core::Cube;
 using Avogadro::Vector3;
 using Avogadro::Vector3i;
@@ -81,6 +85,43 @@ TEST(CubeTest, minmax)
   EXPECT_DOUBLE_EQ(cube.maxValue(), 50.0);
 }
 
+TEST(CubeTest, fillValues)
+{
+  Cube cube;
+  cube.setLimits(Vector3(0.0, 0.0, 0.0), Vector3(1.0, 1.0, 1.0),
+                 Vector3i(10, 10, 10));
+
+  // Each thread fills a plane of the cube, finding its range on the way, and
+  // the range is reduced at the end.
+  std::vector<double> minValues(10, 0.0), maxValues(10, 0.0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 10; ++t) {
+    threads.push_back(std::thread([&cube, &minValues, &maxValues, t]() {
+      std::vector<double> values(100);
+      for (size_t i = 0; i < values.size(); ++i)
+        values[i] = (t - 4.5) * static_cast<double>(i);
+      EXPECT_TRUE(cube.fillValues(t * 100, 100, values.data(), minValues[t],
+                                  maxValues[t]));
+    }));
+  }
+  for (size_t t = 0; t < threads.size(); ++t)
+    threads[t].join();
+  cube.setValueRange(*std::min_element(minValues.begin(), minValues.end()),
+                     *std::max_element(maxValues.begin(), maxValues.end()));
+
+  EXPECT_DOUBLE_EQ(cube.value(0, 9, 9), -4.5 * 99);
+  EXPECT_DOUBLE_EQ(cube.value(9, 9, 9), 4.5 * 99);
+  EXPECT_DOUBLE_EQ(cube.minValue(), -4.5 * 99);
+  EXPECT_DOUBLE_EQ(cube.maxValue(), 4.5 * 99);
+
+  double minValue, maxValue;
+  EXPECT_TRUE(cube.valueRange(900, 100, minValue, maxValue));
+  EXPECT_DOUBLE_EQ(minValue, minValues[9]);
+  EXPECT_DOUBLE_EQ(maxValue, maxValues[9]);
+  EXPECT_FALSE(cube.fillValues(950, 100, minValues.data()));
+  EXPECT_FALSE(cube.valueRange(1000, 1, minValue, maxValue));
+}
+
 TEST(CubeTest, index)
 {
   Cube cube;
@@ -103,3 +144,34 @@ TEST(CubeTest, position)
   for (int i = 0; i < 3; ++i)
     EXPECT_DOUBLE_EQ(cube.position(999)[i], 1.0);
 }
+
+TEST(CubeTest, precision)
+{
+  Cube cube;
+  EXPECT_EQ(cube.precision(), Cube::Double);
+  cube.setPrecision(Cube::Float);
+  cube.setLimits(Vector3(0.0, 0.0, 0.0), Vector3(1.0, 1.0, 1.0),
+                 Vector3i(10, 10, 10));
+  EXPECT_EQ(cube.pointCount(), static_cast<size_t>(1000));
+  EXPECT_EQ(cube.floatData()->size(), static_cast<size_t>(1000));
+  EXPECT_TRUE(cube.data()->empty());
+
+  cube.setValue(0, 0, 1, 0.5);
+  cube.setValue(999, -2.0);
+  EXPECT_DOUBLE_EQ(cube.value(0, 0, 1), 0.5);
+  EXPECT_DOUBLE_EQ(cube.value(9, 9, 9), -2.0);
+  EXPECT_DOUBLE_EQ(cube.minValue(), -2.0);
+  EXPECT_DOUBLE_EQ(cube.maxValue(), 0.5);
+
+  std::vector<double> values(1000, 1.0);
+  values[10] = 0.25;
+  EXPECT_TRUE(cube.setData(values));
+  EXPECT_FLOAT_EQ((*cube.floatData())[10], 0.25f);
+
+  // Switching precision keeps the values.
+  cube.setPrecision(Cube::Double);
+  EXPECT_TRUE(cube.floatData()->empty());
+  EXPECT_EQ(cube.data()->size(), static_cast<size_t>(1000));
+  EXPECT_DOUBLE_EQ((*cube.data())[10], 0.25);
+  EXPECT_DOUBLE_EQ(cube.value(0, 0, 0), 1.0);
+}
@@ -0,0 +1,149 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <avogadro/core/cube.h>
+#include <avogadro/core/gaussianset.h>
+#include <avogadro/core/gaussiansettools.h>
+#include <avogadro/core/molecule.h>
+
+#include <vector>
+
+using Avogadro::MatrixX;
+using Avogadro::Vector3;
+using Avogadro::Vector3i;
+using Avogadro::Core::Cube;
+using Avogadro::Core::GaussianSet;
+using Avogadro::Core::GaussianSetTools;
+using Avogadro::Core::Molecule;
+
+namespace {
+
+// Two atoms carrying one shell of each supported type, plus a third atom far
+// away from the grid so that its shells are screened out.
+void setUpMolecule(Molecule& molecule)
+{
+  molecule.addAtom(8).setPosition3d(Vector3(0.0, 0.0, 0.0));
+  molecule.addAtom(1).setPosition3d(Vector3(0.3, 0.9, -0.2));
+  molecule.addAtom(1).setPosition3d(Vector3(40.0, 0.0, 0.0));
+
+  GaussianSet* basis = new GaussianSet;
+  const GaussianSet::orbital types[] = { GaussianSet::S,  GaussianSet::P,
+                                         GaussianSet::D,  GaussianSet::D5,
+                                         GaussianSet::F,  GaussianSet::F7 };
+  for (unsigned int atom = 0; atom < 3; ++atom) {
+    for (int i = 0; i < 6; ++i) {
+      unsigned int shell = basis->addBasis(atom, types[i]);
+      basis->addGto(shell, 0.4, 5.0 + i);
+      basis->addGto(shell, 0.7, 0.8 + 0.1 * i);
+    }
+  }
+
+  // Coefficients for two MOs over the 3 * 32 basis functions.
+  std::vector<double> mos;
+  for (int mo = 0; mo < 2; ++mo) {
+    for (int i = 0; i < 96; ++i)
+      mos.push_back(((i * 7 + mo * 3) % 11 - 5) * 0.1);
+  }
+  basis->setMolecularOrbitals(mos);
+  molecule.setBasisSet(basis);
+}
+}
+
+TEST(GaussianSetToolsTest, cubeMatchesPoints)
+{
+  Molecule molecule;
+  setUpMolecule(molecule);
+  GaussianSetTools tools(&molecule);
+  ASSERT_TRUE(tools.isValid());
+
+  Cube cube;
+  cube.setLimits(Vector3(-2.0, -2.0, -2.0), Vector3i(13, 11, 9), 0.4);
+  for (int mo = 0; mo < 2; ++mo) {
+    ASSERT_TRUE(tools.calculateMolecularOrbital(cube, mo));
+    for (unsigned int i = 0; i < cube.data()->size(); ++i) {
+      double expected = tools.calculateMolecularOrbital(cube.position(i), mo);
+      EXPECT_NEAR((*cube.data())[i], expected, 1e-8);
+    }
+  }
+
+  EXPECT_FALSE(tools.calculateMolecularOrbital(cube, 2));
+}
+
+TEST(GaussianSetToolsTest, multipleOrbitals)
+{
+  Molecule molecule;
+  setUpMolecule(molecule);
+  GaussianSetTools tools(&molecule);
+
+  Cube single[2];
+  Cube multiple[2];
+  std::vector<Cube*> cubes;
+  std::vector<int> orbitals;
+  for (int mo = 0; mo < 2; ++mo) {
+    single[mo].setLimits(Vector3(-2.0, -1.0, -2.0), Vector3i(10, 9, 7), 0.5);
+    multiple[mo].setLimits(single[mo]);
+    ASSERT_TRUE(tools.calculateMolecularOrbital(single[mo], mo));
+    // Fill in reverse order, to check that each cube gets its own orbital.
+    cubes.insert(cubes.begin(), &multiple[mo]);
+    orbitals.insert(orbitals.begin(), mo);
+  }
+
+  // Two passes over separate ranges of points fill the whole grid.
+  Avogadro::Index size = single[0].data()->size();
+  ASSERT_TRUE(tools.calculateMolecularOrbitals(cubes, orbitals, 0, 200));
+  ASSERT_TRUE(tools.calculateMolecularOrbitals(cubes, orbitals, 200));
+  for (int mo = 0; mo < 2; ++mo) {
+    for (Avogadro::Index i = 0; i < size; ++i)
+      EXPECT_NEAR((*multiple[mo].data())[i], (*single[mo].data())[i], 1e-8);
+  }
+
+  // Cubes must share the same grid.
+  multiple[0].setLimits(Vector3(-2.0, -1.0, -2.0), Vector3i(10, 9, 8), 0.5);
+  EXPECT_FALSE(tools.calculateMolecularOrbitals(cubes, orbitals));
+}
+
+TEST(GaussianSetToolsTest, densityCubeMatchesPoints)
+{
+  Molecule molecule;
+  setUpMolecule(molecule);
+  GaussianSet* basis = dynamic_cast<GaussianSet*>(molecule.basisSet());
+  ASSERT_TRUE(basis != nullptr);
+
+  MatrixX density(96, 96);
+  for (int i = 0; i < 96; ++i) {
+    for (int j = 0; j <= i; ++j) {
+      density(i, j) = ((i * 5 + j * 3) % 13 - 6) * 0.05;
+      density(j, i) = density(i, j);
+    }
+  }
+  ASSERT_TRUE(basis->setDensityMatrix(density));
+  ASSERT_TRUE(basis->setSpinDensityMatrix(0.5 * density));
+
+  GaussianSetTools tools(&molecule);
+  Cube cube;
+  cube.setLimits(Vector3(-2.0, -2.0, -2.0), Vector3i(9, 11, 13), 0.4);
+
+  ASSERT_TRUE(tools.calculateElectronDensity(cube));
+  for (unsigned int i = 0; i < cube.data()->size(); ++i) {
+    double expected = tools.calculateElectronDensity(cube.position(i));
+    EXPECT_NEAR((*cube.data())[i], expected, 1e-8);
+  }
+
+  // The same values when filled in separate ranges of points.
+  Cube ranges;
+  ranges.setLimits(cube);
+  ASSERT_TRUE(tools.calculateElectronDensity(ranges, 0, 500));
+  ASSERT_TRUE(tools.calculateElectronDensity(ranges, 500));
+  for (unsigned int i = 0; i < cube.data()->size(); ++i)
+    EXPECT_NEAR((*ranges.data())[i], (*cube.data())[i], 1e-8);
+
+  ASSERT_TRUE(tools.calculateSpinDensity(cube));
+  for (unsigned int i = 0; i < cube.data()->size(); ++i) {
+    double expected = tools.calculateSpinDensity(cube.position(i));
+    EXPECT_NEAR((*cube.data())[i], expected, 1e-8);
+  }
+}
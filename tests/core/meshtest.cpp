@@ -80,6 +80,7 @@ void MeshTest::assertEquals(const Mesh& m1, const Mesh& m2)
     ++i;
   }
   EXPECT_TRUE(m1.normals() == m2.normals());
+  EXPECT_TRUE(m1.triangles() == m2.triangles());
 }
 
 TEST_F(MeshTest, copy)
@@ -97,3 +98,35 @@ TEST_F(MeshTest, assigment)
   assertEquals(m_testMesh, assign);
   EXPECT_NE(m_testMesh.lock(), assign.lock());
 }
+
+TEST_F(MeshTest, triangles)
+{
+  // Without indices every three vertices form a triangle.
+  Mesh mesh;
+  Array<Vector3f> vertices(6, Vector3f(0.0f, 0.0f, 0.0f));
+  mesh.setVertices(vertices);
+  EXPECT_EQ(mesh.numTriangles(), 2u);
+
+  // Two triangles sharing an edge only need four vertices.
+  vertices.resize(4);
+  mesh.setVertices(vertices);
+  Array<unsigned int> triangles;
+  triangles.push_back(0);
+  triangles.push_back(1);
+  triangles.push_back(2);
+  triangles.push_back(2);
+  triangles.push_back(1);
+  triangles.push_back(3);
+  EXPECT_TRUE(mesh.setTriangles(triangles));
+  EXPECT_EQ(mesh.numTriangles(), 2u);
+
+  Mesh copy(mesh);
+  EXPECT_TRUE(copy.triangles() == triangles);
+
+  triangles.push_back(0);
+  EXPECT_FALSE(mesh.setTriangles(triangles));
+  EXPECT_EQ(mesh.numTriangles(), 2u);
+
+  mesh.clear();
+  EXPECT_EQ(mesh.triangles().size(), 0u);
+}
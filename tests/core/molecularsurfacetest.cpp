@@ -0,0 +1,167 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <avogadro/core/cube.h>
+#include <avogadro/core/elements.h>
+#include <avogadro/core/molecularsurface.h>
+#include <avogadro/core/molecule.h>
+
+#include <algorithm>
+#include <vector>
+
+using Avogadro::Vector3;
+using Avogadro::Core::Cube;
+using Avogadro::Core::Elements;
+using Avogadro::Core::MolecularSurface;
+using Avogadro::Core::Molecule;
+
+namespace {
+
+// Two carbon atoms with a gap between their van der Waals spheres that is too
+// narrow for the probe.
+void setUpMolecule(Molecule& molecule)
+{
+  molecule.addAtom(6).setPosition3d(Vector3(0.0, 0.0, 0.0));
+  molecule.addAtom(6).setPosition3d(Vector3(3.6, 0.0, 0.0));
+}
+
+// The exact depth inside of the union of spheres grown by probe.
+double sphereDepth(const Molecule& molecule, const Vector3& point,
+                   double probe)
+{
+  double depth = -1.0e10;
+  for (size_t i = 0; i < molecule.atomCount(); ++i) {
+    double radius = Elements::radiusVDW(molecule.atomicNumber(i)) + probe;
+    depth = std::max(
+      depth, radius - (point - molecule.atomPosition3d(i)).norm());
+  }
+  return depth;
+}
+} // namespace
+
+TEST(MolecularSurfaceTest, spheres)
+{
+  Molecule molecule;
+  setUpMolecule(molecule);
+  Cube cube;
+  cube.setLimits(molecule, 0.25, 5.0);
+
+  MolecularSurface surface;
+  const MolecularSurface::Type types[2] = {
+    MolecularSurface::VanDerWaals, MolecularSurface::SolventAccessible
+  };
+  for (int t = 0; t < 2; ++t) {
+    EXPECT_TRUE(surface.calculate(molecule, cube, types[t]));
+    double probe = t == 0 ? 0.0 : surface.probeRadius();
+    const std::vector<double>& data = *cube.data();
+    for (size_t i = 0; i < data.size(); ++i) {
+      double expected = sphereDepth(molecule, cube.position(i), probe);
+      // Points well outside of the surface are only known to be outside.
+      if (expected > -0.5) {
+        EXPECT_NEAR(data[i], expected, 1e-10);
+      } else {
+        EXPECT_LT(data[i], 0.0);
+      }
+    }
+  }
+}
+
+TEST(MolecularSurfaceTest, solventExcluded)
+{
+  Molecule molecule;
+  setUpMolecule(molecule);
+  Cube cube;
+  cube.setLimits(molecule, 0.2, 5.0);
+
+  MolecularSurface surface;
+  EXPECT_TRUE(
+    surface.calculate(molecule, cube, MolecularSurface::SolventExcluded));
+  const std::vector<double> ses = *cube.data();
+
+  for (size_t i = 0; i < ses.size(); ++i) {
+    Vector3 point = cube.position(i);
+    // Everything inside of the van der Waals spheres is inside, and nothing
+    // outside of the solvent accessible surface is.
+    if (sphereDepth(molecule, point, 0.0) > 0.0) {
+      EXPECT_GT(ses[i], 0.0);
+    }
+    if (sphereDepth(molecule, point, surface.probeRadius()) < 0.0) {
+      EXPECT_LT(ses[i], 0.0);
+    }
+  }
+
+  // The gap between the atoms is filled in, but only the gap.
+  Vector3 gap(1.8, 0.8, 0.0);
+  EXPECT_LT(sphereDepth(molecule, gap, 0.0), 0.0);
+  EXPECT_GT(cube.value(gap), 0.0);
+  EXPECT_LT(cube.value(Vector3(-2.0, 0.0, 0.0)), 0.0);
+
+  // The result does not depend on the number of threads.
+  surface.setThreadCount(1);
+  EXPECT_TRUE(
+    surface.calculate(molecule, cube, MolecularSurface::SolventExcluded));
+  EXPECT_TRUE(ses == *cube.data());
+}
+
+TEST(MolecularSurfaceTest, emptyCube)
+{
+  Molecule molecule;
+  setUpMolecule(molecule);
+  Cube cube;
+  MolecularSurface surface;
+  EXPECT_FALSE(
+    surface.calculate(molecule, cube, MolecularSurface::VanDerWaals));
+}
+
+TEST(MolecularSurfaceTest, floatPrecision)
+{
+  Molecule molecule;
+  setUpMolecule(molecule);
+  Cube cube;
+  cube.setLimits(molecule, 0.25, 5.0);
+  Cube floatCube;
+  floatCube.setPrecision(Cube::Float);
+  floatCube.setLimits(cube);
+
+  MolecularSurface surface;
+  EXPECT_TRUE(
+    surface.calculate(molecule, cube, MolecularSurface::SolventExcluded));
+  EXPECT_TRUE(
+    surface.calculate(molecule, floatCube, MolecularSurface::SolventExcluded));
+  ASSERT_EQ(floatCube.floatData()->size(), cube.data()->size());
+  for (size_t i = 0; i < cube.data()->size(); ++i)
+    EXPECT_NEAR((*floatCube.floatData())[i], (*cube.data())[i], 1e-5);
+}
+
+TEST(MolecularSurfaceTest, atoms)
+{
+  Molecule molecule;
+  setUpMolecule(molecule);
+  Cube cube;
+  cube.setLimits(molecule, 0.25, 5.0);
+  Cube atomCube;
+  atomCube.setLimits(cube);
+
+  std::vector<Vector3> positions;
+  std::vector<double> radii;
+  for (size_t i = 0; i < molecule.atomCount(); ++i) {
+    positions.push_back(molecule.atomPosition3d(i));
+    radii.push_back(Elements::radiusVDW(molecule.atomicNumber(i)));
+  }
+
+  // The atoms on their own give the same surface as the molecule.
+  MolecularSurface surface;
+  EXPECT_TRUE(
+    surface.calculate(molecule, cube, MolecularSurface::SolventExcluded));
+  EXPECT_TRUE(surface.calculate(positions, radii, atomCube,
+                                MolecularSurface::SolventExcluded));
+  EXPECT_TRUE(*cube.data() == *atomCube.data());
+
+  radii.pop_back();
+  EXPECT_FALSE(surface.calculate(positions, radii, atomCube,
+                                 MolecularSurface::SolventExcluded));
+}
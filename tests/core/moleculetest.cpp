@@ -20,8 +20,10 @@
 
 #include <avogadro/core/array.h>
 #include <avogadro/core/color3f.h>
+#include <avogadro/core/framesource.h>
 #include <avogadro/core/mesh.h>
 #include <avogadro/core/molecule.h>
+#include <avogadro/core/residue.h>
 #include <avogadro/core/vector.h>
 
 using Avogadro::Index;
@@ -32,8 +34,10 @@ using Avogadro::Core::Array;
 using Avogadro::Core::Atom;
 using Avogadro::Core::Bond;
 using Avogadro::Core::Color3f;
+using Avogadro::Core::FrameSource;
 using Avogadro::Core::Mesh;
 using Avogadro::Core::Molecule;
+using Avogadro::Core::Residue;
 using Avogadro::Core::Variant;
 using Avogadro::Core::VariantMap;
 
@@ -222,6 +226,122 @@ TEST_F(MoleculeTest, findBond)
   EXPECT_EQ(molecule.bonds(a3).size(), 1);
 }
 
+TEST_F(MoleculeTest, bondIndex)
+{
+  // A ring 0-1-2-3-4-0, removing atoms moves the last atom (and its bonds)
+  // into the freed slot, which the bond lookups must follow.
+  Molecule molecule;
+  for (int i = 0; i < 5; ++i)
+    molecule.addAtom(6);
+  for (Index i = 0; i < 4; ++i)
+    molecule.addBond(i, i + 1, 1);
+  molecule.addBond(4, 0, 2);
+
+  // Re-adding an existing bond only changes its order.
+  EXPECT_EQ(molecule.addBond(1, 0, 3).index(), static_cast<Index>(0));
+  EXPECT_EQ(molecule.bondCount(), static_cast<Index>(5));
+  EXPECT_EQ(molecule.bondOrder(0), static_cast<unsigned char>(3));
+
+  // Removing atom 1 moves atom 4 to index 1.
+  molecule.removeAtom(1);
+  EXPECT_EQ(molecule.atomCount(), static_cast<Index>(4));
+  EXPECT_EQ(molecule.bondCount(), static_cast<Index>(3));
+  EXPECT_TRUE(molecule.bond(0, 1).isValid());
+  EXPECT_EQ(molecule.bond(1, 0).order(), static_cast<unsigned char>(2));
+  EXPECT_TRUE(molecule.bond(1, 3).isValid());
+  EXPECT_TRUE(molecule.bond(2, 3).isValid());
+  EXPECT_FALSE(molecule.bond(0, 2).isValid());
+  EXPECT_EQ(molecule.bonds(1).size(), static_cast<size_t>(2));
+  for (Index i = 0; i < molecule.bondCount(); ++i)
+    EXPECT_LT(molecule.bondPair(i).first, molecule.bondPair(i).second);
+
+  // Removing a bond moves the last bond into its slot.
+  EXPECT_TRUE(molecule.removeBond(0, 1));
+  EXPECT_FALSE(molecule.removeBond(0, 1));
+  EXPECT_EQ(molecule.bondCount(), static_cast<Index>(2));
+  EXPECT_EQ(molecule.bond(2, 3).index(), static_cast<Index>(1));
+  EXPECT_EQ(molecule.bond(1, 3).index(), static_cast<Index>(0));
+  EXPECT_EQ(molecule.bonds(0).size(), static_cast<size_t>(0));
+
+  // Copies keep a working index, direct edits of the pairs are picked up.
+  Molecule copy(molecule);
+  EXPECT_TRUE(copy.bond(3, 1).isValid());
+  copy.bondPairs()[1] = std::make_pair(Index(0), Index(2));
+  EXPECT_TRUE(copy.bond(2, 0).isValid());
+  EXPECT_FALSE(copy.bond(2, 3).isValid());
+  EXPECT_TRUE(molecule.bond(2, 3).isValid());
+
+  Molecule moved(std::move(copy));
+  EXPECT_EQ(moved.bonds(0).size(), static_cast<size_t>(1));
+  EXPECT_EQ(moved.addBond(0, 2).index(), static_cast<Index>(1));
+}
+
+TEST_F(MoleculeTest, removeAtoms)
+{
+  // A chain 0-1-2-3-4-5 with the atomic number equal to the index + 1.
+  Molecule molecule;
+  for (int i = 0; i < 6; ++i)
+    molecule.addAtom(static_cast<unsigned char>(i + 1));
+  for (Index i = 0; i < 5; ++i)
+    molecule.addBond(i, i + 1, static_cast<unsigned char>(i + 1));
+
+  std::vector<Index> invalid;
+  invalid.push_back(1);
+  invalid.push_back(6);
+  EXPECT_FALSE(molecule.removeAtoms(invalid));
+  EXPECT_EQ(molecule.atomCount(), static_cast<Index>(6));
+  EXPECT_EQ(molecule.bondCount(), static_cast<Index>(5));
+
+  // Duplicates are ignored and the remaining atoms keep their order.
+  std::vector<Index> indices;
+  indices.push_back(4);
+  indices.push_back(1);
+  indices.push_back(4);
+  EXPECT_TRUE(molecule.removeAtoms(indices));
+  EXPECT_EQ(molecule.atomCount(), static_cast<Index>(4));
+  EXPECT_EQ(molecule.atomicNumber(0), static_cast<unsigned char>(1));
+  EXPECT_EQ(molecule.atomicNumber(1), static_cast<unsigned char>(3));
+  EXPECT_EQ(molecule.atomicNumber(2), static_cast<unsigned char>(4));
+  EXPECT_EQ(molecule.atomicNumber(3), static_cast<unsigned char>(6));
+
+  // Only the 2-3 bond survives, now between atoms 1 and 2.
+  EXPECT_EQ(molecule.bondCount(), static_cast<Index>(1));
+  EXPECT_EQ(molecule.bond(1, 2).order(), static_cast<unsigned char>(3));
+  EXPECT_EQ(molecule.bonds(3).size(), static_cast<size_t>(0));
+
+  molecule.clearAtoms();
+  EXPECT_EQ(molecule.atomCount(), static_cast<Index>(0));
+  EXPECT_EQ(molecule.bondCount(), static_cast<Index>(0));
+}
+
+TEST_F(MoleculeTest, removeBonds)
+{
+  Molecule molecule;
+  for (int i = 0; i < 5; ++i)
+    molecule.addAtom(6);
+  for (Index i = 0; i < 4; ++i)
+    molecule.addBond(i, i + 1, static_cast<unsigned char>(i + 1));
+
+  std::vector<Index> indices;
+  indices.push_back(2);
+  indices.push_back(0);
+  EXPECT_TRUE(molecule.removeBonds(indices));
+  EXPECT_EQ(molecule.atomCount(), static_cast<Index>(5));
+  EXPECT_EQ(molecule.bondCount(), static_cast<Index>(2));
+  EXPECT_EQ(molecule.bond(1, 2).index(), static_cast<Index>(0));
+  EXPECT_EQ(molecule.bond(3, 4).index(), static_cast<Index>(1));
+  EXPECT_EQ(molecule.bondOrder(1), static_cast<unsigned char>(4));
+  EXPECT_FALSE(molecule.bond(0, 1).isValid());
+
+  indices.assign(1, 2);
+  EXPECT_FALSE(molecule.removeBonds(indices));
+  EXPECT_EQ(molecule.bondCount(), static_cast<Index>(2));
+
+  molecule.clearBonds();
+  EXPECT_EQ(molecule.bondCount(), static_cast<Index>(0));
+  EXPECT_EQ(molecule.atomCount(), static_cast<Index>(5));
+}
+
 TEST_F(MoleculeTest, setData)
 {
   Molecule molecule;
@@ -268,6 +388,129 @@ TEST_F(MoleculeTest, perceiveBondsSimple)
   EXPECT_FALSE(molecule.bond(h2, h3).isValid());
 }
 
+TEST_F(MoleculeTest, perceiveBondsSimpleLattice)
+{
+  // A simple cubic lattice of carbons, only nearest neighbors are in range.
+  Molecule molecule;
+  const int n = 6;
+  const double spacing = 1.5;
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      for (int k = 0; k < n; ++k) {
+        Atom a = molecule.addAtom(6);
+        a.setPosition3d(Vector3(i * spacing, j * spacing, k * spacing));
+      }
+    }
+  }
+  // An isolated atom far away from the rest of the lattice.
+  Atom isolated = molecule.addAtom(6);
+  isolated.setPosition3d(Vector3(100.0, -50.0, 20.0));
+
+  molecule.perceiveBondsSimple();
+  EXPECT_EQ(molecule.bondCount(), static_cast<Index>(3 * (n - 1) * n * n));
+  EXPECT_TRUE(molecule.bond(0, 1).isValid());
+  EXPECT_TRUE(molecule.bond(0, n).isValid());
+  EXPECT_TRUE(molecule.bond(0, n * n).isValid());
+  EXPECT_FALSE(molecule.bond(0, n + 1).isValid());
+  EXPECT_EQ(molecule.bonds(isolated).size(), static_cast<size_t>(0));
+
+  // Bonds are added in the same order as the pairwise loop produced.
+  for (Index i = 1; i < molecule.bondCount(); ++i)
+    EXPECT_LT(molecule.bondPair(i - 1), molecule.bondPair(i));
+}
+
+namespace {
+// Frames of a single atom at (frame, 0, 0), counting how many were read.
+class CountingFrameSource : public FrameSource
+{
+public:
+  explicit CountingFrameSource(Index frames) : m_frames(frames), m_reads(0) {}
+
+  FrameSource* clone() const override { return new CountingFrameSource(*this); }
+  Index frameCount() const override { return m_frames; }
+  int reads() const { return m_reads; }
+
+protected:
+  bool readFrame(Index index, Array<Vector3>& coordinates) override
+  {
+    ++m_reads;
+    coordinates = Array<Vector3>(1, Vector3(static_cast<double>(index), 0, 0));
+    return true;
+  }
+
+private:
+  Index m_frames;
+  int m_reads;
+};
+} // namespace
+
+TEST_F(MoleculeTest, frameSource)
+{
+  Molecule molecule;
+  molecule.addAtom(6);
+  auto* source = new CountingFrameSource(100);
+  source->setCacheSize(2);
+  molecule.setFrameSource(source);
+  EXPECT_EQ(molecule.coordinate3dCount(), 100);
+
+  // Frames are read on demand, and the most recently used ones are cached.
+  EXPECT_TRUE(molecule.setCoordinate3d(42));
+  EXPECT_EQ(molecule.atomPosition3d(0), Vector3(42, 0, 0));
+  EXPECT_EQ(molecule.coordinate3d(7)[0], Vector3(7, 0, 0));
+  EXPECT_EQ(molecule.coordinate3d(42)[0], Vector3(42, 0, 0));
+  EXPECT_EQ(source->reads(), 2);
+  EXPECT_EQ(molecule.coordinate3d(99)[0], Vector3(99, 0, 0));
+  EXPECT_EQ(molecule.coordinate3d(42)[0], Vector3(42, 0, 0));
+  EXPECT_EQ(source->reads(), 3);
+  EXPECT_EQ(molecule.coordinate3d(7)[0], Vector3(7, 0, 0));
+  EXPECT_EQ(source->reads(), 4);
+
+  EXPECT_FALSE(molecule.setCoordinate3d(100));
+  EXPECT_TRUE(molecule.coordinate3d(100).empty());
+
+  // Sets given explicitly override the source.
+  Array<Vector3> coords(1, Vector3(0, 1, 0));
+  molecule.setCoordinate3d(coords, 3);
+  EXPECT_EQ(molecule.coordinate3d(3)[0], Vector3(0, 1, 0));
+  EXPECT_EQ(molecule.coordinate3d(2)[0], Vector3(2, 0, 0));
+  molecule.setCoordinate3d(coords, 150);
+  EXPECT_EQ(molecule.coordinate3dCount(), 151);
+  EXPECT_TRUE(molecule.coordinate3d(120).empty());
+
+  // Copies get a source of their own.
+  Molecule copy(molecule);
+  ASSERT_NE(copy.frameSource(), nullptr);
+  EXPECT_NE(copy.frameSource(), molecule.frameSource());
+  EXPECT_EQ(copy.coordinate3d(50)[0], Vector3(50, 0, 0));
+  Molecule moved(std::move(copy));
+  EXPECT_EQ(copy.frameSource(), nullptr);
+  EXPECT_EQ(moved.coordinate3dCount(), 151);
+}
+
+TEST_F(MoleculeTest, residues)
+{
+  Molecule molecule;
+  EXPECT_EQ(molecule.residueCount(), static_cast<Index>(0));
+  std::string name("GLY");
+  Index number = 7;
+  char chain = 'B';
+  Residue& residue = molecule.addResidue(name, number, chain);
+  Atom atom = molecule.addAtom(7);
+  std::string atomName("N");
+  residue.addResidueAtom(atomName, atom);
+
+  const Molecule& constMolecule = molecule;
+  EXPECT_EQ(constMolecule.residueCount(), static_cast<Index>(1));
+  const Residue& constResidue = constMolecule.residue(0);
+  EXPECT_EQ(constResidue.residueName(), "GLY");
+  EXPECT_EQ(constResidue.residueId(), static_cast<Index>(7));
+  EXPECT_EQ(constResidue.chainId(), 'B');
+  ASSERT_EQ(constResidue.atomNameMap().size(), static_cast<size_t>(1));
+  EXPECT_EQ(constResidue.atomNameMap().begin()->first, "N");
+  EXPECT_EQ(constResidue.atomNameMap().begin()->second.index(),
+            static_cast<Index>(0));
+}
+
 TEST_F(MoleculeTest, copy)
 {
   Molecule copy(m_testMolecule);
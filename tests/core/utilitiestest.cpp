@@ -18,11 +18,18 @@
 
 #include <avogadro/core/utilities.h>
 
+#include <vector>
+
 using std::string;
 using Avogadro::Core::contains;
+using Avogadro::Core::fromChars;
 using Avogadro::Core::lexicalCast;
+using Avogadro::Core::nextLine;
+using Avogadro::Core::parseNumber;
 using Avogadro::Core::split;
 using Avogadro::Core::startsWith;
+using Avogadro::Core::StringView;
+using Avogadro::Core::tokenize;
 using Avogadro::Core::trimmed;
 
 TEST(UtilitiesTest, split)
@@ -80,3 +87,94 @@ TEST(UtilitiesTest, startsWith)
   EXPECT_FALSE(startsWith("hasFoo", "Foo"));
   EXPECT_FALSE(startsWith("hasFoo", "bar"));
 }
+
+TEST(UtilitiesTest, stringView)
+{
+  string test("ATOM      1  N   ALA A   1");
+  StringView view(test);
+  EXPECT_TRUE(view.startsWith("ATOM"));
+  EXPECT_FALSE(view.startsWith("HETATM"));
+  EXPECT_EQ(view.substr(17, 3).toString(), "ALA");
+  EXPECT_EQ(view.substr(12, 4).trimmed().toString(), "N");
+  // Fields past the end of short lines are empty.
+  EXPECT_TRUE(view.substr(76, 2).empty());
+  EXPECT_TRUE(view.substr(22, 10) == "   1");
+  EXPECT_EQ(view.find('N'), 13);
+  EXPECT_TRUE(StringView(" \t\r").trimmed().empty());
+}
+
+TEST(UtilitiesTest, tokenize)
+{
+  std::vector<StringView> tokens;
+  EXPECT_EQ(tokenize("  C\t1.0  -2.5 3e2\r", tokens), 4);
+  EXPECT_TRUE(tokens[0] == "C");
+  EXPECT_TRUE(tokens[1] == "1.0");
+  EXPECT_TRUE(tokens[3] == "3e2");
+  EXPECT_EQ(tokenize(" \t ", tokens), 0);
+}
+
+TEST(UtilitiesTest, nextLine)
+{
+  StringView text("first\r\n\nlast");
+  StringView line;
+  EXPECT_TRUE(nextLine(text, line));
+  EXPECT_TRUE(line == "first");
+  EXPECT_TRUE(nextLine(text, line));
+  EXPECT_TRUE(line.empty());
+  EXPECT_TRUE(nextLine(text, line));
+  EXPECT_TRUE(line == "last");
+  EXPECT_TRUE(text.empty());
+  EXPECT_FALSE(nextLine(text, line));
+}
+
+TEST(UtilitiesTest, fromChars)
+{
+  const char* text = "-42abc";
+  int i = 0;
+  EXPECT_EQ(fromChars(text, text + 6, i), text + 3);
+  EXPECT_EQ(i, -42);
+
+  // Out of range and missing numbers are left alone.
+  const char* big = "300";
+  unsigned char c = 7;
+  EXPECT_EQ(fromChars(big, big + 3, c), big);
+  EXPECT_EQ(c, 7);
+  const char* negative = "-1";
+  size_t n = 3;
+  EXPECT_EQ(fromChars(negative, negative + 2, n), negative);
+  EXPECT_EQ(n, 3);
+
+  const char* real = "-12.345e-1x";
+  double d = 0.0;
+  EXPECT_EQ(fromChars(real, real + 11, d), real + 10);
+  EXPECT_EQ(d, -1.2345);
+  // An exponent without digits is not part of the number.
+  const char* partial = "1.5e";
+  EXPECT_EQ(fromChars(partial, partial + 4, d), partial + 3);
+  EXPECT_EQ(d, 1.5);
+  const char* dot = ".";
+  EXPECT_EQ(fromChars(dot, dot + 1, d), dot);
+}
+
+TEST(UtilitiesTest, parseNumber)
+{
+  // These match the correctly rounded results of the standard library.
+  const char* numbers[] = { "5.3",     "5.3E-10",   "0.1",
+                            "-99.999", "123.4567", "0.000000000000000000000012",
+                            "1e300",   "3.14159265358979323846", "17" };
+  for (size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); ++i) {
+    double value = 0.0;
+    EXPECT_TRUE(parseNumber(numbers[i], value));
+    EXPECT_EQ(value, lexicalCast<double>(numbers[i])) << numbers[i];
+  }
+
+  float f = 0.0f;
+  EXPECT_TRUE(parseNumber("  0.25", f));
+  EXPECT_EQ(f, 0.25f);
+  int i = 0;
+  EXPECT_TRUE(parseNumber(" 12 ", i));
+  EXPECT_EQ(i, 12);
+  EXPECT_FALSE(parseNumber("five", i));
+  EXPECT_FALSE(parseNumber("", i));
+  EXPECT_FALSE(parseNumber("   ", i));
+}
@@ -18,22 +18,160 @@
 
 #include <gtest/gtest.h>
 
+#include <avogadro/core/cube.h>
+#include <avogadro/core/gaussianset.h>
 #include <avogadro/core/matrix.h>
 #include <avogadro/core/molecule.h>
 #include <avogadro/core/unitcell.h>
 
 #include <avogadro/io/cjsonformat.h>
 
+#include <fstream>
+#include <string>
+
+using Avogadro::Index;
 using Avogadro::PI_F;
 using Avogadro::Real;
+using Avogadro::Vector3;
+using Avogadro::Vector3i;
+using Avogadro::Core::Array;
 using Avogadro::Core::Atom;
 using Avogadro::Core::Bond;
+using Avogadro::Core::Cube;
+using Avogadro::Core::GaussianSet;
 using Avogadro::Core::Molecule;
 using Avogadro::Core::UnitCell;
 using Avogadro::Core::Variant;
+using Avogadro::Io::CjsonBinaryFormat;
 using Avogadro::Io::CjsonFormat;
 using Avogadro::MatrixX;
 
+namespace {
+
+// Two hydrogens with orbitals, a cube and vibrations, enough values in each
+// array for the binary encodings to store them out of the document.
+void setUpMolecule(Molecule& molecule)
+{
+  molecule.addAtom(1).setPosition3d(Vector3(0.0, 0.0, -0.37));
+  molecule.addAtom(1).setPosition3d(Vector3(0.0, 0.0, 0.37));
+  molecule.addBond(0, 1, 1);
+  molecule.setAtomSelected(1, true);
+
+  GaussianSet* basis = new GaussianSet;
+  basis->setMolecule(&molecule);
+  unsigned int s = basis->addBasis(0, GaussianSet::S);
+  basis->addGto(s, 0.154329, 3.42525091);
+  basis->addGto(s, 0.535328, 0.62391373);
+  unsigned int p = basis->addBasis(1, GaussianSet::P);
+  basis->addGto(p, 0.444635, 0.16885540);
+  std::vector<double> coefficients;
+  for (int i = 0; i < 16; ++i)
+    coefficients.push_back(0.125 * i - 0.9);
+  basis->setMolecularOrbitals(coefficients);
+  basis->setElectronCount(2);
+  molecule.setBasisSet(basis);
+
+  Cube* cube = molecule.addCube();
+  cube->setLimits(Vector3(-1.0, -1.5, -2.0), Vector3i(2, 3, 3),
+                  Vector3(0.5, 0.25, 0.75));
+  for (size_t i = 0; i < cube->data()->size(); ++i)
+    (*cube->data())[i] = 0.01 * static_cast<double>(i * i) - 0.3;
+
+  Array<double> frequencies, intensities;
+  Array<Array<Vector3>> lx;
+  for (int mode = 0; mode < 2; ++mode) {
+    frequencies.push_back(4401.2 + mode);
+    intensities.push_back(0.5 * mode);
+    Array<Vector3> displacements;
+    displacements.push_back(Vector3(0.1 * mode, 0.0, -0.707));
+    displacements.push_back(Vector3(-0.1 * mode, 0.0, 0.707));
+    lx.push_back(displacements);
+  }
+  molecule.setVibrationFrequencies(frequencies);
+  molecule.setVibrationIntensities(intensities);
+  molecule.setVibrationLx(lx);
+}
+
+void expectSamePositions(const Array<Vector3>& expected,
+                         const Array<Vector3>& positions)
+{
+  ASSERT_EQ(expected.size(), positions.size());
+  for (size_t i = 0; i < expected.size(); ++i)
+    EXPECT_TRUE(expected[i].isApprox(positions[i], 1e-12)) << "atom " << i;
+}
+
+void expectSameMolecule(const Molecule& expected, const Molecule& molecule)
+{
+  ASSERT_EQ(expected.atomCount(), molecule.atomCount());
+  for (Index i = 0; i < expected.atomCount(); ++i) {
+    EXPECT_EQ(expected.atom(i).atomicNumber(), molecule.atom(i).atomicNumber());
+    EXPECT_EQ(expected.atomSelected(i), molecule.atomSelected(i));
+  }
+  expectSamePositions(expected.atomPositions3d(), molecule.atomPositions3d());
+  ASSERT_EQ(expected.coordinate3dCount(), molecule.coordinate3dCount());
+  for (int i = 0; i < expected.coordinate3dCount(); ++i)
+    expectSamePositions(expected.coordinate3d(i), molecule.coordinate3d(i));
+
+  ASSERT_EQ(expected.bondCount(), molecule.bondCount());
+  for (Index i = 0; i < expected.bondCount(); ++i) {
+    EXPECT_EQ(expected.bond(i).atom1().index(),
+              molecule.bond(i).atom1().index());
+    EXPECT_EQ(expected.bond(i).atom2().index(),
+              molecule.bond(i).atom2().index());
+    EXPECT_EQ(expected.bond(i).order(), molecule.bond(i).order());
+  }
+
+  ASSERT_EQ(expected.unitCell() == nullptr, molecule.unitCell() == nullptr);
+  if (expected.unitCell()) {
+    EXPECT_TRUE(expected.unitCell()->cellMatrix().isApprox(
+      molecule.unitCell()->cellMatrix(), 1e-12));
+  }
+
+  const GaussianSet* expectedBasis =
+    dynamic_cast<const GaussianSet*>(expected.basisSet());
+  const GaussianSet* basis =
+    dynamic_cast<const GaussianSet*>(molecule.basisSet());
+  ASSERT_EQ(expectedBasis == nullptr, basis == nullptr);
+  if (expectedBasis) {
+    EXPECT_EQ(expectedBasis->symmetry(), basis->symmetry());
+    EXPECT_EQ(expectedBasis->atomIndices(), basis->atomIndices());
+    EXPECT_EQ(expectedBasis->gtoIndices(), basis->gtoIndices());
+    EXPECT_EQ(expectedBasis->gtoA(), basis->gtoA());
+    EXPECT_EQ(expectedBasis->gtoC(), basis->gtoC());
+    EXPECT_EQ(expectedBasis->electronCount(), basis->electronCount());
+    EXPECT_TRUE(expectedBasis->moMatrix() == basis->moMatrix());
+  }
+
+  ASSERT_EQ(expected.cubeCount(), molecule.cubeCount());
+  for (Index i = 0; i < expected.cubeCount(); ++i) {
+    const Cube* expectedCube = expected.cube(i);
+    const Cube* cube = molecule.cube(i);
+    EXPECT_TRUE(expectedCube->min().isApprox(cube->min(), 1e-12));
+    EXPECT_TRUE(expectedCube->spacing().isApprox(cube->spacing(), 1e-12));
+    EXPECT_EQ(expectedCube->dimensions(), cube->dimensions());
+    EXPECT_EQ(*expectedCube->data(), *cube->data());
+  }
+
+  EXPECT_EQ(expected.vibrationFrequencies(), molecule.vibrationFrequencies());
+  EXPECT_EQ(expected.vibrationIntensities(), molecule.vibrationIntensities());
+  for (size_t i = 0; i < expected.vibrationFrequencies().size(); ++i) {
+    expectSamePositions(expected.vibrationLx(static_cast<int>(i)),
+                        molecule.vibrationLx(static_cast<int>(i)));
+  }
+}
+// Read text with and without streaming, expecting the same molecule.
+void expectSameStreamed(const std::string& text, Molecule& molecule,
+                        Molecule& streamedMolecule)
+{
+  CjsonFormat cjson, streaming;
+  streaming.setOptions("{\"streaming\": true}");
+  ASSERT_TRUE(cjson.readString(text, molecule)) << cjson.error();
+  ASSERT_TRUE(streaming.readString(text, streamedMolecule))
+    << streaming.error();
+  expectSameMolecule(molecule, streamedMolecule);
+}
+} // namespace
+
 TEST(CjsonTest, readFile)
 {
   CjsonFormat cjson;
@@ -49,6 +187,24 @@ TEST(CjsonTest, readFile)
   EXPECT_EQ(molecule.data("inchi").toString(), "1/C2H6/c1-2/h1-2H3");
 }
 
+TEST(CjsonTest, readStream)
+{
+  // readFile() parses a mapping of the file, which must match the stream.
+  CjsonFormat cjson;
+  Molecule mapped;
+  Molecule streamed;
+  const std::string fileName =
+    std::string(AVOGADRO_DATA) + "/data/ethane.cjson";
+  EXPECT_TRUE(cjson.readFile(fileName, mapped));
+  std::ifstream file(fileName.c_str(), std::ifstream::binary);
+  EXPECT_TRUE(cjson.read(file, streamed));
+  EXPECT_EQ(cjson.error(), "");
+  ASSERT_EQ(streamed.atomCount(), mapped.atomCount());
+  EXPECT_EQ(streamed.bondCount(), mapped.bondCount());
+  for (size_t i = 0; i < mapped.atomCount(); ++i)
+    EXPECT_EQ(streamed.atomPosition3d(i), mapped.atomPosition3d(i));
+}
+
 TEST(CjsonTest, atoms)
 {
   CjsonFormat cjson;
@@ -177,3 +333,141 @@ TEST(CjsonTest, saveFile)
   EXPECT_EQ(bond.atom2().index(), static_cast<size_t>(1));
   EXPECT_EQ(bond.order(), static_cast<unsigned char>(1));
 }
+
+TEST(CjsonTest, binaryRoundTrip)
+{
+  CjsonFormat cjson;
+  Molecule molecule;
+  EXPECT_TRUE(cjson.readFile(std::string(AVOGADRO_DATA) + "/data/ethane.cjson",
+                             molecule));
+  std::string text;
+  EXPECT_TRUE(cjson.writeString(text, molecule));
+
+  // Both encodings read back to the same molecule as the text format.
+  Molecule textMolecule;
+  EXPECT_TRUE(cjson.readString(text, textMolecule));
+  EXPECT_TRUE(cjson.writeString(text, textMolecule));
+  const char* options[2] = { "{\"encoding\": \"cbor\"}",
+                             "{\"encoding\": \"messagepack\"}" };
+  for (int i = 0; i < 2; ++i) {
+    CjsonBinaryFormat binary;
+    binary.setOptions(options[i]);
+    std::string data;
+    EXPECT_TRUE(binary.writeString(data, molecule));
+    EXPECT_LT(data.size(), text.size());
+
+    Molecule readMolecule;
+    EXPECT_TRUE(binary.readString(data, readMolecule));
+    EXPECT_EQ(binary.error(), "");
+    std::string readText;
+    EXPECT_TRUE(cjson.writeString(readText, readMolecule));
+    EXPECT_EQ(readText, text);
+
+    // Truncated data is an error.
+    EXPECT_FALSE(binary.readString(data.substr(0, data.size() / 2),
+                                   readMolecule));
+  }
+}
+
+TEST(CjsonTest, binaryRoundTripOrbitals)
+{
+  Molecule molecule;
+  setUpMolecule(molecule);
+
+  CjsonFormat cjson;
+  std::string text;
+  ASSERT_TRUE(cjson.writeString(text, molecule));
+  Molecule textMolecule;
+  ASSERT_TRUE(cjson.readString(text, textMolecule)) << cjson.error();
+  expectSameMolecule(molecule, textMolecule);
+
+  const char* options[2] = { "{\"encoding\": \"cbor\"}",
+                             "{\"encoding\": \"messagepack\"}" };
+  for (int i = 0; i < 2; ++i) {
+    CjsonBinaryFormat binary;
+    binary.setOptions(options[i]);
+    std::string data;
+    ASSERT_TRUE(binary.writeString(data, molecule));
+    EXPECT_LT(data.size(), text.size());
+
+    Molecule readMolecule;
+    ASSERT_TRUE(binary.readString(data, readMolecule)) << binary.error();
+    expectSameMolecule(molecule, readMolecule);
+  }
+}
+
+TEST(CjsonTest, streaming)
+{
+  CjsonFormat cjson, streaming;
+  streaming.setOptions("{\"streaming\": true}");
+  Molecule molecule, streamedMolecule;
+  const std::string fileName =
+    std::string(AVOGADRO_DATA) + "/data/ethane.cjson";
+  EXPECT_TRUE(cjson.readFile(fileName, molecule));
+  EXPECT_TRUE(streaming.readFile(fileName, streamedMolecule));
+  EXPECT_EQ(streaming.error(), "");
+
+  std::string text, streamedText;
+  EXPECT_TRUE(cjson.writeString(text, molecule));
+  EXPECT_TRUE(cjson.writeString(streamedText, streamedMolecule));
+  EXPECT_EQ(streamedText, text);
+
+  // Streams are parsed as they are read.
+  std::ifstream file(fileName.c_str(), std::ios::binary);
+  Molecule fileMolecule;
+  EXPECT_TRUE(streaming.read(file, fileMolecule));
+  EXPECT_TRUE(cjson.writeString(streamedText, fileMolecule));
+  EXPECT_EQ(streamedText, text);
+}
+
+TEST(CjsonTest, streamingSections)
+{
+  // Coordinate sets, e.g. a trajectory.
+  Molecule trajectory, streamed;
+  expectSameStreamed(
+    "{\"chemical json\": 0, \"atoms\": {"
+    "\"elements\": {\"number\": [8, 1, 1]}, \"coords\": {"
+    "\"3d\": [0, 0, 0, 0.96, 0, 0, -0.24, 0.93, 0], \"3dSets\": ["
+    "[0, 0, 0, 0.96, 0, 0, -0.24, 0.93, 0],"
+    "[0, 0, 0.1, 0.98, 0, 0, -0.25, 0.92, 0.1]]}}}",
+    trajectory, streamed);
+  EXPECT_EQ(trajectory.coordinate3dCount(), 2);
+
+  // Fractional coordinates in a unit cell.
+  Molecule crystal, streamedCrystal;
+  expectSameStreamed(
+    "{\"chemical json\": 0, \"atoms\": {"
+    "\"elements\": {\"number\": [11, 17]}, \"coords\": {"
+    "\"3d fractional\": [0, 0, 0, 0.5, 0.5, 0.5]}}, \"unit cell\": {"
+    "\"a\": 5.64, \"b\": 5.64, \"c\": 5.64,"
+    "\"alpha\": 90, \"beta\": 90, \"gamma\": 90}}",
+    crystal, streamedCrystal);
+  ASSERT_NE(crystal.unitCell(), nullptr);
+  EXPECT_TRUE(crystal.atomPosition3d(1).isApprox(Vector3(2.82, 2.82, 2.82)));
+
+  // A basis set, orbitals with a set of coefficients, a cube and
+  // vibrations.
+  Molecule molecule;
+  setUpMolecule(molecule);
+  CjsonFormat cjson;
+  std::string text;
+  ASSERT_TRUE(cjson.writeString(text, molecule));
+  std::string sets = "\"sets\": [{\"moCoefficients\": [";
+  for (int i = 0; i < 16; ++i)
+    sets += std::to_string(0.5 - 0.0625 * i) + (i < 15 ? ", " : "]}],");
+  std::string::size_type electronCount = text.find("\"electronCount\"");
+  ASSERT_NE(electronCount, std::string::npos);
+  text.insert(electronCount, sets);
+
+  Molecule orbitals, streamedOrbitals;
+  expectSameStreamed(text, orbitals, streamedOrbitals);
+  GaussianSet* basis = dynamic_cast<GaussianSet*>(orbitals.basisSet());
+  GaussianSet* streamedBasis =
+    dynamic_cast<GaussianSet*>(streamedOrbitals.basisSet());
+  ASSERT_NE(basis, nullptr);
+  ASSERT_NE(streamedBasis, nullptr);
+  EXPECT_EQ(basis->setCount(), 1);
+  EXPECT_EQ(streamedBasis->setCount(), 1);
+  EXPECT_EQ(orbitals.cubeCount(), static_cast<Index>(1));
+  EXPECT_EQ(orbitals.vibrationFrequencies().size(), static_cast<size_t>(2));
+}
@@ -0,0 +1,210 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include "iotests.h"
+
+#include <gtest/gtest.h>
+
+#include <avogadro/core/framesource.h>
+#include <avogadro/core/molecule.h>
+#include <avogadro/core/unitcell.h>
+#include <avogadro/core/vector.h>
+
+#include <avogadro/io/dcdformat.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using Avogadro::Vector3;
+using Avogadro::Core::Array;
+using Avogadro::Core::Molecule;
+using Avogadro::Core::UnitCell;
+using Avogadro::Io::DcdFormat;
+
+namespace {
+
+const int atomCount = 4;
+const int frameCount = 3;
+
+// Frames of four atoms, each frame moved a little from the last.
+void setUpTrajectory(Molecule& molecule, int frames = frameCount)
+{
+  for (int i = 0; i < atomCount; ++i)
+    molecule.addAtom(6).setPosition3d(Vector3(i * 1.5, 0.25 * i, -0.5));
+  for (int f = 0; f < frames; ++f) {
+    Array<Vector3> positions = molecule.atomPositions3d();
+    for (int i = 0; i < atomCount; ++i)
+      positions[i] += Vector3(0.1 * f, -0.2 * f, 0.3 * f * i);
+    molecule.setCoordinate3d(positions, f);
+    molecule.setTimeStep(2.0 * f, f);
+  }
+}
+
+// The positions are stored in single precision.
+void expectSameFrames(const Molecule& expected, const Molecule& molecule)
+{
+  ASSERT_EQ(expected.atomCount(), molecule.atomCount());
+  ASSERT_EQ(expected.coordinate3dCount(), molecule.coordinate3dCount());
+  for (int f = 0; f < expected.coordinate3dCount(); ++f) {
+    Array<Vector3> a = expected.coordinate3d(f);
+    Array<Vector3> b = molecule.coordinate3d(f);
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+      EXPECT_TRUE(a[i].isApprox(b[i], 1e-6)) << "frame " << f << " atom "
+                                             << i;
+    }
+  }
+}
+} // namespace
+
+TEST(DcdTest, roundTrip)
+{
+  Molecule molecule;
+  setUpTrajectory(molecule);
+
+  DcdFormat dcd;
+  std::string output;
+  ASSERT_TRUE(dcd.writeString(output, molecule)) << dcd.error();
+
+  Molecule read;
+  ASSERT_TRUE(dcd.readString(output, read)) << dcd.error();
+  EXPECT_EQ(read.atomCount(), static_cast<size_t>(atomCount));
+  EXPECT_EQ(read.coordinate3dCount(), frameCount);
+  EXPECT_TRUE(read.unitCell() == nullptr);
+  expectSameFrames(molecule, read);
+
+  // The time between frames is kept.
+  bool status;
+  EXPECT_NEAR(read.timeStep(2, status), 4.0, 1e-6);
+  EXPECT_TRUE(status);
+}
+
+TEST(DcdTest, unitCell)
+{
+  Molecule molecule;
+  setUpTrajectory(molecule);
+  molecule.setUnitCell(new UnitCell(10.0, 12.0, 14.0, 1.5, 1.4, 1.3));
+
+  DcdFormat dcd;
+  std::string output;
+  ASSERT_TRUE(dcd.writeString(output, molecule)) << dcd.error();
+
+  Molecule read;
+  ASSERT_TRUE(dcd.readString(output, read)) << dcd.error();
+  expectSameFrames(molecule, read);
+  const UnitCell* cell = read.unitCell();
+  ASSERT_TRUE(cell != nullptr);
+  EXPECT_NEAR(cell->a(), 10.0, 1e-10);
+  EXPECT_NEAR(cell->b(), 12.0, 1e-10);
+  EXPECT_NEAR(cell->c(), 14.0, 1e-10);
+  EXPECT_NEAR(cell->alpha(), 1.5, 1e-10);
+  EXPECT_NEAR(cell->beta(), 1.4, 1e-10);
+  EXPECT_NEAR(cell->gamma(), 1.3, 1e-10);
+}
+
+TEST(DcdTest, frameSource)
+{
+  Molecule molecule;
+  setUpTrajectory(molecule);
+
+  DcdFormat dcd;
+  ASSERT_TRUE(dcd.writeFile("dcdtmp.dcd", molecule)) << dcd.error();
+
+  // Frames of files are only read when they are asked for, in any order.
+  Molecule read;
+  ASSERT_TRUE(dcd.readFile("dcdtmp.dcd", read)) << dcd.error();
+  EXPECT_TRUE(read.frameSource() != nullptr);
+  EXPECT_EQ(read.coordinate3dCount(), frameCount);
+  Array<Vector3> last = read.coordinate3d(frameCount - 1);
+  Array<Vector3> expected = molecule.coordinate3d(frameCount - 1);
+  ASSERT_EQ(last.size(), static_cast<size_t>(atomCount));
+  EXPECT_TRUE(last[3].isApprox(expected[3], 1e-6));
+  expectSameFrames(molecule, read);
+
+  // Writing over the file the frames are read from keeps them intact, with
+  // none of them cached.
+  read.frameSource()->clearCache();
+  ASSERT_TRUE(dcd.writeFile("dcdtmp.dcd", read)) << dcd.error();
+  expectSameFrames(molecule, read);
+  Molecule reread;
+  ASSERT_TRUE(dcd.readFile("dcdtmp.dcd", reread)) << dcd.error();
+  expectSameFrames(molecule, reread);
+
+  // Frames of a file truncated by someone else cannot be read any more.
+  reread.frameSource()->clearCache();
+  std::ofstream truncated("dcdtmp.dcd", std::ofstream::trunc);
+  truncated.close();
+  EXPECT_TRUE(reread.coordinate3d(frameCount - 1).empty());
+  std::remove("dcdtmp.dcd");
+}
+
+TEST(DcdTest, truncated)
+{
+  Molecule molecule;
+  setUpTrajectory(molecule, 1);
+
+  DcdFormat dcd;
+  std::string output;
+  ASSERT_TRUE(dcd.writeString(output, molecule));
+
+  // Cut off in the header, and in the first frame.
+  const size_t lengths[3] = { 2, 60, output.size() - 4 };
+  for (int i = 0; i < 3; ++i) {
+    Molecule read;
+    DcdFormat format;
+    EXPECT_FALSE(format.readString(output.substr(0, lengths[i]), read))
+      << "length " << lengths[i];
+    EXPECT_FALSE(format.error().empty());
+  }
+}
+
+TEST(DcdTest, corrupt)
+{
+  Molecule molecule;
+  setUpTrajectory(molecule);
+
+  DcdFormat dcd;
+  std::string output;
+  ASSERT_TRUE(dcd.writeString(output, molecule));
+
+  // Not a DCD file at all.
+  std::string corrupt = output;
+  corrupt[0] = 'x';
+  Molecule read;
+  EXPECT_FALSE(dcd.readString(corrupt, read));
+  EXPECT_FALSE(dcd.error().empty());
+
+  // A title block that runs past the end of the file.
+  corrupt = output;
+  corrupt[96] = 0x7f;
+  DcdFormat format;
+  EXPECT_FALSE(format.readString(corrupt, read));
+  EXPECT_FALSE(format.error().empty());
+}
+
+TEST(DcdTest, frameOptions)
+{
+  Molecule molecule;
+  setUpTrajectory(molecule);
+
+  // Every second frame from the second one on.
+  DcdFormat dcd;
+  dcd.setOptions("{ \"firstFrame\": 1, \"frameStride\": 2 }");
+  std::string output;
+  ASSERT_TRUE(dcd.writeString(output, molecule)) << dcd.error();
+  Molecule read;
+  DcdFormat reader;
+  ASSERT_TRUE(reader.readString(output, read)) << reader.error();
+  ASSERT_EQ(read.coordinate3dCount(), 1);
+  EXPECT_TRUE(read.coordinate3d(0)[3].isApprox(molecule.coordinate3d(1)[3],
+                                               1e-6));
+
+  // Options of the wrong type are reported rather than thrown.
+  DcdFormat bad;
+  bad.setOptions("{ \"lastFrame\": \"end\" }");
+  EXPECT_FALSE(bad.writeString(output, molecule));
+  EXPECT_NE(bad.error().find("lastFrame"), std::string::npos);
+}
@@ -25,11 +25,15 @@
 
 #include <avogadro/io/lammpsformat.h>
 
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <thread>
 
 using Avogadro::Vector3;
+using Avogadro::Core::Array;
 using Avogadro::Core::Atom;
 using Avogadro::Core::Molecule;
 using Avogadro::Core::UnitCell;
@@ -115,3 +119,78 @@ TEST(LammpsTest, modes)
   EXPECT_TRUE(format.isMode(FileFormat::Read | FileFormat::MultiMolecule));
   EXPECT_TRUE(format.isMode(FileFormat::MultiMolecule));
 }
+
+namespace {
+
+// A dump of three atoms with more frames than are parsed in one batch, so
+// that frames cross from one batch into the next. Frame f is at timestep 10f
+// and has its atoms at (f, i, -f).
+std::string dump(int& frameCount)
+{
+  frameCount = 64 * std::max(1u, std::thread::hardware_concurrency()) + 3;
+  std::ostringstream out;
+  for (int f = 0; f < frameCount; ++f) {
+    out << "ITEM: TIMESTEP\n"
+        << 10 * f << "\n"
+        << "ITEM: NUMBER OF ATOMS\n3\n"
+        << "ITEM: BOX BOUNDS pp pp pp\n"
+        << "-5 5\n-5 5\n-5 5\n"
+        << "ITEM: ATOMS id type x y z\n";
+    for (int i = 0; i < 3; ++i)
+      out << i + 1 << " 1 " << f << " " << i << " " << -f << "\n";
+  }
+  return out.str();
+}
+
+void expectFrames(const Molecule& molecule, int frameCount)
+{
+  ASSERT_EQ(molecule.coordinate3dCount(), frameCount);
+  for (int f = 0; f < frameCount; ++f) {
+    Array<Vector3> positions = molecule.coordinate3d(f);
+    ASSERT_EQ(positions.size(), 3u);
+    EXPECT_EQ(positions[2], Vector3(f, 2, -f)) << "frame " << f;
+    bool status;
+    EXPECT_EQ(molecule.timeStep(f, status), 10 * f);
+  }
+}
+} // namespace
+
+TEST(LammpsTest, readBatches)
+{
+  int frameCount;
+  const std::string text = dump(frameCount);
+
+  LammpsTrajectoryFormat format;
+  Molecule molecule;
+  EXPECT_TRUE(format.readString(text, molecule)) << format.error();
+  expectFrames(molecule, frameCount);
+}
+
+TEST(LammpsTest, readTruncatedFrame)
+{
+  int frameCount;
+  std::string text = dump(frameCount);
+  // Cut the last frame short by its last atom.
+  text.resize(text.rfind("3 1 "));
+
+  // The frames before it are kept, but the trajectory is reported as broken.
+  LammpsTrajectoryFormat format;
+  Molecule molecule;
+  EXPECT_FALSE(format.readString(text, molecule));
+  EXPECT_NE(format.error().find("Not enough atoms in the last frame."),
+            std::string::npos);
+  expectFrames(molecule, frameCount - 1);
+
+  // Frames read on demand from a file are reported the same way.
+  {
+    std::ofstream file("truncatedtmp.dump", std::ofstream::binary);
+    file << text;
+  }
+  Molecule lazy;
+  LammpsTrajectoryFormat lazyFormat;
+  EXPECT_FALSE(lazyFormat.readFile("truncatedtmp.dump", lazy));
+  EXPECT_NE(lazyFormat.error().find("Not enough atoms in the last frame."),
+            std::string::npos);
+  expectFrames(lazy, frameCount - 1);
+  std::remove("truncatedtmp.dump");
+}
@@ -0,0 +1,122 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <avogadro/io/linereader.h>
+
+#include <sstream>
+#include <string>
+
+using Avogadro::Core::StringView;
+using Avogadro::Io::LineReader;
+
+TEST(LineReaderTest, getLine)
+{
+  std::istringstream in("first\r\nsecond\n\nlast");
+  LineReader reader(in, 4);
+  StringView line;
+  EXPECT_TRUE(reader.getLine(line));
+  EXPECT_EQ(line.toString(), "first");
+  EXPECT_TRUE(reader.getLine(line));
+  EXPECT_EQ(line.toString(), "second");
+  EXPECT_TRUE(reader.getLine(line));
+  EXPECT_TRUE(line.empty());
+  EXPECT_TRUE(reader.getLine(line));
+  EXPECT_EQ(line.toString(), "last");
+  EXPECT_FALSE(reader.getLine(line));
+}
+
+TEST(LineReaderTest, getLinesAcrossBuffers)
+{
+  // The buffer is much smaller than the blocks, which are read across several
+  // fills of it.
+  std::istringstream in("a 1\nb 2\nc 3\nd 4\ne 5\n");
+  LineReader reader(in, 5);
+  StringView lines;
+  EXPECT_TRUE(reader.getLines(3, lines));
+  EXPECT_EQ(lines.toString(), "a 1\nb 2\nc 3");
+  EXPECT_EQ(reader.tell(), 12);
+  EXPECT_TRUE(reader.getLines(2, lines));
+  EXPECT_EQ(lines.toString(), "d 4\ne 5");
+  EXPECT_FALSE(reader.getLines(1, lines));
+}
+
+TEST(LineReaderTest, getLinesTruncated)
+{
+  // The last line may miss its newline, but not the lines after it.
+  std::istringstream complete("a 1\nb 2");
+  LineReader reader(complete, 3);
+  StringView lines;
+  EXPECT_TRUE(reader.getLines(2, lines));
+  EXPECT_EQ(lines.toString(), "a 1\nb 2");
+
+  std::istringstream truncated("a 1\nb 2\nc");
+  LineReader truncatedReader(truncated, 3);
+  EXPECT_TRUE(truncatedReader.getLines(1, lines));
+  EXPECT_FALSE(truncatedReader.getLines(3, lines));
+  EXPECT_EQ(lines.toString(), "b 2\nc");
+}
+
+TEST(LineReaderTest, position)
+{
+  // The stream is left just past the last line read, as with std::getline.
+  std::istringstream in("one\ntwo\nthree\n");
+  {
+    LineReader reader(in, 2);
+    StringView line;
+    EXPECT_TRUE(reader.getLine(line));
+  }
+  std::string rest;
+  std::getline(in, rest);
+  EXPECT_EQ(rest, "two");
+}
+
+namespace {
+
+// Count the characters read from the string.
+class CountingBuffer : public std::stringbuf
+{
+public:
+  explicit CountingBuffer(const std::string& text)
+    : std::stringbuf(text, std::ios_base::in), count(0)
+  {
+  }
+
+  std::streamsize count;
+
+protected:
+  std::streamsize xsgetn(char* s, std::streamsize n) override
+  {
+    std::streamsize read = std::stringbuf::xsgetn(s, n);
+    count += read;
+    return read;
+  }
+};
+} // namespace
+
+TEST(LineReaderTest, shortRecords)
+{
+  // A short record at the start of a long stream is read without reading
+  // much more of it.
+  CountingBuffer buffer("short\n" + std::string(1 << 21, 'x') + "\nend\n");
+  std::istream in(&buffer);
+  {
+    LineReader reader(in);
+    StringView line;
+    EXPECT_TRUE(reader.getLine(line));
+    EXPECT_EQ(line.toString(), "short");
+  }
+  EXPECT_LT(buffer.count, 1 << 16);
+
+  // Longer reads still get all of it.
+  LineReader reader(in);
+  StringView line;
+  EXPECT_TRUE(reader.getLine(line));
+  EXPECT_EQ(line.size(), static_cast<size_t>(1 << 21));
+  EXPECT_TRUE(reader.getLine(line));
+  EXPECT_EQ(line.toString(), "end");
+  EXPECT_FALSE(reader.getLine(line));
+}
@@ -30,10 +30,12 @@ using Avogadro::DEG_TO_RAD;
 using Avogadro::MatrixX;
 using Avogadro::Real;
 using Avogadro::Vector3;
+using Avogadro::Core::Array;
 using Avogadro::Core::Atom;
 using Avogadro::Core::Bond;
 using Avogadro::Core::Molecule;
 using Avogadro::Core::Residue;
+using Avogadro::Core::UnitCell;
 using Avogadro::Core::Variant;
 using Avogadro::Io::MMTFFormat;
 
@@ -136,3 +138,106 @@ TEST(MMTFTest, residues)
   EXPECT_EQ(res3.residueName(), "HOH");
   EXPECT_EQ(res3.residueAtoms().size(), static_cast<size_t>(1));
 }
+
+TEST(MMTFTest, write)
+{
+  MMTFFormat mmtf;
+  Molecule molecule;
+  ASSERT_TRUE(
+    mmtf.readFile(std::string(AVOGADRO_DATA) + "/data/4HHB.mmtf", molecule))
+    << mmtf.error();
+
+  // Write a second model, which is read back as a coordinate set.
+  Array<Vector3> shifted = molecule.atomPositions3d();
+  for (size_t i = 0; i < shifted.size(); ++i)
+    shifted[i] += Vector3(1.0, 0.0, 0.0);
+  molecule.setCoordinate3d(molecule.atomPositions3d(), 0);
+  molecule.setCoordinate3d(shifted, 1);
+
+  std::string output;
+  EXPECT_TRUE(mmtf.writeString(output, molecule));
+  Molecule readMolecule;
+  EXPECT_TRUE(mmtf.readString(output, readMolecule));
+
+  EXPECT_EQ(readMolecule.data("name").toString(),
+            molecule.data("name").toString());
+  EXPECT_EQ(readMolecule.atomCount(), molecule.atomCount());
+  EXPECT_EQ(readMolecule.bondCount(), molecule.bondCount());
+  EXPECT_EQ(readMolecule.residueCount(), molecule.residueCount());
+  EXPECT_EQ(readMolecule.coordinate3dCount(), 2);
+  EXPECT_NEAR(readMolecule.unitCell()->beta(), 99.34 * DEG_TO_RAD, 1e-3);
+
+  for (size_t i = 0; i < molecule.atomCount(); ++i) {
+    EXPECT_EQ(readMolecule.atomicNumber(i), molecule.atomicNumber(i));
+    EXPECT_NEAR(
+      (readMolecule.atomPosition3d(i) - molecule.atomPosition3d(i)).norm(), 0.0,
+      1e-3);
+    EXPECT_NEAR((readMolecule.coordinate3d(1)[i] - shifted[i]).norm(), 0.0,
+                1e-3);
+  }
+
+  const Residue& heme = readMolecule.residue(579);
+  EXPECT_EQ(heme.residueId(), static_cast<size_t>(148));
+  EXPECT_EQ(heme.residueName(), "HEM");
+  EXPECT_EQ(heme.atomNameMap().size(), static_cast<size_t>(43));
+}
+
+TEST(MMTFTest, writeModels)
+{
+  // Two residues in different chains, and an atom in neither of them.
+  Molecule molecule;
+  std::string names[2] = { "ALA", "HOH" };
+  Avogadro::Index ids[2] = { 1, 2 };
+  char chains[2] = { 'A', 'B' };
+  std::string atomNames[3] = { "N", "CA", "O" };
+  Residue& ala = molecule.addResidue(names[0], ids[0], chains[0]);
+  Atom n = molecule.addAtom(7);
+  Atom ca = molecule.addAtom(6);
+  ala.addResidueAtom(atomNames[0], n);
+  ala.addResidueAtom(atomNames[1], ca);
+  Residue& water = molecule.addResidue(names[1], ids[1], chains[1]);
+  Atom o = molecule.addAtom(8);
+  water.addResidueAtom(atomNames[2], o);
+  Atom na = molecule.addAtom(11);
+  molecule.setFormalCharge(na.index(), 1);
+  molecule.addBond(n, ca, 2);
+  molecule.addBond(ca, o, 1);
+  molecule.setUnitCell(new UnitCell(10.0, 11.0, 12.0, 90.0 * DEG_TO_RAD,
+                                    100.0 * DEG_TO_RAD, 90.0 * DEG_TO_RAD));
+
+  Array<Vector3> positions;
+  for (int i = 0; i < 4; ++i)
+    positions.push_back(Vector3(i, 0.5 * i, -1.25 * i));
+  Array<Vector3> shifted = positions;
+  for (size_t i = 0; i < shifted.size(); ++i)
+    shifted[i] += Vector3(1.0, 0.0, 0.0);
+  molecule.setCoordinate3d(positions, 0);
+  molecule.setCoordinate3d(shifted, 1);
+  molecule.setCoordinate3d(0);
+
+  MMTFFormat mmtf;
+  std::string output;
+  ASSERT_TRUE(mmtf.writeString(output, molecule)) << mmtf.error();
+  Molecule readMolecule;
+  ASSERT_TRUE(mmtf.readString(output, readMolecule)) << mmtf.error();
+
+  // The atom outside of the residues gets a residue of its own.
+  ASSERT_EQ(readMolecule.atomCount(), molecule.atomCount());
+  EXPECT_EQ(readMolecule.bondCount(), molecule.bondCount());
+  EXPECT_EQ(readMolecule.residueCount(), static_cast<size_t>(3));
+  EXPECT_EQ(readMolecule.residue(1).residueName(), "HOH");
+  EXPECT_EQ(readMolecule.residue(1).chainId(), 'B');
+  EXPECT_EQ(readMolecule.formalCharge(3), 1);
+  EXPECT_EQ(readMolecule.bond(0, 1).order(), 2);
+  EXPECT_NEAR(readMolecule.unitCell()->b(), 11.0, 1e-3);
+  EXPECT_NEAR(readMolecule.unitCell()->beta(), 100.0 * DEG_TO_RAD, 1e-3);
+
+  ASSERT_EQ(readMolecule.coordinate3dCount(), 2);
+  for (size_t i = 0; i < molecule.atomCount(); ++i) {
+    EXPECT_EQ(readMolecule.atomicNumber(i), molecule.atomicNumber(i));
+    EXPECT_NEAR((readMolecule.atomPosition3d(i) - positions[i]).norm(), 0.0,
+                1e-3);
+    EXPECT_NEAR((readMolecule.coordinate3d(1)[i] - shifted[i]).norm(), 0.0,
+                1e-3);
+  }
+}
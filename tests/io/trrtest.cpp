@@ -0,0 +1,183 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include "iotests.h"
+
+#include <gtest/gtest.h>
+
+#include <avogadro/core/framesource.h>
+#include <avogadro/core/molecule.h>
+#include <avogadro/core/unitcell.h>
+#include <avogadro/core/vector.h>
+
+#include <avogadro/io/trrformat.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using Avogadro::Vector3;
+using Avogadro::Core::Array;
+using Avogadro::Core::Molecule;
+using Avogadro::Core::UnitCell;
+using Avogadro::Io::TrrFormat;
+
+namespace {
+
+const int atomCount = 4;
+const int frameCount = 3;
+
+// Frames of four atoms, each frame moved a little from the last.
+void setUpTrajectory(Molecule& molecule, int frames = frameCount)
+{
+  for (int i = 0; i < atomCount; ++i)
+    molecule.addAtom(6).setPosition3d(Vector3(i * 1.5, 0.25 * i, -0.5));
+  for (int f = 0; f < frames; ++f) {
+    Array<Vector3> positions = molecule.atomPositions3d();
+    for (int i = 0; i < atomCount; ++i)
+      positions[i] += Vector3(0.1 * f, -0.2 * f, 0.3 * f * i);
+    molecule.setCoordinate3d(positions, f);
+    molecule.setTimeStep(2.0 * f, f);
+  }
+}
+
+// The positions are stored in single precision, in nanometers.
+void expectSameFrames(const Molecule& expected, const Molecule& molecule)
+{
+  ASSERT_EQ(expected.atomCount(), molecule.atomCount());
+  ASSERT_EQ(expected.coordinate3dCount(), molecule.coordinate3dCount());
+  for (int f = 0; f < expected.coordinate3dCount(); ++f) {
+    Array<Vector3> a = expected.coordinate3d(f);
+    Array<Vector3> b = molecule.coordinate3d(f);
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+      EXPECT_TRUE(a[i].isApprox(b[i], 1e-6)) << "frame " << f << " atom "
+                                             << i;
+    }
+  }
+}
+} // namespace
+
+TEST(TrrTest, roundTrip)
+{
+  Molecule molecule;
+  setUpTrajectory(molecule);
+
+  TrrFormat trr;
+  std::string output;
+  ASSERT_TRUE(trr.writeString(output, molecule)) << trr.error();
+
+  Molecule read;
+  ASSERT_TRUE(trr.readString(output, read)) << trr.error();
+  EXPECT_EQ(read.atomCount(), static_cast<size_t>(atomCount));
+  EXPECT_EQ(read.coordinate3dCount(), frameCount);
+  EXPECT_TRUE(read.unitCell() == nullptr);
+  expectSameFrames(molecule, read);
+
+  // The time of each frame is kept.
+  bool status;
+  EXPECT_NEAR(read.timeStep(2, status), 4.0, 1e-6);
+  EXPECT_TRUE(status);
+}
+
+TEST(TrrTest, unitCell)
+{
+  Molecule molecule;
+  setUpTrajectory(molecule);
+  molecule.setUnitCell(new UnitCell(10.0, 12.0, 14.0, 1.5, 1.4, 1.3));
+
+  TrrFormat trr;
+  std::string output;
+  ASSERT_TRUE(trr.writeString(output, molecule)) << trr.error();
+
+  Molecule read;
+  ASSERT_TRUE(trr.readString(output, read)) << trr.error();
+  expectSameFrames(molecule, read);
+  const UnitCell* cell = read.unitCell();
+  ASSERT_TRUE(cell != nullptr);
+  EXPECT_TRUE(
+    cell->cellMatrix().isApprox(molecule.unitCell()->cellMatrix(), 1e-6));
+}
+
+TEST(TrrTest, frameSource)
+{
+  Molecule molecule;
+  setUpTrajectory(molecule);
+
+  TrrFormat trr;
+  ASSERT_TRUE(trr.writeFile("trrtmp.trr", molecule)) << trr.error();
+
+  // Frames of files are only read when they are asked for, in any order.
+  Molecule read;
+  ASSERT_TRUE(trr.readFile("trrtmp.trr", read)) << trr.error();
+  EXPECT_TRUE(read.frameSource() != nullptr);
+  EXPECT_EQ(read.coordinate3dCount(), frameCount);
+  Array<Vector3> last = read.coordinate3d(frameCount - 1);
+  Array<Vector3> expected = molecule.coordinate3d(frameCount - 1);
+  ASSERT_EQ(last.size(), static_cast<size_t>(atomCount));
+  EXPECT_TRUE(last[3].isApprox(expected[3], 1e-6));
+  expectSameFrames(molecule, read);
+
+  // Writing over the file the frames are read from keeps them intact, with
+  // none of them cached.
+  read.frameSource()->clearCache();
+  ASSERT_TRUE(trr.writeFile("trrtmp.trr", read)) << trr.error();
+  expectSameFrames(molecule, read);
+  Molecule reread;
+  ASSERT_TRUE(trr.readFile("trrtmp.trr", reread)) << trr.error();
+  expectSameFrames(molecule, reread);
+
+  // Frames of a file truncated by someone else cannot be read any more.
+  reread.frameSource()->clearCache();
+  std::ofstream truncated("trrtmp.trr", std::ofstream::trunc);
+  truncated.close();
+  EXPECT_TRUE(reread.coordinate3d(frameCount - 1).empty());
+  std::remove("trrtmp.trr");
+}
+
+TEST(TrrTest, truncated)
+{
+  Molecule molecule;
+  setUpTrajectory(molecule, 1);
+
+  TrrFormat trr;
+  std::string output;
+  ASSERT_TRUE(trr.writeString(output, molecule));
+
+  // Cut off in the header, and in the first frame.
+  const size_t lengths[3] = { 2, 60, output.size() - 4 };
+  for (int i = 0; i < 3; ++i) {
+    Molecule read;
+    TrrFormat format;
+    EXPECT_FALSE(format.readString(output.substr(0, lengths[i]), read))
+      << "length " << lengths[i];
+    EXPECT_FALSE(format.error().empty());
+  }
+}
+
+TEST(TrrTest, corrupt)
+{
+  Molecule molecule;
+  setUpTrajectory(molecule);
+
+  TrrFormat trr;
+  std::string output;
+  ASSERT_TRUE(trr.writeString(output, molecule));
+
+  // Not a TRR file at all.
+  std::string corrupt = output;
+  corrupt[0] = 'x';
+  corrupt[3] = 'x';
+  Molecule read;
+  EXPECT_FALSE(trr.readString(corrupt, read));
+  EXPECT_FALSE(trr.error().empty());
+
+  // The wrong version string.
+  corrupt = output;
+  corrupt[12] = 'X';
+  TrrFormat format;
+  EXPECT_FALSE(format.readString(corrupt, read));
+  EXPECT_FALSE(format.error().empty());
+}
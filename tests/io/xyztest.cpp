@@ -24,15 +24,19 @@
 
 #include <avogadro/io/xyzformat.h>
 
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <thread>
 
 using Avogadro::Core::Atom;
 using Avogadro::Core::Molecule;
 using Avogadro::Io::FileFormat;
 using Avogadro::Io::XyzFormat;
 using Avogadro::Vector3;
+using Avogadro::Core::Array;
 
 // methane.xyz uses atomic symbols to identify atoms
 TEST(XyzTest, readAtomicSymbols)
@@ -223,3 +227,71 @@ TEST(DISABLED_XyzTest, writeMulti)
     EXPECT_EQ(mol[i].bondCount(), ref[i].bondCount());
   }
 }
+
+namespace {
+
+// A trajectory of three atoms with more frames than are parsed in one batch,
+// so that frames cross from one batch into the next. Frame f has its atoms at
+// (f, i, -f).
+std::string trajectory(int& frameCount)
+{
+  frameCount = 64 * std::max(1u, std::thread::hardware_concurrency()) + 3;
+  std::ostringstream out;
+  for (int f = 0; f < frameCount; ++f) {
+    out << "3\nFrame " << f << "\n";
+    for (int i = 0; i < 3; ++i)
+      out << "C " << f << " " << i << " " << -f << "\n";
+  }
+  return out.str();
+}
+
+void expectFrames(const Molecule& molecule, int frameCount)
+{
+  ASSERT_EQ(molecule.coordinate3dCount(), frameCount);
+  for (int f = 0; f < frameCount; ++f) {
+    Array<Vector3> positions = molecule.coordinate3d(f);
+    ASSERT_EQ(positions.size(), 3u);
+    EXPECT_EQ(positions[2], Vector3(f, 2, -f)) << "frame " << f;
+  }
+}
+} // namespace
+
+TEST(XyzTest, readBatches)
+{
+  int frameCount;
+  const std::string text = trajectory(frameCount);
+
+  XyzFormat xyz;
+  Molecule molecule;
+  EXPECT_TRUE(xyz.readString(text, molecule)) << xyz.error();
+  expectFrames(molecule, frameCount);
+}
+
+TEST(XyzTest, readTruncatedFrame)
+{
+  int frameCount;
+  std::string text = trajectory(frameCount);
+  // Cut the last frame short by its last atom.
+  text.resize(text.rfind("C "));
+
+  // The frames before it are kept, but the trajectory is reported as broken.
+  XyzFormat xyz;
+  Molecule molecule;
+  EXPECT_FALSE(xyz.readString(text, molecule));
+  EXPECT_NE(xyz.error().find("Not enough atoms in the last frame."),
+            std::string::npos);
+  expectFrames(molecule, frameCount - 1);
+
+  // Frames read on demand from a file are reported the same way.
+  {
+    std::ofstream file("truncatedtmp.xyz", std::ofstream::binary);
+    file << text;
+  }
+  Molecule lazy;
+  XyzFormat format;
+  EXPECT_FALSE(format.readFile("truncatedtmp.xyz", lazy));
+  EXPECT_NE(format.error().find("Not enough atoms in the last frame."),
+            std::string::npos);
+  expectFrames(lazy, frameCount - 1);
+  std::remove("truncatedtmp.xyz");
+}
@@ -0,0 +1,332 @@
+/******************************************************************************
+  This source file is part of the Avogadro project.
+  This source code is released under the 3-Clause BSD License, (see "LICENSE").
+******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <avogadro/rendering/identifierbuffer.h>
+
+#ifdef AVO_USE_EGL
+#include <avogadro/rendering/ambientocclusionspheregeometry.h>
+#include <avogadro/rendering/camera.h>
+#include <avogadro/rendering/cylindergeometry.h>
+#include <avogadro/rendering/geometrynode.h>
+#include <avogadro/rendering/glrenderer.h>
+#include <avogadro/rendering/groupnode.h>
+#include <avogadro/rendering/shaderprogram.h>
+#include <avogadro/rendering/spheregeometry.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <set>
+#include <vector>
+
+using Avogadro::MaxIndex;
+using Avogadro::Vector2i;
+using Avogadro::Vector3f;
+using Avogadro::Vector3ub;
+using Avogadro::Rendering::AtomType;
+using Avogadro::Rendering::BondType;
+using Avogadro::Rendering::Identifier;
+using Avogadro::Rendering::IdentifierBuffer;
+using Avogadro::Rendering::InvalidType;
+using Avogadro::Rendering::Type;
+
+TEST(IdentifierBufferTest, colors)
+{
+  // Every index gets its own color, and none of them is the background.
+  std::set<unsigned int> values;
+  const size_t indices[] = { 0, 1, 254, 255, 256, 65535, 65536,
+                             IdentifierBuffer::maxIndex() - 1 };
+  for (size_t i = 0; i < sizeof(indices) / sizeof(indices[0]); ++i) {
+    Vector3ub color = IdentifierBuffer::color(indices[i]);
+    unsigned int value = color[0] | (color[1] << 8) | (color[2] << 16);
+    EXPECT_EQ(indices[i] + 1, value);
+    EXPECT_TRUE(values.insert(value).second);
+  }
+}
+
+TEST(IdentifierBufferTest, empty)
+{
+  // Nothing is found before the buffer is drawn.
+  IdentifierBuffer buffer;
+  EXPECT_TRUE(buffer.isEmpty());
+  EXPECT_EQ(InvalidType, buffer.hit(10, 10).type);
+  EXPECT_TRUE(buffer.hits(0, 0, 100, 100).empty());
+
+  std::vector<Vector2i> lasso;
+  lasso.push_back(Vector2i(0, 0));
+  lasso.push_back(Vector2i(100, 0));
+  lasso.push_back(Vector2i(50, 100));
+  EXPECT_TRUE(buffer.hits(lasso).empty());
+}
+
+namespace {
+
+// Set the pixel at the display coordinate (x,y) of a buffer two rows high.
+void setPixel(std::vector<unsigned char>& pixels, int width, int x, int y,
+              unsigned char number, size_t index)
+{
+  const size_t offset = 4 * (static_cast<size_t>(1 - y) * width + x);
+  const Vector3ub color = IdentifierBuffer::color(index);
+  pixels[offset] = color[0];
+  pixels[offset + 1] = color[1];
+  pixels[offset + 2] = color[2];
+  pixels[offset + 3] = number;
+}
+
+Identifier makeIdentifier(const void* molecule, Type type, size_t index)
+{
+  Identifier id;
+  id.molecule = molecule;
+  id.type = type;
+  id.index = index;
+  return id;
+}
+} // namespace
+
+TEST(IdentifierBufferTest, pixels)
+{
+  // Atoms of a molecule, its bonds, and its atoms again as in another
+  // drawable. The display, top row first:
+  //   atom 0, atom 0,   bond 1,   -
+  //   -,      atom 300, atom 300, atom 0
+  const int molecule = 0;
+  std::vector<Identifier> drawables;
+  drawables.push_back(makeIdentifier(&molecule, AtomType, MaxIndex));
+  drawables.push_back(makeIdentifier(&molecule, BondType, MaxIndex));
+  drawables.push_back(makeIdentifier(&molecule, AtomType, MaxIndex));
+  const int width = 4;
+  std::vector<unsigned char> pixels(4 * width * 2, 0);
+  setPixel(pixels, width, 0, 0, 1, 0);
+  setPixel(pixels, width, 1, 0, 1, 0);
+  setPixel(pixels, width, 2, 0, 2, 1);
+  setPixel(pixels, width, 1, 1, 1, 300);
+  setPixel(pixels, width, 2, 1, 1, 300);
+  setPixel(pixels, width, 3, 1, 3, 0);
+
+  IdentifierBuffer buffer;
+  ASSERT_TRUE(buffer.setPixels(pixels, width, 2, drawables));
+  EXPECT_FALSE(buffer.isEmpty());
+
+  const Identifier atom0 = makeIdentifier(&molecule, AtomType, 0);
+  const Identifier atom300 = makeIdentifier(&molecule, AtomType, 300);
+  const Identifier bond1 = makeIdentifier(&molecule, BondType, 1);
+  EXPECT_EQ(atom0, buffer.hit(0, 0));
+  EXPECT_EQ(bond1, buffer.hit(2, 0));
+  EXPECT_EQ(atom300, buffer.hit(2, 1));
+  EXPECT_EQ(atom0, buffer.hit(3, 1));
+  EXPECT_EQ(InvalidType, buffer.hit(3, 0).type);
+  EXPECT_EQ(InvalidType, buffer.hit(0, 1).type);
+  EXPECT_EQ(InvalidType, buffer.hit(-1, 0).type);
+  EXPECT_EQ(InvalidType, buffer.hit(4, 0).type);
+
+  // Boxes take in the pixels whose centers they cover, and find each
+  // primitive once.
+  std::vector<Identifier> hits = buffer.hits(0, 0, 4, 2);
+  ASSERT_EQ(3u, hits.size());
+  EXPECT_EQ(atom0, hits[0]);
+  EXPECT_EQ(atom300, hits[1]);
+  EXPECT_EQ(bond1, hits[2]);
+  hits = buffer.hits(4, 1, 2, 0);
+  ASSERT_EQ(1u, hits.size());
+  EXPECT_EQ(bond1, hits[0]);
+  hits = buffer.hits(0, 1, 2, 2);
+  ASSERT_EQ(1u, hits.size());
+  EXPECT_EQ(atom300, hits[0]);
+
+  // A lasso only takes in what is inside of it, not its bounding box.
+  std::vector<Vector2i> lasso;
+  lasso.push_back(Vector2i(0, 0));
+  lasso.push_back(Vector2i(3, 0));
+  lasso.push_back(Vector2i(0, 2));
+  hits = buffer.hits(lasso);
+  ASSERT_EQ(1u, hits.size());
+  EXPECT_EQ(atom0, hits[0]);
+
+  // Display coordinates are scaled to the pixels of high density displays.
+  ASSERT_TRUE(buffer.setPixels(pixels, width, 2, drawables, 2.0f));
+  EXPECT_EQ(bond1, buffer.hit(1, 0));
+  EXPECT_EQ(atom0, buffer.hit(0, 0));
+
+  // Pixels that do not fill the buffer are refused.
+  pixels.pop_back();
+  EXPECT_FALSE(buffer.setPixels(pixels, width, 2, drawables));
+  EXPECT_TRUE(buffer.isEmpty());
+  EXPECT_FALSE(buffer.error().empty());
+}
+
+#ifdef AVO_USE_EGL
+namespace {
+
+// An offscreen context drawing into a small pbuffer, made current while the
+// object lives.
+class OffscreenContext
+{
+public:
+  OffscreenContext(int width, int height)
+    : m_display(EGL_NO_DISPLAY), m_surface(EGL_NO_SURFACE),
+      m_context(EGL_NO_CONTEXT)
+  {
+    // Mesa offers a display without a window system, which is what servers
+    // running the tests have.
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) {
+      m_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                     EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (m_display == EGL_NO_DISPLAY)
+      m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (m_display == EGL_NO_DISPLAY ||
+        !eglInitialize(m_display, nullptr, nullptr)) {
+      m_display = EGL_NO_DISPLAY;
+      return;
+    }
+
+    const EGLint configAttributes[] = { EGL_SURFACE_TYPE,
+                                        EGL_PBUFFER_BIT,
+                                        EGL_RENDERABLE_TYPE,
+                                        EGL_OPENGL_BIT,
+                                        EGL_DEPTH_SIZE,
+                                        24,
+                                        EGL_NONE };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(m_display, configAttributes, &config, 1,
+                         &configCount) ||
+        configCount != 1 || !eglBindAPI(EGL_OPENGL_API)) {
+      return;
+    }
+    const EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height,
+                                         EGL_NONE };
+    m_surface = eglCreatePbufferSurface(m_display, config, surfaceAttributes);
+    m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, nullptr);
+    if (m_surface == EGL_NO_SURFACE || m_context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(m_display, m_surface, m_surface, m_context)) {
+      if (m_context != EGL_NO_CONTEXT)
+        eglDestroyContext(m_display, m_context);
+      m_context = EGL_NO_CONTEXT;
+    }
+  }
+
+  ~OffscreenContext()
+  {
+    if (m_display == EGL_NO_DISPLAY)
+      return;
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (m_context != EGL_NO_CONTEXT)
+      eglDestroyContext(m_display, m_context);
+    if (m_surface != EGL_NO_SURFACE)
+      eglDestroySurface(m_display, m_surface);
+    eglTerminate(m_display);
+  }
+
+  bool isValid() const { return m_context != EGL_NO_CONTEXT; }
+
+private:
+  EGLDisplay m_display;
+  EGLSurface m_surface;
+  EGLContext m_context;
+};
+
+// Get the display coordinate @a point is drawn at.
+Vector2i displayPosition(const Avogadro::Rendering::Camera& camera,
+                         const Vector3f& point)
+{
+  const Vector3f position = camera.project(point);
+  return Vector2i(static_cast<int>(position.x()),
+                  static_cast<int>(camera.height() - position.y()));
+}
+} // namespace
+
+TEST(IdentifierBufferTest, render)
+{
+  using Avogadro::Rendering::AmbientOcclusionSphereGeometry;
+  using Avogadro::Rendering::CylinderGeometry;
+  using Avogadro::Rendering::GeometryNode;
+  using Avogadro::Rendering::GLRenderer;
+  using Avogadro::Rendering::ShaderProgram;
+  using Avogadro::Rendering::SphereGeometry;
+
+  const int width = 200;
+  const int height = 100;
+  OffscreenContext context(width, height);
+  if (!context.isValid())
+    GTEST_SKIP() << "No offscreen OpenGL context is available.";
+  GLRenderer renderer;
+  renderer.initialize();
+  if (!renderer.isValid())
+    GTEST_SKIP() << renderer.error();
+  renderer.resize(width, height);
+
+  // Two atoms of a molecule and the bond between them, numbered as in the
+  // molecule.
+  const int molecule = 0;
+  GeometryNode* geometry = new GeometryNode;
+  renderer.scene().rootNode().addChild(geometry);
+  SphereGeometry* spheres = new SphereGeometry;
+  spheres->identifier().molecule = &molecule;
+  spheres->identifier().type = AtomType;
+  spheres->addSphere(Vector3f(-2.0f, 0.0f, 0.0f), Vector3ub(255, 0, 0), 1.0f);
+  spheres->addSphere(Vector3f(2.0f, 0.0f, 0.0f), Vector3ub(255, 0, 0), 1.0f);
+  geometry->addDrawable(spheres);
+  CylinderGeometry* cylinders = new CylinderGeometry;
+  cylinders->identifier().molecule = &molecule;
+  cylinders->identifier().type = BondType;
+  cylinders->addCylinder(Vector3f(-2.0f, 0.0f, 0.0f),
+                         Vector3f(2.0f, 0.0f, 0.0f), 0.3f,
+                         Vector3ub(0, 255, 0), Vector3ub(0, 255, 0), 7);
+  geometry->addDrawable(cylinders);
+  // The buffer is drawn after a frame, which sets up the projection.
+  renderer.resetCamera();
+  renderer.render();
+
+  IdentifierBuffer buffer;
+  const Avogadro::Rendering::Camera& camera = renderer.camera();
+  if (!ShaderProgram::instancedArraysSupported()) {
+    // Contexts older than 3.3 cannot draw the buffer, and say so.
+    EXPECT_FALSE(buffer.render(renderer.scene().rootNode(), camera,
+                               &renderer.shaderCache()));
+    EXPECT_FALSE(buffer.error().empty());
+    renderer.finalize();
+    GTEST_SKIP() << buffer.error();
+  }
+  ASSERT_TRUE(buffer.render(renderer.scene().rootNode(), camera,
+                            &renderer.shaderCache()))
+    << buffer.error();
+
+  const Vector2i atom1 = displayPosition(camera, Vector3f(2.0f, 0.0f, 0.0f));
+  const Vector2i bond = displayPosition(camera, Vector3f(0.0f, 0.0f, 0.0f));
+  EXPECT_EQ(makeIdentifier(&molecule, AtomType, 1),
+            buffer.hit(atom1.x(), atom1.y()));
+  EXPECT_EQ(makeIdentifier(&molecule, BondType, 7),
+            buffer.hit(bond.x(), bond.y()));
+  EXPECT_EQ(InvalidType, buffer.hit(1, 1).type);
+  std::vector<Identifier> hits = buffer.hits(0, 0, width, height);
+  ASSERT_EQ(3u, hits.size());
+  EXPECT_EQ(makeIdentifier(&molecule, AtomType, 0), hits[0]);
+  EXPECT_EQ(makeIdentifier(&molecule, AtomType, 1), hits[1]);
+  EXPECT_EQ(makeIdentifier(&molecule, BondType, 7), hits[2]);
+
+  // Ambient occlusion spheres cannot be drawn into the buffer, so rather than
+  // leave them out it fails, and the caller casts rays instead.
+  AmbientOcclusionSphereGeometry* aoSpheres =
+    new AmbientOcclusionSphereGeometry;
+  aoSpheres->identifier().molecule = &molecule;
+  aoSpheres->identifier().type = AtomType;
+  aoSpheres->addSphere(Vector3f(0.0f, 2.0f, 0.0f), Vector3ub(255, 0, 0), 1.0f);
+  geometry->addDrawable(aoSpheres);
+  EXPECT_FALSE(buffer.render(renderer.scene().rootNode(), camera,
+                             &renderer.shaderCache()));
+  EXPECT_FALSE(buffer.error().empty());
+  EXPECT_TRUE(buffer.isEmpty());
+
+  renderer.finalize();
+  buffer.releaseFramebuffer();
+}
+#endif
@@ -20,7 +20,11 @@
 #include <avogadro/rendering/geometrynode.h>
 #include <avogadro/rendering/spheregeometry.h>
 
+#include <map>
+
+using Avogadro::Rendering::AtomType;
 using Avogadro::Rendering::GeometryNode;
+using Avogadro::Rendering::Identifier;
 using Avogadro::Rendering::SphereGeometry;
 using Avogadro::Vector3f;
 using Avogadro::Vector3ub;
@@ -73,3 +77,72 @@ TEST(SphereGeometryTest, clear)
   node.clear();
   EXPECT_EQ(node.size(), static_cast<size_t>(0));
 }
+
+TEST(SphereGeometryTest, setSphere)
+{
+  SphereGeometry node;
+  node.addSphere(Vector3f(1.0, 2.0, 3.0), Vector3ub(200, 100, 50), 5.0);
+  node.addSphere(Vector3f(4.0, 5.0, 6.0), Vector3ub(50, 100, 200), 2.0);
+  node.setSphere(1, Vector3f(7.0, 8.0, 9.0), Vector3ub(0, 0, 255), 3.0);
+  EXPECT_EQ(node.size(), static_cast<size_t>(2));
+  EXPECT_EQ(node.spheres()[0].center, Vector3f(1.0, 2.0, 3.0));
+  EXPECT_EQ(node.spheres()[1].center, Vector3f(7.0, 8.0, 9.0));
+  EXPECT_EQ(node.spheres()[1].color, Vector3ub(0, 0, 255));
+  EXPECT_EQ(node.spheres()[1].radius, 3.0f);
+}
+
+TEST(SphereGeometryTest, hits)
+{
+  // A block of spheres, some of them overlapping.
+  SphereGeometry node;
+  node.identifier().type = AtomType;
+  for (int x = 0; x < 10; ++x) {
+    for (int y = 0; y < 10; ++y) {
+      for (int z = 0; z < 10; ++z) {
+        node.addSphere(Vector3f(2.0f * x, 2.0f * y, 2.0f * z),
+                       Vector3ub(200, 100, 50), 0.5f + 0.1f * (x % 6));
+      }
+    }
+  }
+
+  const Vector3f end(9.0f, 9.0f, 100.0f);
+  for (int i = 0; i < 20; ++i) {
+    const Vector3f origin(1.1f * i - 1.0f, 0.9f * i, -50.0f);
+    const Vector3f direction = (end - origin).normalized();
+    std::multimap<float, Identifier> hits =
+      node.hits(origin, end, direction);
+
+    // Every sphere the ray passes through is found.
+    size_t expected = 0;
+    for (size_t j = 0; j < node.size(); ++j) {
+      const Vector3f center = node.spheres()[j].center;
+      const Vector3f offset = center - origin;
+      const float along = offset.dot(direction);
+      if ((offset - along * direction).norm() < node.spheres()[j].radius)
+        ++expected;
+    }
+    EXPECT_EQ(expected, hits.size());
+
+    // The closest one is found on its own.
+    float distance;
+    Identifier id = node.hit(origin, end, direction, distance);
+    if (hits.empty()) {
+      EXPECT_EQ(Avogadro::Rendering::InvalidType, id.type);
+    } else {
+      EXPECT_EQ(hits.begin()->second.index, id.index);
+      EXPECT_FLOAT_EQ(hits.begin()->first, distance);
+    }
+  }
+
+  // Moving a sphere moves where it is picked.
+  const Vector3f origin(50.0f, 50.0f, -50.0f);
+  const Vector3f direction(0.0f, 0.0f, 1.0f);
+  float distance;
+  EXPECT_EQ(Avogadro::Rendering::InvalidType,
+            node.hit(origin, end, direction, distance).type);
+  node.setSphere(3, Vector3f(50.0f, 50.0f, 0.0f), Vector3ub(0, 0, 255), 1.0f);
+  Identifier id = node.hit(origin, end, direction, distance);
+  EXPECT_EQ(AtomType, id.type);
+  EXPECT_EQ(static_cast<size_t>(3), id.index);
+  EXPECT_FLOAT_EQ(49.0f, distance);
+}